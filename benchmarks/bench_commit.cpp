@@ -0,0 +1,88 @@
+//===- benchmarks/bench_commit.cpp ----------------------------------------===//
+//*  _                     _                                     _ _    *
+//* | |__   ___ _ __   ___| |__     ___ ___  _ __ ___  _ __ ___ (_) |_  *
+//* | '_ \ / _ \ '_ \ / __| '_ \   / __/ _ \| '_ ` _ \| '_ ` _ \| | __| *
+//* | |_) |  __/ | | | (__| | | | | (_| (_) | | | | | | | | | | | | |_  *
+//* |_.__/ \___|_| |_|\___|_| |_|  \___\___/|_| |_| |_|_| |_| |_|_|\__| *
+//*                                                                     *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file bench_commit.cpp
+/// \brief Benchmarks for transaction_base::commit().
+
+#include <algorithm>
+
+#include "pstore/core/hamt_map.hpp"
+#include "pstore/core/transaction.hpp"
+
+#include "harness.hpp"
+#include "store.hpp"
+
+namespace {
+
+    using pstore::bench::state;
+
+    /// The number of transactions committed by each of the commit benchmarks. The keys are split
+    /// evenly between them.
+    constexpr auto commits = std::size_t{16};
+
+    // commit_data
+    // ~~~~~~~~~~~
+    /// Commits transactions which contain only raw data: no index is modified. This measures the
+    /// fixed cost of writing and publishing the trailer.
+    void commit_data (state & s) {
+        pstore::bench::bench_store store{s.params ().store};
+        pstore::database & db = store.db ();
+        auto const per_commit = std::max (s.params ().keys / commits, std::size_t{1});
+        auto const value_size = std::max (s.params ().value_size, std::size_t{1});
+        s.set_items_per_sample (per_commit);
+
+        for (auto ctr = std::size_t{0}; ctr < commits; ++ctr) {
+            auto transaction = pstore::begin (db);
+            for (auto v = std::size_t{0}; v < per_commit; ++v) {
+                auto const ptr = transaction.alloc_rw<std::uint8_t> (value_size).first;
+                std::fill_n (ptr.get (), value_size, std::uint8_t{0xFF});
+            }
+            s.measure ([&transaction] () { transaction.commit (); });
+        }
+    }
+    PSTORE_BENCHMARK (commit_data);
+
+    // commit_index
+    // ~~~~~~~~~~~~
+    /// Commits transactions each of which adds a batch of keys to the fragment index. The commit
+    /// time is dominated by flushing the modified index nodes.
+    void commit_index (state & s) {
+        pstore::bench::bench_store store{s.params ().store};
+        pstore::database & db = store.db ();
+        auto const keys = pstore::bench::make_digests (s.params ().keys);
+        auto const per_commit = std::max (keys.size () / commits, std::size_t{1});
+        s.set_items_per_sample (per_commit);
+
+        auto it = std::begin (keys);
+        auto const end = std::end (keys);
+        while (it != end) {
+            auto transaction = pstore::begin (db);
+            auto const index = pstore::index::get_index<pstore::trailer::indices::fragment> (db);
+            auto const last = it + static_cast<std::ptrdiff_t> (
+                                       std::min (per_commit, static_cast<std::size_t> (end - it)));
+            for (; it != last; ++it) {
+                auto const addr = transaction.allocate (s.params ().value_size, 1U);
+                index->insert (transaction,
+                               std::make_pair (*it, pstore::extent<pstore::repo::fragment> (
+                                                        pstore::typed_address<pstore::repo::fragment> (
+                                                            addr),
+                                                        s.params ().value_size)));
+            }
+            s.measure ([&transaction] () { transaction.commit (); });
+        }
+    }
+    PSTORE_BENCHMARK (commit_index);
+
+} // end anonymous namespace
@@ -0,0 +1,120 @@
+//===- benchmarks/bench_getro.cpp -----------------------------------------===//
+//*  _                     _                  _              *
+//* | |__   ___ _ __   ___| |__     __ _  ___| |_ _ __ ___   *
+//* | '_ \ / _ \ '_ \ / __| '_ \   / _` |/ _ \ __| '__/ _ \  *
+//* | |_) |  __/ | | | (__| | | | | (_| |  __/ |_| | | (_) | *
+//* |_.__/ \___|_| |_|\___|_| |_|  \__, |\___|\__|_|  \___/  *
+//*                                |___/                     *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file bench_getro.cpp
+/// \brief Benchmarks for database::getro().
+
+#include <algorithm>
+
+#include "pstore/core/transaction.hpp"
+
+#include "harness.hpp"
+#include "store.hpp"
+
+namespace {
+
+    using pstore::bench::state;
+
+    // getro_region
+    // ~~~~~~~~~~~~
+    /// Reads values which each lie entirely within a single memory-mapped region.
+    void getro_region (state & s) {
+        pstore::bench::bench_store store{s.params ().store};
+        pstore::database & db = store.db ();
+        auto const value_size = std::max (s.params ().value_size, std::size_t{1});
+
+        std::vector<pstore::address> addrs;
+        addrs.reserve (s.params ().keys);
+        {
+            auto transaction = pstore::begin (db);
+            while (addrs.size () < s.params ().keys) {
+                std::shared_ptr<void> ptr;
+                pstore::address addr;
+                std::tie (ptr, addr) = transaction.alloc_rw (value_size, 1U);
+                if (!db.storage ().request_spans_regions (addr, value_size)) {
+                    std::memset (ptr.get (), 0xFF, value_size);
+                    addrs.push_back (addr);
+                }
+            }
+            transaction.commit ();
+        }
+        std::shuffle (std::begin (addrs), std::end (addrs), std::mt19937_64{});
+
+        auto sum = 0U;
+        s.measure_each (addrs.size (), [&] (std::size_t const n) {
+            auto const ptr = db.getro (addrs[n], value_size);
+            sum += *static_cast<std::uint8_t const *> (ptr.get ());
+        });
+        if (sum != 0xFF * addrs.size ()) {
+            s.set_label ("ERROR: bad data");
+        }
+    }
+    PSTORE_BENCHMARK (getro_region);
+
+    // getro_spanning
+    // ~~~~~~~~~~~~~~
+    /// Reads values which straddle a region boundary and must therefore be serviced by
+    /// database::get_spanning().
+    void getro_spanning (state & s) {
+        auto const value_size = s.params ().value_size;
+        if (value_size < 2U) {
+            s.set_label ("skipped: value size must be at least 2");
+            return;
+        }
+        pstore::bench::bench_store store{s.params ().store};
+        pstore::database & db = store.db ();
+
+        // Build a small number of values, each positioned so that it crosses the boundary between
+        // two regions. Regions are multiples of the segment size so we aim for those boundaries.
+        constexpr auto num_values = std::size_t{4};
+        constexpr auto max_attempts = 64U;
+        std::vector<pstore::address> addrs;
+        {
+            auto transaction = pstore::begin (db);
+            for (auto attempt = 0U; attempt < max_attempts && addrs.size () < num_values;
+                 ++attempt) {
+                auto const boundary =
+                    (db.size () / pstore::address::segment_size + 1U) * pstore::address::segment_size;
+                auto const start = boundary - value_size / 2U;
+                if (start > db.size ()) {
+                    transaction.allocate (start - db.size (), 1U);
+                }
+                std::shared_ptr<void> ptr;
+                pstore::address addr;
+                std::tie (ptr, addr) = transaction.alloc_rw (value_size, 1U);
+                std::memset (ptr.get (), 0xFF, value_size);
+                if (db.storage ().request_spans_regions (addr, value_size)) {
+                    addrs.push_back (addr);
+                }
+            }
+            transaction.commit ();
+        }
+        if (addrs.empty ()) {
+            s.set_label ("skipped: no spanning values");
+            return;
+        }
+
+        auto sum = 0U;
+        s.measure_each (s.params ().keys, [&] (std::size_t const n) {
+            auto const ptr = db.getro (addrs[n % addrs.size ()], value_size);
+            sum += *static_cast<std::uint8_t const *> (ptr.get ());
+        });
+        if (sum != 0xFF * s.params ().keys) {
+            s.set_label ("ERROR: bad data");
+        }
+    }
+    PSTORE_BENCHMARK (getro_spanning);
+
+} // end anonymous namespace
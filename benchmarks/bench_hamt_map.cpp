@@ -0,0 +1,230 @@
+//===- benchmarks/bench_hamt_map.cpp --------------------------------------===//
+//*  _                     _       _                     _                            *
+//* | |__   ___ _ __   ___| |__   | |__   __ _ _ __ ___ | |_   _ __ ___   __ _ _ __   *
+//* | '_ \ / _ \ '_ \ / __| '_ \  | '_ \ / _` | '_ ` _ \| __| | '_ ` _ \ / _` | '_ \  *
+//* | |_) |  __/ | | | (__| | | | | | | | (_| | | | | | | |_  | | | | | | (_| | |_) | *
+//* |_.__/ \___|_| |_|\___|_| |_| |_| |_|\__,_|_| |_| |_|\__| |_| |_| |_|\__,_| .__/  *
+//*                                                                           |_|     *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file bench_hamt_map.cpp
+/// \brief Benchmarks for hamt_map lookup and insertion.
+
+#include <algorithm>
+
+#include "pstore/core/hamt_map.hpp"
+#include "pstore/core/transaction.hpp"
+
+#include "harness.hpp"
+#include "store.hpp"
+
+namespace {
+
+    using pstore::bench::state;
+
+    /// Writes a value of the requested size to the store and returns its extent.
+    pstore::extent<pstore::repo::fragment> write_value (pstore::transaction_base & transaction,
+                                                        std::size_t const size) {
+        std::shared_ptr<std::uint8_t> ptr;
+        auto addr = pstore::typed_address<std::uint8_t>::null ();
+        std::tie (ptr, addr) = transaction.alloc_rw<std::uint8_t> (std::max (size, std::size_t{1}));
+        std::fill_n (ptr.get (), size, std::uint8_t{0xFF});
+        return {pstore::typed_address<pstore::repo::fragment> (addr.to_address ()), size};
+    }
+
+    /// Populates the fragment index of \p db with the given keys and commits the result.
+    void populate_fragments (pstore::database & db,
+                             std::vector<pstore::index::digest> const & keys,
+                             std::size_t const value_size) {
+        auto transaction = pstore::begin (db);
+        auto const index = pstore::index::get_index<pstore::trailer::indices::fragment> (db);
+        for (auto const & key : keys) {
+            index->insert (transaction, std::make_pair (key, write_value (transaction, value_size)));
+        }
+        transaction.commit ();
+    }
+
+    // hamt_find_hit
+    // ~~~~~~~~~~~~~
+    /// Looks up each of the keys in a committed fragment index.
+    void hamt_find_hit (state & s) {
+        pstore::bench::bench_store store{s.params ().store};
+        pstore::database & db = store.db ();
+        auto keys = pstore::bench::make_digests (s.params ().keys);
+        populate_fragments (db, keys, s.params ().value_size);
+
+        // Visit the keys in an order that's unrelated to the insertion order.
+        std::shuffle (std::begin (keys), std::end (keys), std::mt19937_64{});
+
+        auto const index = pstore::index::get_index<pstore::trailer::indices::fragment> (db);
+        auto const end = index->cend (db);
+        auto found = std::size_t{0};
+        s.measure_each (keys.size (), [&] (std::size_t const n) {
+            found += static_cast<std::size_t> (index->find (db, keys[n]) != end);
+        });
+        if (found != keys.size ()) {
+            s.set_label ("ERROR: keys missing");
+        }
+    }
+    PSTORE_BENCHMARK (hamt_find_hit);
+
+    /// Looks up all of the keys in a committed fragment index with a single call to \p fn which
+    /// is either find_batch() or parallel_find_batch().
+    template <typename Function>
+    void find_batch_hit (state & s, Function fn) {
+        pstore::bench::bench_store store{s.params ().store};
+        pstore::database & db = store.db ();
+        auto keys = pstore::bench::make_digests (s.params ().keys);
+        populate_fragments (db, keys, s.params ().value_size);
+        std::shuffle (std::begin (keys), std::end (keys), std::mt19937_64{});
+
+        auto const index = pstore::index::get_index<pstore::trailer::indices::fragment> (db);
+        auto const end = index->cend (db);
+        auto found = std::size_t{0};
+        s.set_items_per_sample (keys.size ());
+        s.measure ([&] () {
+            for (auto const & it : fn (*index, db, keys)) {
+                found += static_cast<std::size_t> (it != end);
+            }
+        });
+        if (found != keys.size ()) {
+            s.set_label ("ERROR: keys missing");
+        }
+    }
+
+    // hamt_find_batch
+    // ~~~~~~~~~~~~~~~
+    /// Looks up all of the keys in a committed fragment index using find_batch().
+    void hamt_find_batch (state & s) {
+        find_batch_hit (s, [] (pstore::index::fragment_index const & index,
+                               pstore::database const & db,
+                               std::vector<pstore::index::digest> const & keys) {
+            return index.find_batch (db, std::begin (keys), std::end (keys));
+        });
+    }
+    PSTORE_BENCHMARK (hamt_find_batch);
+
+    // hamt_parallel_find_batch
+    // ~~~~~~~~~~~~~~~~~~~~~~~~
+    /// Looks up all of the keys in a committed fragment index using parallel_find_batch().
+    void hamt_parallel_find_batch (state & s) {
+        find_batch_hit (s, [] (pstore::index::fragment_index const & index,
+                               pstore::database const & db,
+                               std::vector<pstore::index::digest> const & keys) {
+            return index.parallel_find_batch (db, std::begin (keys), std::end (keys));
+        });
+    }
+    PSTORE_BENCHMARK (hamt_parallel_find_batch);
+
+    // hamt_find_miss
+    // ~~~~~~~~~~~~~~
+    /// Looks up keys which are not present in a committed fragment index.
+    void hamt_find_miss (state & s) {
+        pstore::bench::bench_store store{s.params ().store};
+        pstore::database & db = store.db ();
+        auto const num_keys = s.params ().keys;
+        // Generate twice as many keys as we need: the first half are inserted into the index; the
+        // second half are used for the search.
+        auto const keys = pstore::bench::make_digests (num_keys * 2U);
+        populate_fragments (
+            db, std::vector<pstore::index::digest> (std::begin (keys), std::begin (keys) + num_keys),
+            s.params ().value_size);
+
+        auto const index = pstore::index::get_index<pstore::trailer::indices::fragment> (db);
+        auto const end = index->cend (db);
+        auto found = std::size_t{0};
+        s.measure_each (num_keys, [&] (std::size_t const n) {
+            found += static_cast<std::size_t> (index->find (db, keys[num_keys + n]) != end);
+        });
+        if (found != 0U) {
+            s.set_label ("ERROR: unexpected keys");
+        }
+    }
+    PSTORE_BENCHMARK (hamt_find_miss);
+
+    // hamt_find_string
+    // ~~~~~~~~~~~~~~~~
+    /// Looks up each of the keys in a committed write index. The value size parameter is used as
+    /// the key length.
+    void hamt_find_string (state & s) {
+        pstore::bench::bench_store store{s.params ().store};
+        pstore::database & db = store.db ();
+        auto keys = pstore::bench::make_strings (s.params ().keys,
+                                                 std::max (s.params ().value_size, std::size_t{8}));
+        {
+            auto transaction = pstore::begin (db);
+            auto const index = pstore::index::get_index<pstore::trailer::indices::write> (db);
+            for (auto const & key : keys) {
+                index->insert (transaction,
+                               std::make_pair (key, pstore::extent<char> (
+                                                        pstore::typed_address<char>::null (), 0U)));
+            }
+            transaction.commit ();
+        }
+        std::shuffle (std::begin (keys), std::end (keys), std::mt19937_64{});
+
+        auto const index = pstore::index::get_index<pstore::trailer::indices::write> (db);
+        auto const end = index->cend (db);
+        auto found = std::size_t{0};
+        s.measure_each (keys.size (), [&] (std::size_t const n) {
+            found += static_cast<std::size_t> (index->find (db, keys[n]) != end);
+        });
+        if (found != keys.size ()) {
+            s.set_label ("ERROR: keys missing");
+        }
+    }
+    PSTORE_BENCHMARK (hamt_find_string);
+
+    // hamt_insert
+    // ~~~~~~~~~~~
+    /// Inserts keys into the fragment index within a single transaction. The time to write each
+    /// value is excluded.
+    void hamt_insert (state & s) {
+        pstore::bench::bench_store store{s.params ().store};
+        pstore::database & db = store.db ();
+        auto const keys = pstore::bench::make_digests (s.params ().keys);
+
+        auto transaction = pstore::begin (db);
+        auto const index = pstore::index::get_index<pstore::trailer::indices::fragment> (db);
+        for (auto const & key : keys) {
+            auto const value = write_value (transaction, s.params ().value_size);
+            s.measure ([&] () { index->insert (transaction, std::make_pair (key, value)); });
+        }
+        transaction.commit ();
+    }
+    PSTORE_BENCHMARK (hamt_insert);
+
+    // hamt_bulk_insert
+    // ~~~~~~~~~~~~~~~~
+    /// Builds the fragment index from all of the keys with a single call to bulk_insert(). The
+    /// time includes flushing the index so that it is comparable with hamt_insert plus commit.
+    void hamt_bulk_insert (state & s) {
+        pstore::bench::bench_store store{s.params ().store};
+        pstore::database & db = store.db ();
+        auto const keys = pstore::bench::make_digests (s.params ().keys);
+
+        auto transaction = pstore::begin (db);
+        std::vector<std::pair<pstore::index::digest, pstore::extent<pstore::repo::fragment>>>
+            values;
+        values.reserve (keys.size ());
+        for (auto const & key : keys) {
+            values.emplace_back (key, write_value (transaction, s.params ().value_size));
+        }
+
+        auto const index = pstore::index::get_index<pstore::trailer::indices::fragment> (db);
+        s.set_items_per_sample (values.size ());
+        s.measure ([&] () {
+            index->bulk_insert (transaction, std::begin (values), std::end (values));
+            index->flush (transaction, db.get_current_revision ());
+        });
+        transaction.commit ();
+    }
+    PSTORE_BENCHMARK (hamt_bulk_insert);
+
+} // end anonymous namespace
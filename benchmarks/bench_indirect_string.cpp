@@ -0,0 +1,62 @@
+//===- benchmarks/bench_indirect_string.cpp -------------------------------===//
+//*  _                     _       _           _ _               _         _        _              *
+//* | |__   ___ _ __   ___| |__   (_)_ __   __| (_)_ __ ___  ___| |_   ___| |_ _ __(_)_ __   __ _  *
+//* | '_ \ / _ \ '_ \ / __| '_ \  | | '_ \ / _` | | '__/ _ \/ __| __| / __| __| '__| | '_ \ / _` | *
+//* | |_) |  __/ | | | (__| | | | | | | | | (_| | | | |  __/ (__| |_  \__ \ |_| |  | | | | | (_| | *
+//* |_.__/ \___|_| |_|\___|_| |_| |_|_| |_|\__,_|_|_|  \___|\___|\__| |___/\__|_|  |_|_| |_|\__, | *
+//*                                                                                         |___/  *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file bench_indirect_string.cpp
+/// \brief Benchmarks for indirect_string_adder.
+
+#include "pstore/core/hamt_set.hpp"
+#include "pstore/core/transaction.hpp"
+
+#include "harness.hpp"
+#include "store.hpp"
+
+namespace {
+
+    using pstore::bench::state;
+
+    constexpr auto repetitions = std::size_t{8};
+
+    // string_adder_flush
+    // ~~~~~~~~~~~~~~~~~~
+    /// Measures indirect_string_adder::flush() writing the bodies of a batch of new strings. The
+    /// value size parameter is used as the string length.
+    void string_adder_flush (state & s) {
+        pstore::bench::bench_store store{s.params ().store};
+        pstore::database & db = store.db ();
+        auto const length = std::max (s.params ().value_size, std::size_t{1});
+        auto const strings = pstore::bench::make_strings (s.params ().keys * repetitions, length);
+
+        std::vector<pstore::raw_sstring_view> views;
+        views.reserve (strings.size ());
+        for (auto const & str : strings) {
+            views.push_back (pstore::make_sstring_view (str));
+        }
+        s.set_items_per_sample (s.params ().keys);
+
+        auto it = std::begin (views);
+        for (auto rep = std::size_t{0}; rep < repetitions; ++rep) {
+            auto transaction = pstore::begin (db);
+            auto const name_index = pstore::index::get_index<pstore::trailer::indices::name> (db);
+            pstore::indirect_string_adder adder{s.params ().keys};
+            for (auto ctr = std::size_t{0}; ctr < s.params ().keys; ++ctr, ++it) {
+                adder.add (transaction, name_index, &*it);
+            }
+            s.measure ([&] () { adder.flush (transaction); });
+            transaction.commit ();
+        }
+    }
+    PSTORE_BENCHMARK (string_adder_flush);
+
+} // end anonymous namespace
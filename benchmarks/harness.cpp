@@ -0,0 +1,142 @@
+//===- benchmarks/harness.cpp ---------------------------------------------===//
+//*  _                                     *
+//* | |__   __ _ _ __ _ __   ___  ___ ___  *
+//* | '_ \ / _` | '__| '_ \ / _ \/ __/ __| *
+//* | | | | (_| | |  | | | |  __/\__ \__ \ *
+//* |_| |_|\__,_|_|  |_| |_|\___||___/___/ *
+//*                                        *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file harness.cpp
+/// \brief The implementation of the micro-benchmark harness.
+
+#include "harness.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <ostream>
+#include <sstream>
+
+#include "pstore/support/assert.hpp"
+#include "pstore/support/ios_state.hpp"
+
+namespace {
+
+    using duration = pstore::bench::state::duration;
+
+    /// Returns the sample at the given percentile of a sorted collection of samples (using the
+    /// nearest-rank method).
+    duration percentile (std::vector<duration> const & sorted, unsigned const pc) {
+        PSTORE_ASSERT (!sorted.empty () && pc <= 100U);
+        auto const rank = (sorted.size () * pc + 99U) / 100U;
+        return sorted[std::max (rank, std::size_t{1}) - 1U];
+    }
+
+    std::string format_duration (duration const d) {
+        std::ostringstream os;
+        auto const ns = d.count ();
+        if (ns < 10000) {
+            os << ns << "ns";
+        } else if (ns < 10000000) {
+            os << ns / 1000 << "us";
+        } else {
+            os << ns / 1000000 << "ms";
+        }
+        return os.str ();
+    }
+
+} // end anonymous namespace
+
+namespace pstore {
+    namespace bench {
+
+        // to_string
+        // ~~~~~~~~~
+        char const * to_string (store_kind const kind) noexcept {
+            switch (kind) {
+            case store_kind::memory: return "mem";
+            case store_kind::file: return "file";
+            }
+            PSTORE_ASSERT (false);
+            return "";
+        }
+
+        // registry
+        // ~~~~~~~~
+        std::vector<benchmark> & registry () {
+            static std::vector<benchmark> benchmarks;
+            return benchmarks;
+        }
+
+        // registration
+        // ~~~~~~~~~~~~
+        registration::registration (char const * const name, benchmark_function fn) {
+            registry ().push_back (benchmark{name, std::move (fn)});
+        }
+
+        // summarize
+        // ~~~~~~~~~
+        results summarize (state const & s) {
+            results r;
+            std::vector<duration> sorted = s.samples ();
+            r.samples = sorted.size ();
+            if (sorted.empty ()) {
+                return r;
+            }
+            std::sort (std::begin (sorted), std::end (sorted));
+
+            auto const total = std::accumulate (std::begin (sorted), std::end (sorted), duration{0});
+            r.mean = total / static_cast<duration::rep> (sorted.size ());
+            r.p50 = percentile (sorted, 50U);
+            r.p90 = percentile (sorted, 90U);
+            r.p99 = percentile (sorted, 99U);
+            r.max = sorted.back ();
+            if (total.count () > 0) {
+                r.items_per_second = static_cast<double> (sorted.size () * s.items_per_sample ()) /
+                                     std::chrono::duration<double> (total).count ();
+            }
+            return r;
+        }
+
+        // report_header
+        // ~~~~~~~~~~~~~
+        void report_header (std::ostream & os) {
+            ios_flags_saver const flags{os};
+            os << std::left << std::setw (40) << "Benchmark" << std::right << std::setw (10)
+               << "Samples" << std::setw (14) << "Items/s" << std::setw (10) << "Mean"
+               << std::setw (10) << "p50" << std::setw (10) << "p90" << std::setw (10) << "p99"
+               << std::setw (10) << "Max" << '\n'
+               << std::string (114, '-') << '\n';
+        }
+
+        // report
+        // ~~~~~~
+        void report (std::ostream & os, std::string const & name, parameters const & p,
+                     state const & s) {
+            ios_flags_saver const flags{os};
+            std::ostringstream full_name;
+            full_name << name << '/' << p.keys << '/' << p.value_size << '/'
+                      << to_string (p.store);
+
+            results const r = summarize (s);
+            os << std::left << std::setw (40) << full_name.str () << std::right << std::setw (10)
+               << r.samples << std::setw (14) << std::fixed << std::setprecision (0)
+               << r.items_per_second << std::setw (10) << format_duration (r.mean)
+               << std::setw (10) << format_duration (r.p50) << std::setw (10)
+               << format_duration (r.p90) << std::setw (10) << format_duration (r.p99)
+               << std::setw (10) << format_duration (r.max);
+            if (!s.label ().empty ()) {
+                os << ' ' << s.label ();
+            }
+            os << '\n';
+        }
+
+    } // end namespace bench
+} // end namespace pstore
@@ -0,0 +1,153 @@
+//===- benchmarks/harness.hpp -----------------------------*- mode: C++ -*-===//
+//*  _                                     *
+//* | |__   __ _ _ __ _ __   ___  ___ ___  *
+//* | '_ \ / _` | '__| '_ \ / _ \/ __/ __| *
+//* | | | | (_| | |  | | | |  __/\__ \__ \ *
+//* |_| |_|\__,_|_|  |_| |_|\___||___/___/ *
+//*                                        *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file harness.hpp
+/// \brief A small micro-benchmark harness in the style of Google Benchmark.
+///
+/// Each benchmark is a function which is registered by name and invoked once for every
+/// combination of the parameters (key count, value size, store kind) requested on the command
+/// line. A benchmark times each of its operations through the supplied state object; the harness
+/// then reports the overall throughput and the latency distribution of those operations.
+
+#ifndef PSTORE_BENCHMARKS_HARNESS_HPP
+#define PSTORE_BENCHMARKS_HARNESS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace pstore {
+    namespace bench {
+
+        /// Selects the type of storage which backs the database used by a benchmark.
+        enum class store_kind {
+            memory, ///< An in-memory file using region::mem_based_factory.
+            file,   ///< A temporary disk file using region::file_based_factory.
+        };
+
+        char const * to_string (store_kind kind) noexcept;
+
+        struct parameters {
+            /// The number of keys (or operations) that the benchmark should use.
+            std::size_t keys = 0;
+            /// The number of bytes in each value written by the benchmark.
+            std::size_t value_size = 0;
+            /// The type of storage used by the benchmark's database.
+            store_kind store = store_kind::memory;
+        };
+
+        /// The state object is passed to each benchmark function. It provides the benchmark's
+        /// parameters and records the time taken by each measured operation.
+        class state {
+        public:
+            using clock = std::chrono::steady_clock;
+            using duration = std::chrono::nanoseconds;
+
+            explicit state (parameters const & p)
+                    : params_{p} {}
+
+            parameters const & params () const noexcept { return params_; }
+
+            /// Calls \p f once and records the time that it took as a single sample.
+            template <typename Function>
+            void measure (Function f) {
+                auto const start = clock::now ();
+                f ();
+                this->add_sample (clock::now () - start);
+            }
+
+            /// Calls \p f \p count times, passing the iteration number each time. Each call is
+            /// recorded as a separate sample.
+            template <typename Function>
+            void measure_each (std::size_t const count, Function f) {
+                samples_.reserve (samples_.size () + count);
+                for (auto ctr = std::size_t{0}; ctr < count; ++ctr) {
+                    auto const start = clock::now ();
+                    f (ctr);
+                    this->add_sample (clock::now () - start);
+                }
+            }
+
+            /// Records the number of items processed by each sample. This is used to compute the
+            /// throughput when a single sample covers more than one logical operation (for example,
+            /// the commit of a transaction containing many keys).
+            void set_items_per_sample (std::size_t const n) noexcept { items_per_sample_ = n; }
+            std::size_t items_per_sample () const noexcept { return items_per_sample_; }
+
+            /// Records a short string which is displayed alongside the results.
+            void set_label (std::string label) { label_ = std::move (label); }
+            std::string const & label () const noexcept { return label_; }
+
+            std::vector<duration> const & samples () const noexcept { return samples_; }
+
+        private:
+            void add_sample (clock::duration const d) {
+                samples_.push_back (std::chrono::duration_cast<duration> (d));
+            }
+
+            parameters params_;
+            std::vector<duration> samples_;
+            std::size_t items_per_sample_ = 1;
+            std::string label_;
+        };
+
+        using benchmark_function = std::function<void (state &)>;
+
+        struct benchmark {
+            std::string name;
+            benchmark_function fn;
+        };
+
+        /// Returns the collection of registered benchmarks.
+        std::vector<benchmark> & registry ();
+
+        /// Instances of this type are used to register a benchmark function at static
+        /// initialization time.
+        struct registration {
+            registration (char const * name, benchmark_function fn);
+        };
+
+        /// The summary statistics derived from a completed benchmark's samples.
+        struct results {
+            std::size_t samples = 0;
+            double items_per_second = 0.0;
+            state::duration mean{0};
+            state::duration p50{0};
+            state::duration p90{0};
+            state::duration p99{0};
+            state::duration max{0};
+        };
+
+        results summarize (state const & s);
+
+        void report_header (std::ostream & os);
+        void report (std::ostream & os, std::string const & name, parameters const & p,
+                     state const & s);
+
+    } // end namespace bench
+} // end namespace pstore
+
+#define PSTORE_BENCH_CONCAT2(a, b) a##b
+#define PSTORE_BENCH_CONCAT(a, b) PSTORE_BENCH_CONCAT2 (a, b)
+
+/// Registers a function with signature void(pstore::bench::state &) as a benchmark.
+#define PSTORE_BENCHMARK(fn)                                                                       \
+    static ::pstore::bench::registration const PSTORE_BENCH_CONCAT (fn##_registration_,          \
+                                                                    __LINE__) {#fn, fn}
+
+#endif // PSTORE_BENCHMARKS_HARNESS_HPP
@@ -0,0 +1,135 @@
+//===- benchmarks/main.cpp ------------------------------------------------===//
+//*                  _        *
+//*  _ __ ___   __ _(_)_ __   *
+//* | '_ ` _ \ / _` | | '_ \  *
+//* | | | | | | (_| | | | | | *
+//* |_| |_| |_|\__,_|_|_| |_| *
+//*                           *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file main.cpp
+/// \brief The entry point for the pstore micro-benchmark suite.
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+#include "pstore/command_line/command_line.hpp"
+#include "pstore/command_line/tchar.hpp"
+#include "pstore/support/portab.hpp"
+#include "pstore/support/utf.hpp"
+
+#include "harness.hpp"
+
+namespace {
+
+    enum class store_selection { memory, file, both };
+
+    using namespace pstore::command_line;
+
+    opt<std::string> filter_opt{"filter",
+                                desc ("Run only the benchmarks whose names contain this string")};
+    list<unsigned> keys_opt{"keys",
+                            desc ("The number of keys used by each benchmark (Default: 1000,10000)"),
+                            comma_separated};
+    list<unsigned> value_size_opt{
+        "value-size", desc ("The size in bytes of the values written by each benchmark (Default: 64)"),
+        comma_separated};
+    opt<store_selection> store_opt{
+        "store", desc ("The type of storage used by the benchmarks"),
+        values (literal{"memory", static_cast<int> (store_selection::memory), "In-memory stores"},
+                literal{"file", static_cast<int> (store_selection::file), "Temporary disk files"},
+                literal{"both", static_cast<int> (store_selection::both),
+                        "Run each benchmark with both memory and file stores"}),
+        init (store_selection::memory)};
+    opt<bool> list_opt{"list", desc ("List the available benchmarks and exit")};
+
+    template <typename T>
+    std::vector<std::size_t> values_or (list<T> const & option,
+                                        std::initializer_list<std::size_t> const & defaults) {
+        if (option.empty ()) {
+            return {defaults};
+        }
+        return {std::begin (option), std::end (option)};
+    }
+
+    std::vector<pstore::bench::store_kind> store_kinds () {
+        switch (store_opt.get ()) {
+        case store_selection::memory: return {pstore::bench::store_kind::memory};
+        case store_selection::file: return {pstore::bench::store_kind::file};
+        case store_selection::both:
+            return {pstore::bench::store_kind::memory, pstore::bench::store_kind::file};
+        }
+        return {};
+    }
+
+} // end anonymous namespace
+
+#ifdef _WIN32
+int _tmain (int argc, TCHAR * argv[]) {
+#else
+int main (int argc, char * argv[]) {
+#endif
+    int exit_code = EXIT_SUCCESS;
+
+    using pstore::utf::to_native_string;
+
+    PSTORE_TRY {
+        parse_command_line_options (argc, argv, "pstore micro-benchmarks\n");
+
+        auto const & benchmarks = pstore::bench::registry ();
+        if (list_opt.get ()) {
+            for (pstore::bench::benchmark const & b : benchmarks) {
+                std::cout << b.name << '\n';
+            }
+            return exit_code;
+        }
+
+        auto const keys = values_or (keys_opt, {1000U, 10000U});
+        auto const value_sizes = values_or (value_size_opt, {64U});
+        auto const kinds = store_kinds ();
+
+        pstore::bench::report_header (std::cout);
+        for (pstore::bench::benchmark const & b : benchmarks) {
+            if (b.name.find (filter_opt.get ()) == std::string::npos) {
+                continue;
+            }
+            for (auto const kind : kinds) {
+                for (auto const k : keys) {
+                    for (auto const vs : value_sizes) {
+                        pstore::bench::parameters p;
+                        p.keys = k;
+                        p.value_size = vs;
+                        p.store = kind;
+
+                        pstore::bench::state s{p};
+                        b.fn (s);
+                        pstore::bench::report (std::cout, b.name, p, s);
+                    }
+                }
+            }
+        }
+    }
+    // clang-format off
+    PSTORE_CATCH (std::exception const & ex, { // clang-format on
+        auto what = ex.what ();
+        pstore::command_line::error_stream << NATIVE_TEXT ("An error occurred: ")
+                                           << to_native_string (what) << std::endl;
+        exit_code = EXIT_FAILURE;
+    })
+    // clang-format off
+    PSTORE_CATCH (..., { // clang-format on
+        pstore::command_line::error_stream << NATIVE_TEXT ("An unknown error occurred.")
+                                           << std::endl;
+        exit_code = EXIT_FAILURE;
+    })
+    // clang-format on
+
+    return exit_code;
+}
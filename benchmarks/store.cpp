@@ -0,0 +1,102 @@
+//===- benchmarks/store.cpp -----------------------------------------------===//
+//*      _                  *
+//*  ___| |_ ___  _ __ ___  *
+//* / __| __/ _ \| '__/ _ \ *
+//* \__ \ || (_) | | |  __/ *
+//* |___/\__\___/|_|  \___| *
+//*                         *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file store.cpp
+/// \brief Creates the empty data stores used by the benchmarks.
+
+#include "store.hpp"
+
+#include <unordered_set>
+
+#include "pstore/os/memory_mapper.hpp"
+
+namespace pstore {
+    namespace bench {
+
+        constexpr std::size_t bench_store::memory_capacity;
+
+        // (ctor)
+        // ~~~~~~
+        bench_store::bench_store (store_kind const kind) {
+            switch (kind) {
+            case store_kind::memory: {
+                constexpr auto page_size = 4096U;
+                buffer_ = aligned_valloc (memory_capacity, page_size);
+                auto file = std::make_shared<file::in_memory> (buffer_, memory_capacity);
+                database::build_new_store (*file);
+                file_ = file;
+                db_ = std::make_unique<database> (file);
+            } break;
+            case store_kind::file: {
+                auto file = std::make_shared<file::file_handle> ();
+                file->open (file::file_handle::temporary{});
+                database::build_new_store (*file);
+                file_ = file;
+                db_ = std::make_unique<database> (file);
+            } break;
+            }
+            db_->set_vacuum_mode (database::vacuum_mode::disabled);
+        }
+
+        // (dtor)
+        // ~~~~~~
+        bench_store::~bench_store () noexcept = default;
+
+        // string
+        // ~~~~~~
+        std::string key_generator::string (std::size_t const length) {
+            static constexpr char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789_";
+            std::string result;
+            result.reserve (length);
+            while (result.length () < length) {
+                result += alphabet[engine_ () % (sizeof (alphabet) - 1U)];
+            }
+            return result;
+        }
+
+        // make_digests
+        // ~~~~~~~~~~~~
+        std::vector<index::digest> make_digests (std::size_t const count) {
+            key_generator gen;
+            std::unordered_set<index::digest, index::u128_hash> seen;
+            std::vector<index::digest> result;
+            result.reserve (count);
+            while (result.size () < count) {
+                auto const d = gen.digest ();
+                if (seen.insert (d).second) {
+                    result.push_back (d);
+                }
+            }
+            return result;
+        }
+
+        // make_strings
+        // ~~~~~~~~~~~~
+        std::vector<std::string> make_strings (std::size_t const count, std::size_t const length) {
+            key_generator gen;
+            std::unordered_set<std::string> seen;
+            std::vector<std::string> result;
+            result.reserve (count);
+            while (result.size () < count) {
+                auto s = gen.string (length);
+                if (seen.insert (s).second) {
+                    result.push_back (std::move (s));
+                }
+            }
+            return result;
+        }
+
+    } // end namespace bench
+} // end namespace pstore
@@ -0,0 +1,76 @@
+//===- benchmarks/store.hpp -------------------------------*- mode: C++ -*-===//
+//*      _                  *
+//*  ___| |_ ___  _ __ ___  *
+//* / __| __/ _ \| '__/ _ \ *
+//* \__ \ || (_) | | |  __/ *
+//* |___/\__\___/|_|  \___| *
+//*                         *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file store.hpp
+/// \brief Creates the empty data stores used by the benchmarks.
+
+#ifndef PSTORE_BENCHMARKS_STORE_HPP
+#define PSTORE_BENCHMARKS_STORE_HPP
+
+#include <memory>
+#include <random>
+
+#include "pstore/core/database.hpp"
+#include "pstore/core/index_types.hpp"
+
+#include "harness.hpp"
+
+namespace pstore {
+    namespace bench {
+
+        /// Owns an empty database which is backed either by memory or by a temporary file. The
+        /// file variant is deleted when the object is destroyed.
+        class bench_store {
+        public:
+            explicit bench_store (store_kind kind);
+            bench_store (bench_store const &) = delete;
+            bench_store & operator= (bench_store const &) = delete;
+            ~bench_store () noexcept;
+
+            database & db () noexcept { return *db_; }
+
+            /// The number of bytes reserved for an in-memory store. The backing memory is committed
+            /// lazily by the host OS so only the portion that's actually used is paid for.
+            static constexpr std::size_t memory_capacity = std::size_t{1} << 30U; // 1 GiB
+
+        private:
+            std::shared_ptr<std::uint8_t> buffer_;
+            std::shared_ptr<file::file_base> file_;
+            std::unique_ptr<database> db_;
+        };
+
+        /// A deterministic source of pseudo-random values. std::mt19937_64's output sequence is
+        /// fully specified by the standard so the benchmarks see the same keys on every host.
+        class key_generator {
+        public:
+            key_generator () = default;
+
+            index::digest digest () { return {engine_ (), engine_ ()}; }
+            std::string string (std::size_t length);
+
+        private:
+            std::mt19937_64 engine_{UINT64_C (0x70537430726542)};
+        };
+
+        /// Returns \p count unique digests.
+        std::vector<index::digest> make_digests (std::size_t count);
+
+        /// Returns \p count unique strings, each approximately \p length characters long.
+        std::vector<std::string> make_strings (std::size_t count, std::size_t length);
+
+    } // end namespace bench
+} // end namespace pstore
+
+#endif // PSTORE_BENCHMARKS_STORE_HPP
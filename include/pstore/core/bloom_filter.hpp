@@ -0,0 +1,226 @@
+//===- include/pstore/core/bloom_filter.hpp ---------------*- mode: C++ -*-===//
+//*  _     _                          __ _ _ _             *
+//* | |__ | | ___   ___  _ __ ___    / _(_) | |_ ___ _ __  *
+//* | '_ \| |/ _ \ / _ \| '_ ` _ \  | |_| | | __/ _ \ '__| *
+//* | |_) | | (_) | (_) | | | | | | |  _| | | ||  __/ |    *
+//* |_.__/|_|\___/ \___/|_| |_| |_| |_| |_|_|\__\___|_|    *
+//*                                                        *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file bloom_filter.hpp
+/// \brief A persistent approximate-membership filter for the keys of an index.
+
+#ifndef PSTORE_CORE_BLOOM_FILTER_HPP
+#define PSTORE_CORE_BLOOM_FILTER_HPP
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "pstore/core/database.hpp"
+
+namespace pstore {
+    class transaction_base;
+
+    namespace index {
+
+        /// A blocked Bloom filter which records the keys of an index. A query answers either
+        /// "definitely absent" or "possibly present". The bits for each key all lie within a
+        /// single 512-bit block so that a query touches just one cache line of each segment of
+        /// the filter.
+        ///
+        /// Keys are described to the filter by a pair of 64-bit values which between them should
+        /// be well distributed.
+        ///
+        /// The filter is made up of one or more segments. Keys are added to the newest segment
+        /// and, once it is full, a new and larger segment is started so that the filter grows
+        /// without needing the keys that it already holds. In the store, a commit which adds
+        /// keys to an existing segment writes only the blocks that changed as a delta which
+        /// refers to the segment's previous record. A segment's deltas are merged once there are
+        /// max_deltas of them and the segment is rewritten whole once the deltas would amount to
+        /// half of it.
+        class bloom_filter {
+            /// A block holds the bits for a group of keys in one cache line.
+            using block = std::array<std::uint64_t, 8>;
+
+        public:
+            /// The number of filter bits allowed for each key in the first segment. With 'probes'
+            /// bits set per key this gives a false positive rate of around 1% when the segment is
+            /// at capacity. Each later segment allows two more bits per key so that the false
+            /// positive rate of the whole filter stays close to the design rate as it grows.
+            static constexpr unsigned bits_per_key = 10U;
+            /// The number of bits set for each key.
+            static constexpr unsigned probes = 6U;
+            /// The number of deltas which may be chained to a segment before they are merged.
+            static constexpr unsigned max_deltas = 4U;
+
+            /// A filter which has been written to the store. Its queries read only the block
+            /// of each segment which holds the bits for the key.
+            class stored {
+            public:
+                stored () noexcept = default;
+                /// Reads the headers of the filter written to the store at \p addr.
+                stored (database const & db, address addr);
+
+                /// Returns the store address of the filter or null if there is no filter.
+                address addr () const noexcept { return addr_; }
+                /// The number of keys that had been added to the filter when it was written.
+                std::uint64_t size () const noexcept { return size_; }
+
+                bool may_contain (database::read_view & view, std::uint64_t h1,
+                                  std::uint64_t h2) const;
+
+            private:
+                friend class bloom_filter;
+                /// A record of a segment: either the whole segment or a delta.
+                struct layer {
+                    address record;
+                    /// The number of blocks held by the record.
+                    std::uint64_t count;
+                    bool delta;
+                };
+                struct segment {
+                    std::uint64_t num_blocks;
+                    unsigned level;
+                    /// The number of keys that had been added to the segment.
+                    std::uint64_t size;
+                    /// The segment's records, newest first. The last holds the whole segment.
+                    std::vector<layer> layers;
+                };
+
+                /// Returns the union of the bits held by the records of segment \p seg for the
+                /// block at \p index.
+                static block segment_block (database::read_view & view, segment const & seg,
+                                           std::uint64_t index);
+
+                address addr_ = address::null ();
+                std::uint64_t size_ = 0;
+                /// The filter's segments, newest first.
+                std::vector<segment> segments_;
+            };
+
+            /// Creates an empty filter with room for at least \p capacity keys in its first
+            /// segment.
+            explicit bloom_filter (std::uint64_t capacity);
+            /// Creates a filter which adds keys to one which was written to the store. No part
+            /// of the stored filter is copied.
+            explicit bloom_filter (stored const & s);
+
+            /// The number of keys that have been added to the filter.
+            std::uint64_t size () const noexcept { return size_; }
+            /// The number of keys that the filter's segments can hold before its false positive
+            /// rate rises above the design rate. A new segment is started once the newest is
+            /// full.
+            std::uint64_t capacity () const noexcept;
+
+            void insert (std::uint64_t h1, std::uint64_t h2);
+            bool may_contain (database::read_view & view, std::uint64_t h1,
+                              std::uint64_t h2) const;
+
+            /// Writes the keys added to the filter to the store and returns the address of the
+            /// newest record of the filter.
+            address flush (transaction_base & transaction) const;
+            /// Returns an upper bound on the number of bytes, including alignment padding, that
+            /// flush() allocates.
+            std::uint64_t flush_size () const noexcept;
+
+        private:
+            static constexpr unsigned block_bits = sizeof (block) * 8U;
+
+            /// Each record of the filter is preceded in the store by this header. It occupies a
+            /// whole block so that the blocks which follow are aligned to a cache line. A delta's
+            /// blocks are followed by their indices within the segment in ascending order.
+            struct header {
+                std::array<std::uint8_t, 8> signature;
+                std::uint64_t num_blocks;
+                /// The number of keys in the filter.
+                std::uint64_t size;
+                /// For a delta, the record which it updates. For a whole segment, the newest
+                /// record of the previous segment or null if this is the first.
+                address previous;
+                /// The number of keys in this record's segment. Never zero.
+                std::uint64_t segment_size;
+                std::uint64_t level;
+                /// The number of blocks held by a delta.
+                std::uint64_t num_changed;
+                std::uint64_t unused;
+            };
+            static std::array<std::uint8_t, 8> const signature_;
+            static std::array<std::uint8_t, 8> const delta_signature_;
+
+            /// A segment which has not yet been written to the store.
+            struct segment {
+                unsigned level;
+                std::uint64_t size;
+                std::vector<block> blocks;
+            };
+            /// The ways in which flush() can record keys that were added to the newest stored
+            /// segment.
+            enum class extension { delta, merged_delta, whole };
+
+            /// Combines the two key values into the hash from which a key's block and bits are
+            /// selected.
+            static std::uint64_t key_hash (std::uint64_t h1, std::uint64_t h2) noexcept;
+            /// Returns the mask of the bits within a block which are set for the key whose hash
+            /// (as produced by key_hash()) is \p hash.
+            static block key_bits (std::uint64_t hash) noexcept;
+            static bool contains_bits (block const & b, block const & bits) noexcept;
+            static void merge_bits (block & b, block const & bits) noexcept;
+            /// The number of bits allowed for each key in a segment at \p level.
+            static constexpr std::uint64_t level_bits_per_key (unsigned const level) noexcept {
+                return bits_per_key + 2U * std::uint64_t{level};
+            }
+            /// Returns the number of blocks in a segment at \p level with room for at least
+            /// \p capacity keys.
+            static std::uint64_t num_blocks (std::uint64_t capacity, unsigned level) noexcept;
+            static std::uint64_t segment_capacity (std::uint64_t num_blocks,
+                                                   unsigned level) noexcept;
+            /// Returns the number of bytes, including alignment padding, needed for a record
+            /// holding \p blocks blocks.
+            static constexpr std::uint64_t record_size (std::uint64_t const blocks,
+                                                        bool const delta) noexcept {
+                // The record is aligned to a block boundary.
+                return sizeof (header) + blocks * sizeof (block) +
+                       (delta ? blocks * sizeof (std::uint64_t) : 0U) + sizeof (block) - 1U;
+            }
+
+            /// Starts a new segment to which keys are added.
+            void add_segment ();
+            /// Returns an upper bound on the number of blocks in a delta which merges those of
+            /// the newest stored segment with changes_.
+            std::uint64_t merged_delta_blocks () const noexcept;
+            /// Decides how flush() records the keys added to the newest stored segment.
+            extension extension_kind () const noexcept;
+            /// Writes a record to the store and returns its address.
+            static address write_record (transaction_base & transaction, header const & h,
+                                         block const * blocks, std::uint64_t const * indices);
+            /// Writes a delta record holding \p changes to the store and returns its address.
+            static address write_delta (transaction_base & transaction, header h,
+                                        std::map<std::uint64_t, block> const & changes);
+            /// Writes the keys added to the newest stored segment to the store and returns the
+            /// address of the record which holds them.
+            address flush_changes (transaction_base & transaction) const;
+
+            /// The filter to which keys are being added.
+            stored stored_;
+            /// The bits added to the blocks of stored_'s newest segment, keyed by block index.
+            std::map<std::uint64_t, block> changes_;
+            /// The number of keys added to stored_'s newest segment.
+            std::uint64_t changed_keys_ = 0;
+            /// The segments which are not yet in the store, oldest first. Keys are added to the
+            /// last.
+            std::vector<segment> segments_;
+            std::uint64_t size_ = 0;
+        };
+
+    } // end namespace index
+} // end namespace pstore
+
+#endif // PSTORE_CORE_BLOOM_FILTER_HPP
@@ -18,6 +18,9 @@
 #ifndef PSTORE_CORE_DATABASE_HPP
 #define PSTORE_CORE_DATABASE_HPP
 
+#include <atomic>
+#include <mutex>
+
 #include "pstore/adt/sstring_view.hpp"
 #include "pstore/core/file_header.hpp"
 #include "pstore/core/hamt_map_fwd.hpp"
@@ -35,6 +38,7 @@ namespace pstore {
     //*   \__,_|\__,_|\__\__,_|_.__/ \__,_|___/\___|  *
     //*                                               *
 
+    class group_commit;
     class heartbeat;
 
     class database {
@@ -93,6 +97,10 @@ namespace pstore {
         static void build_new_store (file::file_base & file);
 
         /// \brief Update to a specified revision of the data.
+        ///
+        /// sync() may be called whilst other threads are reading from the database. Pointers
+        /// and indices that were obtained before the call remain valid and continue to show the
+        /// revision from which they were read.
         void sync (unsigned revision = head_revision);
 
         /// \brief Returns the address of the footer of a specified revision.
@@ -105,6 +113,20 @@ namespace pstore {
         /// the old currently synced because to do so may require additional space to be mapped.
         typed_address<trailer> older_revision_footer_pos (unsigned revision) const;
 
+        /// \brief Returns the address of the footer of a specified revision by searching
+        /// backwards from the footer at \p start.
+        ///
+        /// The search follows the trailers' skip_generation pointers where they bring it closer
+        /// to the target and requires a number of steps that is logarithmic in the distance
+        /// between the two revisions. Trailers which lack a skip pointer are stepped over one at a
+        /// time.
+        ///
+        /// \param start  The address of the trailer from which the search begins.
+        /// \param revision  The revision number. Must be less than or equal to the generation of
+        /// the trailer at \p start otherwise an unknown_revision error is raised.
+        typed_address<trailer> older_revision_footer_pos (typed_address<trailer> start,
+                                                          unsigned revision) const;
+
         static constexpr bool small_files_enabled () noexcept {
             return region::small_files_enabled ();
         }
@@ -174,6 +196,47 @@ namespace pstore {
         }
         ///@}
 
+        /// A read_view provides read-only access to the store through raw pointers. The
+        /// shared_ptr<> returned by getro() costs an atomic increment and decrement of the
+        /// segment's reference count for every call; a read_view avoids this on its fast path.
+        ///
+        /// The pointers returned by a read_view are valid for the lifetime of the view. The view
+        /// must not outlive its database and the database must not be closed or have a
+        /// transaction rolled back whilst the view is in use. The database may be synced.
+        class read_view {
+        public:
+            explicit read_view (database const & db) noexcept
+                    : db_{db} {}
+            read_view (read_view const &) = delete;
+            read_view (read_view &&) noexcept = default;
+            ~read_view () noexcept = default;
+            read_view & operator= (read_view const &) = delete;
+            read_view & operator= (read_view &&) = delete;
+
+            database const & db () const noexcept { return db_; }
+
+            /// Returns a read-only pointer to \p size bytes of data starting at address \p addr.
+            void const * get (address addr, std::size_t size);
+
+            /// Returns a read-only pointer to an array of \p elements instances of type T starting
+            /// at address \p addr.
+            template <typename T,
+                      typename = typename std::enable_if<std::is_standard_layout<T>::value>::type>
+            T const * get (typed_address<T> const addr, std::size_t const elements = 1) {
+                if (addr.to_address ().absolute () % alignof (T) != 0) {
+                    raise (error_code::bad_alignment);
+                }
+                return static_cast<T const *> (
+                    this->get (addr.to_address (), sizeof (T) * elements));
+            }
+
+        private:
+            database const & db_;
+            /// Requests which span more than one region are satisfied by copying the data into a
+            /// fresh block of memory. These blocks are retained here for the life of the view.
+            std::vector<std::shared_ptr<void const>> spanning_;
+        };
+
         ///@{
         /// A collection of functions which obtain a non-const pointer to database storage.
         /// These functions should only be called by the transaction code. Data outside of
@@ -247,6 +310,45 @@ namespace pstore {
         vacuum_mode get_vacuum_mode () const noexcept { return vacuum_mode_; }
         ///@}
 
+        ///@{
+        /// Controls whether a committed transaction is guaranteed to survive a system crash.
+        enum class durability {
+            /// Commit publishes the new footer but leaves the operating system to write the
+            /// modified pages to disk at its leisure.
+            none,
+            /// Each commit synchronously flushes its data followed by the file header.
+            each_commit,
+            /// Each commit synchronously flushes its data before publishing the new footer. It
+            /// then releases the transaction lock and waits for the file header to be flushed.
+            /// Concurrent commits to the same store from within this process share the header
+            /// flushes. As with each_commit, the header never refers to data that has not reached
+            /// the disk.
+            group,
+        };
+        void set_durability (durability mode);
+        durability get_durability () const noexcept { return durability_; }
+        ///@}
+
+        ///@{
+        /// The number of levels at the top of each index trie which are held, decoded, in memory
+        /// to speed up lookups (see hamt_map::set_node_cache_levels()). 0, the default, disables
+        /// the cache. The setting is used by indices which are loaded after it is changed.
+        void set_index_node_cache_levels (unsigned const levels) noexcept {
+            index_node_cache_levels_ = levels;
+        }
+        unsigned get_index_node_cache_levels () const noexcept { return index_node_cache_levels_; }
+        ///@}
+
+        /// Makes the data in the address range [first, last) durable as required by the current
+        /// durability mode. Does nothing if the mode is durability::none.
+        virtual void flush (address first, address last);
+
+        /// Makes the file header durable as required by the current durability mode. Does nothing
+        /// if the mode is durability::none. In durability::group mode the flush is shared with
+        /// concurrent callers; the transaction lock should not be held since that would prevent
+        /// any other commit from joining the batch.
+        void flush_header ();
+
         /// For unit testing
         class storage const & storage () const noexcept {
             return storage_;
@@ -255,6 +357,17 @@ namespace pstore {
         void close ();
 
         header const & get_header () const noexcept { return *header_; }
+
+        /// Returns true if the store has been replaced by a compacted copy made by vacuum. The
+        /// file is no longer reachable by its path so it must be reopened before it is written.
+        bool is_replaced () const noexcept {
+            return (header_->flags.load () & header::replaced) != 0U;
+        }
+        /// Records that the store has been replaced. Vacuum calls this with the transaction lock
+        /// held once the compacted copy has been renamed over the store. A process that was
+        /// waiting for the lock then fails to begin a transaction rather than committing to a
+        /// file that is no longer reachable by its path.
+        void set_replaced () noexcept { header_->flags.fetch_or (header::replaced); }
         typed_address<trailer> footer_pos () const noexcept { return size_.footer_pos (); }
 
         /// Returns the generation number to which the database is synced.
@@ -291,6 +404,10 @@ namespace pstore {
 
         virtual void truncate (std::uint64_t size);
 
+        /// Returns the number of bytes of the store which are currently memory-mapped. Growing the
+        /// store up to this size won't require any additional memory to be mapped.
+        std::uint64_t mapped_size () const noexcept { return storage_.mapped_size (); }
+
         /// Call as part of completing a transaction. We update the database records to that
         /// the new footer is recorded.
         void set_new_footer (typed_address<trailer> new_footer_pos);
@@ -309,15 +426,33 @@ namespace pstore {
         shared const * get_shared () const;
         shared * get_shared ();
 
-        /// \brief Returns a pointer to an index base.
-        ///
-        /// \param which  An index type from which the index will be read.
-        //  \warning This function is dangerous. It returns a non-const index from a const
+        ///@{
+        /// The database keeps the most recently loaded instance of each index so that the index
+        /// is read from the store just once per revision. These functions are used by
+        /// index::get_index() to manage those instances and may safely be called concurrently
+        /// with each other and with sync().
+        //  \warning These functions are dangerous. They return a non-const index from a const
         //  database.
-        std::shared_ptr<index::index_base> &
-        get_mutable_index (enum pstore::trailer::indices const which) const {
-            return indices_[static_cast<std::underlying_type<decltype (which)>::type> (which)];
-        }
+
+        /// \brief Returns the loaded instance of an index or nullptr if it has not been loaded.
+        ///
+        /// \param which  The index to be returned.
+        std::shared_ptr<index::index_base> loaded_index (trailer::indices which) const;
+
+        /// \brief Records a newly loaded instance of an index.
+        ///
+        /// If another thread has already recorded an instance of the index, or if the database
+        /// has been synced to a different revision since \p footer was read, \p index is not
+        /// recorded.
+        ///
+        /// \param which  The index to be recorded.
+        /// \param index  The newly loaded index.
+        /// \param footer  The position of the footer from which \p index was loaded.
+        /// \returns The recorded instance of the index or \p index if it was not recorded.
+        std::shared_ptr<index::index_base> publish_index (trailer::indices which,
+                                                          std::shared_ptr<index::index_base> index,
+                                                          typed_address<trailer> footer) const;
+        ///@}
         std::shared_ptr<trailer const> get_footer () const {
             return this->getro (this->footer_pos ());
         }
@@ -329,6 +464,10 @@ namespace pstore {
         std::unique_lock<file::range_lock> lock_;
 
         vacuum_mode vacuum_mode_ = vacuum_mode::disabled;
+        durability durability_ = durability::none;
+        unsigned index_node_cache_levels_ = 0;
+        /// Used to batch header flushes when the durability mode is durability::group.
+        std::shared_ptr<group_commit> group_commit_;
         bool modified_ = false;
         bool closed_ = false;
 
@@ -340,43 +479,63 @@ namespace pstore {
         /// the transaction's file footer. If a write transaction is active, then this becomes the
         /// point at which new data is written; when the transaction is complete, a new footer will
         /// be written at this location.
+        ///
+        /// Both values may be read by any thread. They are modified only by sync() and by the
+        /// thread which owns an open transaction. The logical size is stored after the storage
+        /// which it covers has been mapped so that a reader which sees the new size can access
+        /// that storage.
         class sizes {
         public:
             sizes () noexcept = default;
-            constexpr explicit sizes (typed_address<trailer> const footer_pos) noexcept
-                    : footer_pos_{footer_pos}
-                    , logical_{footer_pos_.absolute () + sizeof (trailer)} {}
+            explicit sizes (typed_address<trailer> const footer_pos) noexcept
+                    : footer_pos_{footer_pos.absolute ()}
+                    , logical_{footer_pos.absolute () + sizeof (trailer)} {}
 
-            typed_address<trailer> footer_pos () const noexcept { return footer_pos_; }
-            std::uint64_t logical_size () const noexcept { return logical_; }
+            typed_address<trailer> footer_pos () const noexcept {
+                return typed_address<trailer>::make (footer_pos_.load (std::memory_order_acquire));
+            }
+            std::uint64_t logical_size () const noexcept {
+                return logical_.load (std::memory_order_acquire);
+            }
 
             void update_footer_pos (typed_address<trailer> const new_footer_pos) noexcept {
                 PSTORE_ASSERT (new_footer_pos.absolute () >= leader_size);
-                footer_pos_ = new_footer_pos;
-                logical_ = std::max (logical_, footer_pos_.absolute () + sizeof (trailer));
+                this->grow (new_footer_pos.absolute () + sizeof (trailer));
+                footer_pos_.store (new_footer_pos.absolute (), std::memory_order_release);
             }
 
             void update_logical_size (std::uint64_t const new_logical_size) noexcept {
-                PSTORE_ASSERT (new_logical_size >= footer_pos_.absolute () + sizeof (trailer));
-                logical_ = std::max (logical_, new_logical_size);
+                PSTORE_ASSERT (new_logical_size >= footer_pos ().absolute () + sizeof (trailer));
+                this->grow (new_logical_size);
             }
 
             void truncate_logical_size (std::uint64_t const new_logical_size) noexcept {
-                PSTORE_ASSERT (new_logical_size >= footer_pos_.absolute () + sizeof (trailer));
-                logical_ = new_logical_size;
+                PSTORE_ASSERT (new_logical_size >= footer_pos ().absolute () + sizeof (trailer));
+                logical_.store (new_logical_size, std::memory_order_release);
             }
 
         private:
-            typed_address<trailer> footer_pos_ = typed_address<trailer>::null ();
+            void grow (std::uint64_t const new_logical_size) noexcept {
+                logical_.store (std::max (this->logical_size (), new_logical_size),
+                                std::memory_order_release);
+            }
+
+            std::atomic<std::uint64_t> footer_pos_{0};
 
             /// This value tracks space as it's appended to the file.
-            std::uint64_t logical_ = 0;
+            std::atomic<std::uint64_t> logical_{0};
         };
         sizes size_;
 
+        /// The loaded indices. Each element is accessed using the atomic shared_ptr<> functions
+        /// so that the indices can be read without holding indices_mutex_.
         mutable std::array<std::shared_ptr<index::index_base>,
                            static_cast<unsigned> (trailer::indices::last)>
             indices_;
+        /// Serializes changes to indices_ with changes to the footer position.
+        mutable std::mutex indices_mutex_;
+        /// Serializes calls to sync().
+        std::mutex sync_mutex_;
         std::string sync_name_;
         static constexpr auto const sync_name_length = std::size_t{20};
 
@@ -385,9 +544,14 @@ namespace pstore {
         std::shared_ptr<heartbeat> heartbeat_;
 
         /// Clears the index cache: the next time that an index is requested it will be read from
-        /// the disk. Used after a sync() operation has changed the current database view.
+        /// the disk. Used after a sync() operation has changed the current database view. The
+        /// caller must hold indices_mutex_.
         void clear_index_cache ();
 
+        /// Checks that the range [addr, addr+size) lies within the store and raises an error if
+        /// the store is closed or if the range is invalid.
+        void check_get (address addr, std::size_t size, bool writable) const;
+
         /// Returns the lowest address from which a writable pointer can be obtained.
         address first_writable_address () const;
 
@@ -465,7 +629,8 @@ namespace pstore {
         }
 #endif
         if (h->a.header_size != sizeof (class header) || h->a.version[0] != header::major_version ||
-            h->a.version[1] != header::minor_version) {
+            h->a.version[1] < header::min_minor_version ||
+            h->a.version[1] > header::minor_version) {
             raise (error_code::header_version_mismatch, file.path ());
         }
         if (!h->is_valid ()) {
@@ -20,8 +20,12 @@
 #ifndef PSTORE_CORE_DB_ARCHIVE_HPP
 #define PSTORE_CORE_DB_ARCHIVE_HPP
 
+#include <cstring>
+
+#include "pstore/adt/small_vector.hpp"
 #include "pstore/core/transaction.hpp"
 #include "pstore/serialize/archive.hpp"
+#include "pstore/support/aligned.hpp"
 #include "pstore/support/error.hpp"
 
 namespace pstore {
@@ -94,6 +98,156 @@ namespace pstore {
             }
 
 
+            // *******************************************************
+            // *   b u f f e r e d _ d a t a b a s e _ w r i t e r   *
+            // *******************************************************
+            namespace details {
+
+                /// An archive-writer policy which accumulates the values written to it in a
+                /// local buffer. When the policy is flushed, the buffer is copied to the store
+                /// with a single allocation.
+                class buffered_database_writer_policy {
+                public:
+                    /// The offset of a value from the start of the buffer. Once the buffer has
+                    /// been flushed, the value's address is given by address_of().
+                    using result_type = std::size_t;
+
+                    explicit buffered_database_writer_policy (transaction_base & trans) noexcept
+                            : transaction_ (trans) {}
+
+                    /// Writes an instance of a standard-layout type Ty to the buffer.
+                    /// \param value  The value to be written.
+                    /// \returns The offset within the buffer at which the value was written.
+                    template <typename Ty>
+                    auto put (Ty const & value) -> result_type {
+                        return this->append (&value, sizeof (Ty), alignof (Ty));
+                    }
+
+                    /// Writes a span of standard-layout values to the buffer.
+                    /// \param sp  The span of values to be written.
+                    /// \returns The offset within the buffer at which the first value was written.
+                    template <typename Span>
+                    auto putn (Span sp) -> result_type {
+                        return this->append (sp.data (), unsigned_cast (sp.size_bytes ()),
+                                             alignof (typename Span::element_type));
+                    }
+
+                    /// Adds padding to the buffer so that the next value written is aligned to
+                    /// at least \p align bytes within the store.
+                    ///
+                    /// \param align  The required alignment. Must be a power of 2.
+                    /// \returns  The offset within the buffer of the aligned position.
+                    result_type align (std::size_t align);
+
+                    /// Copies the contents of the buffer to the store.
+                    void flush ();
+
+                    /// Returns the store address of the value which was written at the given
+                    /// offset within the buffer. Must not be called before the buffer is flushed.
+                    ///
+                    /// \param offset  A value returned by put() or putn().
+                    address address_of (result_type const offset) const noexcept {
+                        PSTORE_ASSERT (flushed_ && offset <= buffer_.size ());
+                        return base_ + offset;
+                    }
+
+                    /// Returns the number of bytes that have been written to the buffer including
+                    /// any padding.
+                    std::size_t bytes_produced () const noexcept { return buffer_.size (); }
+
+                private:
+                    result_type append (void const * data, std::size_t size, std::size_t align);
+
+                    /// The transaction to which data is written.
+                    transaction_base & transaction_;
+                    /// The values to be written to the store.
+                    small_vector<std::uint8_t, 256> buffer_;
+                    /// The maximum alignment of the values in the buffer. The buffer is written
+                    /// to the store at an address with this alignment.
+                    std::size_t align_ = 1U;
+                    /// The address in the store at which the buffer was written.
+                    address base_ = address::null ();
+                    bool flushed_ = false;
+                };
+
+                // align
+                // ~~~~~
+                inline auto buffered_database_writer_policy::align (std::size_t const align)
+                    -> result_type {
+                    PSTORE_ASSERT (!flushed_ && is_power_of_two (align));
+                    align_ = std::max (align_, align);
+                    std::size_t const pos = buffer_.size ();
+                    std::size_t const aligned = pos + calc_alignment (pos, align);
+                    if (aligned != pos) {
+                        buffer_.resize (aligned);
+                        std::memset (buffer_.data () + pos, 0, aligned - pos);
+                    }
+                    return aligned;
+                }
+
+                // append
+                // ~~~~~~
+                inline auto buffered_database_writer_policy::append (void const * const data,
+                                                                     std::size_t const size,
+                                                                     std::size_t const align)
+                    -> result_type {
+                    std::size_t const pos = this->align (align);
+                    buffer_.resize (pos + size);
+                    std::memcpy (buffer_.data () + pos, data, size);
+                    return pos;
+                }
+
+                // flush
+                // ~~~~~
+                inline void buffered_database_writer_policy::flush () {
+                    PSTORE_ASSERT (!flushed_);
+                    flushed_ = true;
+                    std::size_t const size = buffer_.size ();
+                    if (size == 0U) {
+                        return;
+                    }
+                    std::shared_ptr<void> ptr;
+                    std::tie (ptr, base_) =
+                        transaction_.alloc_rw (size, static_cast<unsigned> (align_));
+                    std::memcpy (ptr.get (), buffer_.data (), size);
+                }
+
+            } // namespace details
+
+            /// An archive-writer which accumulates the values written to it and writes them to
+            /// the store with a single allocation when it is flushed. Each value is given the
+            /// same alignment, relative to the others, that it would have if it had been written
+            /// with database_writer.
+            ///
+            /// The put() and putn() functions (and therefore serialize::write()) return the offset
+            /// of the value within the buffer. The value's store address is available from
+            /// address_of() once the writer has been flushed.
+            class buffered_database_writer final
+                    : public writer_base<details::buffered_database_writer_policy> {
+                using policy = details::buffered_database_writer_policy;
+
+            public:
+                /// \brief Constructs the writer using the transaction.
+                /// \param transaction The active transaction to the store to which the
+                ///                    buffered_database_writer will write.
+                explicit buffered_database_writer (transaction_base & transaction)
+                        : writer_base<policy> (policy{transaction}) {}
+
+                /// Adds padding so that the next value written is aligned to at least \p align
+                /// bytes in the store.
+                /// \returns  The offset within the buffer of the aligned position.
+                std::size_t align (std::size_t const align) {
+                    return this->writer_policy ().align (align);
+                }
+
+                /// Returns the store address of the value which was written at the given offset.
+                /// Must not be called before the writer is flushed.
+                address address_of (std::size_t const offset) const noexcept {
+                    return this->writer_policy ().address_of (offset);
+                }
+            };
+
+
             // *************************************
             // *   d a t a b a s e _ r e a d e r   *
             // *************************************
@@ -109,6 +263,17 @@ namespace pstore {
                         : db_ (db)
                         , addr_ (addr) {}
 
+                /// Constructs a reader which reads data from a database through a read_view. This
+                /// avoids the reference-counting overhead of database::getro().
+                ///
+                /// \param view The view through which data is read.
+                /// \param addr The start address from which data is read.
+                database_reader (pstore::database::read_view & view,
+                                 pstore::address const addr) noexcept
+                        : db_ (view.db ())
+                        , view_ (&view)
+                        , addr_ (addr) {}
+
                 pstore::database const & get_db () const noexcept { return db_; }
                 pstore::address get_address () const noexcept { return addr_; }
                 void skip (std::size_t const distance) noexcept { addr_ += distance; }
@@ -136,7 +301,10 @@ namespace pstore {
 
             private:
                 database const & db_; ///< The database from which data is read.
-                address addr_;        ///< The address from which data is read.
+                /// The view through which data is read or nullptr if data is read directly from
+                /// the database.
+                database::read_view * view_ = nullptr;
+                address addr_; ///< The address from which data is read.
             };
 
             // get
@@ -147,11 +315,13 @@ namespace pstore {
                 auto const extra_for_alignment = calc_alignment (addr_.absolute (), alignof (Ty));
                 PSTORE_ASSERT (extra_for_alignment < sizeof (Ty));
                 addr_ += extra_for_alignment;
-                // Load the data.
-                auto result = db_.getro (typed_address<Ty> (addr_));
+                // Load the data and copy to the destination.
+                if (view_ != nullptr) {
+                    new (&v) Ty (*view_->get (typed_address<Ty> (addr_)));
+                } else {
+                    new (&v) Ty (*db_.getro (typed_address<Ty> (addr_)));
+                }
                 addr_ += sizeof (Ty);
-                // Copy to the destination.
-                new (&v) Ty (*result);
             }
 
             // getn
@@ -168,12 +338,16 @@ namespace pstore {
 
                 // Load the data.
                 auto const size = unsigned_cast (span.size_bytes ());
-                auto src = db_.getro (typed_address<std::uint8_t> (addr_), size);
+                auto * const dest = reinterpret_cast<std::uint8_t *> (span.data ());
+                if (view_ != nullptr) {
+                    std::uint8_t const * const first =
+                        view_->get (typed_address<std::uint8_t> (addr_), size);
+                    std::copy (first, first + size, dest);
+                } else {
+                    auto const src = db_.getro (typed_address<std::uint8_t> (addr_), size);
+                    std::copy (src.get (), src.get () + size, dest);
+                }
                 addr_ += size;
-
-                // Copy to the destination span.
-                auto first = src.get ();
-                std::copy (first, first + size, reinterpret_cast<std::uint8_t *> (span.data ()));
             }
 
             /// A convenience function which provides symmetry with the make_writer() function.
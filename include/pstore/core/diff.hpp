@@ -16,7 +16,11 @@
 #ifndef PSTORE_CORE_DIFF_HPP
 #define PSTORE_CORE_DIFF_HPP
 
+#include <numeric>
+#include <vector>
+
 #include "pstore/core/hamt_set.hpp"
+#include "pstore/support/parallel_for_each.hpp"
 
 namespace pstore {
 
@@ -152,6 +156,262 @@ namespace pstore {
         return t (out);
     }
 
+    /// The ways in which the entry for a key may differ between two revisions of an index.
+    enum class change_kind { added, replaced, removed };
+
+    /// Describes a key whose entry differs between two revisions of an index.
+    struct index_change {
+        change_kind kind;
+        /// The address of the key's leaf in the old index or null if the key was added.
+        address old_leaf;
+        /// The address of the key's leaf in the new index or null if the key was removed.
+        address new_leaf;
+    };
+
+    inline bool operator== (index_change const & lhs, index_change const & rhs) noexcept {
+        return lhs.kind == rhs.kind && lhs.old_leaf == rhs.old_leaf &&
+               lhs.new_leaf == rhs.new_leaf;
+    }
+    inline bool operator!= (index_change const & lhs, index_change const & rhs) noexcept {
+        return !operator== (lhs, rhs);
+    }
+
+    namespace diff_details {
+
+        /// Returns the key from a member of a container such as hamt_set.
+        template <typename KeyType>
+        KeyType const & member_key (KeyType const & v) noexcept {
+            return v;
+        }
+        /// Returns the key from a member of an associative container such as hamt_map.
+        template <typename KeyType, typename ValueType>
+        KeyType const & member_key (std::pair<KeyType, ValueType> const & kvp) noexcept {
+            return kvp.first;
+        }
+
+        /// Walks two revisions of an index together. A sub-trie which has the same address in
+        /// both revisions cannot contain a change and is skipped, so the cost of a comparison is
+        /// proportional to the size of the change rather than of the index.
+        template <typename Index>
+        class comparer {
+            using index_pointer = index::details::index_pointer;
+
+        public:
+            /// \param db  The owning database instance.
+            /// \param old_index  The old revision of the index.
+            /// \param new_index  The new revision of the index.
+            constexpr comparer (database const & db, Index const & old_index,
+                                Index const & new_index) noexcept
+                    : db_{db}
+                    , old_index_{old_index}
+                    , new_index_{new_index} {}
+
+            /// Compares two sub-tries which are found at the same position in the old and new
+            /// indices.
+            ///
+            /// \tparam OutputIterator An Output-Iterator type.
+            /// \param old_node  A node from the old index or an empty index_pointer.
+            /// \param new_node  A node from the new index or an empty index_pointer.
+            /// \param shifts  The depth of the nodes in the tree structure.
+            /// \param out  The output iterator to which index_change records are written.
+            /// \result The output iterator to which results were written.
+            template <typename OutputIterator>
+            OutputIterator compare (index_pointer old_node, index_pointer new_node,
+                                    unsigned shifts, OutputIterator out) const;
+
+            /// Returns the internal node referenced by \p node together with the storage which
+            /// owns it.
+            auto internal (index_pointer const node) const
+                -> std::pair<std::shared_ptr<void const>, index::details::internal_node const *> {
+                return index::details::internal_node::get_node (db_, node);
+            }
+
+        private:
+            /// Appends the address of every leaf in the sub-trie rooted at \p node to \p leaves.
+            void collect_leaves (index_pointer node, unsigned shifts,
+                                 std::vector<address> * leaves) const;
+
+            /// Compares two sets of leaves by key.
+            template <typename OutputIterator>
+            OutputIterator match_leaves (std::vector<address> && old_leaves,
+                                         std::vector<address> && new_leaves,
+                                         OutputIterator out) const;
+
+            database const & db_;
+            Index const & old_index_;
+            Index const & new_index_;
+        };
+
+        // compare
+        // ~~~~~~~
+        template <typename Index>
+        template <typename OutputIterator>
+        OutputIterator comparer<Index>::compare (index_pointer const old_node,
+                                                 index_pointer const new_node,
+                                                 unsigned const shifts, OutputIterator out) const {
+            if (old_node == new_node) {
+                return out; // Unchanged (or both empty).
+            }
+            if (!old_node.is_empty () && !new_node.is_empty () && !old_node.is_leaf () &&
+                !new_node.is_leaf () && index::details::depth_is_internal_node (shifts)) {
+                // Two internal nodes: pair up their children by hash digit.
+                auto const old_internal = this->internal (old_node);
+                auto const new_internal = this->internal (new_node);
+                for (auto digit = index::details::hash_type{0};
+                     digit < index::details::hash_size; ++digit) {
+                    out = this->compare (old_internal.second->lookup (digit).first,
+                                         new_internal.second->lookup (digit).first,
+                                         shifts + index::details::hash_index_bits, out);
+                }
+                return out;
+            }
+
+            // The shapes of the two sub-tries differ or we've reached the linear nodes. At least
+            // one side is usually a single leaf so the keys of the two sides are simply matched.
+            std::vector<address> old_leaves;
+            std::vector<address> new_leaves;
+            this->collect_leaves (old_node, shifts, &old_leaves);
+            this->collect_leaves (new_node, shifts, &new_leaves);
+            return this->match_leaves (std::move (old_leaves), std::move (new_leaves), out);
+        }
+
+        // collect leaves
+        // ~~~~~~~~~~~~~~
+        template <typename Index>
+        void comparer<Index>::collect_leaves (index_pointer const node, unsigned const shifts,
+                                              std::vector<address> * const leaves) const {
+            if (node.is_empty ()) {
+                return;
+            }
+            if (node.is_leaf ()) {
+                PSTORE_ASSERT (node.is_address ());
+                leaves->push_back (node.addr);
+                return;
+            }
+            if (index::details::depth_is_internal_node (shifts)) {
+                auto const p = this->internal (node);
+                for (index_pointer const & child : *p.second) {
+                    this->collect_leaves (child, shifts + index::details::hash_index_bits,
+                                          leaves);
+                }
+                return;
+            }
+            auto const p = index::details::linear_node::get_node (db_, node);
+            for (address const child : *p.second) {
+                leaves->push_back (child);
+            }
+        }
+
+        // match leaves
+        // ~~~~~~~~~~~~
+        template <typename Index>
+        template <typename OutputIterator>
+        OutputIterator comparer<Index>::match_leaves (std::vector<address> && old_leaves,
+                                                      std::vector<address> && new_leaves,
+                                                      OutputIterator out) const {
+            // A leaf which is present in both revisions is unchanged.
+            std::sort (std::begin (old_leaves), std::end (old_leaves));
+            std::sort (std::begin (new_leaves), std::end (new_leaves));
+            std::vector<address> removed;
+            std::set_difference (std::begin (old_leaves), std::end (old_leaves),
+                                 std::begin (new_leaves), std::end (new_leaves),
+                                 std::back_inserter (removed));
+            std::vector<address> added;
+            std::set_difference (std::begin (new_leaves), std::end (new_leaves),
+                                 std::begin (old_leaves), std::end (old_leaves),
+                                 std::back_inserter (added));
+
+            using key_type = typename Index::key_type;
+            std::vector<std::pair<key_type, address>> old_keys;
+            old_keys.reserve (removed.size ());
+            for (address const addr : removed) {
+                old_keys.emplace_back (member_key (old_index_.load_leaf_node (db_, addr)), addr);
+            }
+
+            // Keys are not necessarily assignable so matched old keys are flagged rather than
+            // erased.
+            std::vector<bool> matched (old_keys.size (), false);
+            typename Index::key_equal const equal;
+            for (address const addr : added) {
+                auto const value = new_index_.load_leaf_node (db_, addr);
+                auto const pos = std::find_if (
+                    std::begin (old_keys), std::end (old_keys),
+                    [&] (std::pair<key_type, address> const & ok) {
+                        return equal (ok.first, member_key (value));
+                    });
+                if (pos == std::end (old_keys)) {
+                    *out = index_change{change_kind::added, address::null (), addr};
+                } else {
+                    *out = index_change{change_kind::replaced, pos->second, addr};
+                    matched[static_cast<std::size_t> (pos - std::begin (old_keys))] = true;
+                }
+                ++out;
+            }
+            for (auto ctr = std::size_t{0}; ctr < old_keys.size (); ++ctr) {
+                if (!matched[ctr]) {
+                    *out = index_change{change_kind::removed, old_keys[ctr].second,
+                                        address::null ()};
+                    ++out;
+                }
+            }
+            return out;
+        }
+
+    } // end namespace diff_details
+
+    /// Compares two revisions of an index and writes an index_change record to an output
+    /// iterator for each key which was added, replaced, or removed between them. Sub-tries
+    /// which are shared by the two revisions are not visited.
+    ///
+    /// \note Both revisions must be readable from \p db: that is, \p db must be synced to a
+    ///   revision no older than either of them.
+    ///
+    /// \param db  The owning database instance.
+    /// \param old_index  The old revision of the index.
+    /// \param new_index  The new revision of the index.
+    /// \param out  The output iterator to which index_change records are written.
+    /// \result The output iterator to which results were written.
+    template <typename Index, typename OutputIterator>
+    OutputIterator diff_indices (database const & db, Index const & old_index,
+                                 Index const & new_index, OutputIterator out) {
+        diff_details::comparer<Index> const c{db, old_index, new_index};
+        return c.compare (old_index.root (), new_index.root (), 0U, out);
+    }
+
+    /// Performs the same comparison as diff_indices() but compares the sub-tries below the
+    /// roots of the two indices concurrently. The records are written to \p out from the
+    /// calling thread and in the same order as diff_indices().
+    template <typename Index, typename OutputIterator>
+    OutputIterator parallel_diff_indices (database const & db, Index const & old_index,
+                                          Index const & new_index, OutputIterator out) {
+        using index::details::hash_size;
+        using index::details::index_pointer;
+        diff_details::comparer<Index> const c{db, old_index, new_index};
+        index_pointer const old_root = old_index.root ();
+        index_pointer const new_root = new_index.root ();
+        if (old_root == new_root || old_root.is_empty () || new_root.is_empty () ||
+            old_root.is_leaf () || new_root.is_leaf ()) {
+            return c.compare (old_root, new_root, 0U, out);
+        }
+
+        auto const old_internal = c.internal (old_root);
+        auto const new_internal = c.internal (new_root);
+        std::vector<std::vector<index_change>> changes (hash_size);
+        std::vector<index::details::hash_type> digits (hash_size);
+        std::iota (std::begin (digits), std::end (digits), index::details::hash_type{0});
+        parallel_for_each (std::begin (digits), std::end (digits),
+                           [&] (index::details::hash_type const digit) {
+                               c.compare (old_internal.second->lookup (digit).first,
+                                          new_internal.second->lookup (digit).first,
+                                          index::details::hash_index_bits,
+                                          std::back_inserter (changes[digit]));
+                           });
+        for (std::vector<index_change> const & v : changes) {
+            out = std::copy (std::begin (v), std::end (v), out);
+        }
+        return out;
+    }
+
 } // end namespace pstore
 
 #endif // PSTORE_CORE_DIFF_HPP
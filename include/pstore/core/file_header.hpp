@@ -94,7 +94,20 @@ namespace pstore {
         std::array<std::uint16_t, 2> const & version () const noexcept { return a.version; }
 
         static constexpr std::uint16_t major_version = 1;
-        static constexpr std::uint16_t minor_version = 12;
+        /// Minor version 13 introduced:
+        /// - sorted index linear nodes which carry key prefixes ('IndxLnrS');
+        /// - the trailer's skip_generation field, which was previously unused and zeroed;
+        /// - the leaf hash records of string key indices ('IndxHash' index headers);
+        /// - the key filters of the digest indices ('IndxFltr' index headers with 'IndxBlom' and
+        ///   'IndxBlmD' filter records);
+        /// - the #flags field, previously unused1, and its #replaced bit.
+        static constexpr std::uint16_t minor_version = 13;
+        /// The oldest minor version that can be opened. Minor version 12 stores have none of the
+        /// above. Their unsorted linear nodes remain readable and are converted as they are
+        /// modified. Their indices keep plain 'IndxHedr' headers and are searched without leaf
+        /// hashes or key filters. Their trailers' skip_generation fields are null and are
+        /// ignored, and their unused1 field is zero so no flags are set.
+        static constexpr std::uint16_t min_minor_version = 12;
 
         static std::array<std::uint8_t, 4> const file_signature1;
         static std::uint32_t const file_signature2 = 0x0507FFFF;
@@ -132,7 +145,12 @@ namespace pstore {
         /// This crc is used to ensure that the fields from #signature1 to #sync_name are not
         /// modified.
         std::uint32_t crc = 0;
-        std::uint32_t unused1 = 0;
+
+        /// Set in a store which vacuum has replaced with a compacted copy (see #flags).
+        static constexpr std::uint32_t replaced = 1U;
+        /// Flags describing the state of the file. These may change after the store is created
+        /// so aren't covered by the crc.
+        std::atomic<std::uint32_t> flags{0};
 
         /// The file offset of the current (most recent) file footer. This value is modified as the
         /// the very last step of commiting a transaction.
@@ -150,6 +168,7 @@ namespace pstore {
 
     PSTORE_STATIC_ASSERT (offsetof (header, a) == 0);
     PSTORE_STATIC_ASSERT (offsetof (header, crc) == 32);
+    PSTORE_STATIC_ASSERT (offsetof (header, flags) == 36);
     PSTORE_STATIC_ASSERT (offsetof (header, footer_pos) == 40);
     PSTORE_STATIC_ASSERT (alignof (header) == 8);
     PSTORE_STATIC_ASSERT (sizeof (header) == 48);
@@ -217,6 +236,10 @@ namespace pstore {
         /// Computes the trailer's CRC value.
         std::uint32_t get_crc () const noexcept;
 
+        /// Returns \p x with its least significant set bit cleared.
+        static constexpr unsigned clear_lowest_one (unsigned const x) noexcept {
+            return x & (x - 1U);
+        }
 
 #define X(a) a,
         // Note that the first enum member must have the value 0 or flush_indices() will need to
@@ -247,10 +270,24 @@ namespace pstore {
             typed_address<trailer> prev_generation = typed_address<trailer>::null ();
 
             index_records_array index_records;
-            std::uint32_t unused2{0};
-            std::uint32_t unused3{0};
+
+            /// A pointer to an earlier generation whose number is given by
+            /// trailer::skip_target(generation). Together with prev_generation, these pointers
+            /// allow any revision to be found in a logarithmic number of steps. Null for
+            /// generation 0 and in stores written before the field was introduced.
+            typed_address<trailer> skip_generation = typed_address<trailer>::null ();
         };
 
+        /// Returns the generation number to which the skip_generation field of a trailer with
+        /// generation number \p generation points. Odd generations skip further than the even
+        /// generations either side of them so that a search can approach any target quickly.
+        static constexpr unsigned skip_target (unsigned const generation) noexcept {
+            return generation < 2U ? 0U
+                   : (generation & 1U) != 0U
+                       ? clear_lowest_one (clear_lowest_one (generation - 1U)) + 1U
+                       : clear_lowest_one (generation);
+        }
+
 
         body a;
 
@@ -273,8 +310,7 @@ namespace pstore {
     PSTORE_STATIC_ASSERT (offsetof (trailer::body, time) == 24);
     PSTORE_STATIC_ASSERT (offsetof (trailer::body, prev_generation) == 32);
     PSTORE_STATIC_ASSERT (offsetof (trailer::body, index_records) == 40);
-    PSTORE_STATIC_ASSERT (offsetof (trailer::body, unused2) == 88);
-    PSTORE_STATIC_ASSERT (offsetof (trailer::body, unused3) == 92);
+    PSTORE_STATIC_ASSERT (offsetof (trailer::body, skip_generation) == 88);
     PSTORE_STATIC_ASSERT (alignof (trailer::body) == 8);
     PSTORE_STATIC_ASSERT (sizeof (trailer::body) == 96);
 
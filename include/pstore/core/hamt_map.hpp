@@ -18,8 +18,14 @@
 #ifndef PSTORE_CORE_HAMT_MAP_HPP
 #define PSTORE_CORE_HAMT_MAP_HPP
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "pstore/core/bloom_filter.hpp"
 #include "pstore/core/hamt_map_types.hpp"
 #include "pstore/serialize/standard_types.hpp"
+#include "pstore/support/parallel_for_each.hpp"
 
 namespace pstore {
 
@@ -302,6 +308,26 @@ namespace pstore {
                           pair_types_compatible<OtherKeyType, OtherValueType>::value>::type>
             auto insert_or_assign (transaction_base & transaction, OtherKeyType const & key,
                                    OtherValueType const & value) -> std::pair<iterator, bool>;
+
+            /// Inserts each of the elements in the range [first, last) whose key is not already
+            /// present in the container. If the range contains more than one element with
+            /// equivalent keys, only the first is inserted. All iterators are invalidated.
+            ///
+            /// If the container is empty, the elements are sorted by hash and the trie is built
+            /// bottom-up in a single pass: each node is written directly to the store exactly once
+            /// and the per-key path traversal and copying performed by insert() is avoided.
+            /// Otherwise each element is inserted as if by insert().
+            ///
+            /// \tparam ForwardIterator  An iterator whose value type is a std::pair<> with types
+            /// whose serialized representations are compatible with KeyType and ValueType.
+            /// \param transaction  The transaction to which the new key-value pairs will be
+            /// appended.
+            /// \param first  The start of the range of elements to insert.
+            /// \param last  The end of the range of elements to insert.
+            /// \result  The number of elements that were inserted.
+            template <typename ForwardIterator>
+            std::size_t bulk_insert (transaction_base & transaction, ForwardIterator first,
+                                     ForwardIterator last);
             ///@}
 
             /// \name Lookup
@@ -333,6 +359,87 @@ namespace pstore {
             bool contains (database const & db, OtherKeyType const & key) const {
                 return this->find (db, key) != this->end (db);
             }
+
+            /// Finds the elements with keys equivalent to each of the keys in the range [first,
+            /// last). The result is the same as calling find() for each key in turn, but the
+            /// lookups are interleaved: each key advances by one tree level per pass over the
+            /// batch and the next node for each key is prefetched so that the memory accesses for
+            /// different keys overlap.
+            ///
+            /// \tparam ForwardIterator  An iterator whose value type has a serialized
+            /// representation which is compatible with KeyType.
+            /// \param db  The database to which the index belongs.
+            /// \param first  The first of the keys to be found.
+            /// \param last  The end of the range of keys to be found.
+            /// \return A vector containing an iterator for each of the keys in the range [first,
+            ///         last) and in the same order. A key which is not found produces a
+            ///         past-the-end iterator.
+            template <typename ForwardIterator,
+                      typename = typename std::enable_if<serialize::is_compatible<
+                          typename std::iterator_traits<ForwardIterator>::value_type,
+                          KeyType>::value>::type>
+            std::vector<const_iterator> find_batch (database const & db, ForwardIterator first,
+                                                    ForwardIterator last) const;
+
+            /// Performs the same function as find_batch() but divides the keys between multiple
+            /// threads.
+            ///
+            /// \tparam RandomAccessIterator  An iterator whose value type has a serialized
+            /// representation which is compatible with KeyType.
+            /// \param db  The database to which the index belongs.
+            /// \param first  The first of the keys to be found.
+            /// \param last  The end of the range of keys to be found.
+            /// \return A vector containing an iterator for each of the keys in the range [first,
+            ///         last) and in the same order. A key which is not found produces a
+            ///         past-the-end iterator.
+            template <typename RandomAccessIterator,
+                      typename = typename std::enable_if<serialize::is_compatible<
+                          typename std::iterator_traits<RandomAccessIterator>::value_type,
+                          KeyType>::value>::type>
+            std::vector<const_iterator> parallel_find_batch (database const & db,
+                                                             RandomAccessIterator first,
+                                                             RandomAccessIterator last) const;
+            ///@}
+
+            /// \name Partitioning
+            ///@{
+
+            /// Divides the members of the index into runs which can be visited independently (for
+            /// example, by different threads). Each run consists of one or more complete
+            /// sub-tries. The runs are returned in iteration order and between them contain every
+            /// member of the index exactly once.
+            ///
+            /// \param db  The database to which the index belongs.
+            /// \param min_parts  The number of runs wanted. The trie is divided a whole level at a
+            ///   time so more runs than this may be produced. Fewer are produced if the trie has
+            ///   too few sub-tries and none if the index is empty.
+            /// \return The runs, in iteration order.
+            std::vector<subrange<const_iterator>> partition (database const & db,
+                                                             std::size_t min_parts) const;
+
+            /// Divides the members of the index into runs which are to be processed by the
+            /// threads of the global thread pool. Several runs are produced for each thread so
+            /// that the work is evenly shared even if the sub-tries differ in size. See
+            /// partition().
+            ///
+            /// \param db  The database to which the index belongs.
+            /// \return The runs, in iteration order.
+            std::vector<subrange<const_iterator>> parallel_partition (database const & db) const {
+                constexpr auto parts_per_thread = std::size_t{8};
+                return this->partition (db,
+                                        (thread_pool::global ().size () + 1U) * parts_per_thread);
+            }
+
+            /// Invokes \p fn for each member of the index. The index is divided using
+            /// parallel_partition() and the resulting runs are visited by the threads of the global
+            /// thread pool. Calls to \p fn may therefore be concurrent and are made in no
+            /// particular order.
+            ///
+            /// \param db  The database to which the index belongs.
+            /// \param fn  A function which is compatible with void(const_iterator const &). It is
+            ///   passed an iterator to each member of the index in turn.
+            template <typename Function>
+            void parallel_visit (database const & db, Function fn) const;
             ///@}
 
             /// Flush any modified index nodes to the store.
@@ -341,6 +448,20 @@ namespace pstore {
             /// \param generation The generation number to which the map will be written.
             /// \returns The address of the index root node.
             typed_address<header_block> flush (transaction_base & transaction, unsigned generation);
+            /// Returns an upper bound on the number of bytes that flush() will allocate, provided
+            /// that the transaction's next allocation is aligned to
+            /// details::internal_node::node_alignment.
+            std::uint64_t flush_size () const;
+
+            /// Sets the number of levels at the top of the trie which are held in memory to speed
+            /// up lookups. The internal nodes at these levels are visited by every search so
+            /// caching them saves one or more loads from the store per search. The cache is built
+            /// by the first lookup which follows and is discarded whenever the index is modified.
+            /// 0 disables the cache.
+            ///
+            /// The initial value is given by database::get_index_node_cache_levels().
+            void set_node_cache_levels (unsigned levels);
+            unsigned node_cache_levels () const noexcept { return cache_levels_; }
 
             /// \name Accessors
             /// Provide access to index internals.
@@ -351,30 +472,152 @@ namespace pstore {
 
             /// Returns the index root pointer.
             index_pointer root () const noexcept { return root_; }
+
+            /// Returns true if each leaf of this index is preceded in the store by the hash of its
+            /// key (see persist_leaf_hash<>).
+            bool leaf_hashes () const noexcept { return leaf_hashes_; }
             ///@}
 
         private:
+            /// The signature of an index whose leaves are not preceded by their hash.
             static constexpr std::array<std::uint8_t, 8> index_signature{
                 {'I', 'n', 'd', 'x', 'H', 'e', 'd', 'r'}};
-
-            /// Stores a key/value data pair.
+            /// The signature of an index whose leaves are each preceded by their key's hash.
+            static constexpr std::array<std::uint8_t, 8> hashed_index_signature{
+                {'I', 'n', 'd', 'x', 'H', 'a', 's', 'h'}};
+            /// The signature of an index which has a key filter. Its header is a
+            /// filtered_header_block.
+            static constexpr std::array<std::uint8_t, 8> filtered_index_signature{
+                {'I', 'n', 'd', 'x', 'F', 'l', 't', 'r'}};
+
+            /// True if this index keeps a filter of its keys (see persist_key_filter<>).
+            static constexpr bool key_filter = persist_key_filter<KeyType, Hash>::value;
+            static_assert (!key_filter || !persist_leaf_hash<KeyType>::value,
+                           "An index cannot have both a key filter and leaf hashes");
+            /// The smallest number of keys for which a key filter is sized.
+            static constexpr std::uint64_t min_filter_capacity = 256U;
+
+            /// Stores a key/value data pair whose key has the hash \p key_hash and records its
+            /// address in \p parents.
             template <typename OtherValueType>
             address store_leaf_node (transaction_base & transaction, OtherValueType const & v,
-                                     gsl::not_null<parent_stack *> parents);
+                                     hash_type key_hash, gsl::not_null<parent_stack *> parents);
+            /// Writes a key/value data pair to the store and returns its address. If leaf_hashes_
+            /// is true, \p hash is written immediately before the pair.
+            template <typename OtherValueType>
+            address write_leaf_node (transaction_base & transaction, OtherValueType const & v,
+                                     hash_type hash);
 
-            /// If the \p node is a heap internal node, clear its children and itself.
-            void clear (index_pointer node, unsigned shifts);
+            ///@{
+            /// Returns the hash stored before the leaf at \p addr. Must only be called if
+            /// leaf_hashes_ is true.
+            static hash_type leaf_hash (database const & db, address addr);
+            static hash_type leaf_hash (database::read_view & view, address addr);
+            ///@}
+            /// Returns \p hash shifted right by \p shifts bits as it is during a descent of the
+            /// trie. The result is 0 once all of the bits have been consumed.
+            static constexpr hash_type shift_hash (hash_type const hash,
+                                                   unsigned const shifts) noexcept {
+                return shifts < details::hash_size ? hash >> shifts : hash_type{0};
+            }
+
+            /// A record used by bulk_insert() to sort the incoming elements.
+            template <typename ForwardIterator>
+            struct bulk_entry {
+                /// The key hash.
+                hash_type hash;
+                /// The key hash with its 6-bit digits reversed so that sorting by this value
+                /// places the keys in the order in which they appear in the trie.
+                hash_type order;
+                /// The key prefix (see key_prefix<>).
+                std::uint64_t prefix;
+                /// The element to be inserted.
+                ForwardIterator it;
+            };
+
+            /// Returns the hash digits in reverse order so that sorting by the result yields the
+            /// left-to-right order of the keys in the trie.
+            static constexpr hash_type trie_order (hash_type hash) noexcept;
 
-            /// Clear the hamt_map when transaction::rollback() function is called.
+            /// Recursively writes the sub-trie containing the elements [first, last) to the store.
+            /// The elements must be sorted and must not contain duplicate keys.
+            ///
+            /// \param transaction  The transaction to which the nodes will be appended.
+            /// \param first  The first of the elements belonging to this sub-trie.
+            /// \param last  The end of the elements belonging to this sub-trie.
+            /// \param shifts  The number of bits by which the hash value is shifted to reach the
+            /// current tree level.
+            /// \result  The store reference to the root of the new sub-trie.
+            template <typename EntryIterator>
+            index_pointer bulk_build (transaction_base & transaction, EntryIterator first,
+                                      EntryIterator last, unsigned shifts);
+
+            /// The state of a single key's descent through the trie.
+            struct find_cursor {
+                explicit find_cursor (hash_type h, index_pointer root) noexcept
+                        : hash{h}
+                        , node{root} {}
+
+                /// The key hash, shifted to select the digit for the current tree level.
+                hash_type hash;
+                /// The number of bits by which the hash has been shifted.
+                unsigned shifts = 0;
+                /// The node to be visited next.
+                index_pointer node;
+                /// The nodes visited so far (and the positions within each of those nodes).
+                parent_stack parents;
+                /// True if the key was found.
+                bool found = false;
+            };
+
+            /// The number of keys whose lookups are interleaved by find_batch().
+            static constexpr std::size_t find_batch_width = 16;
+
+            /// The smallest number of keys that parallel_find_batch() will give to a thread.
+            static constexpr std::size_t parallel_find_min_keys = 1024;
+
+            /// Advances the search for \p key by one tree level.
+            ///
+            /// \param view  A view of the database to which the index belongs.
+            /// \param key  The key being searched for.
+            /// \param cursor  The state of the search.
+            /// \return True if the search must continue, false if it is complete in which case
+            ///   cursor.found indicates whether \p key was found.
+            template <typename OtherKeyType>
+            bool find_step (database::read_view & view, OtherKeyType const & key,
+                            find_cursor & cursor) const;
+
+            /// Returns the node cache, building it if necessary, or nullptr if the cache is
+            /// disabled or cannot be used because the trie has been modified.
+            details::node_cache const * get_node_cache (database const & db) const;
+            /// Discards the node cache. Called before the trie is modified.
+            void drop_node_cache () noexcept;
+            /// Advances the search described by \p cursor through the levels of the trie which
+            /// are held by \p cache. Returns true if the search must continue or false if the key
+            /// is not in the index.
+            static bool descend_cached (details::node_cache const & cache, find_cursor & cursor);
+
+            /// Clear the hamt_map when transaction::rollback() function is called. Every heap
+            /// node is released in one step.
             void clear () {
                 if (root_.is_heap ()) {
-                    this->clear (root_, 0 /*shifts*/);
                     root_.internal = nullptr;
                 }
+                arena_.clear ();
             }
 
+            ///@{
             /// Read a key from a store.
             key_type get_key (database const & db, address const addr) const;
+            key_type get_key (database::read_view & view, address const addr) const;
+            ///@}
+
+            /// Loads keys from the store for comparison. For some key types (see
+            /// key_view_traits<>) this avoids constructing a key_type instance.
+            using stored_key = details::stored_key<KeyType, KeyEqual>;
+
+            /// True if the children of a linear node are kept sorted (see sorted_linear_nodes<>).
+            static constexpr bool sorted_linear = sorted_linear_nodes<KeyType, KeyEqual>::value;
 
             /// Called when the trie's top-level loop has descended as far as a leaf node. We need
             /// to convert that to an internal node.
@@ -382,7 +625,7 @@ namespace pstore {
             auto insert_into_leaf (transaction_base & transaction,
                                    index_pointer const & existing_leaf,
                                    OtherValueType const & new_leaf, hash_type existing_hash,
-                                   hash_type hash, unsigned shifts,
+                                   hash_type key_hash, unsigned shifts,
                                    gsl::not_null<parent_stack *> parents) -> index_pointer;
 
             /// Inserts a key-value pair into an internal node, potentially traversing to deeper
@@ -391,7 +634,7 @@ namespace pstore {
             /// \param transaction  The transaction to which new data will be appended.
             /// \param node  A heap or in-store reference to an existing internal node.
             /// \param value The key/value pair to be inserted.
-            /// \param hash  The key hash.
+            /// \param key_hash  The full hash of the key.
             /// \param shifts  The number of bits by which the hash value is shifted to reach the
             /// current tree level.
             /// \param parents  A stack containing references to the nodes visited during the tree
@@ -404,21 +647,22 @@ namespace pstore {
             /// whether the key was already present.
             template <typename OtherValueType>
             auto insert_into_internal (transaction_base & transaction, index_pointer node,
-                                       OtherValueType const & value, hash_type hash,
+                                       OtherValueType const & value, hash_type key_hash,
                                        unsigned shifts, gsl::not_null<parent_stack *> parents,
                                        bool is_upsert) -> std::pair<index_pointer, bool>;
 
             template <typename OtherValueType>
             auto insert_into_linear (transaction_base & transaction, index_pointer const node,
-                                     OtherValueType const & value,
+                                     OtherValueType const & value, hash_type key_hash,
                                      gsl::not_null<parent_stack *> parents, bool is_upsert)
                 -> std::pair<index_pointer, bool>;
 
             /// Insert a new key/value pair into a existing node, which could be a leaf node, an
-            /// internal store node or an internal heap node.
+            /// internal store node or an internal heap node. \p key_hash is the full hash of the
+            /// key: the bits which select a child at this level are found using \p shifts.
             template <typename OtherValueType>
             auto insert_node (transaction_base & transaction, index_pointer const node,
-                              OtherValueType const & value, hash_type hash, unsigned shifts,
+                              OtherValueType const & value, hash_type key_hash, unsigned shifts,
                               gsl::not_null<parent_stack *> parents, bool is_upsert)
                 -> std::pair<index_pointer, bool>;
 
@@ -438,13 +682,17 @@ namespace pstore {
                                                         OtherValueType const & value,
                                                         bool is_upsert);
 
-            /// Frees memory consumed by a heap-allocated tree node.
-            ///
-            /// \param node  The tree node to be deleted.
-            /// \param shifts  The number of bits by which the hash value is shifted to reach the
-            /// current tree level. This is used to determine whether the reference is to an
-            /// internal or linear node.
-            void delete_node (index_pointer node, unsigned shifts);
+            /// Returns false if the key filter shows that \p key, whose hash is \p hash, is not in
+            /// the index. Returns true if it may be.
+            template <typename OtherKeyType>
+            bool may_contain (database::read_view & view, OtherKeyType const & key,
+                              hash_type hash) const;
+            /// Records a newly inserted key, whose hash is \p hash, in the key filter.
+            /// \param key  The new key.
+            /// \param hash  The hash of \p key.
+            /// \param was_empty  True if the index was empty before \p key was inserted.
+            template <typename OtherKeyType>
+            void add_to_filter (OtherKeyType const & key, hash_type hash, bool was_empty);
 
             /// \brief Write the index header.
             /// The index header simply holds a check signature, the tree root, and remembers the
@@ -454,25 +702,15 @@ namespace pstore {
             /// \result  The address at which the header block was written.
             typed_address<header_block> write_header_block (transaction_base & transaction);
 
-            static constexpr auto internal_nodes_per_chunk =
-                std::size_t{256} * 1024 / sizeof (internal_node);
-
-            /// Internal nodes are allocated using a "chunked-sequence". This allocates memory in
-            /// lumps sufficent for internal_nodes_per_chunk entries. This is then consumed as new
-            /// in-heap internal nodes are created.
+            /// The in-heap internal and linear nodes are allocated from this arena. A node which
+            /// is replaced (for example, by a larger linear node) is simply abandoned. The arena is
+            /// released in one step once the index has been flushed so that an insert-heavy
+            /// transaction makes few calls to the system heap and doesn't leave it fragmented.
             ///
-            /// The effect of this is to significantly reduce the number of memory allocations
-            /// performed by the index code under heavy insertion pressure and thus give us a little
-            /// extra performance. The cost is that we may waste as much as one chunk's worth of
-            /// memory (minus sizeof (internal_node)).
-            ///
-            // TODO: we allocate nodes at their maximum size even though they may only contain two
-            // members. This is rather wasteful and will prevent us from moving to larger hash
-            // sizes due to the bloated memory consumption.
-            using internal_nodes_container =
-                chunked_sequence<internal_node, internal_nodes_per_chunk,
-                                 internal_node::size_bytes (details::hash_size)>;
-            std::unique_ptr<internal_nodes_container> internals_container_;
+            // TODO: we allocate internal nodes at their maximum size even though they may only
+            // contain two members. This is rather wasteful and will prevent us from moving to
+            // larger hash sizes due to the bloated memory consumption.
+            details::node_arena arena_;
 
             unsigned revision_;
             index_pointer root_;
@@ -481,6 +719,26 @@ namespace pstore {
             Hash hash_;
             /// The function used to compare keys for equality.
             key_equal equal_;
+            /// True if each leaf is preceded in the store by its key's hash. An index loaded from
+            /// the store keeps the format in which it was created.
+            bool leaf_hashes_ = persist_leaf_hash<KeyType>::value;
+
+            /// The key filter which was most recently written to the store.
+            bloom_filter::stored stored_filter_;
+            /// The key filter extended with the keys added since the index was last flushed.
+            /// Null if no keys have been added. An index written without a filter (by an earlier
+            /// version of the library) stays without one rather than have flush() build a filter
+            /// from every one of its keys.
+            std::unique_ptr<bloom_filter> filter_;
+
+            /// The number of trie levels held by the node cache.
+            unsigned cache_levels_;
+            /// Serializes construction of the node cache by concurrent lookups.
+            mutable std::mutex cache_mutex_;
+            /// Owns the node cache.
+            mutable std::unique_ptr<details::node_cache const> cache_owner_;
+            /// The node cache or nullptr if it has not been built.
+            mutable std::atomic<details::node_cache const *> cache_{nullptr};
         };
 #ifdef _WIN32
 #    pragma warning(pop)
@@ -600,25 +858,46 @@ namespace pstore {
         template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
         constexpr std::array<std::uint8_t, 8>
             hamt_map<KeyType, ValueType, Hash, KeyEqual>::index_signature;
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        constexpr std::array<std::uint8_t, 8>
+            hamt_map<KeyType, ValueType, Hash, KeyEqual>::hashed_index_signature;
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        constexpr std::array<std::uint8_t, 8>
+            hamt_map<KeyType, ValueType, Hash, KeyEqual>::filtered_index_signature;
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        constexpr bool hamt_map<KeyType, ValueType, Hash, KeyEqual>::key_filter;
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        constexpr std::uint64_t hamt_map<KeyType, ValueType, Hash, KeyEqual>::min_filter_capacity;
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        constexpr std::size_t hamt_map<KeyType, ValueType, Hash, KeyEqual>::find_batch_width;
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        constexpr std::size_t hamt_map<KeyType, ValueType, Hash, KeyEqual>::parallel_find_min_keys;
 
         template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
         hamt_map<KeyType, ValueType, Hash, KeyEqual>::hamt_map (
             database const & db, typed_address<header_block> const pos, Hash const & hash,
             KeyEqual const & equal)
-                : internals_container_{std::make_unique<internal_nodes_container> ()}
-                , revision_{db.get_current_revision ()}
+                : revision_{db.get_current_revision ()}
                 , hash_{hash}
-                , equal_{equal} {
+                , equal_{equal}
+                , cache_levels_{db.get_index_node_cache_levels ()} {
 
             if (pos != typed_address<header_block>::null ()) {
                 // 'pos' points to the index header block which gives us the tree root and size.
                 std::shared_ptr<header_block const> const hb = db.getro (pos);
                 // Check that this block appears to be sensible.
+                leaf_hashes_ = hb->signature == hashed_index_signature;
+                bool const filtered = hb->signature == filtered_index_signature;
 #if PSTORE_SIGNATURE_CHECKS_ENABLED
-                if (hb->signature != index_signature) {
+                if (!leaf_hashes_ && !filtered && hb->signature != index_signature) {
                     raise (pstore::error_code::index_corrupt);
                 }
 #endif
+                if (filtered) {
+                    std::shared_ptr<filtered_header_block const> const fhb =
+                        db.getro (typed_address<filtered_header_block>::make (pos.to_address ()));
+                    stored_filter_ = bloom_filter::stored{db, fhb->filter};
+                }
 
                 {
                     auto const root = index_pointer{hb->root};
@@ -635,25 +914,6 @@ namespace pstore {
             }
         }
 
-        // hamt_map::clear
-        // ~~~~~~~~~~~~~~~
-        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
-        void hamt_map<KeyType, ValueType, Hash, KeyEqual>::clear (index_pointer node,
-                                                                  unsigned shifts) {
-            PSTORE_ASSERT (node.is_heap () && !node.is_leaf ());
-            if (details::depth_is_internal_node (shifts)) {
-                auto * const internal = node.untag_node<internal_node *> ();
-                // Recursively release the children of this internal node.
-                for (auto p : *internal) {
-                    if (p.is_heap ()) {
-                        this->clear (p, shifts + details::hash_index_bits);
-                    }
-                }
-            }
-
-            this->delete_node (node, shifts);
-        }
-
         // hamt_map::load_leaf_node
         // ~~~~~~~~~~~~~~~~~~~~~~~~
         template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
@@ -674,48 +934,88 @@ namespace pstore {
 
             return serialize::read<KeyType> (serialize::archive::database_reader{db, addr});
         }
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::get_key (database::read_view & view,
+                                                                    address const addr) const
+            -> key_type {
+
+            return serialize::read<KeyType> (serialize::archive::database_reader{view, addr});
+        }
 
         // hamt_map::store_leaf_node
         // ~~~~~~~~~~~~~~~~~~~~~~~~~
         template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
         template <typename OtherValueType>
         address hamt_map<KeyType, ValueType, Hash, KeyEqual>::store_leaf_node (
-            transaction_base & transaction, OtherValueType const & v,
+            transaction_base & transaction, OtherValueType const & v, hash_type const key_hash,
             gsl::not_null<parent_stack *> const parents) {
 
+            address const result = this->write_leaf_node (transaction, v, key_hash);
+            parents->push ({index_pointer{result}});
+            return result;
+        }
+
+        // hamt_map::write_leaf_node
+        // ~~~~~~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        template <typename OtherValueType>
+        address hamt_map<KeyType, ValueType, Hash, KeyEqual>::write_leaf_node (
+            transaction_base & transaction, OtherValueType const & v, hash_type const hash) {
             // Make sure the alignment of leaf node is 4 to ensure that the two LSB are guaranteed
             // 0. If 'v' has greater alignment, serialize::write() will add additional padding.
             constexpr auto aligned_to = std::size_t{4};
             static_assert ((details::internal_node_bit | details::heap_node_bit) == aligned_to - 1,
                            "expected required alignment to be 4");
-            transaction.allocate (0, aligned_to);
 
-            // Now write the node and return where it went.
-            address const result =
-                serialize::write (serialize::archive::make_writer (transaction), v);
-            PSTORE_ASSERT ((result.absolute () & (aligned_to - 1U)) == 0U);
-            parents->push ({index_pointer{result}});
+            // The leaf (and its hash) are gathered in a buffer so that they reach the store with a
+            // single allocation.
+            serialize::archive::buffered_database_writer writer{transaction};
+            if (leaf_hashes_) {
+                // The hash is followed immediately by the leaf, which is therefore also aligned.
+                serialize::write (writer, hash);
+            }
+            writer.align (aligned_to);
+            std::size_t const offset = serialize::write (writer, v);
+            PSTORE_ASSERT (!leaf_hashes_ || offset == sizeof (hash_type));
+            writer.flush ();
 
+            address const result = writer.address_of (offset);
+            PSTORE_ASSERT ((result.absolute () & (aligned_to - 1U)) == 0U);
             return result;
         }
 
+        // hamt_map::leaf_hash
+        // ~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::leaf_hash (database const & db,
+                                                                      address const addr)
+            -> hash_type {
+            return *db.getro (typed_address<hash_type>::make (addr - sizeof (hash_type)));
+        }
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::leaf_hash (database::read_view & view,
+                                                                      address const addr)
+            -> hash_type {
+            return *view.get (typed_address<hash_type>::make (addr - sizeof (hash_type)));
+        }
+
         // hamt_map::insert_into_leaf
         // ~~~~~~~~~~~~~~~~~~~~~~~~~~
         template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
         template <typename OtherValueType>
         auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::insert_into_leaf (
             transaction_base & transaction, index_pointer const & existing_leaf,
-            OtherValueType const & new_leaf, hash_type existing_hash, hash_type hash,
+            OtherValueType const & new_leaf, hash_type existing_hash, hash_type const key_hash,
             unsigned shifts, gsl::not_null<parent_stack *> parents) -> index_pointer {
 
             if (details::depth_is_internal_node (shifts)) {
-                auto const new_hash = hash & details::hash_index_mask;
+                auto const new_hash = shift_hash (key_hash, shifts) & details::hash_index_mask;
                 auto const old_hash = existing_hash & details::hash_index_mask;
                 if (new_hash != old_hash) {
                     address const leaf_addr =
-                        this->store_leaf_node (transaction, new_leaf, parents);
+                        this->store_leaf_node (transaction, new_leaf, key_hash, parents);
                     auto const internal_ptr = index_pointer{
-                        internal_node::allocate (internals_container_.get (), existing_leaf,
+                        internal_node::allocate (&arena_, existing_leaf,
                                                  index_pointer{leaf_addr}, old_hash, new_hash)};
                     parents->push (
                         {internal_ptr, internal_node::get_new_index (new_hash, old_hash)});
@@ -731,52 +1031,55 @@ namespace pstore {
                 // hash function.
 
                 shifts += details::hash_index_bits;
-                hash >>= details::hash_index_bits;
                 existing_hash >>= details::hash_index_bits;
 
                 index_pointer const leaf_ptr = this->insert_into_leaf (
-                    transaction, existing_leaf, new_leaf, existing_hash, hash, shifts, parents);
+                    transaction, existing_leaf, new_leaf, existing_hash, key_hash, shifts, parents);
                 auto const internal_ptr = index_pointer{
-                    internal_node::allocate (internals_container_.get (), leaf_ptr, old_hash)};
+                    internal_node::allocate (&arena_, leaf_ptr, old_hash)};
                 parents->push ({internal_ptr, 0U});
                 return internal_ptr;
             }
 
             // We ran out of hash bits: create a new linear node.
+            if (!sorted_linear) {
+                address const new_addr =
+                    this->store_leaf_node (transaction, new_leaf, key_hash, parents);
+                auto const linear_ptr = index_pointer{
+                    linear_node::allocate_unsorted (arena_, existing_leaf.addr, new_addr)};
+                parents->push ({linear_ptr, 1U});
+                return linear_ptr;
+            }
+
+            // The children of a sorted node are ordered by key prefix and then by key.
+            auto const existing_key = stored_key::load (transaction.db (), existing_leaf.addr);
+            key_prefix<KeyType> const prefix_fn{};
+            auto const existing_prefix = prefix_fn (existing_key);
+            auto const new_prefix = prefix_fn (new_leaf.first);
+            bool const new_first = new_prefix < existing_prefix ||
+                                   (new_prefix == existing_prefix && !(existing_key < new_leaf.first));
+
+            address const new_addr =
+                this->store_leaf_node (transaction, new_leaf, key_hash, parents);
             auto const linear_ptr = index_pointer{
-                linear_node::allocate (existing_leaf.addr,
-                                       this->store_leaf_node (transaction, new_leaf, parents))
-                    .release ()};
-            parents->push ({linear_ptr, 1U});
+                new_first ? linear_node::allocate (arena_, new_addr, new_prefix,
+                                                   existing_leaf.addr, existing_prefix)
+                          : linear_node::allocate (arena_, existing_leaf.addr, existing_prefix,
+                                                   new_addr, new_prefix)};
+            parents->push ({linear_ptr, new_first ? 0U : 1U});
             return linear_ptr;
         }
 
-        // hamt_map::delete_node
-        // ~~~~~~~~~~~~~~~~~~~~~
-        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
-        void hamt_map<KeyType, ValueType, Hash, KeyEqual>::delete_node (index_pointer const node,
-                                                                        unsigned const shifts) {
-            if (node.is_heap ()) {
-                PSTORE_ASSERT (!node.is_leaf ());
-                if (details::depth_is_internal_node (shifts)) {
-                    // Internal nodes are owned by internals_container_. Don't delete them here. If
-                    // this ever changes, then add something like: delete
-                    // node.untag_node<internal_node *> ();
-                } else {
-                    delete node.untag_node<linear_node *> ();
-                }
-            }
-        }
-
         // hamt_map::insert_into_internal
         // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
         template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
         template <typename OtherValueType>
         auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::insert_into_internal (
             transaction_base & transaction, index_pointer node, OtherValueType const & value,
-            hash_type hash, unsigned shifts, gsl::not_null<parent_stack *> parents, bool is_upsert)
-            -> std::pair<index_pointer, bool> {
+            hash_type const key_hash, unsigned shifts, gsl::not_null<parent_stack *> parents,
+            bool is_upsert) -> std::pair<index_pointer, bool> {
 
+            auto const hash = shift_hash (key_hash, shifts);
             std::shared_ptr<internal_node const> iptr;
             internal_node const * internal = nullptr;
             std::tie (iptr, internal) = internal_node::get_node (transaction.db (), node);
@@ -791,40 +1094,34 @@ namespace pstore {
             // and point to it.
             if (index == details::not_found) {
                 internal_node * const inode =
-                    internal_node::make_writable (internals_container_.get (), node, *internal);
+                    internal_node::make_writable (&arena_, node, *internal);
                 inode->insert_child (
-                    hash, index_pointer{this->store_leaf_node (transaction, value, parents)},
+                    hash,
+                    index_pointer{this->store_leaf_node (transaction, value, key_hash, parents)},
                     parents);
                 return {index_pointer{inode}, false};
             }
 
             shifts += details::hash_index_bits;
-            hash >>= details::hash_index_bits;
 
             // update child_slot
             bool key_exists;
             index_pointer new_child;
-            std::tie (new_child, key_exists) = this->insert_node (transaction, child_slot, value,
-                                                                  hash, shifts, parents, is_upsert);
+            std::tie (new_child, key_exists) = this->insert_node (
+                transaction, child_slot, value, key_hash, shifts, parents, is_upsert);
 
             // If the insertion resulted in our child node being reallocated, then this node needs
-            // to be heap-allocated and the child reference updated. The original child pointer may
-            // also need to be freed.
-
-            std::unique_ptr<internal_node> new_node;
+            // to be heap-allocated and the child reference updated.
             if (new_child != child_slot) {
                 internal_node * const inode =
-                    internal_node::make_writable (internals_container_.get (), node, *internal);
+                    internal_node::make_writable (&arena_, node, *internal);
 
-                // Release a previous heap-allocated instance.
-                index_pointer & child = (*inode)[index];
-                this->delete_node (child, shifts);
-                child = new_child;
+                // A previous heap-allocated child is owned by the arena: it is simply abandoned.
+                (*inode)[index] = new_child;
                 node = inode;
             }
 
             parents->push ({node, index});
-            new_node.release ();
             return {node, key_exists};
         }
 
@@ -834,7 +1131,7 @@ namespace pstore {
         template <typename OtherValueType>
         auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::insert_into_linear (
             transaction_base & transaction, index_pointer const node, OtherValueType const & value,
-            gsl::not_null<parent_stack *> parents, bool const is_upsert)
+            hash_type const key_hash, gsl::not_null<parent_stack *> parents, bool const is_upsert)
             -> std::pair<index_pointer, bool> {
 
             index_pointer result;
@@ -845,24 +1142,35 @@ namespace pstore {
             std::tie (lptr, orig_node) = linear_node::get_node (transaction.db (), node);
             PSTORE_ASSERT (orig_node != nullptr);
 
-            index_pointer child_slot;
             auto index = std::size_t{0};
+            bool found = false;
+            std::tie (index, found) =
+                orig_node->lower_bound<KeyType> (transaction.db (), value.first, equal_);
+            if (!found && !sorted_linear) {
+                // The key wasn't present in an unsorted node so it is appended.
+                PSTORE_ASSERT (!orig_node->is_sorted () && index == orig_node->size ());
+                linear_node * const lnode = linear_node::allocate_from (arena_, *orig_node, 1U);
+                (*lnode)[index] = this->store_leaf_node (transaction, value, key_hash, parents);
+                result = lnode;
+            } else if (!found) {
+                // The key wasn't present in the node so we insert it at the position which
+                // maintains the node's order. A node in the original unsorted format is first
+                // converted.
+                std::unique_ptr<linear_node> sorted_node;
+                if (!orig_node->is_sorted ()) {
+                    sorted_node = linear_node::allocate_sorted<KeyType> (transaction.db (), *orig_node);
+                    std::tie (index, found) =
+                        sorted_node->lower_bound<KeyType> (transaction.db (), value.first, equal_);
+                    PSTORE_ASSERT (!found);
+                    orig_node = sorted_node.get ();
+                }
 
-            std::tie (child_slot, index) =
-                orig_node->lookup<KeyType> (transaction.db (), value.first, equal_);
-            if (index == details::not_found) {
-                // The key wasn't present in the node so we simply append it.
-                // TODO: keep these entries sorted?
-
-                // Load into memory with space for 1 new child node.
-                std::unique_ptr<linear_node> new_node = linear_node::allocate_from (*orig_node, 1U);
-                index = orig_node->size ();
-                (*new_node)[index] = this->store_leaf_node (transaction, value, parents);
-                result = new_node.release ();
+                address const leaf = this->store_leaf_node (transaction, value, key_hash, parents);
+                result = linear_node::allocate_insert (arena_, *orig_node, index, leaf,
+                                                       key_prefix<KeyType>{}(value.first));
             } else {
                 key_exists = true;
                 if (is_upsert) {
-                    std::unique_ptr<linear_node> new_node;
                     linear_node * lnode = nullptr;
 
                     if (node.is_heap ()) {
@@ -871,12 +1179,10 @@ namespace pstore {
                         result = node;
                     } else {
                         // Load into memory but no extra space.
-                        new_node = linear_node::allocate_from (*orig_node, 0U);
-                        lnode = new_node.get ();
+                        lnode = linear_node::allocate_from (arena_, *orig_node, 0U);
                         result = lnode;
                     }
-                    (*lnode)[index] = this->store_leaf_node (transaction, value, parents);
-                    new_node.release ();
+                    (*lnode)[index] = this->store_leaf_node (transaction, value, key_hash, parents);
                 } else {
                     parents->push (details::parent_type{index_pointer{(*orig_node)[index]}});
 
@@ -896,35 +1202,51 @@ namespace pstore {
         template <typename OtherValueType>
         auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::insert_node (
             transaction_base & transaction, index_pointer const node, OtherValueType const & value,
-            hash_type hash, unsigned shifts, gsl::not_null<parent_stack *> parents, bool is_upsert)
-            -> std::pair<index_pointer, bool> {
+            hash_type const key_hash, unsigned shifts, gsl::not_null<parent_stack *> parents,
+            bool is_upsert) -> std::pair<index_pointer, bool> {
 
+            auto const hash = shift_hash (key_hash, shifts);
             index_pointer result;
             bool key_exists = false;
             if (node.is_leaf ()) { // This node is a leaf node.
-                key_type const existing_key = get_key (transaction.db (), node.addr); // Read key.
-                if (equal_ (value.first, existing_key)) {
+                database const & db = transaction.db ();
+                bool matched = false;
+                auto existing_hash = hash_type{0};
+                if (leaf_hashes_) {
+                    // Compare the hashes first: the existing key is only loaded if they match.
+                    existing_hash = shift_hash (leaf_hash (db, node.addr), shifts);
+                    matched = existing_hash == hash &&
+                              stored_key::equal (equal_, stored_key::load (db, node.addr),
+                                                 value.first);
+                } else {
+                    auto const existing_key = stored_key::load (db, node.addr);
+                    matched = stored_key::equal (equal_, existing_key, value.first);
+                    if (!matched) {
+                        existing_hash = static_cast<hash_type> (
+                            (hash_ (stored_key::to_key (db, node.addr, existing_key)) >> shifts));
+                    }
+                }
+
+                if (matched) {
                     if (is_upsert) {
-                        result = this->store_leaf_node (transaction, value, parents);
+                        result = this->store_leaf_node (transaction, value, key_hash, parents);
                     } else {
                         parents->push ({node});
                         result = node;
                     }
                     key_exists = true;
                 } else {
-                    auto const existing_hash =
-                        static_cast<hash_type> ((hash_ (existing_key) >> shifts));
-                    result = this->insert_into_leaf (transaction, node, value, existing_hash, hash,
-                                                     shifts, parents);
+                    result = this->insert_into_leaf (transaction, node, value, existing_hash,
+                                                     key_hash, shifts, parents);
                 }
             } else {
                 // This node is an internal or a linear node.
                 if (details::depth_is_internal_node (shifts)) {
                     std::tie (result, key_exists) = this->insert_into_internal (
-                        transaction, node, value, hash, shifts, parents, is_upsert);
+                        transaction, node, value, key_hash, shifts, parents, is_upsert);
                 } else {
-                    std::tie (result, key_exists) =
-                        this->insert_into_linear (transaction, node, value, parents, is_upsert);
+                    std::tie (result, key_exists) = this->insert_into_linear (
+                        transaction, node, value, key_hash, parents, is_upsert);
                 }
             }
 
@@ -944,16 +1266,19 @@ namespace pstore {
                 raise (error_code::index_not_latest_revision);
             }
 
+            this->drop_node_cache ();
+            auto const hash = static_cast<hash_type> (hash_ (value.first));
+
             parent_stack parents;
             if (this->empty ()) {
-                root_ = this->store_leaf_node (transaction, value, &parents);
+                root_ = this->store_leaf_node (transaction, value, hash, &parents);
                 size_ = 1;
+                this->add_to_filter (value.first, hash, true /*was_empty*/);
                 return std::make_pair (iterator (db, std::move (parents), this), true);
             }
 
             parent_stack reverse_parents;
             bool key_exists = false;
-            auto hash = static_cast<hash_type> (hash_ (value.first));
             std::tie (root_, key_exists) = this->insert_node (
                 transaction, root_, value, hash, 0 /* shifts */, &reverse_parents, is_upsert);
             while (!reverse_parents.empty ()) {
@@ -962,6 +1287,7 @@ namespace pstore {
             }
             if (!key_exists) {
                 ++size_;
+                this->add_to_filter (value.first, hash, false /*was_empty*/);
             }
             return std::make_pair (iterator (db, std::move (parents), this), !key_exists);
         }
@@ -999,6 +1325,164 @@ namespace pstore {
             return this->insert_or_assign (transaction, std::make_pair (key, value));
         }
 
+        // hamt_map::trie_order
+        // ~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        constexpr auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::trie_order (hash_type hash) noexcept
+            -> hash_type {
+            // The first level of the trie is indexed by the least significant digit of the hash so
+            // it becomes the most significant digit of the result. The final digit has only as many
+            // bits as remain in hash_type.
+            constexpr unsigned last_digit_bits =
+                details::hash_size - (details::max_internal_depth - 1U) * details::hash_index_bits;
+            auto result = hash_type{0};
+            for (auto level = 0U; level < details::max_internal_depth - 1U; ++level) {
+                result = (result << details::hash_index_bits) | (hash & details::hash_index_mask);
+                hash >>= details::hash_index_bits;
+            }
+            return (result << last_digit_bits) | hash;
+        }
+
+        // hamt_map::bulk_insert
+        // ~~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        template <typename ForwardIterator>
+        std::size_t hamt_map<KeyType, ValueType, Hash, KeyEqual>::bulk_insert (
+            transaction_base & transaction, ForwardIterator first, ForwardIterator last) {
+
+            if (revision_ != transaction.db ().get_current_revision ()) {
+                raise (error_code::index_not_latest_revision);
+            }
+            if (!this->empty ()) {
+                auto count = std::size_t{0};
+                for (; first != last; ++first) {
+                    if (this->insert (transaction, *first).second) {
+                        ++count;
+                    }
+                }
+                return count;
+            }
+
+            using entry = bulk_entry<ForwardIterator>;
+            std::vector<entry> entries;
+            entries.reserve (static_cast<std::size_t> (std::distance (first, last)));
+            key_prefix<KeyType> const prefix_fn{};
+            for (; first != last; ++first) {
+                auto const & key = (*first).first;
+                auto const hash = static_cast<hash_type> (hash_ (key));
+                entries.push_back (entry{hash, trie_order (hash), prefix_fn (key), first});
+            }
+
+            if (sorted_linear) {
+                // Sort into trie order. Keys with identical hashes end up in the same linear node
+                // so are ordered as they would be there: by prefix and then by key. The sort is
+                // stable so that the first of any elements with equivalent keys is the one that's
+                // kept.
+                std::stable_sort (std::begin (entries), std::end (entries),
+                                  [] (entry const & lhs, entry const & rhs) {
+                                      if (lhs.order != rhs.order) {
+                                          return lhs.order < rhs.order;
+                                      }
+                                      if (lhs.prefix != rhs.prefix) {
+                                          return lhs.prefix < rhs.prefix;
+                                      }
+                                      return (*lhs.it).first < (*rhs.it).first;
+                                  });
+                entries.erase (std::unique (std::begin (entries), std::end (entries),
+                                            [] (entry const & lhs, entry const & rhs) {
+                                                return lhs.order == rhs.order &&
+                                                       lhs.prefix == rhs.prefix &&
+                                                       !((*lhs.it).first < (*rhs.it).first);
+                                            }),
+                               std::end (entries));
+            } else {
+                // Sort into trie order. operator< can't be used to order keys with identical
+                // hashes so a later element is dropped if equal_ matches it with an earlier one
+                // that has the same hash.
+                std::stable_sort (
+                    std::begin (entries), std::end (entries),
+                    [] (entry const & lhs, entry const & rhs) { return lhs.order < rhs.order; });
+                auto const out = std::begin (entries);
+                auto kept = std::size_t{0};
+                auto run_first = std::size_t{0};
+                for (entry const & e : entries) {
+                    if (kept > 0U && entries[kept - 1U].order != e.order) {
+                        run_first = kept;
+                    }
+                    if (std::none_of (out + static_cast<std::ptrdiff_t> (run_first),
+                                      out + static_cast<std::ptrdiff_t> (kept),
+                                      [this, &e] (entry const & k) {
+                                          return equal_ ((*k.it).first, (*e.it).first);
+                                      })) {
+                        entries[kept++] = e;
+                    }
+                }
+                entries.erase (out + static_cast<std::ptrdiff_t> (kept), std::end (entries));
+            }
+
+            if (!entries.empty ()) {
+                root_ = this->bulk_build (transaction, std::begin (entries), std::end (entries),
+                                          0U /*shifts*/);
+                size_ = entries.size ();
+                if (key_filter) {
+                    filter_ = std::make_unique<bloom_filter> (
+                        std::max (std::uint64_t{entries.size ()}, min_filter_capacity));
+                    for (entry const & e : entries) {
+                        filter_->insert (e.hash, e.prefix);
+                    }
+                }
+            }
+            return entries.size ();
+        }
+
+        // hamt_map::bulk_build
+        // ~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        template <typename EntryIterator>
+        auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::bulk_build (
+            transaction_base & transaction, EntryIterator first, EntryIterator last,
+            unsigned const shifts) -> index_pointer {
+
+            PSTORE_ASSERT (first != last);
+            if (std::next (first) == last) {
+                // A single element is simply a leaf.
+                return index_pointer{this->write_leaf_node (transaction, *first->it, first->hash)};
+            }
+
+            if (!details::depth_is_internal_node (shifts)) {
+                // We ran out of hash bits: build a linear node. The elements are already sorted in
+                // linear node order.
+                linear_node * const linear = linear_node::allocate_children (
+                    arena_, static_cast<std::size_t> (std::distance (first, last)), sorted_linear);
+                auto pos = std::size_t{0};
+                for (auto it = first; it != last; ++it) {
+                    linear->set_child (pos++,
+                                       this->write_leaf_node (transaction, *it->it, it->hash),
+                                       it->prefix);
+                }
+                return index_pointer{linear->flush (transaction) | details::internal_node_bit};
+            }
+
+            // Build an internal node with a child for each distinct hash digit at this level.
+            std::array<index_pointer, details::hash_size> children;
+            auto num_children = std::size_t{0};
+            auto bitmap = hash_type{0};
+            using entry = typename std::iterator_traits<EntryIterator>::value_type;
+            while (first != last) {
+                auto const digit = (first->hash >> shifts) & details::hash_index_mask;
+                auto const group_end =
+                    std::find_if (std::next (first), last, [shifts, digit] (entry const & e) {
+                        return ((e.hash >> shifts) & details::hash_index_mask) != digit;
+                    });
+                children[num_children++] = this->bulk_build (transaction, first, group_end,
+                                                             shifts + details::hash_index_bits);
+                bitmap |= hash_type{1} << digit;
+                first = group_end;
+            }
+            return index_pointer{internal_node::write_node (
+                transaction, bitmap, gsl::make_span (children.data (), num_children))};
+        }
+
         // hamt_map::flush
         // ~~~~~~~~~~~~~~~
         template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
@@ -1009,21 +1493,30 @@ namespace pstore {
                 raise (error_code::index_not_latest_revision);
             }
 
+            this->drop_node_cache ();
+
             // If the root is a leaf node, there's nothing to do. If not, we start to recursively
             // flush the tree.
             if (!root_.is_address ()) {
                 PSTORE_ASSERT (root_.is_internal ());
                 root_ = root_.untag_node<internal_node *> ()->flush (transaction, 0 /*shifts*/);
                 PSTORE_ASSERT (root_.is_address ());
-                // Don't delete the internal node here. They are owned by internals_container_. If
-                // this ever changes, then use something like 'delete internal' here.
+                // Don't delete the internal node here. Heap nodes are owned by arena_.
+            }
+
+            if (key_filter && filter_ != nullptr) {
+                // Write the keys that were added to the key filter. Only the filter blocks which
+                // they changed are written unless it is time to merge its records.
+                stored_filter_ =
+                    bloom_filter::stored{transaction.db (), filter_->flush (transaction)};
+                filter_.reset ();
             }
 
             auto const header_addr = this->size () > 0U ? this->write_header_block (transaction)
                                                         : typed_address<header_block>::null ();
 
-            // Release all of the in-heap internal nodes that we have now flushed.
-            internals_container_->clear ();
+            // Release all of the in-heap nodes that we have now flushed.
+            arena_.clear ();
 
             // Update the revision number into which the index will be flushed.
             revision_ = generation;
@@ -1031,6 +1524,66 @@ namespace pstore {
             return header_addr;
         }
 
+        // hamt_map::flush_size
+        // ~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        std::uint64_t hamt_map<KeyType, ValueType, Hash, KeyEqual>::flush_size () const {
+            auto result = std::uint64_t{0};
+            if (!root_.is_address ()) {
+                result += root_.untag_node<internal_node const *> ()->flush_size (0 /*shifts*/);
+            }
+            if (this->size () == 0U) {
+                return result;
+            }
+            if (key_filter && filter_ != nullptr) {
+                result += filter_->flush_size ();
+            }
+            // The filtered header block is the larger of the two.
+            PSTORE_STATIC_ASSERT (sizeof (filtered_header_block) >= sizeof (header_block));
+            return result + sizeof (filtered_header_block) + alignof (filtered_header_block) - 1U;
+        }
+
+        // hamt_map::may_contain
+        // ~~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        template <typename OtherKeyType>
+        bool hamt_map<KeyType, ValueType, Hash, KeyEqual>::may_contain (
+            database::read_view & view, OtherKeyType const & key, hash_type const hash) const {
+            if (!key_filter) {
+                return true;
+            }
+            if (filter_ != nullptr) {
+                return filter_->may_contain (view, hash, key_prefix<KeyType>{}(key));
+            }
+            if (stored_filter_.addr () != address::null ()) {
+                return stored_filter_.may_contain (view, hash, key_prefix<KeyType>{}(key));
+            }
+            return true;
+        }
+
+        // hamt_map::add_to_filter
+        // ~~~~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        template <typename OtherKeyType>
+        void hamt_map<KeyType, ValueType, Hash, KeyEqual>::add_to_filter (OtherKeyType const & key,
+                                                                          hash_type const hash,
+                                                                          bool const was_empty) {
+            if (!key_filter) {
+                return;
+            }
+            if (filter_ == nullptr) {
+                if (stored_filter_.addr () != address::null ()) {
+                    filter_ = std::make_unique<bloom_filter> (stored_filter_);
+                } else if (was_empty) {
+                    filter_ = std::make_unique<bloom_filter> (min_filter_capacity);
+                } else {
+                    // The index has no filter to which the key could be added.
+                    return;
+                }
+            }
+            filter_->insert (hash, key_prefix<KeyType>{}(key));
+        }
+
         // write header block
         // ~~~~~~~~~~~~~~~~~~
         template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
@@ -1038,13 +1591,140 @@ namespace pstore {
         hamt_map<KeyType, ValueType, Hash, KeyEqual>::write_header_block (
             transaction_base & transaction) {
             PSTORE_ASSERT (this->root ().is_address ());
+            if (stored_filter_.addr () != address::null ()) {
+                auto const pos = transaction.alloc_rw<filtered_header_block> ();
+                pos.first->header.signature = filtered_index_signature;
+                pos.first->header.size = this->size ();
+                pos.first->header.root = this->root ().addr;
+                pos.first->filter = stored_filter_.addr ();
+                return typed_address<header_block>::make (pos.second.to_address ());
+            }
+
             auto const pos = transaction.alloc_rw<header_block> ();
-            pos.first->signature = index_signature;
+            pos.first->signature = leaf_hashes_ ? hashed_index_signature : index_signature;
             pos.first->size = this->size ();
             pos.first->root = this->root ().addr;
             return pos.second;
         }
 
+        // hamt_map::find_step
+        // ~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        template <typename OtherKeyType>
+        bool hamt_map<KeyType, ValueType, Hash, KeyEqual>::find_step (database::read_view & view,
+                                                                      OtherKeyType const & key,
+                                                                      find_cursor & cursor) const {
+            index_pointer const node = cursor.node;
+            if (node.is_leaf ()) {
+                cursor.found =
+                    (!leaf_hashes_ ||
+                     shift_hash (leaf_hash (view, node.addr), cursor.shifts) == cursor.hash) &&
+                    stored_key::equal (equal_, stored_key::load (view, node.addr), key);
+                if (cursor.found) {
+                    cursor.parents.push ({node});
+                }
+                return false;
+            }
+
+            index_pointer child_node;
+            auto index = std::size_t{0};
+            if (details::depth_is_internal_node (cursor.shifts)) {
+                // It's an internal node.
+                internal_node const * const internal = internal_node::get_node (view, node);
+                std::tie (child_node, index) =
+                    internal->lookup (cursor.hash & details::hash_index_mask);
+            } else {
+                // It's a linear node.
+                linear_node const * const linear = linear_node::get_node (view, node);
+                std::tie (child_node, index) = linear->lookup<KeyType> (view, key, equal_);
+                if (index != details::not_found) {
+                    // The linear node lookup has matched the key so the child leaf need not be
+                    // loaded again.
+                    cursor.parents.push ({node, index});
+                    cursor.parents.push ({child_node});
+                    cursor.found = true;
+                    return false;
+                }
+            }
+
+            if (index == details::not_found) {
+                return false;
+            }
+            cursor.parents.push ({node, index});
+
+            // Go to next sub-trie level
+            cursor.node = child_node;
+            cursor.shifts += details::hash_index_bits;
+            cursor.hash >>= details::hash_index_bits;
+            return true;
+        }
+
+        // hamt_map::set_node_cache_levels
+        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        void hamt_map<KeyType, ValueType, Hash, KeyEqual>::set_node_cache_levels (
+            unsigned const levels) {
+            if (levels != cache_levels_) {
+                this->drop_node_cache ();
+                cache_levels_ = levels;
+            }
+        }
+
+        // hamt_map::get_node_cache
+        // ~~~~~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        auto
+        hamt_map<KeyType, ValueType, Hash, KeyEqual>::get_node_cache (database const & db) const
+            -> details::node_cache const * {
+            // Only an unmodified trie whose root is an internal node is cached.
+            if (cache_levels_ == 0U || !root_.is_internal () || root_.is_heap ()) {
+                return nullptr;
+            }
+            if (details::node_cache const * const cache = cache_.load (std::memory_order_acquire)) {
+                return cache;
+            }
+            std::lock_guard<std::mutex> const lock{cache_mutex_};
+            if (cache_owner_ == nullptr) {
+                cache_owner_ = std::make_unique<details::node_cache> (db, root_, cache_levels_);
+                cache_.store (cache_owner_.get (), std::memory_order_release);
+            }
+            PSTORE_ASSERT (cache_owner_->node (0U) == root_);
+            return cache_owner_.get ();
+        }
+
+        // hamt_map::drop_node_cache
+        // ~~~~~~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        void hamt_map<KeyType, ValueType, Hash, KeyEqual>::drop_node_cache () noexcept {
+            // Modifying the index is not safe in the presence of concurrent lookups so no lookup
+            // can be using the cache.
+            cache_.store (nullptr, std::memory_order_relaxed);
+            cache_owner_.reset ();
+        }
+
+        // hamt_map::descend_cached
+        // ~~~~~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        bool hamt_map<KeyType, ValueType, Hash, KeyEqual>::descend_cached (
+            details::node_cache const & cache, find_cursor & cursor) {
+            PSTORE_ASSERT (cursor.shifts == 0U && cursor.node == cache.node (0U));
+            auto n = std::uint32_t{0};
+            while (n != details::node_cache::none) {
+                index_pointer child_node;
+                auto index = std::size_t{0};
+                std::tie (child_node, index) =
+                    cache.lookup (n, cursor.hash & details::hash_index_mask, &n);
+                if (index == details::not_found) {
+                    return false;
+                }
+                cursor.parents.push ({cursor.node, index});
+                cursor.node = child_node;
+                cursor.shifts += details::hash_index_bits;
+                cursor.hash >>= details::hash_index_bits;
+            }
+            return true;
+        }
+
         // hamt_map::find
         // ~~~~~~~~~~~~~~
         template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
@@ -1056,47 +1736,219 @@ namespace pstore {
                 return this->cend (db);
             }
 
-            auto hash = static_cast<hash_type> (hash_ (key));
-            unsigned bit_shifts = 0;
-            index_pointer node = root_;
-            parent_stack parents;
+            database::read_view view{db};
+            auto const hash = static_cast<hash_type> (hash_ (key));
+            if (!this->may_contain (view, key, hash)) {
+                return this->cend (db);
+            }
+            find_cursor cursor{hash, root_};
+            details::node_cache const * const cache = this->get_node_cache (db);
+            if (cache != nullptr && !descend_cached (*cache, cursor)) {
+                return this->cend (db);
+            }
+            while (this->find_step (view, key, cursor)) {
+            }
+            if (cursor.found) {
+                return const_iterator (db, std::move (cursor.parents), this);
+            }
+            return this->cend (db);
+        }
 
-            std::shared_ptr<void const> store_node;
-            while (!node.is_leaf ()) {
-                index_pointer child_node;
-                auto index = std::size_t{0};
+        // hamt_map::find_batch
+        // ~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        template <typename ForwardIterator, typename>
+        auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::find_batch (database const & db,
+                                                                       ForwardIterator first,
+                                                                       ForwardIterator last) const
+            -> std::vector<const_iterator> {
+            std::vector<const_iterator> result;
+            result.reserve (static_cast<std::size_t> (std::distance (first, last)));
+            if (empty ()) {
+                for (; first != last; ++first) {
+                    result.push_back (this->cend (db));
+                }
+                return result;
+            }
 
-                if (details::depth_is_internal_node (bit_shifts)) {
-                    // It's an internal node.
-                    internal_node const * internal = nullptr;
-                    std::tie (store_node, internal) = internal_node::get_node (db, node);
-                    std::tie (child_node, index) =
-                        internal->lookup (hash & details::hash_index_mask);
-                } else {
-                    // It's a linear node.
-                    linear_node const * linear = nullptr;
-                    std::tie (store_node, linear) = linear_node::get_node (db, node);
-                    std::tie (child_node, index) = linear->lookup<KeyType> (db, key, equal_);
+            struct lane {
+                lane (ForwardIterator k, find_cursor const & c)
+                        : key{k}
+                        , cursor{c} {}
+                ForwardIterator key;
+                find_cursor cursor;
+                bool active = true;
+            };
+            std::vector<lane> lanes;
+            lanes.reserve (find_batch_width);
+            database::read_view view{db};
+            details::node_cache const * const cache = this->get_node_cache (db);
+
+            while (first != last) {
+                lanes.clear ();
+                auto active = std::size_t{0};
+                for (; first != last && lanes.size () < find_batch_width; ++first) {
+                    auto const hash = static_cast<hash_type> (hash_ (*first));
+                    lanes.emplace_back (first, find_cursor{hash, root_});
+                    // A key which the filter or the node cache rules out needs no further work.
+                    lane & l = lanes.back ();
+                    l.active = this->may_contain (view, *first, hash) &&
+                               (cache == nullptr || descend_cached (*cache, l.cursor));
+                    if (l.active) {
+                        ++active;
+                    }
                 }
 
-                if (index == details::not_found) {
-                    return this->cend (db);
+                // Advance each of the keys by one tree level per pass. Once a key has moved to its
+                // next node, we ask for that node to be fetched while the remaining keys are
+                // processed.
+                while (active > 0) {
+                    for (lane & l : lanes) {
+                        if (!l.active) {
+                            continue;
+                        }
+                        if (this->find_step (view, *l.key, l.cursor)) {
+                            details::prefetch_node (db, l.cursor.node);
+                        } else {
+                            l.active = false;
+                            --active;
+                        }
+                    }
                 }
-                parents.push ({node, index});
 
-                // Go to next sub-trie level
-                node = child_node;
-                bit_shifts += details::hash_index_bits;
-                hash >>= details::hash_index_bits;
+                for (lane & l : lanes) {
+                    if (l.cursor.found) {
+                        result.emplace_back (db, std::move (l.cursor.parents), this);
+                    } else {
+                        result.push_back (this->cend (db));
+                    }
+                }
             }
-            // It's a leaf node.
-            PSTORE_ASSERT (node.is_leaf ());
-            key_type const existing_key = get_key (db, node.addr);
-            if (equal_ (existing_key, key)) {
-                parents.push ({node});
-                return const_iterator (db, std::move (parents), this);
+            return result;
+        }
+
+        // hamt_map::parallel_find_batch
+        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        template <typename RandomAccessIterator, typename>
+        auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::parallel_find_batch (
+            database const & db, RandomAccessIterator first, RandomAccessIterator last) const
+            -> std::vector<const_iterator> {
+            auto const num_keys = static_cast<std::size_t> (std::max (
+                std::distance (first, last),
+                typename std::iterator_traits<RandomAccessIterator>::difference_type{0}));
+            auto const num_chunks = std::min (
+                std::size_t{std::max (std::thread::hardware_concurrency (), 1U)},
+                (num_keys + parallel_find_min_keys - 1U) / parallel_find_min_keys);
+            if (num_chunks <= 1U) {
+                return this->find_batch (db, first, last);
             }
-            return this->cend (db);
+
+            // Divide the keys into approximately equal-sized chunks. Each chunk has its own
+            // result vector so that the worker threads don't need to synchronize.
+            struct chunk {
+                RandomAccessIterator first;
+                RandomAccessIterator last;
+                std::vector<const_iterator> * result;
+            };
+            std::vector<std::vector<const_iterator>> results (num_chunks);
+            std::vector<chunk> chunks;
+            chunks.reserve (num_chunks);
+            auto const chunk_size = (num_keys + num_chunks - 1U) / num_chunks;
+            for (auto ctr = std::size_t{0}; ctr < num_chunks; ++ctr) {
+                auto const begin = std::min (ctr * chunk_size, num_keys);
+                auto const end = std::min (begin + chunk_size, num_keys);
+                using difference_type =
+                    typename std::iterator_traits<RandomAccessIterator>::difference_type;
+                chunks.push_back (chunk{first + static_cast<difference_type> (begin),
+                                        first + static_cast<difference_type> (end), &results[ctr]});
+            }
+
+            parallel_for_each (std::begin (chunks), std::end (chunks),
+                               [this, &db] (chunk const & c) {
+                                   *c.result = this->find_batch (db, c.first, c.last);
+                               });
+
+            std::vector<const_iterator> result;
+            result.reserve (num_keys);
+            for (auto const & r : results) {
+                result.insert (std::end (result), std::begin (r), std::end (r));
+            }
+            return result;
+        }
+
+        // hamt_map::partition
+        // ~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        auto hamt_map<KeyType, ValueType, Hash, KeyEqual>::partition (database const & db,
+                                                                      std::size_t const min_parts)
+            const -> std::vector<subrange<const_iterator>> {
+            std::vector<subrange<const_iterator>> result;
+            if (this->empty ()) {
+                return result;
+            }
+
+            // A sub-trie is described by its root and the path from the root of the trie.
+            struct subtrie {
+                parent_stack path;
+                index_pointer node;
+            };
+            std::vector<subtrie> parts{subtrie{parent_stack{}, root_}};
+            // Split each of the sub-tries into its children until there are enough of them. The
+            // linear nodes at the bottom of the trie are not split.
+            for (auto shifts = 0U; parts.size () < min_parts &&
+                                   details::depth_is_internal_node (shifts);
+                 shifts += details::hash_index_bits) {
+                std::vector<subtrie> next;
+                next.reserve (parts.size () * 2U);
+                for (subtrie const & part : parts) {
+                    if (part.node.is_leaf ()) {
+                        next.push_back (part);
+                        continue;
+                    }
+                    std::shared_ptr<internal_node const> store_node;
+                    internal_node const * internal = nullptr;
+                    std::tie (store_node, internal) = internal_node::get_node (db, part.node);
+                    auto position = std::size_t{0};
+                    for (index_pointer const & child : *internal) {
+                        next.push_back (subtrie{part.path, child});
+                        next.back ().path.push ({part.node, position++});
+                    }
+                }
+                if (next.size () == parts.size ()) {
+                    break; // Nothing could be split.
+                }
+                parts = std::move (next);
+            }
+
+            // Each run extends from the first member of its sub-trie to the first member of the
+            // next.
+            result.reserve (parts.size ());
+            auto end = this->cend (db);
+            for (auto it = parts.rbegin (); it != parts.rend (); ++it) {
+                const_iterator begin{db, std::move (it->path), this};
+                begin.move_to_left_most_child (it->node);
+                result.emplace_back (begin, end);
+                end = begin;
+            }
+            std::reverse (std::begin (result), std::end (result));
+            return result;
+        }
+
+        // hamt_map::parallel_visit
+        // ~~~~~~~~~~~~~~~~~~~~~~~~
+        template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual>
+        template <typename Function>
+        void hamt_map<KeyType, ValueType, Hash, KeyEqual>::parallel_visit (database const & db,
+                                                                           Function fn) const {
+            auto const parts = this->parallel_partition (db);
+            parallel_for_each (std::begin (parts), std::end (parts),
+                               [&fn] (subrange<const_iterator> const & part) {
+                                   for (auto it = part.begin (), end = part.end (); it != end;
+                                        ++it) {
+                                       fn (it);
+                                   }
+                               });
         }
 
         // hamt_map::make_begin_iterator
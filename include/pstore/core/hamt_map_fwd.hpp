@@ -18,7 +18,9 @@
 #ifndef PSTORE_CORE_HAMT_MAP_FWD_HPP
 #define PSTORE_CORE_HAMT_MAP_FWD_HPP
 
+#include <cstdint>
 #include <functional>
+#include <type_traits>
 
 namespace pstore {
     namespace index {
@@ -52,6 +54,79 @@ namespace pstore {
             Container & c_;
         };
 
+        /// A pair of iterators which describe a contiguous run of the members of a hamt_map or
+        /// hamt_set. Produced by the containers' partition() method.
+        template <typename Iterator>
+        class subrange {
+        public:
+            subrange (Iterator b, Iterator e)
+                    : begin_{b}
+                    , end_{e} {}
+            /// Returns an iterator to the first member of the run.
+            Iterator begin () const { return begin_; }
+            /// Returns an iterator just beyond the last member of the run.
+            Iterator end () const { return end_; }
+
+        private:
+            Iterator begin_;
+            Iterator end_;
+        };
+
+        /// Computes a 64-bit value from a key which is cached alongside each child of a linear
+        /// node. The children of a linear node are ordered first by this value and then by key so
+        /// that a lookup can binary search the cached values and, unless two keys share a prefix,
+        /// need load and compare only a single key from the store. All of the keys in a linear
+        /// node have the same hash so the prefix should be derived from some other property of
+        /// the key.
+        ///
+        /// The primary template returns 0 for every key: linear node children are then ordered
+        /// entirely by key.
+        template <typename KeyType>
+        struct key_prefix {
+            template <typename OtherKeyType>
+            constexpr std::uint64_t operator() (OtherKeyType const &) const noexcept {
+                return 0U;
+            }
+        };
+
+        /// If true, the children of a linear node in an index whose keys are of type KeyType and
+        /// are compared by KeyEqual are kept sorted by key_prefix<> and then by operator<. This
+        /// requires that two keys are equivalent under operator< if, and only if, KeyEqual
+        /// considers them equal. Otherwise linear nodes are written in the original unsorted
+        /// format and searched linearly. The primary template assumes that this holds for
+        /// std::equal_to<> alone.
+        template <typename KeyType, typename KeyEqual>
+        struct sorted_linear_nodes : std::is_same<KeyEqual, std::equal_to<KeyType>> {};
+
+        /// Describes how a key held in the store may be compared with another key without
+        /// constructing an instance of KeyType. The primary template provides no such view: keys
+        /// are read from the store as KeyType instances and compared using the index's KeyEqual.
+        ///
+        /// A specialization sets `enabled` to true and provides static load() functions which take
+        /// a database (or a database::read_view) and the address of a serialized key. They return
+        /// an object which refers to the key's bytes in the store and which supports == and <
+        /// with any key type that is compatible with KeyType.
+        template <typename KeyType, typename KeyEqual>
+        struct key_view_traits {
+            static constexpr bool enabled = false;
+        };
+
+        /// If true, an index whose keys are of type KeyType writes each key's full hash to the
+        /// store immediately before the leaf that holds it. An insertion can then compare a new
+        /// key's hash with that of an existing leaf, and split the leaf, without loading and
+        /// rehashing the existing key. The primary template is false: this is only worthwhile
+        /// for keys which are expensive to load or to hash.
+        template <typename KeyType>
+        struct persist_leaf_hash : std::false_type {};
+
+        /// If true, an index whose keys are of type KeyType and are hashed by Hash keeps a Bloom
+        /// filter of its keys in the store. A lookup for a key which isn't in the index is then
+        /// usually rejected by the filter without walking the trie. The filter is keyed on both
+        /// the key's hash and its key_prefix<> so both should be well distributed. The primary
+        /// template is false.
+        template <typename KeyType, typename Hash>
+        struct persist_key_filter : std::false_type {};
+
         template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>,
                   typename KeyEqual = std::equal_to<KeyType>>
         class hamt_map;
@@ -18,9 +18,17 @@
 #ifndef PSTORE_CORE_HAMT_MAP_TYPES_HPP
 #define PSTORE_CORE_HAMT_MAP_TYPES_HPP
 
-#include "pstore/adt/chunked_sequence.hpp"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "pstore/adt/sstring_view.hpp"
 #include "pstore/core/array_stack.hpp"
 #include "pstore/core/db_archive.hpp"
+#include "pstore/core/hamt_map_fwd.hpp"
+#include "pstore/support/gsl.hpp"
 
 namespace pstore {
     class transaction_base;
@@ -68,6 +76,85 @@ namespace pstore {
             /// Using second LSB for marking newly allocated internal nodes
             constexpr std::uintptr_t heap_node_bit = 2;
 
+            /// Returns the first eight bytes of a string as a big-endian integer so that the
+            /// ordering of these values is consistent with the lexicographical ordering of the
+            /// strings themselves. Shorter strings are padded with zeros.
+            inline std::uint64_t string_prefix (char const * const str,
+                                                std::size_t const length) noexcept {
+                auto result = std::uint64_t{0};
+                auto const n = std::min (length, sizeof (result));
+                for (auto ctr = std::size_t{0}; ctr < sizeof (result); ++ctr) {
+                    result = (result << 8U) |
+                             (ctr < n ? static_cast<std::uint8_t> (str[ctr]) : std::uint8_t{0});
+                }
+                return result;
+            }
+
+        } // end namespace details
+
+        template <>
+        struct key_prefix<std::string> {
+            template <typename StringType>
+            std::uint64_t operator() (StringType const & str) const noexcept {
+                return details::string_prefix (str.data (), str.length ());
+            }
+        };
+
+        template <>
+        struct persist_leaf_hash<std::string> : std::true_type {};
+
+        /// std::string keys are compared in place: looking up a string key doesn't allocate
+        /// memory for each key that is read from the store.
+        template <>
+        struct key_view_traits<std::string, std::equal_to<std::string>> {
+            static constexpr bool enabled = true;
+            static shared_sstring_view load (database const & db, address addr);
+            static raw_sstring_view load (database::read_view & view, address addr);
+        };
+
+        namespace details {
+
+            /// Loads the key stored at a given address so that it can be compared with a key
+            /// supplied by the caller. If key_view_traits<> is enabled for the index's key type,
+            /// the result refers directly to the store; otherwise a KeyType instance is read.
+            template <typename KeyType, typename KeyEqual,
+                      bool HasView = key_view_traits<KeyType, KeyEqual>::enabled>
+            struct stored_key {
+                template <typename Source>
+                static KeyType load (Source & source, address const addr) {
+                    return serialize::read<KeyType> (
+                        serialize::archive::database_reader{source, addr});
+                }
+                template <typename StoredKey, typename OtherKeyType>
+                static bool equal (KeyEqual const & eq, StoredKey const & stored,
+                                   OtherKeyType const & key) {
+                    return eq (stored, key);
+                }
+                /// Returns a KeyType instance for a key previously returned by load().
+                template <typename Source>
+                static KeyType const & to_key (Source &, address, KeyType const & stored) {
+                    return stored;
+                }
+            };
+            template <typename KeyType, typename KeyEqual>
+            struct stored_key<KeyType, KeyEqual, true> {
+                template <typename Source>
+                static auto load (Source & source, address const addr)
+                    -> decltype (key_view_traits<KeyType, KeyEqual>::load (source, addr)) {
+                    return key_view_traits<KeyType, KeyEqual>::load (source, addr);
+                }
+                template <typename StoredKey, typename OtherKeyType>
+                static bool equal (KeyEqual const &, StoredKey const & stored,
+                                   OtherKeyType const & key) {
+                    return stored == key;
+                }
+                template <typename Source, typename StoredKey>
+                static KeyType to_key (Source & source, address const addr, StoredKey const &) {
+                    return serialize::read<KeyType> (
+                        serialize::archive::database_reader{source, addr});
+                }
+            };
+
         } // end namespace details
 
         //*  _                _           _    _         _    *
@@ -90,6 +177,17 @@ namespace pstore {
         PSTORE_STATIC_ASSERT (offsetof (header_block, size) == 8);
         PSTORE_STATIC_ASSERT (offsetof (header_block, root) == 16);
 
+        /// The header of an index which keeps a filter of its keys (see persist_key_filter<>).
+        struct filtered_header_block {
+            header_block header;
+            /// The store address of the key filter.
+            address filter;
+        };
+
+        PSTORE_STATIC_ASSERT (sizeof (filtered_header_block) == 32);
+        PSTORE_STATIC_ASSERT (offsetof (filtered_header_block, header) == 0);
+        PSTORE_STATIC_ASSERT (offsetof (filtered_header_block, filter) == 24);
+
 
         namespace details {
 
@@ -106,6 +204,56 @@ namespace pstore {
                 std::size_t n;
             };
 
+            //*               _                               *
+            //*  _ _  ___  __| |___   __ _ _ _ ___ _ _  __ _  *
+            //* | ' \/ _ \/ _` / -_) / _` | '_/ -_) ' \/ _` | *
+            //* |_||_\___/\__,_\___| \__,_|_| \___|_||_\__,_| *
+            //*                                               *
+            /// A monotonic arena from which the in-heap internal and linear nodes of an index are
+            /// allocated. Storage is handed out sequentially from large chunks and is never
+            /// returned individually: it is released in a single step by clear() once the nodes
+            /// have been flushed or discarded. Nodes created one after another are adjacent in
+            /// memory, which suits the depth-first walk performed by flush().
+            ///
+            /// The objects placed in the arena must be trivially destructible.
+            class node_arena {
+            public:
+                /// The number of bytes in each of the arena's chunks.
+                static constexpr std::size_t chunk_size = std::size_t{256} * 1024;
+                /// The alignment of every allocation made from the arena.
+                static constexpr std::size_t alignment = alignof (std::uint64_t);
+
+                node_arena () noexcept = default;
+                node_arena (node_arena const &) = delete;
+                node_arena (node_arena &&) noexcept = default;
+                ~node_arena () noexcept = default;
+
+                node_arena & operator= (node_arena const &) = delete;
+                node_arena & operator= (node_arena &&) noexcept = default;
+
+                /// Allocates \p size bytes aligned to node_arena::alignment.
+                void * allocate (std::size_t size);
+
+                /// Releases every allocation. The first chunk is kept for reuse so that an index
+                /// which is modified by a series of transactions doesn't return to the system heap
+                /// for each one.
+                void clear () noexcept;
+
+                /// Returns the number of bytes that have been allocated since the arena was
+                /// created or last cleared.
+                std::size_t size () const noexcept { return size_; }
+
+            private:
+                using chunk = std::unique_ptr<std::uint8_t[]>;
+                /// Chunks of chunk_size bytes from which allocations are carved.
+                std::vector<chunk> chunks_;
+                /// Chunks holding a single allocation which was too large for a standard chunk.
+                std::vector<chunk> large_;
+                std::uint8_t * next_ = nullptr;
+                std::uint8_t * end_ = nullptr;
+                std::size_t size_ = 0;
+            };
+
             //*  _         _                     _     _            *
             //* (_)_ _  __| |_____ __  _ __  ___(_)_ _| |_ ___ _ _  *
             //* | | ' \/ _` / -_) \ / | '_ \/ _ \ | ' \  _/ -_) '_| *
@@ -271,6 +419,13 @@ namespace pstore {
 
             using parent_stack = array_stack<parent_type, max_tree_depth>;
 
+            /// Hints to the processor that the node (or leaf) referenced by \p node is about to be
+            /// read. This has no effect on the store's contents and never faults.
+            ///
+            /// \param db  The database containing the node.
+            /// \param node  An internal node, linear node, or leaf.
+            void prefetch_node (database const & db, index_pointer node);
+
 
             //*  _ _                                  _      *
             //* | (_)_ _  ___ __ _ _ _   _ _  ___  __| |___  *
@@ -280,6 +435,15 @@ namespace pstore {
             /// \brief A linear node.
             /// Linear nodes as used as the place of last resort for entries which cannot be
             /// distinguished by their hash value.
+            ///
+            /// The children of a linear node are sorted. Alongside each child address, the node
+            /// stores the value of index::key_prefix<> for that child's key; the children are
+            /// ordered first by this prefix and then by key. A lookup can therefore binary search
+            /// the prefixes and only needs to load keys from the store when two or more children
+            /// share a prefix. Nodes written by earlier versions of the library, and the nodes of
+            /// indices whose operator< and KeyEqual disagree (see sorted_linear_nodes<>), are
+            /// unsorted and have no prefixes: they are distinguished by their signature and are
+            /// searched linearly.
             class linear_node {
             public:
                 using iterator = address *;
@@ -300,6 +464,10 @@ namespace pstore {
                 /// child of the supplied node plus the number passed in the 'extra_children'
                 /// parameter.
                 ///
+                /// \note The extra children are zeroed. For a sorted node it is the caller's
+                /// responsibility to ensure that the node's ordering is maintained when they are
+                /// filled in.
+                ///
                 /// \param orig_node  A node whose contents will be copied into the newly allocated
                 /// linear node.
                 /// \param extra_children  The number of extra child for which space will be
@@ -322,13 +490,84 @@ namespace pstore {
                                                                    index_pointer const node,
                                                                    std::size_t extra_children);
 
-                /// \brief Allocates a new linear node in memory with sufficient space for two leaf
-                /// addresses.
+                /// \brief Allocates a copy of an existing node in \p arena. See
+                /// allocate_from(linear_node const &, std::size_t).
+                ///
+                /// \result  A pointer to the new linear node which is owned by \p arena.
+                static linear_node * allocate_from (node_arena & arena,
+                                                    linear_node const & orig_node,
+                                                    std::size_t extra_children);
+
+                /// \brief Allocates a new sorted linear node in memory with sufficient space for
+                /// two leaf addresses. The caller must ensure that 'a' sorts before 'b'.
                 ///
                 /// \param a  The first leaf address for the new linear node.
+                /// \param prefix_a  The key prefix of the first leaf.
                 /// \param b  The second leaf address for the new linear node.
+                /// \param prefix_b  The key prefix of the second leaf.
+                /// \result  A pointer to the newly allocated linear node.
+                static std::unique_ptr<linear_node> allocate (address a, std::uint64_t prefix_a,
+                                                              address b, std::uint64_t prefix_b);
+
+                /// \brief Allocates a new sorted linear node with two leaves in \p arena. See
+                /// allocate(address, std::uint64_t, address, std::uint64_t).
+                ///
+                /// \result  A pointer to the new linear node which is owned by \p arena.
+                static linear_node * allocate (node_arena & arena, address a,
+                                               std::uint64_t prefix_a, address b,
+                                               std::uint64_t prefix_b);
+
+                /// \brief Allocates a new linear node with two leaves in \p arena. The node uses
+                /// the original unsorted format and carries no key prefixes: it is used by
+                /// indices whose keys can't be kept sorted (see sorted_linear_nodes<>).
+                ///
+                /// \result  A pointer to the new linear node which is owned by \p arena.
+                static linear_node * allocate_unsorted (node_arena & arena, address a, address b);
+
+                /// \brief Allocates a linear node with space for \p size children in \p arena. The
+                /// children are null: the caller must fill each of them in using set_child().
+                ///
+                /// \param arena  The arena which will own the new node.
+                /// \param size  The number of children.
+                /// \param sorted  True for a sorted node which carries key prefixes, false for a
+                /// node in the original unsorted format.
+                /// \result  A pointer to the new linear node which is owned by \p arena.
+                static linear_node * allocate_children (node_arena & arena, std::size_t size,
+                                                        bool sorted);
+
+                /// \brief Allocates a new in-memory linear node containing the children of a sorted
+                /// node together with an additional leaf.
+                ///
+                /// \param orig_node  A sorted node whose children will be copied into the newly
+                /// allocated linear node.
+                /// \param pos  The position at which the new leaf is inserted. This should be the
+                /// value produced by lower_bound().
+                /// \param leaf  The address of the new leaf.
+                /// \param prefix  The key prefix of the new leaf.
+                /// \result  A pointer to the newly allocated linear node.
+                static std::unique_ptr<linear_node> allocate_insert (linear_node const & orig_node,
+                                                                     std::size_t pos, address leaf,
+                                                                     std::uint64_t prefix);
+
+                /// \brief Allocates a copy of a sorted node with an additional leaf in \p arena.
+                /// See allocate_insert(linear_node const &, std::size_t, address, std::uint64_t).
+                ///
+                /// \result  A pointer to the new linear node which is owned by \p arena.
+                static linear_node * allocate_insert (node_arena & arena,
+                                                      linear_node const & orig_node,
+                                                      std::size_t pos, address leaf,
+                                                      std::uint64_t prefix);
+
+                /// \brief Allocates a sorted in-memory copy of an unsorted linear node. Every key
+                /// in the node is loaded from the store.
+                ///
+                /// \tparam KeyType The type of the keys stored in the linear node.
+                /// \param db  The database from which child keys should be loaded.
+                /// \param orig_node  An unsorted node whose children will be copied.
                 /// \result  A pointer to the newly allocated linear node.
-                static std::unique_ptr<linear_node> allocate (address a, address b);
+                template <typename KeyType>
+                static std::unique_ptr<linear_node> allocate_sorted (database const & db,
+                                                                     linear_node const & orig_node);
 
                 /// \brief Returns a pointer to a linear node which may be in-heap or in-store.
                 ///
@@ -346,6 +585,15 @@ namespace pstore {
                 /// its raw pointer.
                 static auto get_node (database const & db, index_pointer const node)
                     -> std::pair<std::shared_ptr<linear_node const>, linear_node const *>;
+
+                /// \brief Returns a pointer to a linear node which may be in-heap or in-store.
+                ///
+                /// \param view The view through which the node should be loaded. The result is
+                /// valid for the lifetime of the view.
+                /// \param node A pointer to the node location: either in the heap or in the store.
+                /// \result A pointer to the node.
+                static linear_node const * get_node (database::read_view & view,
+                                                     index_pointer const node);
                 ///@}
 
                 /// \name Element access
@@ -358,6 +606,22 @@ namespace pstore {
                     PSTORE_ASSERT (i < size_);
                     return leaves_[i];
                 }
+                /// Returns the key prefix of the child at position \p i. Only sorted nodes record
+                /// key prefixes.
+                std::uint64_t prefix (std::size_t const i) const noexcept {
+                    PSTORE_ASSERT (this->is_sorted () && i < size_);
+                    return this->prefixes ()[i];
+                }
+                /// Sets the child at position \p i to \p leaf. A sorted node also records the
+                /// leaf's key prefix: the caller must keep the node's ordering.
+                void set_child (std::size_t const i, address const leaf,
+                                std::uint64_t const prefix) noexcept {
+                    PSTORE_ASSERT (i < size_);
+                    leaves_[i] = leaf;
+                    if (this->is_sorted ()) {
+                        this->prefixes ()[i] = prefix;
+                    }
+                }
                 ///@}
 
                 /// \name Iterators
@@ -382,17 +646,25 @@ namespace pstore {
                 std::size_t size () const { return size_; }
                 ///@}
 
+                /// Returns true if the node's children are sorted and it records their key
+                /// prefixes. Returns false for a node written in the original unsorted format.
+                bool is_sorted () const noexcept { return signature_ == sorted_signature_; }
+
                 /// \name Storage
                 ///@{
 
                 /// Returns the number of bytes of storage required for the node.
-                std::size_t size_bytes () const { return linear_node::size_bytes (this->size ()); }
+                std::size_t size_bytes () const {
+                    return linear_node::size_bytes (this->size (), this->is_sorted ());
+                }
 
                 /// Returns the number of bytes of storage required for a linear node with 'size'
                 /// children.
-                static constexpr std::size_t size_bytes (std::uint64_t const size) {
+                static constexpr std::size_t size_bytes (std::uint64_t const size,
+                                                         bool const sorted = true) {
                     return sizeof (linear_node) - sizeof (linear_node::leaves_) +
-                           sizeof (linear_node::leaves_[0]) * size;
+                           sizeof (linear_node::leaves_[0]) * size +
+                           (sorted ? sizeof (std::uint64_t) * size : 0U);
                 }
                 ///@}
 
@@ -402,6 +674,35 @@ namespace pstore {
                 /// \result The address at which the node was written.
                 address flush (transaction_base & transaction) const;
 
+                /// Searches the linear node for a key.
+                ///
+                /// \tparam KeyType The type of the keys stored in the linear node.
+                /// \tparam OtherKeyType  A type whose serialized value is compatible with KeyType
+                /// \tparam KeyEqual  The type of the key-comparison function.
+                /// \param db  The database instance from which child nodes should be loaded.
+                /// \param key  The key to be located.
+                /// \param equal  A comparison function which will be called to compare child nodes
+                /// to the supplied key value. It should return true if the keys match and false
+                /// otherwise.
+                /// \result  A pair whose second member is true if the key was found, in which case
+                /// the first member is its position. If not found, the first member is the position
+                /// at which the key should be inserted to maintain the node's order (or size() for
+                /// an unsorted node).
+                template <typename KeyType, typename OtherKeyType, typename KeyEqual,
+                          typename = typename std::enable_if<
+                              serialize::is_compatible<KeyType, OtherKeyType>::value>::type>
+                auto lower_bound (database const & db, OtherKeyType const & key,
+                                  KeyEqual equal) const -> std::pair<std::size_t, bool> {
+                    return this->lower_bound_impl<KeyType> (db, key, equal);
+                }
+                template <typename KeyType, typename OtherKeyType, typename KeyEqual,
+                          typename = typename std::enable_if<
+                              serialize::is_compatible<KeyType, OtherKeyType>::value>::type>
+                auto lower_bound (database::read_view & view, OtherKeyType const & key,
+                                  KeyEqual equal) const -> std::pair<std::size_t, bool> {
+                    return this->lower_bound_impl<KeyType> (view, key, equal);
+                }
+
                 /// Search the linear node and return the child slot if the key exists.
                 /// Otherwise, return the {nullptr, not_found} pair.
                 /// \tparam KeyType The type of the keys stored in the linear node.
@@ -420,11 +721,37 @@ namespace pstore {
                           typename = typename std::enable_if<
                               serialize::is_compatible<KeyType, OtherKeyType>::value>::type>
                 auto lookup (database const & db, OtherKeyType const & key, KeyEqual equal) const
-                    -> std::pair<index_pointer const, std::size_t>;
+                    -> std::pair<index_pointer const, std::size_t> {
+                    return this->lookup_impl<KeyType> (db, key, equal);
+                }
+                template <typename KeyType, typename OtherKeyType, typename KeyEqual,
+                          typename = typename std::enable_if<
+                              serialize::is_compatible<KeyType, OtherKeyType>::value>::type>
+                auto lookup (database::read_view & view, OtherKeyType const & key,
+                             KeyEqual equal) const -> std::pair<index_pointer const, std::size_t> {
+                    return this->lookup_impl<KeyType> (view, key, equal);
+                }
 
             private:
+                /// The implementation of lower_bound(). \p source is either a database or a
+                /// database::read_view from which keys are loaded.
+                template <typename KeyType, typename Source, typename OtherKeyType,
+                          typename KeyEqual>
+                auto lower_bound_impl (Source & source, OtherKeyType const & key,
+                                       KeyEqual equal) const -> std::pair<std::size_t, bool>;
+
+                /// The implementation of lookup(). \p source is either a database or a
+                /// database::read_view from which keys are loaded.
+                template <typename KeyType, typename Source, typename OtherKeyType,
+                          typename KeyEqual>
+                auto lookup_impl (Source & source, OtherKeyType const & key, KeyEqual equal) const
+                    -> std::pair<index_pointer const, std::size_t>;
+
                 using signature_type = std::array<std::uint8_t, 8>;
-                static signature_type const node_signature_;
+                /// The signature of a node whose children are sorted and carry key prefixes.
+                static signature_type const sorted_signature_;
+                /// The signature of a node written in the original unsorted format.
+                static signature_type const unsorted_signature_;
 
                 /// A placement-new implementation which allocates sufficient storage for a linear
                 /// node with the number of children given by the size parameter.
@@ -444,8 +771,15 @@ namespace pstore {
                 linear_node (linear_node const & rhs);
                 linear_node (linear_node && rhs) = delete;
 
+                /// Constructs an empty linear node with space for \p size children. The node is
+                /// placed in \p arena or, if that is null, is allocated from the heap and owned by
+                /// the caller.
+                static linear_node * construct (node_arena * arena, std::size_t size);
+
                 /// Allocates a new linear node in memory.
                 ///
+                /// \param arena The arena which will own the node or null if it is to be allocated
+                /// from the heap.
                 /// \param num_children Sufficient space is allocated for the number of child nodes
                 /// specified in this parameter.
                 /// \param from_node A node whose contents will be copied into the new node. If the
@@ -453,33 +787,133 @@ namespace pstore {
                 /// from_node, the remaining entries are zeroed; if less then the child node
                 /// collection is truncated after the specified number of entries.
                 /// \result A pointer to the newly allocated linear node.
-                static std::unique_ptr<linear_node> allocate (std::size_t num_children,
-                                                              linear_node const & from_node);
+                static linear_node * copy_node (node_arena * arena, std::size_t num_children,
+                                                linear_node const & from_node);
+                /// The implementation of allocate(address, std::uint64_t, address, std::uint64_t).
+                static linear_node * pair_node (node_arena * arena, address a,
+                                                std::uint64_t prefix_a, address b,
+                                                std::uint64_t prefix_b);
+                /// The implementation of allocate_insert().
+                static linear_node * insert_node (node_arena * arena, linear_node const & orig_node,
+                                                  std::size_t pos, address leaf,
+                                                  std::uint64_t prefix);
+
+                /// The key prefixes of a sorted node are stored immediately after its child
+                /// addresses.
+                std::uint64_t * prefixes () noexcept {
+                    return reinterpret_cast<std::uint64_t *> (&leaves_[0] + size_);
+                }
+                std::uint64_t const * prefixes () const noexcept {
+                    return reinterpret_cast<std::uint64_t const *> (&leaves_[0] + size_);
+                }
 
-                signature_type signature_ = node_signature_;
+                signature_type signature_ = sorted_signature_;
                 std::uint64_t size_;
                 address leaves_[1];
             };
 
-            // lookup
-            // ~~~~~~
-            template <typename KeyType, typename OtherKeyType, typename KeyEqual, typename>
-            auto linear_node::lookup (database const & db, OtherKeyType const & key,
-                                      KeyEqual equal) const
-                -> std::pair<index_pointer const, std::size_t> {
-                // Linear search. TODO: perhaps we should sort the nodes and use a binary
-                // search? This would require a template compare method.
-                std::size_t cnum = 0;
-                for (auto const & child : *this) {
-                    KeyType const existing_key =
-                        serialize::read<KeyType> (serialize::archive::database_reader{db, child});
-                    if (equal (existing_key, key)) {
-                        return {index_pointer{child}, cnum};
+            // allocate_sorted
+            // ~~~~~~~~~~~~~~~
+            template <typename KeyType>
+            std::unique_ptr<linear_node>
+            linear_node::allocate_sorted (database const & db, linear_node const & orig_node) {
+                PSTORE_ASSERT (!orig_node.is_sorted ());
+                auto const size = orig_node.size ();
+
+                std::vector<KeyType> keys;
+                std::vector<std::uint64_t> prefixes;
+                std::vector<std::size_t> order;
+                keys.reserve (size);
+                prefixes.reserve (size);
+                order.reserve (size);
+                key_prefix<KeyType> const prefix_fn{};
+                for (auto ctr = std::size_t{0}; ctr < size; ++ctr) {
+                    keys.emplace_back (serialize::read<KeyType> (
+                        serialize::archive::database_reader{db, orig_node[ctr]}));
+                    prefixes.push_back (prefix_fn (keys.back ()));
+                    order.push_back (ctr);
+                }
+                std::sort (std::begin (order), std::end (order),
+                           [&keys, &prefixes] (std::size_t const lhs, std::size_t const rhs) {
+                               if (prefixes[lhs] != prefixes[rhs]) {
+                                   return prefixes[lhs] < prefixes[rhs];
+                               }
+                               return keys[lhs] < keys[rhs];
+                           });
+
+                auto result =
+                    std::unique_ptr<linear_node> (new (nchildren{size}) linear_node (size));
+                std::uint64_t * const result_prefixes = result->prefixes ();
+                for (auto ctr = std::size_t{0}; ctr < size; ++ctr) {
+                    result->leaves_[ctr] = orig_node[order[ctr]];
+                    result_prefixes[ctr] = prefixes[order[ctr]];
+                }
+                return result;
+            }
+
+            // lower_bound_impl
+            // ~~~~~~~~~~~~~~~~
+            template <typename KeyType, typename Source, typename OtherKeyType, typename KeyEqual>
+            auto linear_node::lower_bound_impl (Source & source, OtherKeyType const & key,
+                                                KeyEqual equal) const
+                -> std::pair<std::size_t, bool> {
+                using stored_key = details::stored_key<KeyType, KeyEqual>;
+                auto const get_key = [&source] (address const addr) {
+                    return stored_key::load (source, addr);
+                };
+
+                if (!this->is_sorted ()) {
+                    // An unsorted node: linear search.
+                    std::size_t cnum = 0;
+                    for (auto const & child : *this) {
+                        if (stored_key::equal (equal, get_key (child), key)) {
+                            return {cnum, true};
+                        }
+                        ++cnum;
+                    }
+                    return {size_, false};
+                }
+
+                // Find the children whose prefix matches that of the key. We only need to load
+                // keys from the store if there's more than one of these.
+                std::uint64_t const * const first = this->prefixes ();
+                std::uint64_t const * const last = first + size_;
+                std::pair<std::uint64_t const *, std::uint64_t const *> const range =
+                    std::equal_range (first, last, key_prefix<KeyType>{}(key));
+                // A binary search of the keys within the range. Sorted nodes are only built for
+                // key types whose operator< agrees with KeyEqual (see sorted_linear_nodes<>).
+                auto pos = static_cast<std::size_t> (range.first - first);
+                auto count = static_cast<std::size_t> (range.second - range.first);
+                while (count > 0U) {
+                    auto const step = count / 2U;
+                    auto const mid = pos + step;
+                    auto const existing_key = get_key (leaves_[mid]);
+                    if (stored_key::equal (equal, existing_key, key)) {
+                        return {mid, true};
+                    }
+                    if (existing_key < key) {
+                        pos = mid + 1U;
+                        count -= step + 1U;
+                    } else {
+                        count = step;
                     }
-                    ++cnum;
                 }
-                // Not found
-                return {index_pointer (), details::not_found};
+                return {pos, false};
+            }
+
+            // lookup_impl
+            // ~~~~~~~~~~~
+            template <typename KeyType, typename Source, typename OtherKeyType, typename KeyEqual>
+            auto linear_node::lookup_impl (Source & source, OtherKeyType const & key,
+                                           KeyEqual equal) const
+                -> std::pair<index_pointer const, std::size_t> {
+                std::pair<std::size_t, bool> const pos =
+                    this->lower_bound_impl<KeyType> (source, key, equal);
+                if (!pos.second) {
+                    // Not found
+                    return {index_pointer (), details::not_found};
+                }
+                return {index_pointer{leaves_[pos.first]}, pos.first};
             }
 
 
@@ -512,63 +946,40 @@ namespace pstore {
                 /// used, for example, when copying an in-store node into memory in preparation for
                 /// modifying it.
                 ///
-                /// \tparam SequenceContainer A container of internal_node instances which supports
-                ///   emplace_back().
-                /// \param container Points to the container which will own the new internal node
-                ///   instance.
+                /// \param arena  The arena which will own the new internal node instance.
                 /// \param other A existing internal_node whose contents are copied into the newly
                 ///   allocated instance.
-                /// \returns A new instance of internal_node which is owned by *container.
-                template <typename SequenceContainer,
-                          typename = typename std::enable_if<std::is_same<
-                              typename SequenceContainer::value_type, internal_node>::value>::type>
-                static internal_node * allocate (SequenceContainer * const container,
+                /// \returns A new instance of internal_node which is owned by *arena.
+                static internal_node * allocate (node_arena * const arena,
                                                  internal_node const & other) {
-                    container->emplace_back (other);
-                    // TODO: in C++17 we can use the emplace_back return value.
-                    return &container->back ();
+                    return new (internal_node::heap_storage (arena)) internal_node (other);
                 }
 
                 /// Construct an internal node with a single child.
                 ///
-                /// \tparam SequenceContainer A container of internal_node instances which supports
-                ///   emplace_back().
-                /// \param container Points to the container which will own the new internal node
-                ///   instance.
+                /// \param arena  The arena which will own the new internal node instance.
                 /// \param leaf The child of the newly allocated internal node.
                 /// \param hash The hash associated with the child node.
-                /// \returns A new instance of internal_node which is owned by *container.
-                template <typename SequenceContainer,
-                          typename = typename std::enable_if<std::is_same<
-                              typename SequenceContainer::value_type, internal_node>::value>::type>
-                static internal_node * allocate (SequenceContainer * container,
+                /// \returns A new instance of internal_node which is owned by *arena.
+                static internal_node * allocate (node_arena * const arena,
                                                  index_pointer const & leaf, hash_type const hash) {
-                    container->emplace_back (leaf, hash);
-                    // TODO: in C++17 we can use the emplace_back return value.
-                    return &container->back ();
+                    return new (internal_node::heap_storage (arena)) internal_node (leaf, hash);
                 }
 
                 /// Construct an internal node with two children.
                 ///
-                /// \tparam SequenceContainer A container of internal_node instances which supports
-                ///   emplace_back().
-                /// \param container Points to the container which will own the new internal node
-                ///   instance.
+                /// \param arena  The arena which will own the new internal node instance.
                 /// \param existing_leaf  One of the two child nodes of the new internal node.
                 /// \param new_leaf  One of the two child nodes of the new internal node.
                 /// \param existing_hash  The hash associated with the \p existing_leaf node.
                 /// \param new_hash  The hash associated with the \p new_leaf node.
-                /// \returns A new instance of internal_node which is owned by *container.
-                template <typename SequenceContainer,
-                          typename = typename std::enable_if<std::is_same<
-                              typename SequenceContainer::value_type, internal_node>::value>::type>
+                /// \returns A new instance of internal_node which is owned by *arena.
                 static internal_node *
-                allocate (SequenceContainer * container, index_pointer const & existing_leaf,
+                allocate (node_arena * const arena, index_pointer const & existing_leaf,
                           index_pointer const & new_leaf, hash_type const existing_hash,
                           hash_type const new_hash) {
-                    container->emplace_back (existing_leaf, new_leaf, existing_hash, new_hash);
-                    // TODO: in C++17 we can use the emplace_back return value.
-                    return &container->back ();
+                    return new (internal_node::heap_storage (arena))
+                        internal_node (existing_leaf, new_leaf, existing_hash, new_hash);
                 }
 
                 /// Return a pointer to an internal node. If the node is in-store, it is loaded and
@@ -584,9 +995,20 @@ namespace pstore {
                 static auto get_node (database const & db, index_pointer const node)
                     -> std::pair<std::shared_ptr<internal_node const>, internal_node const *>;
 
+                /// Return a pointer to an internal node which may be in-heap or in-store.
+                ///
+                /// \param view  The view through which an in-store node is loaded. The result is
+                /// valid for the lifetime of the view.
+                /// \param node  The node's location: either in-store or in-heap.
+                /// \return The node pointer.
+                static internal_node const * get_node (database::read_view & view,
+                                                       index_pointer const node);
+
                 /// Load an internal node from the store.
                 static auto read_node (database const & db, typed_address<internal_node> const addr)
                     -> std::shared_ptr<internal_node const>;
+                static internal_node const * read_node (database::read_view & view,
+                                                        typed_address<internal_node> const addr);
 
                 /// Returns a writable reference to an internal node. If the \p node parameter
                 /// references an in-heap node, then this pointer is returned otherwise a copy of
@@ -595,19 +1017,13 @@ namespace pstore {
                 /// \note It is expected that both \p node and \p internal are references to the
                 /// same node.
                 ///
-                /// \tparam SequenceContainer A container of internal_node instances which supports
-                ///   emplace_back().
-                /// \param container Points to the container which will own the new internal node
-                ///   instance.
+                /// \param arena  The arena which will own a new internal node instance.
                 /// \param node A reference to an internal node. This may be either in-store on the
                 /// heap. If on the heap the returned value is the underlying pointer.
                 /// \param internal  A read-only instance of an internal node. If the \p node
                 /// parameter is in-store then a copy of this value is placed on the heap.
                 /// \result  See above.
-                template <typename SequenceContainer,
-                          typename = typename std::enable_if<std::is_same<
-                              typename SequenceContainer::value_type, internal_node>::value>::type>
-                static internal_node * make_writable (SequenceContainer * const container,
+                static internal_node * make_writable (node_arena * const arena,
                                                       index_pointer const node,
                                                       internal_node const & internal) {
                     if (node.is_heap ()) {
@@ -616,7 +1032,7 @@ namespace pstore {
                         return inode;
                     }
 
-                    return allocate (container, internal);
+                    return allocate (arena, internal);
                 }
 
                 /// Returns the number of bytes occupied by an in-store internal node with the given
@@ -653,6 +1069,24 @@ namespace pstore {
 
                 /// Write an internal node and its children into a store.
                 address flush (transaction_base & transaction, unsigned shifts);
+                /// Returns the number of bytes that flush() will allocate for this node and its
+                /// in-heap descendants when each allocation starts at a multiple of
+                /// node_alignment. It is an upper bound if the nodes are written to a block
+                /// whose start is aligned to node_alignment.
+                std::uint64_t flush_size (unsigned shifts) const;
+                /// The alignment of both internal and linear nodes in the store.
+                static constexpr unsigned node_alignment = alignof (index_pointer);
+
+                /// Writes a new internal node directly to the store without first creating it in
+                /// the heap.
+                ///
+                /// \param transaction  The transaction to which the node will be appended.
+                /// \param bitmap  The node's bitmap. A bit is set for each child.
+                /// \param children  The node's children in bitmap order. These must all be
+                /// in-store references.
+                /// \result  The tagged address at which the node was written.
+                static address write_node (transaction_base & transaction, hash_type bitmap,
+                                           gsl::span<index_pointer const> children);
 
 
                 index_pointer const & operator[] (std::size_t const i) const {
@@ -690,6 +1124,17 @@ namespace pstore {
                 /// store. Returns a new (in-store) internal store address.
                 address store_node (transaction_base & transaction) const;
 
+                /// Returns storage in \p arena for an in-heap internal node. This is sufficient for
+                /// the maximum number of children so that insert_child() can add to the node in
+                /// place.
+                static void * heap_storage (node_arena * const arena) {
+                    static_assert (std::is_trivially_destructible<internal_node>::value,
+                                   "node_arena does not run destructors");
+                    static_assert (alignof (internal_node) <= node_arena::alignment,
+                                   "node_arena storage is insufficiently aligned");
+                    return arena->allocate (internal_node::size_bytes (hash_size));
+                }
+
                 using signature_type = std::array<std::uint8_t, 8>;
                 static signature_type const node_signature_;
 
@@ -721,6 +1166,97 @@ namespace pstore {
             }
 
 
+            //*               _                  _         *
+            //*  _ _  ___  __| |___   __ __ _ __| |_  ___  *
+            //* | ' \/ _ \/ _` / -_) / _/ _` / _| ' \/ -_) *
+            //* |_||_\___/\__,_\___| \__\__,_\__|_||_\___| *
+            //*                                            *
+            /// A read-only, in-memory copy of the internal nodes which form the top levels of an
+            /// in-store trie. These nodes are visited by every lookup so the cache saves loading
+            /// (and validating) each of them from the store on every search.
+            ///
+            /// The nodes are held in breadth-first order in a single cache-line aligned block of
+            /// memory followed by all of their children. Each node occupies 32 bytes so that two
+            /// share a cache line.
+            class node_cache {
+            public:
+                /// The value that lookup() yields for a child which is not in the cache.
+                static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max ();
+
+                /// Loads up to \p levels levels of internal nodes from the trie whose root is
+                /// \p root. The root must be an in-store internal node.
+                node_cache (database const & db, index_pointer root, unsigned levels);
+                node_cache (node_cache const &) = delete;
+                node_cache & operator= (node_cache const &) = delete;
+
+                /// The number of trie levels held by the cache. This may be fewer than were
+                /// requested if the trie is shallow.
+                unsigned levels () const noexcept { return levels_; }
+                /// The number of internal nodes held by the cache.
+                std::size_t size () const noexcept { return size_; }
+
+                /// Returns a reference to the in-store node that is copied by cache node \p n.
+                /// Node 0 is the root.
+                index_pointer node (std::uint32_t const n) const noexcept {
+                    PSTORE_ASSERT (n < size_);
+                    return nodes_[n].self;
+                }
+
+                /// Performs the same function as internal_node::lookup() for cache node \p n.
+                ///
+                /// \param n  The cache node in which the child is to be found.
+                /// \param hash_index  The hash digit for the node's tree level.
+                /// \param next  Set to the number of the cache node which holds the child or to
+                ///   'none' if it is absent or is not in the cache.
+                /// \returns A pair of the child and its index within the node. The index is
+                ///   not_found if the node has no child for \p hash_index.
+                std::pair<index_pointer, std::size_t>
+                lookup (std::uint32_t n, hash_type hash_index,
+                        gsl::not_null<std::uint32_t *> next) const noexcept;
+
+            private:
+                struct entry {
+                    /// A copy of the bitmap of the internal node.
+                    hash_type bitmap;
+                    /// A bit is set for each child which is itself held by the cache.
+                    hash_type cached;
+                    /// The in-store internal node.
+                    index_pointer self;
+                    /// The position in children_ of the node's first child.
+                    std::uint32_t first_child;
+                    /// The cache node of the first of the node's children which is held by the
+                    /// cache. The remainder follow consecutively.
+                    std::uint32_t first_node;
+                };
+
+                static constexpr std::size_t cache_line_size = 64U;
+
+                std::unique_ptr<std::uint8_t[]> storage_;
+                entry * nodes_ = nullptr;
+                index_pointer * children_ = nullptr;
+                std::size_t size_ = 0;
+                unsigned levels_ = 0;
+            };
+
+            // lookup
+            // ~~~~~~
+            inline auto node_cache::lookup (std::uint32_t const n, hash_type const hash_index,
+                                            gsl::not_null<std::uint32_t *> const next) const
+                noexcept -> std::pair<index_pointer, std::size_t> {
+                PSTORE_ASSERT (n < size_ && hash_index < (hash_type{1} << hash_index_bits));
+                entry const & e = nodes_[n];
+                auto const bit_pos = hash_type{1} << hash_index;
+                if ((e.bitmap & bit_pos) == 0) { //! OCLINT(PH - bitwise in conditional is ok)
+                    *next = none;
+                    return {index_pointer{}, not_found};
+                }
+                *next = (e.cached & bit_pos) != 0
+                            ? e.first_node + bit_count::pop_count (e.cached & (bit_pos - 1U))
+                            : none;
+                std::size_t const index = bit_count::pop_count (e.bitmap & (bit_pos - 1U));
+                return {children_[e.first_child + index], index};
+            }
+
         } // namespace details
     }     // namespace index
 } // namespace pstore
@@ -152,6 +152,28 @@ namespace pstore {
                 return {iterator{it.first}, it.second};
             }
 
+            /// Inserts each of the elements in the range [first, last) which is not already
+            /// present in the container. If the container is empty, the trie is built bottom-up
+            /// as described for hamt_map::bulk_insert(). All iterators are invalidated.
+            ///
+            /// \tparam ForwardIterator  An iterator whose value type has a serialized
+            /// representation that is compatible with KeyType.
+            /// \param transaction  The transaction into which the new elements will be inserted.
+            /// \param first  The start of the range of elements to insert.
+            /// \param last  The end of the range of elements to insert.
+            /// \returns The number of elements that were inserted.
+            template <typename ForwardIterator>
+            std::size_t bulk_insert (transaction_base & transaction, ForwardIterator first,
+                                     ForwardIterator last) {
+                using other_key_type = typename std::iterator_traits<ForwardIterator>::value_type;
+                std::vector<std::pair<other_key_type, details::empty_class>> elements;
+                elements.reserve (static_cast<std::size_t> (std::distance (first, last)));
+                for (; first != last; ++first) {
+                    elements.emplace_back (*first, details::empty_class ());
+                }
+                return map_.bulk_insert (transaction, std::begin (elements), std::end (elements));
+            }
+
             /// \brief Find the element with a specific key.
             /// Finds an element with key equivalent to \p key.
             ///
@@ -168,6 +190,38 @@ namespace pstore {
                 return const_iterator{map_.find (db, key)};
             }
 
+            /// Divides the members of the set into runs which can be visited independently. See
+            /// hamt_map::partition().
+            std::vector<subrange<const_iterator>> partition (database const & db,
+                                                             std::size_t const min_parts) const {
+                std::vector<subrange<const_iterator>> result;
+                for (auto const & part : map_.partition (db, min_parts)) {
+                    result.emplace_back (const_iterator{part.begin ()},
+                                         const_iterator{part.end ()});
+                }
+                return result;
+            }
+
+            /// Divides the members of the set into runs for the threads of the global thread pool.
+            /// See hamt_map::parallel_partition().
+            std::vector<subrange<const_iterator>> parallel_partition (database const & db) const {
+                std::vector<subrange<const_iterator>> result;
+                for (auto const & part : map_.parallel_partition (db)) {
+                    result.emplace_back (const_iterator{part.begin ()},
+                                         const_iterator{part.end ()});
+                }
+                return result;
+            }
+
+            /// Invokes \p fn for each member of the set using multiple threads. See
+            /// hamt_map::parallel_visit().
+            template <typename Function>
+            void parallel_visit (database const & db, Function fn) const {
+                using map_iterator = typename decltype (map_)::const_iterator;
+                map_.parallel_visit (
+                    db, [&fn] (map_iterator const & it) { fn (const_iterator{it}); });
+            }
+
             /// Flush any modified index nodes to the store.
             ///
             /// \param transaction  The transaction to which the set will be written.
@@ -177,6 +231,16 @@ namespace pstore {
                                                unsigned generation) {
                 return map_.flush (transaction, generation);
             }
+            /// Returns an upper bound on the number of bytes that flush() will allocate. See
+            /// hamt_map::flush_size().
+            std::uint64_t flush_size () const { return map_.flush_size (); }
+
+            /// Sets the number of levels at the top of the trie which are held in memory to speed
+            /// up lookups. See hamt_map::set_node_cache_levels().
+            void set_node_cache_levels (unsigned const levels) {
+                map_.set_node_cache_levels (levels);
+            }
+            unsigned node_cache_levels () const noexcept { return map_.node_cache_levels (); }
 
             /// \name Accessors
             /// Provide access to index internals.
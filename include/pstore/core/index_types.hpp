@@ -17,6 +17,7 @@
 #ifndef PSTORE_CORE_INDEX_TYPES_HPP
 #define PSTORE_CORE_INDEX_TYPES_HPP
 
+#include "pstore/core/hamt_map_types.hpp"
 #include "pstore/core/indirect_string.hpp"
 
 namespace pstore {
@@ -27,6 +28,17 @@ namespace pstore {
             std::uint64_t operator() (digest const & v) const { return v.high (); }
         };
 
+        /// Digests which share a linear node have identical high halves (see u128_hash), so the
+        /// low half is used to discriminate between them.
+        template <>
+        struct key_prefix<digest> {
+            std::uint64_t operator() (digest const & v) const noexcept { return v.low (); }
+        };
+
+        /// Most lookups in the digest indices are for keys which are absent.
+        template <>
+        struct persist_key_filter<digest, u128_hash> : std::true_type {};
+
     } // namespace index
 
     namespace serialize {
@@ -102,6 +114,18 @@ namespace pstore {
             }
         };
 
+        template <>
+        struct key_prefix<indirect_string> {
+            std::uint64_t operator() (indirect_string const & indir) const {
+                shared_sstring_view owner;
+                raw_sstring_view const str = indir.as_string_view (&owner);
+                return details::string_prefix (str.data (), str.length ());
+            }
+        };
+
+        template <>
+        struct persist_leaf_hash<indirect_string> : std::true_type {};
+
         using name_index = hamt_set<indirect_string, fnv_64a_hash_indirect_string>;
         using path_index = hamt_set<indirect_string, fnv_64a_hash_indirect_string>;
 
@@ -120,25 +144,34 @@ namespace pstore {
 
         /// Returns a pointer to a index, loading it from the store on first access. If 'create' is
         /// false and the index does not already exist then nullptr is returned.
+        ///
+        /// May be called by multiple threads which share a database. If more than one of them
+        /// loads the same index, all but the first of the resulting instances are discarded.
         template <pstore::trailer::indices Index, typename Database = pstore::database,
                   typename Return =
                       typename inherit_const<Database, typename enum_to_index<Index>::type>::type>
         std::shared_ptr<Return> get_index (Database & db, bool const create = true) {
-            auto & dx = db.get_mutable_index (Index);
+            std::shared_ptr<index_base> dx = db.loaded_index (Index);
 
             // Have we already loaded this index?
             if (dx.get () == nullptr) {
-                std::shared_ptr<trailer const> const footer = db.get_footer ();
+                typed_address<trailer> const footer_pos = db.footer_pos ();
+                std::shared_ptr<trailer const> const footer = db.getro (footer_pos);
                 typed_address<index::header_block> const location = footer->a.index_records.at (
                     static_cast<typename std::underlying_type<decltype (Index)>::type> (Index));
                 if (location == decltype (location)::null ()) {
                     if (create) {
                         // Create a new (empty) index.
-                        dx = std::make_shared<typename std::remove_const<Return>::type> (db);
+                        dx = db.publish_index (
+                            Index, std::make_shared<typename std::remove_const<Return>::type> (db),
+                            footer_pos);
                     }
                 } else {
                     // Construct the index from the location.
-                    dx = std::make_shared<typename std::remove_const<Return>::type> (db, location);
+                    dx = db.publish_index (
+                        Index,
+                        std::make_shared<typename std::remove_const<Return>::type> (db, location),
+                        footer_pos);
                 }
             }
 
@@ -103,6 +103,15 @@ namespace pstore {
                                                      raw_sstring_view const & str,
                                                      typed_address<address> address_to_patch);
 
+        /// Writes the body of a string to a buffered archive. Once the archive has been flushed,
+        /// the indirect pointer must be updated to point to the body's address.
+        ///
+        /// \param writer  The archive to which the string body is written.
+        /// \param str  The string to be written.
+        /// \returns  The offset of the string body within the archive's buffer.
+        static std::size_t write_body (serialize::archive::buffered_database_writer & writer,
+                                       raw_sstring_view const & str);
+
         /// Reads an indirect string from the store.
         static indirect_string read (database const & db, typed_address<indirect_string> addr);
 
@@ -161,6 +170,17 @@ namespace pstore {
                 return write_string_address (archive, value);
             }
 
+            /// \brief Writes an instance of `indirect_string` to a buffered database archiver.
+            ///
+            /// \param archive  The Archiver to which the string will be written.
+            /// \param value  The indirect_string instance to be serialized.
+            /// \result  The offset within the archive's buffer at which the data was written.
+            static auto write (archive::buffered_database_writer & archive,
+                               value_type const & value)
+                -> archive_result_type<archive::buffered_database_writer> {
+                return write_string_address (archive, value);
+            }
+
 
             /// \brief Reads an instance of `indirect_string` from an archiver.
             ///
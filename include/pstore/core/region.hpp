@@ -29,6 +29,33 @@ namespace pstore {
 
         using memory_mapper_ptr = std::shared_ptr<memory_mapper_base>;
 
+        namespace details {
+
+            /// Creates an instance of MemoryMapper for a region of a file. The primary template
+            /// ignores the address reservation: only memory_mapper is able to use one.
+            template <typename File, typename MemoryMapper>
+            struct make_mapper {
+                static memory_mapper_ptr make (File & file, std::uint64_t const offset,
+                                               std::uint64_t const size,
+                                               std::shared_ptr<address_reservation> const &) {
+                    return std::make_shared<MemoryMapper> (file, file.is_writable (), offset,
+                                                           size);
+                }
+            };
+
+            template <>
+            struct make_mapper<file::file_handle, memory_mapper> {
+                static memory_mapper_ptr
+                make (file::file_handle & file, std::uint64_t const offset,
+                      std::uint64_t const size,
+                      std::shared_ptr<address_reservation> const & reservation) {
+                    return std::make_shared<memory_mapper> (file, file.is_writable (), offset,
+                                                            size, reservation);
+                }
+            };
+
+        } // end namespace details
+
 
         //*                  _               _           _ _     _             *
         //*   _ __ ___  __ _(_) ___  _ __   | |__  _   _(_) | __| | ___ _ __   *
@@ -54,8 +81,11 @@ namespace pstore {
             /// \param full_size The number of bytes in a "full size" memory-mapped region.
             /// \param minimum_size The number of bytes in a "minimum size" memory-mapped
             /// region.
+            /// \param reservation An optional address range into which the regions are mapped so
+            /// that they are adjacent in memory.
             region_builder (std::shared_ptr<File> file, std::uint64_t full_size,
-                            std::uint64_t minimum_size) noexcept;
+                            std::uint64_t minimum_size,
+                            std::shared_ptr<address_reservation> reservation = nullptr) noexcept;
             // No assignment or copying.
             region_builder (region_builder const &) = delete;
             region_builder (region_builder &&) noexcept = delete;
@@ -100,6 +130,8 @@ namespace pstore {
             std::uint64_t const full_size_;
             ///< The number of bytes in a "minimum size" memory-mapped region.
             std::uint64_t const minimum_size_;
+            /// The address range into which regions are mapped (or nullptr).
+            std::shared_ptr<address_reservation> reservation_;
         };
 
         // region_builder
@@ -107,10 +139,12 @@ namespace pstore {
         template <typename File, typename MemoryMapper>
         region_builder<File, MemoryMapper>::region_builder (
             std::shared_ptr<File> file, std::uint64_t const full_size,
-            std::uint64_t const minimum_size) noexcept
+            std::uint64_t const minimum_size,
+            std::shared_ptr<address_reservation> reservation) noexcept
                 : file_ (file)
                 , full_size_ (full_size)
-                , minimum_size_ (minimum_size) {
+                , minimum_size_ (minimum_size)
+                , reservation_ (std::move (reservation)) {
 
             PSTORE_ASSERT (full_size >= minimum_size && full_size_ % minimum_size_ == 0);
         }
@@ -162,8 +196,8 @@ namespace pstore {
             PSTORE_ASSERT (size >= minimum_size_);
             // (Note that we separately make pages read-only to guard against writing to committed
             // transactions: that's done by database::protect() rather than here.)
-            regions->push_back (
-                std::make_shared<MemoryMapper> (*file_, file_->is_writable (), offset, size));
+            using maker = details::make_mapper<File, MemoryMapper>;
+            regions->push_back (maker::make (*file_, offset, size, reservation_));
         }
 
         // check_regions_are_contiguous
@@ -222,6 +256,14 @@ namespace pstore {
 
             virtual std::shared_ptr<file::file_base> file () = 0;
 
+            /// Returns the number of bytes, starting at offset 0, which the given regions map to a
+            /// single contiguous range of memory. An access which lies entirely within this range
+            /// never needs to be split between regions. The default implementation returns 0.
+            ///
+            /// \param regions  A container of regions created by init() and add().
+            virtual std::uint64_t
+            contiguous_bytes (std::vector<memory_mapper_ptr> const & regions) const;
+
             std::uint64_t full_size () const noexcept { return full_size_; }
             std::uint64_t min_size () const noexcept { return min_size_; }
 
@@ -236,12 +278,15 @@ namespace pstore {
             }
 
             template <typename File, typename MemoryMapper>
-            auto create (std::shared_ptr<File> file) -> std::vector<memory_mapper_ptr>;
+            auto create (std::shared_ptr<File> file,
+                         std::shared_ptr<address_reservation> reservation = nullptr)
+                -> std::vector<memory_mapper_ptr>;
 
             template <typename File, typename MemoryMapper>
             void append (std::shared_ptr<File> file,
                          gsl::not_null<std::vector<memory_mapper_ptr> *> regions,
-                         std::uint64_t original_size, std::uint64_t new_size);
+                         std::uint64_t original_size, std::uint64_t new_size,
+                         std::shared_ptr<address_reservation> reservation = nullptr);
 
         private:
             std::uint64_t const full_size_;
@@ -251,15 +296,17 @@ namespace pstore {
         // create
         // ~~~~~~
         template <typename File, typename MemoryMapper>
-        auto factory::create (std::shared_ptr<File> file) -> std::vector<memory_mapper_ptr> {
+        auto factory::create (std::shared_ptr<File> file,
+                              std::shared_ptr<address_reservation> reservation)
+            -> std::vector<memory_mapper_ptr> {
 
             // There's no lock on the file when we call the size() method here. However, the file
             // is only allowed to grow so if it changes then the worst outcome is that we end up
             // memory mapping more of it beyond the logical size.
 
             std::uint64_t const file_size = file->size ();
-            region_builder<File, MemoryMapper> builder (file, this->full_size (),
-                                                        this->min_size ());
+            region_builder<File, MemoryMapper> builder (file, this->full_size (), this->min_size (),
+                                                        std::move (reservation));
             return builder (file_size);
         }
 
@@ -268,12 +315,14 @@ namespace pstore {
         template <typename File, typename MemoryMapper>
         void factory::append (std::shared_ptr<File> file,
                               gsl::not_null<std::vector<memory_mapper_ptr> *> regions,
-                              std::uint64_t original_size, std::uint64_t new_size) {
+                              std::uint64_t original_size, std::uint64_t new_size,
+                              std::shared_ptr<address_reservation> reservation) {
 
             PSTORE_ASSERT (new_size >= original_size);
 
             auto const min_size = this->min_size ();
-            region_builder<File, MemoryMapper> builder (file, this->full_size (), min_size);
+            region_builder<File, MemoryMapper> builder (file, this->full_size (), min_size,
+                                                        std::move (reservation));
 
             new_size = round_up (new_size, min_size);
             if (!small_files_enabled ()) {
@@ -302,8 +351,18 @@ namespace pstore {
 
             std::shared_ptr<file::file_base> file () override;
 
+            std::uint64_t
+            contiguous_bytes (std::vector<memory_mapper_ptr> const & regions) const override;
+
+            /// The number of bytes of address space reserved for a file's regions. Regions beyond
+            /// this limit are mapped wherever the operating system chooses.
+            static constexpr std::uint64_t reservation_size = std::uint64_t{1} << 40U; // 1 TiB
+
         private:
             std::shared_ptr<file::file_handle> file_;
+            /// A range of addresses into which the file's regions are mapped so that the store
+            /// appears contiguous in memory. nullptr if the range could not be reserved.
+            std::shared_ptr<address_reservation> reservation_;
         };
 
 
@@ -18,6 +18,8 @@
 #ifndef PSTORE_CORE_STORAGE_HPP
 #define PSTORE_CORE_STORAGE_HPP
 
+#include <atomic>
+
 #include "pstore/core/address.hpp"
 #include "pstore/core/region.hpp"
 #include "pstore/support/aligned.hpp"
@@ -86,6 +88,12 @@ namespace pstore {
 
         void map_bytes (std::uint64_t new_size);
 
+        /// Returns the number of bytes at the start of the file which are covered by
+        /// memory-mapped regions.
+        std::uint64_t mapped_size () const noexcept {
+            return regions_.empty () ? std::uint64_t{0} : regions_.back ()->end ();
+        }
+
         /// Called to add newly created memory-mapped regions to the segment address table. This
         /// happens when the file is initially opened, and when it is grown by calling allocate().
         void update_master_pointers (std::size_t old_length);
@@ -138,6 +146,10 @@ namespace pstore {
         /// Marks the address range [first, last) as read-only.
         void protect (address first, address last);
 
+        /// Synchronously writes any modified data in the address range [first, last) back to the
+        /// underlying file.
+        void flush (address first, address last);
+
         ///@{
         /// Returns the base address of a segment given its index.
         /// \param segment The segment number whose base address it to be returned. The segment
@@ -159,6 +171,14 @@ namespace pstore {
             return address_to_pointer_impl (*this, addr);
         }
 
+        /// Returns a raw pointer to the store data at \p addr. Unlike address_to_pointer(), this
+        /// doesn't touch the reference count of the segment's shared_ptr<>. The result is valid
+        /// for as long as the region containing \p addr remains mapped.
+        void const * address_to_raw_pointer (address const addr) const noexcept {
+            return static_cast<std::uint8_t const *> ((*sat_)[addr.segment ()].value.get ()) +
+                   addr.offset ();
+        }
+
         template <typename T>
         std::shared_ptr<T const> address_to_pointer (typed_address<T> addr) const noexcept {
             return std::static_pointer_cast<T const> (address_to_pointer (addr.to_address ()));
@@ -202,6 +222,14 @@ namespace pstore {
             std::make_unique<system_page_size> ();
         std::unique_ptr<region::factory> region_factory_;
         region_container regions_;
+        /// The number of bytes at the start of the store which are mapped to a single contiguous
+        /// range of memory (see region::factory::contiguous_bytes()). A request which lies
+        /// entirely within this range doesn't span regions even if it crosses a region boundary.
+        ///
+        /// Readers may call request_spans_regions() whilst another thread syncs the store, so
+        /// the value is stored (with release semantics) only once the regions and segment address
+        /// table that it describes are in place.
+        std::atomic<std::uint64_t> contiguous_bytes_{0};
     };
 
     // segment_base
@@ -238,6 +266,9 @@ namespace pstore {
 #ifdef PSTORE_ALWAYS_SPANNING
         return true;
 #else
+        if (addr.absolute () + size <= contiguous_bytes_.load (std::memory_order_acquire)) {
+            return false;
+        }
         return (*sat_)[addr.segment ()].region != (*sat_)[(addr + size - 1U).segment ()].region;
 #endif // PSTORE_ALWAYS_SPANNING
     }
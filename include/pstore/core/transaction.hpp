@@ -19,6 +19,7 @@
 #ifndef PSTORE_CORE_TRANSACTION_HPP
 #define PSTORE_CORE_TRANSACTION_HPP
 
+#include <atomic>
 #include <mutex>
 #include <type_traits>
 
@@ -58,7 +59,9 @@ namespace pstore {
         bool is_open () const noexcept { return first_ != address::null (); }
 
         /// Commits all modifications made to the data store as part of this transaction.
-        /// Modifications are visible to other processes when the commit is complete.
+        /// Modifications are visible to other processes when the commit is complete. In
+        /// database::durability::group mode, the transaction lock is released before commit()
+        /// waits for the file header to be flushed.
         transaction_base & commit ();
 
         /// Discards all modifications made to the data store as part of this transaction.
@@ -165,10 +168,37 @@ namespace pstore {
         /// Returns the number of bytes allocated in this transaction.
         std::uint64_t size () const noexcept { return size_; }
 
+        /// Returns the space at the end of the transaction, from \p end onwards, that the most
+        /// recent allocation reserved but did not use. The next allocation is made at \p end.
+        ///
+        /// \param end  An address within the most recent allocation made by this transaction.
+        void trim (address end) noexcept;
+
+        /// The preferred number of bytes that the transaction reserves from the database at a
+        /// time. Individual allocations are carved from the reserved space and any that remains
+        /// unused is returned to the database when the transaction is committed.
+        static constexpr std::uint64_t reserve_size = std::uint64_t{1} << 20U; // 1 Megabyte
+
     protected:
         explicit transaction_base (database & db);
 
+        struct nested_tag {};
+        /// Constructs a transaction which shares a database with an open transaction. Unlike
+        /// the public constructor, it does not sync the database to its head revision: the
+        /// enclosing transaction has already done so.
+        transaction_base (database & db, nested_tag) noexcept
+                : db_{db} {}
+
+        /// Called by commit() in database::durability::group mode once the new footer has been
+        /// published. Releases the transaction lock so that other threads can commit whilst this
+        /// one waits for the file header to reach the disk.
+        virtual void release_lock () {}
+
     private:
+        /// Extends the space reserved from the database so that at least 'size' bytes are
+        /// available at the position given by next_.
+        void reserve (std::uint64_t size);
+
         database & db_;
         /// The number of bytes allocated in this transaction.
         std::uint64_t size_ = 0;
@@ -179,6 +209,40 @@ namespace pstore {
         /// The first address occupied by this transaction. 0 if the transaction
         /// has not yet allocated any data.
         address first_ = address::null ();
+
+        /// The address at which the next allocation will be made.
+        address next_ = address::null ();
+        /// The end of the space that has been reserved from the database. Allocations are made
+        /// from [next_, reserved_end_) without calling database::allocate().
+        address reserved_end_ = address::null ();
+    };
+
+
+    /// A transaction which hands out storage from a block that has already been allocated by an
+    /// open transaction. Several threads can share a block transaction and thereby add data to
+    /// the enclosing transaction concurrently: a block transaction never extends the database and
+    /// its allocations are made one after another from the start of the block, leaving no gaps
+    /// other than alignment padding. It is never open; the data that it writes is committed or
+    /// rolled back along with the enclosing transaction.
+    class block_transaction final : public transaction_base {
+    public:
+        /// \param parent  The open transaction which allocated the block.
+        /// \param first  The address of the first byte of the block.
+        /// \param size  The number of bytes in the block.
+        block_transaction (transaction_base & parent, address first, std::uint64_t size);
+
+        /// Allocates storage from the block. Raises error_code::bad_address if the block does
+        /// not have room for the request. May be called from several threads at once.
+        address allocate (std::uint64_t size, unsigned align) override;
+
+        /// Returns the number of bytes of the block that have been used.
+        std::uint64_t used () const noexcept { return next_.load () - first_.absolute (); }
+
+    private:
+        address first_;
+        /// The absolute address at which the next allocation will be made.
+        std::atomic<std::uint64_t> next_;
+        address end_;
     };
 
 
@@ -202,6 +266,8 @@ namespace pstore {
         transaction & operator= (transaction && rhs) noexcept = delete;
 
     private:
+        void release_lock () override { lock_.unlock (); }
+
         lock_type lock_;
     };
 
@@ -247,12 +313,7 @@ namespace pstore {
             rhs.owned_ = false;
         }
 
-        ~lock_guard () {
-            if (owned_) {
-                mut_.unlock ();
-                owned_ = false;
-            }
-        }
+        ~lock_guard () { this->unlock (); }
 
         lock_guard & operator= (lock_guard const & rhs) = delete;
         lock_guard & operator= (lock_guard && rhs) noexcept {
@@ -264,6 +325,14 @@ namespace pstore {
             return *this;
         }
 
+        /// Releases the mutex before the lock_guard is destroyed.
+        void unlock () {
+            if (owned_) {
+                mut_.unlock ();
+                owned_ = false;
+            }
+        }
+
     private:
         MutexType mut_;
         bool owned_ = false;
@@ -73,51 +73,11 @@ namespace pstore {
                 unsigned const old_revision_;
             };
 
-            /// An OutputIterator which converts the address of objects in a known index into their
-            /// value_ptr representation for display to the user.
-            template <typename Index>
-            class diff_out {
-            public:
-                using iterator_category = std::output_iterator_tag;
-                using value_type = void;
-                using difference_type = void;
-                using pointer = void;
-                using reference = void;
-
-                struct params {
-                    params (gsl::not_null<database const *> const db,
-                            gsl::not_null<Index const *> const index,
-                            gsl::not_null<dump::array::container *> const members) noexcept
-                            : db_{db}
-                            , index_{index}
-                            , members_{members} {}
-
-                    gsl::not_null<database const *> const db_;
-                    gsl::not_null<Index const *> const index_;
-                    gsl::not_null<dump::array::container *> const members_;
-                };
-
-                explicit diff_out (gsl::not_null<params *> const p) noexcept
-                        : p_{p} {}
-
-                diff_out & operator= (pstore::address addr) {
-                    p_->members_->emplace_back (
-                        dump::make_value (get_key (p_->index_->load_leaf_node (*p_->db_, addr))));
-                    return *this;
-                }
-
-                diff_out & operator* () noexcept { return *this; }
-                diff_out & operator++ () noexcept { return *this; }
-                diff_out operator++ (int) noexcept { return *this; }
-
-            private:
-                gsl::not_null<params *> p_;
-            };
-
         } // end namespace details
 
         /// Make a value pointer which contains the keys that are different between two database
-        /// revisions.
+        /// revisions: that is, those which were added or whose value was replaced after
+        /// \p old_revision. The newer revision is the one to which \p db is synced.
         ///
         /// \param db The database from which the index is to be read.
         /// \param old_revision  A old database revision number to be compared to new_contents.
@@ -128,9 +88,24 @@ namespace pstore {
         dump::value_ptr make_diff (database & db, revision_number const old_revision,
                                    GetIndexFunction get_index) {
             dump::array::container members;
-            std::shared_ptr<Index const> const index = get_index (db, true /* create */);
-            typename details::diff_out<Index>::params params{&db, index.get (), &members};
-            diff (db, *index, old_revision, details::diff_out<Index>{&params});
+            std::shared_ptr<Index const> const new_index = get_index (db, true /* create */);
+            revision_number const new_revision = db.get_current_revision ();
+            if (old_revision != head_revision && old_revision <= new_revision) {
+                // Load the old revision of the index. It remains usable once the database has
+                // returned to the new revision because the store is append-only.
+                db.sync (old_revision);
+                std::shared_ptr<Index const> const old_index = get_index (db, true /* create */);
+                db.sync (new_revision);
+
+                std::vector<index_change> changes;
+                parallel_diff_indices (db, *old_index, *new_index, std::back_inserter (changes));
+                for (index_change const & change : changes) {
+                    if (change.kind != change_kind::removed) {
+                        members.emplace_back (dump::make_value (
+                            get_key (new_index->load_leaf_node (db, change.new_leaf))));
+                    }
+                }
+            }
             return dump::make_value (members);
         }
 
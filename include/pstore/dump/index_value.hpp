@@ -16,22 +16,38 @@
 #ifndef PSTORE_DUMP_INDEX_VALUE_HPP
 #define PSTORE_DUMP_INDEX_VALUE_HPP
 
+#include <iterator>
+#include <numeric>
+
 #include "pstore/core/index_types.hpp"
 #include "pstore/dump/mcrepo_value.hpp"
+#include "pstore/support/parallel_for_each.hpp"
 
 namespace pstore {
     namespace dump {
 
+        /// Produces an array containing the result of calling \p mk for each member of an index.
+        /// The index is divided into runs which are processed concurrently so \p mk may be called
+        /// from multiple threads. The members of the array are in index order.
         template <typename trailer::indices Index, typename MakeValueFn>
         value_ptr make_index (database const & db, MakeValueFn mk) {
             using return_type = typename index::enum_to_index<Index>::type const;
-            using value_type = typename return_type::value_type;
             array::container members;
             if (std::shared_ptr<return_type> const index =
                     index::get_index<Index> (db, false /* create */)) {
-                std::for_each (
-                    index->begin (db), index->end (db),
-                    [&members, mk] (value_type const & v) { members.emplace_back (mk (v)); });
+                auto const parts = index->parallel_partition (db);
+                std::vector<array::container> part_members (parts.size ());
+                std::vector<std::size_t> part_indices (parts.size ());
+                std::iota (std::begin (part_indices), std::end (part_indices), std::size_t{0});
+                parallel_for_each (std::begin (part_indices), std::end (part_indices),
+                                   [&parts, &part_members, &mk] (std::size_t const p) {
+                                       for (auto const & v : parts[p]) {
+                                           part_members[p].emplace_back (mk (v));
+                                       }
+                                   });
+                for (array::container & pm : part_members) {
+                    std::move (std::begin (pm), std::end (pm), std::back_inserter (members));
+                }
             }
             return make_value (std::move (members));
         }
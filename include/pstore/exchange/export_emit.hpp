@@ -20,8 +20,12 @@
 #ifndef PSTORE_EXCHANGE_EXPORT_EMIT_HPP
 #define PSTORE_EXCHANGE_EXPORT_EMIT_HPP
 
+#include <numeric>
+#include <vector>
+
 #include "pstore/core/indirect_string.hpp"
 #include "pstore/exchange/export_ostream.hpp"
+#include "pstore/support/parallel_for_each.hpp"
 
 namespace pstore {
 
@@ -210,6 +214,48 @@ namespace pstore {
                 return os;
             }
 
+            /// Writes the members of a JSON object or array to the output stream \p os. Each member
+            /// is preceded by a newline and all but the first by a comma. The members are written
+            /// in order but are formatted concurrently, in runs of consecutive elements, by the
+            /// threads of the global thread pool.
+            ///
+            /// \tparam T  The type of the elements which describe the members.
+            /// \tparam Function  A callable whose signature should be equivalent to:
+            ///     void fun(ostream_base &, T const &);
+            ///   It may be called from several threads at once.
+            /// \param os  The output stream to which the members are written.
+            /// \param elements  The elements describing the members to be written, for example
+            ///   the addresses of new index leaves that were reported by diff().
+            /// \param fn  A function which is called to write the member described by each element.
+            template <typename T, typename Function>
+            void emit_members (ostream_base & os, std::vector<T> const & elements, Function fn) {
+                constexpr auto run_size = std::size_t{256};
+                // The output of a batch of runs is held in memory until it is written.
+                constexpr auto runs_per_batch = std::size_t{256};
+                auto const num_runs = (elements.size () + run_size - 1U) / run_size;
+                std::vector<std::size_t> runs;
+                std::vector<std::string> output;
+                for (auto batch = std::size_t{0}; batch < num_runs; batch += runs_per_batch) {
+                    runs.resize (std::min (runs_per_batch, num_runs - batch));
+                    std::iota (std::begin (runs), std::end (runs), batch);
+                    output.assign (runs.size (), std::string{});
+                    parallel_for_each (
+                        std::begin (runs), std::end (runs), [&] (std::size_t const run) {
+                            ostringstream run_os;
+                            auto const first = run * run_size;
+                            auto const last = std::min (first + run_size, elements.size ());
+                            for (auto ctr = first; ctr < last; ++ctr) {
+                                run_os << (ctr == 0U ? "\n" : ",\n");
+                                fn (run_os, elements[ctr]);
+                            }
+                            output[run - batch] = run_os.str ();
+                        });
+                    for (std::string const & s : output) {
+                        os.write (s);
+                    }
+                }
+            }
+
             /// Writes a object to the output stream \p os. The output consists of a pair of braces
             /// with appropriate whitespace. The function \p fn is called to write the properties
             /// and values of the object.
@@ -105,7 +105,7 @@ namespace pstore {
             auto const content_length = std::to_string (content_str.length ());
             std::array<czstring_pair, 5> const h{{
                 {"Content-length", content_length.c_str ()},
-                {"Connection", "close"}, // TODO remove this when we support persistent connections
+                {"Connection", "close"}, // The server closes the connection after an error.
                 {"Content-type", "text/html"},
                 {"Date", now.c_str ()},
                 {"Last-Modified", now.c_str ()},
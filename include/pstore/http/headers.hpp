@@ -16,6 +16,7 @@
 #ifndef PSTORE_HTTP_HEADERS_HPP
 #define PSTORE_HTTP_HEADERS_HPP
 
+#include <ctime>
 #include <string>
 
 #include "pstore/support/maybe.hpp"
@@ -29,8 +30,16 @@ namespace pstore {
 
             bool upgrade_to_websocket = false;
             bool connection_upgrade = false;
+            /// True if the client asked for the connection to be closed after the response.
+            bool connection_close = false;
             pstore::maybe<std::string> websocket_key;
             pstore::maybe<unsigned> websocket_version;
+            /// The value of an If-None-Match header: a comma-separated list of entity tags or "*".
+            pstore::maybe<std::string> if_none_match;
+            /// The time given by a valid If-Modified-Since header.
+            pstore::maybe<std::time_t> if_modified_since;
+            /// True if the client accepts responses with the gzip content coding.
+            bool accept_gzip = false;
 
             header_info handler (std::string const & key, std::string const & value);
         };
@@ -22,12 +22,21 @@
 #include <ctime>
 #include <string>
 
+#include "pstore/support/maybe.hpp"
+
 namespace pstore {
     namespace http {
 
         std::string http_date (std::chrono::system_clock::time_point time);
         std::string http_date (std::time_t time);
 
+        /// Parses a date in the IMF-fixdate format produced by http_date(). The obsolete
+        /// RFC 850 and asctime() formats are not accepted.
+        ///
+        /// \param str  The string to be parsed.
+        /// \returns  The time represented by \p str or nothing if it is not a valid IMF-fixdate.
+        maybe<std::time_t> parse_http_date (std::string const & str);
+
     } // end namespace http
 } // end namespace pstore
 
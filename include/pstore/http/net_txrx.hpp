@@ -17,6 +17,7 @@
 #define PSTORE_HTTP_NET_TXRX_HPP
 
 #include "pstore/adt/error_or.hpp"
+#include "pstore/http/send.hpp"
 #include "pstore/os/descriptor.hpp"
 #include "pstore/support/gsl.hpp"
 
@@ -33,7 +34,25 @@ namespace pstore {
             error_or<socket_descriptor &> network_sender (socket_descriptor & socket,
                                                           gsl::span<std::uint8_t const> const & s);
 
+            /// Writes the contents of a sequence of buffers to a socket. On POSIX systems, the
+            /// buffers are passed to the kernel together by a single call to writev() (unless it
+            /// writes only part of the data).
+            error_or<socket_descriptor &>
+            network_gather_sender (socket_descriptor & socket,
+                                   gsl::span<gsl::span<std::uint8_t const> const> buffers);
+
         } // end namespace net
+
+        /// Buffers sent over the network are written by a single system call.
+        template <>
+        struct gather_sender<decltype (&net::network_sender)> {
+            template <typename IO>
+            static error_or<IO> send (decltype (&net::network_sender), IO io,
+                                      gsl::span<gsl::span<std::uint8_t const> const> buffers) {
+                error_or<socket_descriptor &> const eo = net::network_gather_sender (io, buffers);
+                return eo ? error_or<IO>{io} : error_or<IO>{eo.get_error ()};
+            }
+        };
     }     // end namespace http
 } // end namespace pstore
 
@@ -0,0 +1,73 @@
+//===- include/pstore/http/poller.hpp ---------------------*- mode: C++ -*-===//
+//*              _ _            *
+//*  _ __   ___ | | | ___ _ __  *
+//* | '_ \ / _ \| | |/ _ \ '__| *
+//* | |_) | (_) | | |  __/ |    *
+//* | .__/ \___/|_|_|\___|_|    *
+//* |_|                         *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file poller.hpp
+/// \brief Waits for input on a changing set of descriptors.
+
+#ifndef PSTORE_HTTP_POLLER_HPP
+#define PSTORE_HTTP_POLLER_HPP
+
+#ifndef _WIN32
+
+#    include <chrono>
+#    include <vector>
+
+#    ifndef __linux__
+#        include <poll.h>
+#    endif
+
+#    include "pstore/os/descriptor.hpp"
+
+namespace pstore {
+    namespace http {
+
+        /// Watches a set of descriptors and reports those which have input waiting (or which
+        /// have been closed by the peer). On Linux this uses epoll so that the cost of a wait
+        /// does not depend on the number of idle descriptors; elsewhere poll() is used.
+        ///
+        /// The member functions must all be called from the same thread.
+        class poller {
+        public:
+            poller ();
+            poller (poller const &) = delete;
+            poller (poller &&) = delete;
+            ~poller () noexcept = default;
+
+            poller & operator= (poller const &) = delete;
+            poller & operator= (poller &&) = delete;
+
+            /// Starts watching \p fd for input.
+            void add (int fd);
+            /// Stops watching \p fd.
+            void remove (int fd);
+
+            /// Blocks until at least one of the watched descriptors is ready or until \p timeout
+            /// has elapsed. The descriptors which are ready are appended to \p ready.
+            void wait (std::vector<int> * ready, std::chrono::milliseconds timeout);
+
+        private:
+#    ifdef __linux__
+            pstore::details::descriptor<pstore::details::posix_descriptor_traits> epoll_;
+#    else
+            std::vector<pollfd> fds_;
+#    endif
+        };
+
+    } // end namespace http
+} // end namespace pstore
+
+#endif // _WIN32
+
+#endif // PSTORE_HTTP_POLLER_HPP
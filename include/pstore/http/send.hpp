@@ -45,6 +45,29 @@ namespace pstore {
             return send (sender, io, os.str ());
         }
 
+        /// Sends the contents of a sequence of buffers. The primary template passes each buffer
+        /// to the sender in turn. A specialization may instead write all of them at once for
+        /// senders which support that.
+        template <typename Sender>
+        struct gather_sender {
+            template <typename IO>
+            static error_or<IO> send (Sender sender, IO io,
+                                      gsl::span<gsl::span<std::uint8_t const> const> buffers) {
+                if (buffers.empty ()) {
+                    return error_or<IO>{io};
+                }
+                return sender (io, buffers[0]) >>= [&] (IO io2) {
+                    return gather_sender::send (sender, io2, buffers.subspan (1));
+                };
+            }
+        };
+
+        template <typename Sender, typename IO>
+        error_or<IO> send_buffers (Sender sender, IO io,
+                                   gsl::span<gsl::span<std::uint8_t const> const> buffers) {
+            return gather_sender<Sender>::send (sender, io, buffers);
+        }
+
         template <typename Sender, typename IO, typename T,
                   typename = typename std::enable_if<std::is_integral<T>::value>::type>
         error_or<IO> send (Sender sender, IO io, T v) {
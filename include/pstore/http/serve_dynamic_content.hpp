@@ -49,7 +49,8 @@ namespace pstore {
         using query_container = std::unordered_map<std::string, std::string>;
 
         template <typename Sender, typename IO>
-        pstore::error_or<IO> handle_version (Sender sender, IO io, query_container const &) {
+        pstore::error_or<IO> handle_version (Sender sender, IO io, query_container const &,
+                                             bool const keep_alive) {
             auto version_string = [] () {
                 std::ostringstream os;
                 os << R"({ "version": ")" << header::major_version << '.' << header::minor_version
@@ -62,9 +63,11 @@ namespace pstore {
             static auto const modified = std::chrono::system_clock::now ();
 
             std::ostringstream os;
-            os << "HTTP/1.1 200 OK" << crlf                                         //
-               << "Connection: close" << crlf                                       //
-               << "Content-length: " << version.length () << crlf                   //
+            os << "HTTP/1.1 200 OK" << crlf;
+            if (!keep_alive) {
+                os << "Connection: close" << crlf;
+            }
+            os << "Content-length: " << version.length () << crlf                   //
                << "Content-type: application/json" << crlf                          //
                << "Date: " << http_date (std::chrono::system_clock::now ()) << crlf //
                << "Last-Modified: " << http_date (modified) << crlf                 //
@@ -100,7 +103,7 @@ namespace pstore {
             struct commands_helper {
                 using return_type = error_or<IO>;
                 using function_type =
-                    std::function<return_type (Sender, IO, query_container const &)>;
+                    std::function<return_type (Sender, IO, query_container const &, bool)>;
 
                 using container = std::array<std::pair<std::string, function_type>, 1>;
             };
@@ -116,8 +119,12 @@ namespace pstore {
         } // end namespace details
 
 
+        /// Runs the command named by \p uri and sends its response. \p keep_alive should be
+        /// false if the server will close the connection once the response has been sent. The
+        /// response then tells the client so.
         template <typename Sender, typename IO>
-        error_or<IO> serve_dynamic_content (Sender sender, IO io, std::string uri) {
+        error_or<IO> serve_dynamic_content (Sender sender, IO io, std::string uri,
+                                            bool const keep_alive) {
 
             // Remove the common path prefix from the URI.
             PSTORE_ASSERT (details::starts_with (uri, dynamic_path));
@@ -146,15 +153,17 @@ namespace pstore {
 
             auto const lb = std::lower_bound (
                 std::begin (commands), std::end (commands),
-                value_type{command, [] (Sender, IO io2,
-                                        query_container const &) { return error_or<IO>{io2}; }},
+                value_type{command,
+                           [] (Sender, IO io2, query_container const &, bool) {
+                               return error_or<IO>{io2};
+                           }},
                 compare);
             if (lb == std::end (commands) || std::get<0> (*lb) != command) {
                 return error_or<IO>{error_code::bad_request};
             }
 
             // Yep, this is a command we understand. Call it.
-            return std::get<1> (*lb) (sender, io, arguments);
+            return std::get<1> (*lb) (sender, io, arguments, keep_alive);
         }
 
     } // end namespace http
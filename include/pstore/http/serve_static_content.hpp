@@ -22,6 +22,11 @@
 #ifndef PSTORE_HTTP_SERVE_STATIC_CONTENT_HPP
 #define PSTORE_HTTP_SERVE_STATIC_CONTENT_HPP
 
+#include <array>
+#include <sstream>
+#include <string>
+
+#include "pstore/http/headers.hpp"
 #include "pstore/http/http_date.hpp"
 #include "pstore/http/media_type.hpp"
 #include "pstore/http/send.hpp"
@@ -32,29 +37,39 @@ namespace pstore {
 
         namespace details {
 
-            template <typename Sender, typename IO>
-            pstore::error_or<IO> read_and_send (Sender sender, IO io,
-                                                pstore::romfs::descriptor fd) {
-                std::array<std::uint8_t, 1024> buffer{{0}};
-                auto * const data = buffer.data ();
-                std::size_t const num_read =
-                    fd.read (data, sizeof (decltype (buffer)::value_type), buffer.size ());
-                if (num_read == 0) {
-                    return pstore::error_or<IO>{io};
-                }
-                pstore::error_or<IO> const eo =
-                    send (sender, io, gsl::span<std::uint8_t const> (data, data + num_read));
-                if (!eo) {
-                    return eo;
-                }
-                return read_and_send (sender, io, fd);
-            }
+            /// Returns the entity tag of the gzip-compressed representation of a file whose
+            /// (uncompressed) entity tag is \p etag. A strong entity tag must differ between
+            /// representations with different content codings.
+            std::string gzip_etag (std::string const & etag);
+
+            /// Returns true if the request's conditional headers show that the client already
+            /// holds the current representation of a file and a 304 (Not Modified) response
+            /// should be sent.
+            ///
+            /// \param request_headers  The request's headers.
+            /// \param etag  The entity tag of the selected representation of the file. May be
+            ///   empty if the file has none.
+            /// \param mtime  The file's modification time.
+            bool is_not_modified (header_info const & request_headers, std::string const & etag,
+                                  std::time_t mtime);
 
         } // end namespace details
 
+        /// Sends the file at \p path in \p file_system. The file's contents are sent directly
+        /// from the file system image along with the response header.
+        ///
+        /// If the client already holds the current version of the file, as shown by the
+        /// request's If-None-Match or If-Modified-Since headers, a 304 (Not Modified) response is
+        /// sent instead. If the client accepts gzip content coding and the file system holds a
+        /// compressed copy of the file, that copy is sent.
+        ///
+        /// \p keep_alive should be false if the server will close the connection once the
+        /// response has been sent. The response then tells the client so.
         template <typename Sender, typename IO>
         pstore::error_or<IO> serve_static_content (Sender sender, IO io, std::string path,
-                                                   pstore::romfs::romfs const & file_system) {
+                                                   pstore::romfs::romfs const & file_system,
+                                                   header_info const & request_headers,
+                                                   bool const keep_alive) {
             if (path.empty ()) {
                 path = "/";
             }
@@ -62,23 +77,58 @@ namespace pstore {
                 path += "index.html";
             }
 
-            return file_system.stat (path.c_str ()) >>= [&] (pstore::romfs::stat const & stat) {
-                return file_system.open (path.c_str ()) >>= [&] (pstore::romfs::descriptor fd) {
-                    // Send the response header.
-                    std::ostringstream os;
-                    os << "HTTP/1.0 200 OK" << crlf               //
-                       << "Server: " << server_name << crlf       //
-                       << "Content-length: " << stat.size << crlf //
+            return file_system.lookup (path.c_str ()) >>= [&] (pstore::romfs::dirent const *
+                                                                 PSTORE_NONNULL const de) {
+                pstore::romfs::stat const & stat = de->stat ();
+                bool const gzip = request_headers.accept_gzip && de->gzip_contents () != nullptr;
+                std::string etag = de->etag () != nullptr ? de->etag () : "";
+                if (gzip) {
+                    etag = details::gzip_etag (etag);
+                }
+
+                bool const not_modified =
+                    details::is_not_modified (request_headers, etag, stat.mtime);
+                auto const body =
+                    not_modified ? gsl::span<std::uint8_t const>{}
+                    : gzip ? gsl::make_span (
+                                 static_cast<std::uint8_t const *> (de->gzip_contents ()),
+                                 static_cast<std::ptrdiff_t> (de->gzip_size ()))
+                           : gsl::make_span (static_cast<std::uint8_t const *> (de->contents ()),
+                                             static_cast<std::ptrdiff_t> (stat.size));
+
+                // Build the response header.
+                std::ostringstream os;
+                os << (not_modified ? "HTTP/1.1 304 Not Modified" : "HTTP/1.1 200 OK") << crlf
+                   << "Server: " << server_name << crlf //
+                   << "Date: " << http_date (std::chrono::system_clock::now ()) << crlf;
+                if (!keep_alive) {
+                    os << "Connection: close" << crlf;
+                }
+                if (!etag.empty ()) {
+                    os << "ETag: " << etag << crlf;
+                }
+                if (de->gzip_contents () != nullptr) {
+                    // The response depends on whether the client accepts gzip.
+                    os << "Vary: Accept-Encoding" << crlf;
+                }
+                os << "Last-Modified: " << http_date (stat.mtime) << crlf;
+                if (!not_modified) {
+                    os << "Content-length: " << body.size () << crlf //
                        << "Content-type: " << pstore::http::media_type_from_filename (path)
-                       << crlf //
-                       << "Connection: close"
-                       << crlf // TODO remove this when we support persistent connections
-                       << "Date: " << http_date (std::chrono::system_clock::now ()) << crlf //
-                       << "Last-Modified: " << http_date (stat.mtime) << crlf               //
                        << crlf;
-                    return send (sender, io, os.str ()) >>=
-                           [&] (IO io2) { return details::read_and_send (sender, io2, fd); };
-                };
+                    if (gzip) {
+                        os << "Content-encoding: gzip" << crlf;
+                    }
+                }
+                os << crlf;
+
+                // Send the header and the file's contents together.
+                std::string const header = os.str ();
+                auto const * const header_data =
+                    reinterpret_cast<std::uint8_t const *> (header.data ());
+                std::array<gsl::span<std::uint8_t const>, 2> const buffers{
+                    {gsl::make_span (header_data, header_data + header.length ()), body}};
+                return send_buffers (sender, io, gsl::make_span (buffers));
             };
         }
 
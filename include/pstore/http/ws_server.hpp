@@ -575,6 +575,36 @@ namespace pstore {
                        gsl::not_null<descriptor_condition_variable *>>;
         using channel_container = std::unordered_map<std::string, channel_container_entry>;
 
+        /// The subscription of a WebSockets session to the channel named by its URI.
+        struct ws_subscription {
+            brokerface::channel<descriptor_condition_variable>::subscriber_pointer subscriber;
+            /// Signalled when a message is published to the channel. Null if the URI did not name
+            /// a channel.
+            descriptor_condition_variable * cv = nullptr;
+        };
+
+        /// Subscribes to the channel named by a WebSockets request URI of the form
+        /// "/channel-name".
+        ws_subscription subscribe (std::string const & uri, channel_container const & channels);
+
+        // push_messages
+        // ~~~~~~~~~~~~~
+        /// Sends each of the messages that are waiting in a subscriber's queue to the peer.
+        template <typename Sender, typename IO>
+        void push_messages (Sender && sender, IO io, ws_subscription const & subscription) {
+            if (!subscription.subscriber) {
+                return;
+            }
+            while (maybe<std::string> const message = subscription.subscriber->pop ()) {
+                log (logger::priority::info, "sending:", *message);
+                error_or<IO> const eo3 =
+                    send_message (sender, io, opcode::text, as_bytes (gsl::make_span (*message)));
+                if (!eo3) {
+                    log (logger::priority::error, "Send error: ", eo3.get_error ().message ());
+                }
+            }
+        }
+
         // ws_server_loop
         // ~~~~~~~~~~~~~~
         template <typename Reader, typename Sender, typename IO>
@@ -582,19 +612,8 @@ namespace pstore {
                              channel_container const & channels) {
 
             ws_command command;
-            brokerface::channel<descriptor_condition_variable>::subscriber_pointer subscription;
-            descriptor_condition_variable * cv = nullptr;
-
-            if (uri.length () > 0 && uri[0] == '/') {
-                std::string const name = uri.substr (1);
-                auto const pos = channels.find (name);
-                if (pos != channels.end ()) {
-                    subscription = std::get<0> (pos->second)->new_subscriber ();
-                    cv = std::get<1> (pos->second);
-                } else {
-                    log (logger::priority::error, "No channel named: ", name);
-                }
-            }
+            ws_subscription const subscription = subscribe (uri, channels);
+            descriptor_condition_variable * const cv = subscription.cv;
 
             bool done = false;
             while (!done) {
@@ -607,17 +626,7 @@ namespace pstore {
                     // There's a message to push to our peer.
                     PSTORE_ASSERT (cv != nullptr);
                     cv->reset ();
-                    if (subscription) {
-                        while (maybe<std::string> const message = subscription->pop ()) {
-                            log (logger::priority::info, "sending:", *message);
-                            error_or<IO> const eo3 = send_message (
-                                sender, io, opcode::text, as_bytes (gsl::make_span (*message)));
-                            if (!eo3) {
-                                log (logger::priority::error,
-                                     "Send error: ", eo3.get_error ().message ());
-                            }
-                        }
-                    }
+                    push_messages (sender, io, subscription);
                 }
             }
         }
@@ -27,6 +27,10 @@
 #ifndef PSTORE_OS_MEMORY_MAPPER_HPP
 #define PSTORE_OS_MEMORY_MAPPER_HPP
 
+#include <mutex>
+#include <utility>
+#include <vector>
+
 #include "pstore/os/file.hpp"
 
 namespace pstore {
@@ -109,6 +113,18 @@ namespace pstore {
         /// \note The function is virtual for mocking.
         virtual void read_only (void * addr, std::size_t len);
 
+        /// \brief Synchronously writes any modified pages in the range of addresses given by addr
+        /// and len back to the underlying file.
+        ///
+        /// This function validates the input parameter before calling flush_impl() which is
+        /// responsible for calling the real OS API.
+        ///
+        /// \param addr  A pointer that describes the starting page of the region of pages to be
+        ///              flushed.
+        /// \param len   The size of the region to be flushed.
+        /// \note The function is virtual for mocking.
+        virtual void flush (void * addr, std::size_t len);
+
     protected:
         /// \param ptr          A pointer to the mapped memory.
         /// \param is_writable  If the mapped memory  writeable? If true, then the underlying file,
@@ -133,6 +149,13 @@ namespace pstore {
         ///       automatically gains the behavior.
         void read_only_impl (void * addr, std::size_t len);
 
+        /// \brief Writes any modified pages in the range given by addr and len to disk.
+        ///
+        /// \param addr  A pointer that describes the starting page of the region of pages to be
+        ///              flushed.
+        /// \param len   The size of the region to be flushed.
+        void flush_impl (void * addr, std::size_t len);
+
         /// A pointer to the mapped memory.
         std::shared_ptr<void> ptr_;
         /// True if the underlying memory is writable.
@@ -146,6 +169,60 @@ namespace pstore {
 
     std::ostream & operator<< (std::ostream & os, memory_mapper_base const & mm);
 
+    /// A range of virtual addresses which is reserved (but not backed by memory) so that a series
+    /// of file mappings can later be placed at adjacent addresses. A mapping is placed at the
+    /// reservation's base address plus the file offset that it maps: two mappings of consecutive
+    /// file ranges are therefore themselves consecutive in memory.
+    ///
+    /// Reservation is only supported on Linux. Elsewhere, or if the operating system refuses to
+    /// reserve the range, valid() returns false and the caller should map without it.
+    class address_reservation {
+    public:
+        /// \param size  The number of bytes of address space to be reserved.
+        explicit address_reservation (std::uint64_t size);
+        // No copying or assignment.
+        address_reservation (address_reservation const &) = delete;
+        address_reservation (address_reservation &&) noexcept = delete;
+        ~address_reservation () noexcept;
+
+        address_reservation & operator= (address_reservation const &) = delete;
+        address_reservation & operator= (address_reservation &&) noexcept = delete;
+
+        /// Returns true if the address range was successfully reserved.
+        bool valid () const noexcept { return base_ != nullptr; }
+        /// Returns the first address of the reserved range or nullptr if it is not valid.
+        void * base () const noexcept { return base_; }
+        /// Returns the number of bytes in the reserved range.
+        std::uint64_t size () const noexcept { return size_; }
+
+        /// Claims the range [offset, offset + length) of the reservation for a new mapping.
+        ///
+        /// \param offset  The offset of the range from the reservation's base address.
+        /// \param length  The number of bytes in the range.
+        /// \returns  The address at which the mapping should be placed or nullptr if the range
+        ///   does not lie within the reservation or overlaps a range which is already in use.
+        void * acquire (std::uint64_t offset, std::uint64_t length);
+
+        /// Returns a range previously claimed by acquire() to the reservation. Any mapping in the
+        /// range is replaced by inaccessible memory so that the addresses remain reserved.
+        void release (std::uint64_t offset, std::uint64_t length) noexcept;
+
+    private:
+        /// Reserves 'size' bytes of address space. Returns nullptr on failure.
+        static void * reserve (std::uint64_t size) noexcept;
+        /// Releases the address space given by [addr, addr + size) to the operating system.
+        static void unreserve (void * addr, std::uint64_t size) noexcept;
+        /// Replaces the contents of [addr, addr + size) with reserved, inaccessible, memory.
+        static void reset (void * addr, std::uint64_t size) noexcept;
+
+        std::uint64_t const size_;
+        void * const base_;
+
+        std::mutex mut_;
+        /// The (offset, length) pairs of the ranges which are currently in use.
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> in_use_;
+    };
+
     /// memory_mapper provides an operating system independent interface for memory mapping of
     /// files. The underlying constaints imposed by the OS are not affected. They are:
     ///
@@ -166,11 +243,22 @@ namespace pstore {
 
         memory_mapper (file::file_handle & file, bool write_enabled, std::uint64_t offset,
                        std::uint64_t length);
+        /// \param file           The file whose contents are to be mapped into memory.
+        /// \param write_enabled  Should the mapped memory be writeable?
+        /// \param offset         The starting offset within the file for the mapped region.
+        /// \param length         The number of bytes to be mapped.
+        /// \param reservation    A reserved address range within which the region should be
+        ///                       placed (at offset bytes from its base). If null, or if the
+        ///                       range cannot be acquired, the operating system chooses the
+        ///                       address as usual.
+        memory_mapper (file::file_handle & file, bool write_enabled, std::uint64_t offset,
+                       std::uint64_t length, std::shared_ptr<address_reservation> reservation);
         ~memory_mapper () noexcept override;
 
     private:
         static std::shared_ptr<void> mmap (file::file_handle & file, bool write_enabled,
-                                           std::uint64_t offset, std::uint64_t length);
+                                           std::uint64_t offset, std::uint64_t length,
+                                           std::shared_ptr<address_reservation> reservation);
     };
 
 
@@ -181,6 +269,9 @@ namespace pstore {
                 : memory_mapper_base (pointer (file, offset), write_enabled, offset, length) {}
         ~in_memory_mapper () noexcept override;
 
+        /// In-memory "files" have no backing store so there is nothing to flush.
+        void flush (void *, std::size_t) override {}
+
         static std::shared_ptr<std::uint8_t> pointer (pstore::file::in_memory & file,
                                                       std::uint64_t const offset) {
             auto const p = std::static_pointer_cast<std::uint8_t> (file.data ());
@@ -57,6 +57,28 @@ namespace pstore {
                     : name_{name}
                     , contents_{contents}
                     , stat_{s} {}
+            /// Constructs a file entry which carries an entity tag and, optionally, a
+            /// gzip-compressed copy of the file's contents.
+            ///
+            /// \param name  The file's name.
+            /// \param contents  The file's contents.
+            /// \param s  The file's size, modification time, and mode.
+            /// \param etag  A strong entity tag (including its surrounding quotes) which is
+            ///   unique to the file's contents.
+            /// \param gzip_contents  The file's contents compressed with gzip or nullptr if there
+            ///   is no compressed copy.
+            /// \param gzip_size  The number of bytes at \p gzip_contents.
+            constexpr dirent (gsl::czstring const PSTORE_NONNULL name,
+                              void const * const PSTORE_NONNULL contents, stat const s,
+                              gsl::czstring const PSTORE_NULLABLE etag,
+                              void const * const PSTORE_NULLABLE gzip_contents,
+                              std::size_t const gzip_size) noexcept
+                    : name_{name}
+                    , contents_{contents}
+                    , stat_{s}
+                    , etag_{etag}
+                    , gzip_contents_{gzip_contents}
+                    , gzip_size_{gzip_size} {}
             constexpr dirent (gsl::czstring const PSTORE_NONNULL name,
                               directory const * const PSTORE_NONNULL dir) noexcept
                     : name_{name}
@@ -68,6 +90,16 @@ namespace pstore {
 
             error_or<class directory const * PSTORE_NONNULL> opendir () const;
 
+            /// Returns the file's entity tag or nullptr if it has none.
+            constexpr gsl::czstring PSTORE_NULLABLE etag () const noexcept { return etag_; }
+            /// Returns the gzip-compressed copy of the file's contents or nullptr if there is
+            /// none.
+            constexpr void const * PSTORE_NULLABLE gzip_contents () const noexcept {
+                return gzip_contents_;
+            }
+            /// Returns the size of the gzip-compressed copy of the file's contents.
+            constexpr std::size_t gzip_size () const noexcept { return gzip_size_; }
+
             constexpr struct stat const & stat () const noexcept { return stat_; }
             constexpr bool is_directory () const noexcept {
                 return stat_.mode == mode_t::directory;
@@ -77,6 +109,9 @@ namespace pstore {
             gsl::czstring PSTORE_NONNULL name_;
             void const * PSTORE_NONNULL contents_;
             struct stat stat_;
+            gsl::czstring PSTORE_NULLABLE etag_ = nullptr;
+            void const * PSTORE_NULLABLE gzip_contents_ = nullptr;
+            std::size_t gzip_size_ = 0;
         };
 
     } // end namespace romfs
@@ -123,6 +123,10 @@ namespace pstore {
             error_or<descriptor> open (gsl::czstring PSTORE_NONNULL path) const;
             error_or<dirent_descriptor> opendir (gsl::czstring PSTORE_NONNULL path);
             error_or<struct stat> stat (gsl::czstring PSTORE_NONNULL path) const;
+            /// Returns the directory entry to which \p path refers. The contents of a file may be
+            /// used directly from the entry without being opened and copied.
+            error_or<dirent const * PSTORE_NONNULL>
+            lookup (gsl::czstring PSTORE_NONNULL path) const;
 
             error_or<std::string> getcwd () const;
             std::error_code chdir (gsl::czstring PSTORE_NONNULL path);
@@ -58,7 +58,8 @@ namespace pstore {
     X (bad_message_part_number)                                                                    \
     X (unable_to_open_named_pipe)                                                                  \
     X (pipe_write_timeout)                                                                         \
-    X (write_failed)
+    X (write_failed)                                                                               \
+    X (store_replaced) /* the store was replaced by vacuum and must be reopened */
 
     // Add more error values here
 
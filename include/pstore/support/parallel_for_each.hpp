@@ -18,71 +18,145 @@
 #define PSTORE_SUPPORT_PARALLEL_FOR_EACH_HPP
 
 #include <algorithm>
-#include <future>
+#include <condition_variable>
+#include <exception>
 #include <iterator>
-#include <vector>
+#include <memory>
+#include <mutex>
 
 #include "pstore/support/assert.hpp"
+#include "pstore/support/portab.hpp"
+#include "pstore/support/thread_pool.hpp"
 
 namespace pstore {
 
-    template <typename InputIt, typename UnaryFunction>
-    void parallel_for_each (InputIt first, InputIt last, UnaryFunction fn) {
-        auto it_distance = std::distance (first, last);
-        if (it_distance <= 0) {
-            return;
+    namespace details {
+
+        /// The state shared by the threads cooperating in a call to parallel_for_each(). Each
+        /// thread repeatedly claims the next chunk of the input range until it is exhausted, so
+        /// threads which are given cheap elements simply claim more chunks.
+        template <typename InputIt>
+        class for_each_state {
+        public:
+            using difference_type = typename std::iterator_traits<InputIt>::difference_type;
+
+            for_each_state (InputIt first, difference_type const size,
+                            difference_type const chunk_size)
+                    : next_{first}
+                    , remaining_{size}
+                    , chunk_size_{chunk_size} {}
+
+            /// Processes chunks of the input range until there are none left.
+            template <typename UnaryFunction>
+            void run (UnaryFunction & fn);
+
+            /// Waits until every chunk that has been claimed has been processed. Any exception
+            /// raised by a worker is rethrown.
+            void wait ();
+
+        private:
+            std::mutex mut_;
+            std::condition_variable cv_;
+            InputIt next_;
+            difference_type remaining_;
+            difference_type const chunk_size_;
+            /// The number of chunks currently being processed.
+            unsigned in_flight_ = 0;
+            std::exception_ptr error_;
+        };
+
+        // run
+        // ~~~
+        template <typename InputIt>
+        template <typename UnaryFunction>
+        void for_each_state<InputIt>::run (UnaryFunction & fn) {
+            using value_type = typename std::iterator_traits<InputIt>::value_type;
+            for (;;) {
+                InputIt first;
+                InputIt last;
+                {
+                    std::lock_guard<std::mutex> const lock{mut_};
+                    if (remaining_ <= 0) {
+                        return;
+                    }
+                    auto const n = std::min (chunk_size_, remaining_);
+                    first = next_;
+                    std::advance (next_, n);
+                    last = next_;
+                    remaining_ -= n;
+                    ++in_flight_;
+                }
+
+                std::exception_ptr error;
+                PSTORE_TRY {
+                    std::for_each (first, last, [&fn] (value_type const & v) { fn (v); });
+                }
+                // clang-format off
+                PSTORE_CATCH (..., { error = std::current_exception (); })
+                // clang-format on
+
+                std::lock_guard<std::mutex> const lock{mut_};
+                if (error) {
+                    // Record the first exception and abandon the rest of the range.
+                    if (!error_) {
+                        error_ = error;
+                    }
+                    remaining_ = 0;
+                }
+                PSTORE_ASSERT (in_flight_ > 0U);
+                if (--in_flight_ == 0U && remaining_ <= 0) {
+                    cv_.notify_all ();
+                }
+            }
         }
 
-        using difference_type = typename std::iterator_traits<InputIt>::difference_type;
-        using udifference_type = typename std::make_unsigned<difference_type>::type;
-        using wide_type =
-            typename std::conditional<sizeof (udifference_type) >= sizeof (unsigned int),
-                                      udifference_type, unsigned int>::type;
-        auto num_elements = static_cast<wide_type> (it_distance);
-
-        auto const num_threads =
-            std::min (static_cast<wide_type> (std::max (std::thread::hardware_concurrency (), 1U)),
-                      num_elements);
-
-        // The number of work items to be processed by each worker thread.
-        auto const partition_size = (num_elements + num_threads - 1) / num_threads;
-        PSTORE_ASSERT (partition_size * num_threads >= num_elements);
-
-        // TODO: use small_vector<>.
-        std::vector<std::future<void>> futures;
-        futures.reserve (num_threads);
-
-        while (first != last) {
-            wide_type const distance = std::min (partition_size, num_elements);
-            auto next = first;
-            PSTORE_ASSERT (distance >= 0 &&
-                           distance < static_cast<udifference_type> (
-                                          std::numeric_limits<difference_type>::max ()));
-
-            std::advance (next, static_cast<difference_type> (distance));
-            using value_type = typename std::iterator_traits<InputIt>::value_type;
+        // wait
+        // ~~~~
+        template <typename InputIt>
+        void for_each_state<InputIt>::wait () {
+            std::unique_lock<std::mutex> lock{mut_};
+            cv_.wait (lock, [this] () { return in_flight_ == 0U && remaining_ <= 0; });
+            if (error_) {
+                std::rethrow_exception (error_);
+            }
+        }
 
-            // Create an asynchronous task which will sequentially process from 'first' to
-            // 'next' invoking f() for each data member.
-            auto per_thread_fn = [&fn] (InputIt fst, InputIt lst) {
-                std::for_each (fst, lst, [&fn] (value_type const & v) { fn (v); });
-            };
-            futures.emplace_back (std::async (std::launch::async, per_thread_fn, first, next));
+    } // end namespace details
 
-            first = next;
-            PSTORE_ASSERT (num_elements >= distance);
-            num_elements -= distance;
+
+    /// Invokes \p fn for every element in the range [first, last) using the threads of the
+    /// global thread pool as well as the calling thread. The range is divided into chunks which
+    /// are claimed dynamically by each of the participating threads. May safely be called from
+    /// within a pool worker.
+    template <typename InputIt, typename UnaryFunction>
+    void parallel_for_each (InputIt first, InputIt last, UnaryFunction fn) {
+        using difference_type = typename std::iterator_traits<InputIt>::difference_type;
+        auto const num_elements = std::distance (first, last);
+        if (num_elements <= 0) {
+            return;
         }
-        PSTORE_ASSERT (num_elements == 0 && futures.size () <= num_threads);
-
-        // Join
-        for (auto & f : futures) {
-            PSTORE_ASSERT (f.valid ());
-            // Note that future::get<> is normally used to retreive the future's result, but
-            // here I'm calling it to ensure that an exception stored in the future's state is
-            // raised.
-            f.get ();
+
+        // Each thread is expected to process several chunks so that a thread which is handed
+        // expensive elements doesn't hold up the others.
+        constexpr auto chunks_per_thread = difference_type{8};
+        thread_pool & pool = thread_pool::global ();
+        auto const num_threads = static_cast<difference_type> (pool.size ()) + 1;
+        auto const chunk_size =
+            std::max (num_elements / (num_threads * chunks_per_thread), difference_type{1});
+        auto const num_chunks = (num_elements + chunk_size - 1) / chunk_size;
+
+        // The state is shared with the pool tasks because a task may not start until after the
+        // calling thread has processed the entire range and returned.
+        using state_type = details::for_each_state<InputIt>;
+        auto const state = std::make_shared<state_type> (first, num_elements, chunk_size);
+        auto const num_helpers = std::min (num_threads - 1, num_chunks - 1);
+        for (auto ctr = difference_type{0}; ctr < num_helpers; ++ctr) {
+            // A helper only touches fn once it has claimed a chunk, which cannot happen once the
+            // calling thread has returned.
+            pool.submit ([state, &fn] () { state->run (fn); });
         }
+        state->run (fn);
+        state->wait ();
     }
 
 } // namespace pstore
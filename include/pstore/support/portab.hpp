@@ -85,6 +85,14 @@ namespace pstore {
 #    define PSTORE_UNLIKELY(expr) (expr)
 #endif
 
+/// A macro which is a wrapper around __builtin_prefetch(). It hints to the processor that the
+/// memory at the given address will shortly be read so that the fetch can overlap other work.
+#if __has_builtin(__builtin_prefetch) || defined(__GNUC__)
+#    define PSTORE_PREFETCH(addr) __builtin_prefetch ((addr))
+#else
+#    define PSTORE_PREFETCH(addr) static_cast<void> (addr)
+#endif
+
 
 // Specifies that the function does not return.
 #if __has_cpp_attribute(noreturn)
@@ -0,0 +1,93 @@
+//===- include/pstore/support/thread_pool.hpp -------------*- mode: C++ -*-===//
+//*  _   _                        _                     _  *
+//* | |_| |__  _ __ ___  __ _  __| |  _ __   ___   ___ | | *
+//* | __| '_ \| '__/ _ \/ _` |/ _` | | '_ \ / _ \ / _ \| | *
+//* | |_| | | | | |  __/ (_| | (_| | | |_) | (_) | (_) | | *
+//*  \__|_| |_|_|  \___|\__,_|\__,_| | .__/ \___/ \___/|_| *
+//*                                  |_|                   *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file thread_pool.hpp
+/// \brief A persistent, work-stealing pool of worker threads.
+
+#ifndef PSTORE_SUPPORT_THREAD_POOL_HPP
+#define PSTORE_SUPPORT_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pstore {
+
+    /// A fixed-size pool of worker threads which execute submitted tasks. Each worker has its own
+    /// queue of tasks. A worker whose queue is empty steals work from the other queues before
+    /// going to sleep, so an uneven distribution of tasks is rebalanced as the workers run.
+    class thread_pool {
+    public:
+        using task = std::function<void ()>;
+
+        /// \param num_threads  The number of worker threads. Must be greater than 0.
+        explicit thread_pool (unsigned num_threads);
+        thread_pool (thread_pool const &) = delete;
+        thread_pool (thread_pool &&) = delete;
+        /// Runs any tasks which are still queued and then joins the worker threads.
+        ~thread_pool () noexcept;
+
+        thread_pool & operator= (thread_pool const &) = delete;
+        thread_pool & operator= (thread_pool &&) = delete;
+
+        /// Returns a process-wide pool with one worker per hardware thread. The pool is created
+        /// on first use.
+        static thread_pool & global ();
+
+        /// Returns the number of worker threads.
+        unsigned size () const noexcept { return static_cast<unsigned> (queues_.size ()); }
+
+        /// Queues a task for execution by one of the pool's workers. If called from one of
+        /// this pool's worker threads, the task is added to that worker's own queue; otherwise,
+        /// tasks are distributed between the queues in turn.
+        ///
+        /// \param t  The task to be run. It must not throw.
+        void submit (task t);
+
+    private:
+        struct queue {
+            std::mutex mut;
+            std::deque<task> tasks;
+        };
+
+        /// The body of the worker thread with index \p index.
+        void worker (unsigned index);
+        /// Removes a task from the back of queue \p index or, failing that, from the front of one
+        /// of the other queues.
+        bool pop (unsigned index, task & t);
+
+        std::vector<std::unique_ptr<queue>> queues_;
+        /// The index of the queue to which the next task submitted by a thread outside the pool
+        /// will be added.
+        unsigned next_ = 0;
+
+        std::mutex wake_mut_;
+        std::condition_variable wake_cv_;
+        /// The number of tasks that have been queued but not yet started. Guarded by wake_mut_.
+        std::size_t pending_ = 0;
+        /// Set when the pool is being destroyed. Guarded by wake_mut_.
+        bool done_ = false;
+
+        std::vector<std::thread> threads_;
+    };
+
+} // end namespace pstore
+
+#endif // PSTORE_SUPPORT_THREAD_POOL_HPP
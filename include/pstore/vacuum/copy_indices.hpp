@@ -0,0 +1,133 @@
+//===- include/pstore/vacuum/copy_indices.hpp -------------*- mode: C++ -*-===//
+//*                            _           _ _                *
+//*   ___ ___  _ __  _   _    (_)_ __   __| (_) ___ ___  ___  *
+//*  / __/ _ \| '_ \| | | |   | | '_ \ / _` | |/ __/ _ \/ __| *
+//* | (_| (_) | |_) | |_| |   | | | | | (_| | | (_|  __/\__ \ *
+//*  \___\___/| .__/ \__, |   |_|_| |_|\__,_|_|\___\___||___/ *
+//*           |_|    |___/                                    *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file copy_indices.hpp
+/// \brief Copies the live contents of a store's indices to a new store.
+
+#ifndef PSTORE_VACUUM_COPY_INDICES_HPP
+#define PSTORE_VACUUM_COPY_INDICES_HPP
+
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+#include "pstore/core/address.hpp"
+#include "pstore/core/index_types.hpp"
+#include "pstore/support/head_revision.hpp"
+
+namespace pstore {
+    class database;
+    class transaction_base;
+    namespace repo {
+        class compilation;
+        class fragment;
+    } // end namespace repo
+} // end namespace pstore
+
+namespace vacuum {
+    struct status;
+
+    namespace details {
+
+        /// A reference to a compilation definition from a fragment's linked-definitions section.
+        /// The compilation's new address may not be known until after the fragments have been
+        /// copied, so the pointer is patched once all of the compilations have been written.
+        struct definition_link {
+            /// The address of the destination's linked_definitions::value_type::pointer field.
+            pstore::address where;
+            pstore::index::digest compilation;
+            std::uint32_t index;
+        };
+
+    } // end namespace details
+
+    /// Copies the records referenced by the indices of a source store to a destination store.
+    ///
+    /// Strings, debug line headers, fragments, and compilations are written afresh and any
+    /// address in them which refers to another record is rewritten to point at that record's new
+    /// location. The copier remembers where each record was written so that the records that
+    /// are added to the source after an initial copy can be carried across by later calls to
+    /// copy_since().
+    class index_copier {
+    public:
+        explicit index_copier (pstore::database const & source);
+        index_copier (index_copier const &) = delete;
+        index_copier & operator= (index_copier const &) = delete;
+
+        /// Copies every record in the current revision of the source to the store to which
+        /// \p transaction belongs. The indices of the destination store must be empty. Each of
+        /// them is built in a single bulk operation.
+        ///
+        /// \param transaction  An open transaction on the destination store.
+        /// \param abandon  If not null, the copy is abandoned as soon as *abandon is true.
+        /// \returns True if the copy was completed, false if it was abandoned. The caller should
+        ///   roll back \p transaction in the latter case.
+        bool copy (pstore::transaction_base & transaction,
+                   std::atomic<bool> const * abandon = nullptr);
+
+        /// Copies the records that were added to the source's indices after revision \p since
+        /// and up to its current revision. The records in revision \p since must already have
+        /// been copied to the destination by this object.
+        ///
+        /// \param transaction  An open transaction on the destination store.
+        /// \param since  The source revision that was most recently copied.
+        void copy_since (pstore::transaction_base & transaction, pstore::revision_number since);
+
+    private:
+        template <typename T>
+        using digest_map = std::unordered_map<pstore::index::digest, pstore::extent<T>>;
+
+        bool copy_impl (pstore::transaction_base & transaction, pstore::revision_number since,
+                        std::atomic<bool> const * abandon);
+
+        template <pstore::trailer::indices Index>
+        bool copy_strings (pstore::transaction_base & transaction, pstore::revision_number since,
+                           std::atomic<bool> const * abandon);
+        template <pstore::trailer::indices Index>
+        bool copy_blobs (pstore::transaction_base & transaction, pstore::revision_number since,
+                         std::atomic<bool> const * abandon);
+        bool copy_fragments (pstore::transaction_base & transaction,
+                             pstore::revision_number since, std::atomic<bool> const * abandon);
+        bool copy_compilations (pstore::transaction_base & transaction,
+                                pstore::revision_number since, std::atomic<bool> const * abandon);
+
+        pstore::database const & source_;
+
+        /// Maps from the address of a string in the source store to its address in the
+        /// destination.
+        std::unordered_map<pstore::address, pstore::typed_address<pstore::indirect_string>>
+            strings_;
+        /// The new locations of the debug line headers, fragments, and compilations.
+        digest_map<std::uint8_t> headers_;
+        digest_map<pstore::repo::fragment> fragments_;
+        digest_map<pstore::repo::compilation> compilations_;
+        /// The linked-definitions pointers waiting to be patched.
+        std::vector<details::definition_link> links_;
+    };
+
+    /// Copies every record referenced by the indices of the current revision of \p source to the
+    /// store to which \p transaction belongs.
+    ///
+    /// \param source  The store from which data is to be copied.
+    /// \param transaction  An open transaction on the destination store.
+    /// \param st  The vacuum status. The copy is abandoned if st.modified becomes true.
+    /// \returns True if the copy was completed, false if it was abandoned. The caller should roll
+    ///   back \p transaction in the latter case.
+    bool copy_indices (pstore::database const & source, pstore::transaction_base & transaction,
+                       status const & st);
+
+} // end namespace vacuum
+
+#endif // PSTORE_VACUUM_COPY_INDICES_HPP
@@ -22,6 +22,9 @@
 namespace vacuum {
     struct user_options {
         bool daemon_mode;
+        /// If true, the store is copied while other processes continue to write to it. Writers
+        /// are locked out only while the last few revisions are copied.
+        bool incremental = false;
         std::string src_path;
     };
 } // namespace vacuum
@@ -0,0 +1,483 @@
+//===- lib/core/bloom_filter.cpp ------------------------------------------===//
+//*  _     _                          __ _ _ _             *
+//* | |__ | | ___   ___  _ __ ___    / _(_) | |_ ___ _ __  *
+//* | '_ \| |/ _ \ / _ \| '_ ` _ \  | |_| | | __/ _ \ '__| *
+//* | |_) | | (_) | (_) | | | | | | |  _| | | ||  __/ |    *
+//* |_.__/|_|\___/ \___/|_| |_| |_| |_| |_|_|\__\___|_|    *
+//*                                                        *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file bloom_filter.cpp
+/// \brief A persistent approximate-membership filter for the keys of an index.
+
+#include "pstore/core/bloom_filter.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "pstore/config/config.hpp"
+#include "pstore/core/transaction.hpp"
+
+namespace {
+
+    /// The finalizer of the SplitMix64 generator: a cheap and thorough 64-bit mix.
+    constexpr std::uint64_t mix (std::uint64_t x) noexcept {
+        x = (x ^ (x >> 30U)) * UINT64_C (0xBF58476D1CE4E5B9);
+        x = (x ^ (x >> 27U)) * UINT64_C (0x94D049BB133111EB);
+        return x ^ (x >> 31U);
+    }
+
+    constexpr bool is_power_of_two (std::uint64_t const x) noexcept {
+        return x != 0U && (x & (x - 1U)) == 0U;
+    }
+
+    /// The largest segment level accepted from the store. Each segment has room for twice as
+    /// many keys as all of those before it so real filters never come close.
+    constexpr std::uint64_t max_level = 64U;
+
+} // end anonymous namespace
+
+namespace pstore {
+    namespace index {
+
+        constexpr unsigned bloom_filter::bits_per_key;
+        constexpr unsigned bloom_filter::probes;
+        constexpr unsigned bloom_filter::max_deltas;
+        constexpr unsigned bloom_filter::block_bits;
+
+        std::array<std::uint8_t, 8> const bloom_filter::signature_ = {
+            {'I', 'n', 'd', 'x', 'B', 'l', 'o', 'm'}};
+        std::array<std::uint8_t, 8> const bloom_filter::delta_signature_ = {
+            {'I', 'n', 'd', 'x', 'B', 'l', 'm', 'D'}};
+
+        //*     _                  _  *
+        //*  __| |_ ___ _ _ ___ __| | *
+        //* (_-<  _/ _ \ '_/ -_) _` | *
+        //* /__/\__\___/_| \___\__,_| *
+        //*                           *
+        // (ctor)
+        // ~~~~~~
+        bloom_filter::stored::stored (database const & db, address const addr)
+                : addr_{addr} {
+            // True while following the deltas of a segment back to the record of the whole
+            // segment.
+            bool in_segment = false;
+            for (address record = addr; record != address::null ();) {
+                std::shared_ptr<header const> const h =
+                    db.getro (typed_address<header>::make (record));
+                bool const delta = h->signature == delta_signature_;
+#if PSTORE_SIGNATURE_CHECKS_ENABLED
+                if (!delta && h->signature != signature_) {
+                    raise (error_code::index_corrupt, db.path ());
+                }
+#endif
+                // Records only refer to those written before them.
+                if (!is_power_of_two (h->num_blocks) || h->level > max_level ||
+                    h->segment_size == 0U || !(h->previous < record) ||
+                    (delta && (h->num_changed == 0U || h->num_changed > h->num_blocks))) {
+                    raise (error_code::index_corrupt, db.path ());
+                }
+                auto const level = static_cast<unsigned> (h->level);
+                if (record == addr) {
+                    size_ = h->size;
+                }
+                if (!in_segment) {
+                    segments_.push_back (segment{h->num_blocks, level, h->segment_size, {}});
+                } else if (h->num_blocks != segments_.back ().num_blocks ||
+                           level != segments_.back ().level) {
+                    raise (error_code::index_corrupt, db.path ());
+                }
+                segments_.back ().layers.push_back (
+                    layer{record, delta ? h->num_changed : h->num_blocks, delta});
+                in_segment = delta;
+                record = h->previous;
+            }
+            if (in_segment) {
+                // A delta must lead back to the whole segment.
+                raise (error_code::index_corrupt, db.path ());
+            }
+        }
+
+        // may_contain
+        // ~~~~~~~~~~~
+        bool bloom_filter::stored::may_contain (database::read_view & view, std::uint64_t const h1,
+                                                std::uint64_t const h2) const {
+            PSTORE_ASSERT (addr_ != address::null ());
+            auto const hash = key_hash (h1, h2);
+            block const bits = key_bits (hash);
+            for (segment const & seg : segments_) {
+                if (contains_bits (segment_block (view, seg, hash & (seg.num_blocks - 1U)),
+                                   bits)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // segment_block
+        // ~~~~~~~~~~~~~
+        auto bloom_filter::stored::segment_block (database::read_view & view, segment const & seg,
+                                                  std::uint64_t const index) -> block {
+            block result{{0}};
+            for (layer const & l : seg.layers) {
+                auto const blocks = l.record + sizeof (header);
+                if (!l.delta) {
+                    merge_bits (result, *view.get (typed_address<block>::make (
+                                            blocks + index * sizeof (block))));
+                    continue;
+                }
+                std::uint64_t const * const indices = view.get (
+                    typed_address<std::uint64_t>::make (blocks + l.count * sizeof (block)),
+                    l.count);
+                std::uint64_t const * const end = indices + l.count;
+                std::uint64_t const * const pos = std::lower_bound (indices, end, index);
+                if (pos != end && *pos == index) {
+                    auto const offset = static_cast<std::uint64_t> (pos - indices);
+                    merge_bits (result, *view.get (typed_address<block>::make (
+                                            blocks + offset * sizeof (block))));
+                }
+            }
+            return result;
+        }
+
+
+        //*  _    _                   __ _ _ _            *
+        //* | |__| |___  ___ _ __    / _(_) | |_ ___ _ _  *
+        //* | '_ \ / _ \/ _ \ '  \  |  _| | |  _/ -_) '_| *
+        //* |_.__/_\___/\___/_|_|_| |_| |_|_|\__\___|_|   *
+        //*                                               *
+        // (ctor)
+        // ~~~~~~
+        bloom_filter::bloom_filter (std::uint64_t const capacity) {
+            segments_.push_back (
+                segment{0U, 0U, std::vector<block> (num_blocks (capacity, 0U), block{{0}})});
+        }
+
+        bloom_filter::bloom_filter (stored const & s)
+                : stored_{s}
+                , size_{s.size_} {}
+
+        // capacity
+        // ~~~~~~~~
+        std::uint64_t bloom_filter::capacity () const noexcept {
+            auto result = std::uint64_t{0};
+            for (stored::segment const & seg : stored_.segments_) {
+                result += segment_capacity (seg.num_blocks, seg.level);
+            }
+            for (segment const & seg : segments_) {
+                result += segment_capacity (seg.blocks.size (), seg.level);
+            }
+            return result;
+        }
+
+        // insert
+        // ~~~~~~
+        void bloom_filter::insert (std::uint64_t const h1, std::uint64_t const h2) {
+            auto const hash = key_hash (h1, h2);
+            block const bits = key_bits (hash);
+            if (segments_.empty () && !stored_.segments_.empty ()) {
+                stored::segment const & seg = stored_.segments_.front ();
+                if (seg.size + changed_keys_ < segment_capacity (seg.num_blocks, seg.level)) {
+                    // Record just the bits that the key adds to the newest stored segment.
+                    merge_bits (changes_[hash & (seg.num_blocks - 1U)], bits);
+                    ++changed_keys_;
+                    ++size_;
+                    return;
+                }
+            }
+            if (segments_.empty () ||
+                segments_.back ().size >=
+                    segment_capacity (segments_.back ().blocks.size (), segments_.back ().level)) {
+                this->add_segment ();
+            }
+            segment & seg = segments_.back ();
+            merge_bits (seg.blocks[hash & (seg.blocks.size () - 1U)], bits);
+            ++seg.size;
+            ++size_;
+        }
+
+        // add_segment
+        // ~~~~~~~~~~~
+        void bloom_filter::add_segment () {
+            auto level = 0U;
+            if (!segments_.empty ()) {
+                level = segments_.back ().level + 1U;
+            } else if (!stored_.segments_.empty ()) {
+                level = stored_.segments_.front ().level + 1U;
+            }
+            // Leave room for the filter to double in size before another segment is needed.
+            segments_.push_back (segment{
+                level, 0U, std::vector<block> (num_blocks (size_ * 2U, level), block{{0}})});
+        }
+
+        // may_contain
+        // ~~~~~~~~~~~
+        bool bloom_filter::may_contain (database::read_view & view, std::uint64_t const h1,
+                                        std::uint64_t const h2) const {
+            auto const hash = key_hash (h1, h2);
+            block const bits = key_bits (hash);
+            for (segment const & seg : segments_) {
+                if (contains_bits (seg.blocks[hash & (seg.blocks.size () - 1U)], bits)) {
+                    return true;
+                }
+            }
+            for (stored::segment const & seg : stored_.segments_) {
+                auto const index = hash & (seg.num_blocks - 1U);
+                block b = stored::segment_block (view, seg, index);
+                if (&seg == &stored_.segments_.front ()) {
+                    auto const pos = changes_.find (index);
+                    if (pos != changes_.end ()) {
+                        merge_bits (b, pos->second);
+                    }
+                }
+                if (contains_bits (b, bits)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // flush
+        // ~~~~~
+        address bloom_filter::flush (transaction_base & transaction) const {
+            address previous = stored_.addr_;
+            auto size = stored_.size_;
+            if (!changes_.empty ()) {
+                previous = this->flush_changes (transaction);
+                size += changed_keys_;
+            }
+            for (segment const & seg : segments_) {
+                size += seg.size;
+                previous = write_record (transaction,
+                                         header{signature_, seg.blocks.size (), size, previous,
+                                                seg.size, seg.level, 0U, 0U},
+                                         seg.blocks.data (), nullptr);
+            }
+            return previous;
+        }
+
+        // flush_changes
+        // ~~~~~~~~~~~~~
+        address bloom_filter::flush_changes (transaction_base & transaction) const {
+            PSTORE_ASSERT (!changes_.empty ());
+            stored::segment const & seg = stored_.segments_.front ();
+            header h{signature_, seg.num_blocks, stored_.size_ + changed_keys_, stored_.addr_,
+                     seg.size + changed_keys_, seg.level, 0U, 0U};
+            database const & db = transaction.db ();
+            database::read_view view{db};
+            // Calls f(index, bits) for each block held by the deltas of the segment.
+            auto const for_each_delta_block = [&] (auto const & f) {
+                for (stored::layer const & l : seg.layers) {
+                    if (!l.delta) {
+                        continue;
+                    }
+                    auto const blocks_addr = l.record + sizeof (header);
+                    block const * const blocks =
+                        view.get (typed_address<block>::make (blocks_addr), l.count);
+                    std::uint64_t const * const indices =
+                        view.get (typed_address<std::uint64_t>::make (
+                                      blocks_addr + l.count * sizeof (block)),
+                                  l.count);
+                    for (auto ctr = std::uint64_t{0}; ctr < l.count; ++ctr) {
+                        if (indices[ctr] >= seg.num_blocks) {
+                            raise (error_code::index_corrupt, db.path ());
+                        }
+                        f (indices[ctr], blocks[ctr]);
+                    }
+                }
+            };
+
+            switch (this->extension_kind ()) {
+            case extension::delta:
+                h.signature = delta_signature_;
+                return write_delta (transaction, h, changes_);
+
+            case extension::merged_delta: {
+                // Replace the segment's deltas with one which refers to the whole segment.
+                std::map<std::uint64_t, block> merged = changes_;
+                for_each_delta_block ([&merged] (std::uint64_t const index, block const & b) {
+                    merge_bits (merged[index], b);
+                });
+                h.signature = delta_signature_;
+                h.previous = seg.layers.back ().record;
+                return write_delta (transaction, h, merged);
+            }
+
+            case extension::whole: {
+                block const * const base = view.get (
+                    typed_address<block>::make (seg.layers.back ().record + sizeof (header)),
+                    seg.num_blocks);
+                std::vector<block> blocks (base, base + seg.num_blocks);
+                for_each_delta_block ([&blocks] (std::uint64_t const index, block const & b) {
+                    merge_bits (blocks[index], b);
+                });
+                for (auto const & c : changes_) {
+                    merge_bits (blocks[c.first], c.second);
+                }
+                h.previous = stored_.segments_.size () > 1U
+                                 ? stored_.segments_[1].layers.front ().record
+                                 : address::null ();
+                return write_record (transaction, h, blocks.data (), nullptr);
+            }
+            }
+            PSTORE_ASSERT (false);
+            return address::null ();
+        }
+
+        // flush_size
+        // ~~~~~~~~~~
+        std::uint64_t bloom_filter::flush_size () const noexcept {
+            auto result = std::uint64_t{0};
+            if (!changes_.empty ()) {
+                switch (this->extension_kind ()) {
+                case extension::delta: result += record_size (changes_.size (), true); break;
+                case extension::merged_delta:
+                    result += record_size (this->merged_delta_blocks (), true);
+                    break;
+                case extension::whole:
+                    result += record_size (stored_.segments_.front ().num_blocks, false);
+                    break;
+                }
+            }
+            for (segment const & seg : segments_) {
+                result += record_size (seg.blocks.size (), false);
+            }
+            return result;
+        }
+
+        // merged_delta_blocks
+        // ~~~~~~~~~~~~~~~~~~~
+        std::uint64_t bloom_filter::merged_delta_blocks () const noexcept {
+            auto result = std::uint64_t{changes_.size ()};
+            for (stored::layer const & l : stored_.segments_.front ().layers) {
+                if (l.delta) {
+                    result += l.count;
+                }
+            }
+            return result;
+        }
+
+        // extension_kind
+        // ~~~~~~~~~~~~~~
+        auto bloom_filter::extension_kind () const noexcept -> extension {
+            PSTORE_ASSERT (!changes_.empty ());
+            stored::segment const & seg = stored_.segments_.front ();
+            // A segment which will take no more keys is written whole so that lookups read a
+            // single record of it.
+            if (!segments_.empty () || this->merged_delta_blocks () * 2U >= seg.num_blocks) {
+                return extension::whole;
+            }
+            // The last layer holds the whole segment; the rest are deltas.
+            return seg.layers.size () > max_deltas ? extension::merged_delta : extension::delta;
+        }
+
+        // write_record
+        // ~~~~~~~~~~~~
+        address bloom_filter::write_record (transaction_base & transaction, header const & h,
+                                            block const * const blocks,
+                                            std::uint64_t const * const indices) {
+            static_assert (sizeof (header) == sizeof (block), "The header must occupy one block");
+            auto const count = indices != nullptr ? h.num_changed : h.num_blocks;
+            auto const blocks_size = count * sizeof (block);
+            auto const indices_size = indices != nullptr ? count * sizeof (std::uint64_t) : 0U;
+            std::shared_ptr<void> ptr;
+            address addr;
+            // Align the record so that each block occupies a single cache line.
+            std::tie (ptr, addr) = transaction.alloc_rw (
+                sizeof (header) + blocks_size + indices_size, unsigned{sizeof (block)});
+
+            auto * const out = static_cast<std::uint8_t *> (ptr.get ());
+            std::memcpy (out, &h, sizeof (header));
+            std::memcpy (out + sizeof (header), blocks, blocks_size);
+            if (indices != nullptr) {
+                std::memcpy (out + sizeof (header) + blocks_size, indices, indices_size);
+            }
+            return addr;
+        }
+
+        // write_delta
+        // ~~~~~~~~~~~
+        address bloom_filter::write_delta (transaction_base & transaction, header h,
+                                           std::map<std::uint64_t, block> const & changes) {
+            std::vector<block> blocks;
+            std::vector<std::uint64_t> indices;
+            blocks.reserve (changes.size ());
+            indices.reserve (changes.size ());
+            // The map yields the indices in the ascending order in which they are stored.
+            for (auto const & c : changes) {
+                indices.push_back (c.first);
+                blocks.push_back (c.second);
+            }
+            h.num_changed = changes.size ();
+            return write_record (transaction, h, blocks.data (), indices.data ());
+        }
+
+        // num_blocks
+        // ~~~~~~~~~~
+        std::uint64_t bloom_filter::num_blocks (std::uint64_t const capacity,
+                                                unsigned const level) noexcept {
+            auto const bits = std::max (capacity, std::uint64_t{1}) * level_bits_per_key (level);
+            auto result = std::uint64_t{1};
+            while (result * block_bits < bits) {
+                result *= 2U;
+            }
+            return result;
+        }
+
+        // segment_capacity
+        // ~~~~~~~~~~~~~~~~
+        std::uint64_t bloom_filter::segment_capacity (std::uint64_t const num_blocks,
+                                                      unsigned const level) noexcept {
+            return num_blocks * block_bits / level_bits_per_key (level);
+        }
+
+        // key_hash
+        // ~~~~~~~~
+        std::uint64_t bloom_filter::key_hash (std::uint64_t const h1,
+                                              std::uint64_t const h2) noexcept {
+            return mix (h1 ^ mix (h2));
+        }
+
+        // key_bits
+        // ~~~~~~~~
+        auto bloom_filter::key_bits (std::uint64_t const hash) noexcept -> block {
+            static_assert (block_bits == 512U, "Each probe takes 9 bits of the hash");
+            static_assert (probes * 9U <= 64U, "There are not enough hash bits for the probes");
+            // The low bits of the hash select the block so the probes use a fresh mix of it.
+            auto bits = mix (hash + UINT64_C (0x9E3779B97F4A7C15));
+            block result{{0}};
+            for (auto ctr = 0U; ctr < probes; ++ctr) {
+                auto const bit = bits & (block_bits - 1U);
+                result[bit / 64U] |= std::uint64_t{1} << (bit % 64U);
+                bits >>= 9U;
+            }
+            return result;
+        }
+
+        // contains_bits
+        // ~~~~~~~~~~~~~
+        bool bloom_filter::contains_bits (block const & b, block const & bits) noexcept {
+            for (auto ctr = std::size_t{0}; ctr < b.size (); ++ctr) {
+                if ((b[ctr] & bits[ctr]) != bits[ctr]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // merge_bits
+        // ~~~~~~~~~~
+        void bloom_filter::merge_bits (block & b, block const & bits) noexcept {
+            for (auto ctr = std::size_t{0}; ctr < b.size (); ++ctr) {
+                b[ctr] |= bits[ctr];
+            }
+        }
+
+    } // end namespace index
+} // end namespace pstore
@@ -21,6 +21,7 @@
 #include "pstore/os/path.hpp"
 
 #include "base32.hpp"
+#include "group_commit.hpp"
 #include "heartbeat.hpp"
 
 namespace {
@@ -138,10 +139,39 @@ namespace pstore {
     // ~~~~~~~~~~~~~~~~~
     void database::clear_index_cache () {
         for (std::shared_ptr<index::index_base> & index : indices_) {
-            index.reset ();
+            std::atomic_store (&index, std::shared_ptr<index::index_base>{});
         }
     }
 
+    // loaded_index
+    // ~~~~~~~~~~~~
+    std::shared_ptr<index::index_base>
+    database::loaded_index (trailer::indices const which) const {
+        return std::atomic_load (
+            &indices_[static_cast<std::underlying_type<decltype (which)>::type> (which)]);
+    }
+
+    // publish_index
+    // ~~~~~~~~~~~~~
+    std::shared_ptr<index::index_base>
+    database::publish_index (trailer::indices const which,
+                             std::shared_ptr<index::index_base> index,
+                             typed_address<trailer> const footer) const {
+        std::shared_ptr<index::index_base> & slot =
+            indices_[static_cast<std::underlying_type<decltype (which)>::type> (which)];
+        std::lock_guard<std::mutex> const lock{indices_mutex_};
+        if (footer != size_.footer_pos ()) {
+            // The database was synced whilst the index was being loaded. The caller may use the
+            // index, which shows the earlier revision, but it must not be kept.
+            return index;
+        }
+        if (std::shared_ptr<index::index_base> existing = std::atomic_load (&slot)) {
+            return existing;
+        }
+        std::atomic_store (&slot, index);
+        return index;
+    }
+
     // older_revision_footer_pos
     // ~~~~~~~~~~~~~~~~~~~~~~~~~
     typed_address<trailer> database::older_revision_footer_pos (unsigned const revision) const {
@@ -149,8 +179,13 @@ namespace pstore {
             raise (pstore::error_code::unknown_revision);
         }
 
-        // Walk backwards down the linked list of revisions to find it.
-        typed_address<trailer> footer_pos = size_.footer_pos ();
+        return this->older_revision_footer_pos (size_.footer_pos (), revision);
+    }
+
+    typed_address<trailer> database::older_revision_footer_pos (typed_address<trailer> footer_pos,
+                                                                unsigned const revision) const {
+        // Walk backwards down the linked list of revisions to find it. Where a trailer's skip
+        // pointer moves us closer to the target revision without overshooting it, we take it.
         for (;;) {
             auto const tail = this->getro (footer_pos);
             unsigned int const tail_revision = tail->a.generation;
@@ -161,11 +196,31 @@ namespace pstore {
                 break;
             }
 
-            // TODO: check that footer_pos and generation number are be getting smaller; time must
-            // not be getting larger.
+            // TODO: check that time is not getting larger.
             // TODO: prev_generation should probably be atomic
-            footer_pos = tail->a.prev_generation;
+            typed_address<trailer> const skip_pos = tail->a.skip_generation;
+            unsigned const skip_revision = trailer::skip_target (tail_revision);
+            unsigned const prev_skip_revision = trailer::skip_target (tail_revision - 1U);
+            // Prefer the previous trailer's skip if it's at least two generations better than
+            // ours and doesn't overshoot: the next step will then take it.
+            bool const take_skip =
+                skip_pos != typed_address<trailer>::null () &&
+                (skip_revision == revision ||
+                 (skip_revision > revision &&
+                  !(prev_skip_revision + 2U < skip_revision && prev_skip_revision >= revision)));
+
+            unsigned expected_revision = tail_revision - 1U;
+            if (take_skip) {
+                footer_pos = skip_pos;
+                expected_revision = skip_revision;
+            } else {
+                footer_pos = tail->a.prev_generation;
+            }
             trailer::validate (*this, footer_pos);
+            if (footer_pos == typed_address<trailer>::null () ||
+                this->getro (footer_pos)->a.generation != expected_revision) {
+                raise (error_code::footer_corrupt, this->path ());
+            }
         }
 
         return footer_pos;
@@ -174,6 +229,8 @@ namespace pstore {
     // sync
     // ~~~~
     void database::sync (unsigned const revision) {
+        std::lock_guard<std::mutex> const sync_lock{sync_mutex_};
+
         // If revision <= current revision then we don't need to start at head! We do so if the
         // revision is later than the current region (that's what is_newer is about with footer_pos
         // tracking the current footer as it moves backwards).
@@ -239,6 +296,7 @@ namespace pstore {
         }
 
         // We must clear the index cache because the current revision has changed.
+        std::lock_guard<std::mutex> const indices_lock{indices_mutex_};
         this->clear_index_cache ();
         size_.update_footer_pos (footer_pos);
     }
@@ -374,10 +432,10 @@ namespace pstore {
         return std::static_pointer_cast<void const> (result);
     }
 
-    // get
-    // ~~~
-    auto database::get (address const addr, std::size_t const size, bool const initialized,
-                        bool const writable) const -> std::shared_ptr<void const> {
+    // check_get
+    // ~~~~~~~~~
+    void database::check_get (address const addr, std::size_t const size,
+                              bool const writable) const {
         if (closed_) {
             raise (pstore::error_code::store_closed);
         }
@@ -391,13 +449,31 @@ namespace pstore {
         if (start > logical_size || size > logical_size - start) {
             raise (error_code::bad_address);
         }
+    }
 
+    // get
+    // ~~~
+    auto database::get (address const addr, std::size_t const size, bool const initialized,
+                        bool const writable) const -> std::shared_ptr<void const> {
+        this->check_get (addr, size, writable);
         if (storage_.request_spans_regions (addr, size)) {
             return this->get_spanning (addr, size, initialized, writable);
         }
         return storage_.address_to_pointer (addr);
     }
 
+    // read_view::get
+    // ~~~~~~~~~~~~~~
+    void const * database::read_view::get (address const addr, std::size_t const size) {
+        db_.check_get (addr, size, false /*writable*/);
+        if (!db_.storage_.request_spans_regions (addr, size)) {
+            return db_.storage_.address_to_raw_pointer (addr);
+        }
+        spanning_.push_back (
+            db_.get_spanning (addr, size, true /*initialized*/, false /*writable*/));
+        return spanning_.back ().get ();
+    }
+
     // allocate
     // ~~~~~~~~
     pstore::address database::allocate (std::uint64_t const bytes, unsigned const align) {
@@ -447,11 +523,49 @@ namespace pstore {
         }
     }
 
+    // set_durability
+    // ~~~~~~~~~~~~~~
+    void database::set_durability (durability const mode) {
+        if (mode == durability::group && group_commit_ == nullptr) {
+            group_commit_ = group_commit::get (this->get_sync_name ());
+        }
+        durability_ = mode;
+    }
+
+    // flush
+    // ~~~~~
+    void database::flush (address const first, address const last) {
+        if (durability_ != durability::none) {
+            storage_.flush (first, last);
+        }
+    }
+
+    // flush_header
+    // ~~~~~~~~~~~~
+    void database::flush_header () {
+        if (durability_ != durability::group) {
+            this->flush (address::null (), address{sizeof (header)});
+            return;
+        }
+        PSTORE_ASSERT (group_commit_ != nullptr);
+        group_commit_->flush (address::null (), address{sizeof (header)},
+                              [this] (address const first, address const last) {
+                                  this->flush (first, last);
+                              });
+    }
+
     // set_new_footer
     // ~~~~~~~~~~~~~~
     void database::set_new_footer (typed_address<trailer> const new_footer_pos) {
         size_.update_footer_pos (new_footer_pos);
 
+        // A store created by an earlier minor version may now contain records which that version
+        // cannot read so record the current version number before publishing the new footer.
+        if (header_->a.version[1] != header::minor_version) {
+            header_->a.version[1] = header::minor_version;
+            header_->crc = header_->get_crc ();
+        }
+
         // Finally (this should be the last thing we do), point the file header at the new
         // footer. Any other threads/processes will now see our new transaction as the state
         // of the database.
@@ -36,6 +36,7 @@ namespace pstore {
     //*                              *
     std::uint16_t const header::major_version;
     std::uint16_t const header::minor_version;
+    std::uint16_t const header::min_minor_version;
     std::array<std::uint8_t, 4> const header::file_signature1{{'p', 'S', 't', 'r'}};
     std::uint32_t const header::file_signature2;
 
@@ -0,0 +1,91 @@
+//===- lib/core/group_commit.cpp ------------------------------------------===//
+//*                                                             _ _    *
+//*   __ _ _ __ ___  _   _ _ __     ___ ___  _ __ ___  _ __ ___ (_) |_  *
+//*  / _` | '__/ _ \| | | | '_ \   / __/ _ \| '_ ` _ \| '_ ` _ \| | __| *
+//* | (_| | | | (_) | |_| | |_) | | (_| (_) | | | | | | | | | | | | |_  *
+//*  \__, |_|  \___/ \__,_| .__/   \___\___/|_| |_| |_|_| |_| |_|_|\__| *
+//*  |___/                |_|                                           *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file group_commit.cpp
+/// \brief Batches the disk flushes requested by concurrent committers.
+
+#include "group_commit.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "pstore/support/assert.hpp"
+#include "pstore/support/portab.hpp"
+
+namespace pstore {
+
+    // get [static]
+    // ~~~
+    std::shared_ptr<group_commit> group_commit::get (std::string const & name) {
+        static std::mutex mut;
+        static std::unordered_map<std::string, std::weak_ptr<group_commit>> instances;
+
+        std::lock_guard<std::mutex> const lock{mut};
+        std::weak_ptr<group_commit> & w = instances[name];
+        std::shared_ptr<group_commit> result = w.lock ();
+        if (result == nullptr) {
+            result = std::make_shared<group_commit> ();
+            w = result;
+        }
+        return result;
+    }
+
+    // flush
+    // ~~~~~
+    void group_commit::flush (address const first, address const last, sync_function sync) {
+        PSTORE_ASSERT (first <= last && sync != nullptr);
+        std::unique_lock<std::mutex> lock{mut_};
+        if (pending_ == nullptr) {
+            pending_ = std::make_shared<batch> ();
+        }
+        std::shared_ptr<batch> const b = pending_;
+        b->first = std::min (b->first, first);
+        if (b->sync == nullptr || last > b->last) {
+            b->last = last;
+            b->sync = std::move (sync);
+        }
+
+        while (!b->done) {
+            if (flushing_) {
+                cv_.wait (lock);
+                continue;
+            }
+
+            // No flush is in progress so this thread becomes the leader for our batch. Any
+            // later callers will start a new one.
+            PSTORE_ASSERT (pending_ == b);
+            flushing_ = true;
+            pending_.reset ();
+            lock.unlock ();
+
+            std::exception_ptr error;
+            PSTORE_TRY { b->sync (b->first, b->last); }
+            // clang-format off
+            PSTORE_CATCH (..., { error = std::current_exception (); })
+            // clang-format on
+
+            lock.lock ();
+            b->error = error;
+            b->done = true;
+            flushing_ = false;
+            cv_.notify_all ();
+        }
+
+        if (b->error) {
+            std::rethrow_exception (b->error);
+        }
+    }
+
+} // end namespace pstore
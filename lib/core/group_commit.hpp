@@ -0,0 +1,93 @@
+//===- lib/core/group_commit.hpp --------------------------*- mode: C++ -*-===//
+//*                                                             _ _    *
+//*   __ _ _ __ ___  _   _ _ __     ___ ___  _ __ ___  _ __ ___ (_) |_  *
+//*  / _` | '__/ _ \| | | | '_ \   / __/ _ \| '_ ` _ \| '_ ` _ \| | __| *
+//* | (_| | | | (_) | |_| | |_) | | (_| (_) | | | | | | | | | | | | |_  *
+//*  \__, |_|  \___/ \__,_| .__/   \___\___/|_| |_| |_|_| |_| |_|_|\__| *
+//*  |___/                |_|                                           *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file group_commit.hpp
+/// \brief Batches the disk flushes requested by concurrent committers.
+
+#ifndef PSTORE_CORE_GROUP_COMMIT_HPP
+#define PSTORE_CORE_GROUP_COMMIT_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "pstore/core/address.hpp"
+
+namespace pstore {
+
+    /// A group_commit object allows the threads of a process which are committing to the same
+    /// store to share the cost of flushing that store's file header to disk.
+    ///
+    /// Each caller of flush() adds the address range that it wrote to the current batch. The first
+    /// thread to find that no flush is in progress becomes the batch's "leader": it takes the
+    /// whole batch and makes a single call to the sync function for the union of its ranges. The
+    /// other members of the batch wait for the leader to finish. Callers that arrive whilst a
+    /// flush is in progress form the next batch. Committers flush their own data and publish
+    /// their new footer before calling flush() for the header and release the transaction lock
+    /// first so that a batch collects every commit which completes whilst the previous batch is
+    /// being written.
+    class group_commit {
+    public:
+        /// A function which makes the address range [first, last) durable.
+        using sync_function = std::function<void (address first, address last)>;
+
+        group_commit () = default;
+        group_commit (group_commit const &) = delete;
+        group_commit & operator= (group_commit const &) = delete;
+
+        /// Returns the group_commit instance which is shared by all of the connections to the
+        /// store named \p name in this process.
+        ///
+        /// \param name  A name that uniquely identifies the store (its "sync name").
+        static std::shared_ptr<group_commit> get (std::string const & name);
+
+        /// Adds the range [first, last) to the current batch and blocks until that batch has been
+        /// flushed. If the flush raises an exception, that exception is rethrown to every member
+        /// of the batch.
+        ///
+        /// \param first  The first address written by the caller.
+        /// \param last  The address one beyond the last written by the caller.
+        /// \param sync  A function which flushes data to disk. The batch leader calls the sync
+        ///   function of the member whose range ends at the highest address since that member's
+        ///   view of the store covers all of the others.
+        void flush (address first, address last, sync_function sync);
+
+    private:
+        struct batch {
+            /// The union of the address ranges added to the batch.
+            address first = address::max ();
+            address last = address::null ();
+            /// The sync function supplied by the member whose range ends at 'last'.
+            sync_function sync;
+            bool done = false;
+            std::exception_ptr error;
+        };
+
+        /// Protects access to all of the member variables (in conjunction with #cv_).
+        std::mutex mut_;
+        /// Signalled when a batch has been completed.
+        std::condition_variable cv_;
+        /// True whilst a leader thread is running a batch.
+        bool flushing_ = false;
+        /// The batch to which new work is added. nullptr if there is no such work.
+        std::shared_ptr<batch> pending_;
+    };
+
+} // end namespace pstore
+
+#endif // PSTORE_CORE_GROUP_COMMIT_HPP
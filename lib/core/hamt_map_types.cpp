@@ -16,26 +16,78 @@
 /// \file hamt_map_types.cpp
 #include "pstore/core/hamt_map_types.hpp"
 
+#include <algorithm>
+#include <iterator>
+#include <memory>
 #include <new>
 
+#include "pstore/serialize/standard_types.hpp"
+#include "pstore/support/aligned.hpp"
+#include "pstore/support/portab.hpp"
+
 namespace pstore {
     namespace index {
         namespace details {
 
+            //*               _                               *
+            //*  _ _  ___  __| |___   __ _ _ _ ___ _ _  __ _  *
+            //* | ' \/ _ \/ _` / -_) / _` | '_/ -_) ' \/ _` | *
+            //* |_||_\___/\__,_\___| \__,_|_| \___|_||_\__,_| *
+            //*                                               *
+            constexpr std::size_t node_arena::chunk_size;
+            constexpr std::size_t node_arena::alignment;
+
+            // allocate
+            // ~~~~~~~~
+            void * node_arena::allocate (std::size_t const size) {
+                std::size_t const bytes = aligned (size, alignment);
+                size_ += bytes;
+                if (bytes > chunk_size / 4U) {
+                    // A large allocation gets a chunk of its own so that the remainder of the
+                    // current chunk isn't wasted.
+                    large_.emplace_back (new std::uint8_t[bytes]);
+                    return large_.back ().get ();
+                }
+                if (static_cast<std::size_t> (end_ - next_) < bytes) {
+                    chunks_.emplace_back (new std::uint8_t[chunk_size]);
+                    next_ = chunks_.back ().get ();
+                    end_ = next_ + chunk_size;
+                }
+                void * const result = next_;
+                next_ += bytes;
+                return result;
+            }
+
+            // clear
+            // ~~~~~
+            void node_arena::clear () noexcept {
+                large_.clear ();
+                size_ = 0;
+                if (!chunks_.empty ()) {
+                    chunks_.erase (std::next (std::begin (chunks_)), std::end (chunks_));
+                    next_ = chunks_.front ().get ();
+                    end_ = next_ + chunk_size;
+                }
+            }
+
             //*  _ _                                  _      *
             //* | (_)_ _  ___ __ _ _ _   _ _  ___  __| |___  *
             //* | | | ' \/ -_) _` | '_| | ' \/ _ \/ _` / -_) *
             //* |_|_|_||_\___\__,_|_|   |_||_\___/\__,_\___| *
             //*                                              *
 
-            linear_node::signature_type const linear_node::node_signature_ = {
+            linear_node::signature_type const linear_node::sorted_signature_ = {
+                {'I', 'n', 'd', 'x', 'L', 'n', 'r', 'S'}};
+            linear_node::signature_type const linear_node::unsorted_signature_ = {
                 {'I', 'n', 'd', 'x', 'L', 'n', 'e', 'r'}};
 
             // operator new
             // ~~~~~~~~~~~~
             void * linear_node::operator new (std::size_t const s, nchildren const size) {
                 (void) s;
-                std::size_t const actual_bytes = linear_node::size_bytes (size.n);
+                // Always allocate sufficient storage for a sorted node. This is also enough for an
+                // unsorted node with the same number of children.
+                std::size_t const actual_bytes = linear_node::size_bytes (size.n, true);
                 PSTORE_ASSERT (actual_bytes >= s);
                 return ::operator new (actual_bytes);
             }
@@ -64,46 +116,169 @@ namespace pstore {
                                "offsetof (linear_node, size_) must be 8");
                 static_assert (offsetof (linear_node, leaves_) == 16,
                                "offset of the first child must be 16");
+                static_assert (sizeof (linear_node::leaves_[0]) == sizeof (std::uint64_t),
+                               "the key prefixes must immediately follow the child addresses");
 
                 std::fill_n (&leaves_[0], size, address::null ());
+                std::fill_n (this->prefixes (), size, std::uint64_t{0});
             }
 
             linear_node::linear_node (linear_node const & rhs)
-                    : size_{rhs.size ()} {
+                    : signature_{rhs.signature_}
+                    , size_{rhs.size ()} {
 
                 std::copy (rhs.begin (), rhs.end (), &leaves_[0]);
+                if (rhs.is_sorted ()) {
+                    std::copy_n (rhs.prefixes (), size_, this->prefixes ());
+                }
             }
 
-            // allocate
-            // ~~~~~~~~
-            std::unique_ptr<linear_node> linear_node::allocate (std::size_t const num_children,
-                                                                linear_node const & from_node) {
+            // construct
+            // ~~~~~~~~~
+            linear_node * linear_node::construct (node_arena * const arena,
+                                                  std::size_t const size) {
+                if (arena == nullptr) {
+                    return new (nchildren{size}) linear_node (size);
+                }
+                static_assert (std::is_trivially_destructible<linear_node>::value,
+                               "node_arena does not run destructors");
+                static_assert (alignof (linear_node) <= node_arena::alignment,
+                               "node_arena storage is insufficiently aligned");
+                return new (arena->allocate (linear_node::size_bytes (size, true)))
+                    linear_node (size);
+            }
+
+            // copy_node
+            // ~~~~~~~~~
+            linear_node * linear_node::copy_node (node_arena * const arena,
+                                                  std::size_t const num_children,
+                                                  linear_node const & from_node) {
                 // Allocate the new node and fill in the basic fields.
-                auto new_node = std::unique_ptr<linear_node> (new (nchildren{num_children})
-                                                                  linear_node (num_children));
+                linear_node * const new_node = linear_node::construct (arena, num_children);
+                new_node->signature_ = from_node.signature_;
 
                 std::size_t const num_to_copy = std::min (num_children, from_node.size ());
                 auto const * const src_begin = from_node.leaves_;
                 // Note that the last argument is '&leaves[0]' rather than just 'leaves' to defeat
                 // an MSVC debug assertion that thinks it knows how big the leaves_ array is...
                 std::copy (src_begin, src_begin + num_to_copy, &new_node->leaves_[0]);
-
+                if (from_node.is_sorted ()) {
+                    std::copy_n (from_node.prefixes (), num_to_copy, new_node->prefixes ());
+                }
                 return new_node;
             }
 
-            std::unique_ptr<linear_node> linear_node::allocate (address const a, address const b) {
-                auto result = std::unique_ptr<linear_node> (new (nchildren{2U}) linear_node (2U));
+            // pair_node
+            // ~~~~~~~~~
+            linear_node * linear_node::pair_node (node_arena * const arena, address const a,
+                                                  std::uint64_t const prefix_a, address const b,
+                                                  std::uint64_t const prefix_b) {
+                PSTORE_ASSERT (prefix_a <= prefix_b);
+                linear_node * const result = linear_node::construct (arena, 2U);
+                (*result)[0] = a;
+                (*result)[1] = b;
+                std::uint64_t * const prefixes = result->prefixes ();
+                prefixes[0] = prefix_a;
+                prefixes[1] = prefix_b;
+                return result;
+            }
+
+            // insert_node
+            // ~~~~~~~~~~~
+            linear_node * linear_node::insert_node (node_arena * const arena,
+                                                    linear_node const & orig_node,
+                                                    std::size_t const pos, address const leaf,
+                                                    std::uint64_t const prefix) {
+                PSTORE_ASSERT (orig_node.is_sorted ());
+                auto const orig_size = orig_node.size ();
+                PSTORE_ASSERT (pos <= orig_size);
+                linear_node * const result = linear_node::construct (arena, orig_size + 1U);
+
+                auto const * const src_leaves = orig_node.leaves_;
+                address * const dest_leaves = &result->leaves_[0];
+                std::copy (src_leaves, src_leaves + pos, dest_leaves);
+                dest_leaves[pos] = leaf;
+                std::copy (src_leaves + pos, src_leaves + orig_size, dest_leaves + pos + 1);
+
+                std::uint64_t const * const src_prefixes = orig_node.prefixes ();
+                std::uint64_t * const dest_prefixes = result->prefixes ();
+                std::copy (src_prefixes, src_prefixes + pos, dest_prefixes);
+                dest_prefixes[pos] = prefix;
+                std::copy (src_prefixes + pos, src_prefixes + orig_size, dest_prefixes + pos + 1);
+
+                PSTORE_ASSERT (std::is_sorted (dest_prefixes, dest_prefixes + orig_size + 1U));
+                return result;
+            }
+
+            // allocate
+            // ~~~~~~~~
+            std::unique_ptr<linear_node> linear_node::allocate (address const a,
+                                                                std::uint64_t const prefix_a,
+                                                                address const b,
+                                                                std::uint64_t const prefix_b) {
+                return std::unique_ptr<linear_node>{
+                    linear_node::pair_node (nullptr, a, prefix_a, b, prefix_b)};
+            }
+
+            linear_node * linear_node::allocate (node_arena & arena, address const a,
+                                                 std::uint64_t const prefix_a, address const b,
+                                                 std::uint64_t const prefix_b) {
+                return linear_node::pair_node (&arena, a, prefix_a, b, prefix_b);
+            }
+
+            // allocate_unsorted
+            // ~~~~~~~~~~~~~~~~~
+            linear_node * linear_node::allocate_unsorted (node_arena & arena, address const a,
+                                                          address const b) {
+                linear_node * const result = linear_node::construct (&arena, 2U);
+                result->signature_ = unsorted_signature_;
                 (*result)[0] = a;
                 (*result)[1] = b;
                 return result;
             }
 
+            // allocate_children
+            // ~~~~~~~~~~~~~~~~~
+            linear_node * linear_node::allocate_children (node_arena & arena,
+                                                          std::size_t const size,
+                                                          bool const sorted) {
+                linear_node * const result = linear_node::construct (&arena, size);
+                if (!sorted) {
+                    result->signature_ = unsorted_signature_;
+                }
+                return result;
+            }
+
+            // allocate_insert
+            // ~~~~~~~~~~~~~~~
+            std::unique_ptr<linear_node>
+            linear_node::allocate_insert (linear_node const & orig_node, std::size_t const pos,
+                                          address const leaf, std::uint64_t const prefix) {
+                return std::unique_ptr<linear_node>{
+                    linear_node::insert_node (nullptr, orig_node, pos, leaf, prefix)};
+            }
+
+            linear_node * linear_node::allocate_insert (node_arena & arena,
+                                                        linear_node const & orig_node,
+                                                        std::size_t const pos, address const leaf,
+                                                        std::uint64_t const prefix) {
+                return linear_node::insert_node (&arena, orig_node, pos, leaf, prefix);
+            }
+
             // allocate_from
             // ~~~~~~~~~~~~~
             std::unique_ptr<linear_node>
             linear_node::allocate_from (linear_node const & orig_node,
                                         std::size_t const extra_children) {
-                return linear_node::allocate (orig_node.size () + extra_children, orig_node);
+                return std::unique_ptr<linear_node>{linear_node::copy_node (
+                    nullptr, orig_node.size () + extra_children, orig_node)};
+            }
+
+            linear_node * linear_node::allocate_from (node_arena & arena,
+                                                      linear_node const & orig_node,
+                                                      std::size_t const extra_children) {
+                return linear_node::copy_node (&arena, orig_node.size () + extra_children,
+                                               orig_node);
             }
 
             std::unique_ptr<linear_node>
@@ -122,14 +297,17 @@ namespace pstore {
 
                 if (node.is_heap ()) {
                     auto const * ptr = node.untag_node<linear_node const *> ();
-                    PSTORE_ASSERT (ptr->signature_ == node_signature_);
+                    PSTORE_ASSERT (ptr->signature_ == sorted_signature_ ||
+                                   ptr->signature_ == unsorted_signature_);
                     return {nullptr, ptr};
                 }
 
                 // Read an existing node. First work out its size.
                 auto const addr = node.untag_linear_address ();
-                std::size_t const in_store_size =
-                    linear_node::size_bytes (db.getro (addr)->size ());
+                std::size_t const in_store_size = [&db, &addr] () {
+                    std::shared_ptr<linear_node const> const h = db.getro (addr);
+                    return linear_node::size_bytes (h->size (), h->is_sorted ());
+                }();
 
                 // Now access the data block for this linear node. We need to use the "raw address"
                 // version of getro() because in_store_size is a number of bytes, not a number of
@@ -137,7 +315,7 @@ namespace pstore {
                 auto const ln = std::static_pointer_cast<linear_node const> (
                     db.getro (addr.to_address (), in_store_size));
 #if PSTORE_SIGNATURE_CHECKS_ENABLED
-                if (ln->signature_ != node_signature_) {
+                if (ln->signature_ != sorted_signature_ && ln->signature_ != unsorted_signature_) {
                     raise (pstore::error_code::index_corrupt);
                 }
 #endif
@@ -145,6 +323,30 @@ namespace pstore {
                 return {std::move (ln), p};
             }
 
+            linear_node const * linear_node::get_node (database::read_view & view,
+                                                       index_pointer const node) {
+                if (node.is_heap ()) {
+                    auto const * ptr = node.untag_node<linear_node const *> ();
+                    PSTORE_ASSERT (ptr->signature_ == sorted_signature_ ||
+                                   ptr->signature_ == unsorted_signature_);
+                    return ptr;
+                }
+
+                // Read the node header to discover its size then access the complete node.
+                auto const addr = node.untag_linear_address ();
+                linear_node const * const h = view.get (addr);
+                std::size_t const in_store_size =
+                    linear_node::size_bytes (h->size (), h->is_sorted ());
+                auto const * const ln =
+                    static_cast<linear_node const *> (view.get (addr.to_address (), in_store_size));
+#if PSTORE_SIGNATURE_CHECKS_ENABLED
+                if (ln->signature_ != sorted_signature_ && ln->signature_ != unsorted_signature_) {
+                    raise (pstore::error_code::index_corrupt);
+                }
+#endif
+                return ln;
+            }
+
             // flush
             // ~~~~~
             address linear_node::flush (transaction_base & transaction) const {
@@ -165,6 +367,7 @@ namespace pstore {
 
             internal_node::signature_type const internal_node::node_signature_ = {
                 {'I', 'n', 't', 'e', 'r', 'n', 'a', 'l'}};
+            constexpr unsigned internal_node::node_alignment;
 
             // ctor (one child)
             // ~~~~~~~~~~~~~~~~
@@ -280,6 +483,25 @@ namespace pstore {
                 return resl;
             }
 
+            internal_node const *
+            internal_node::read_node (database::read_view & view,
+                                      typed_address<internal_node> const addr) {
+                // As above, the node must be loaded in two stages: first to learn the number of
+                // children, then the complete structure.
+                auto const * const base = static_cast<internal_node const *> (
+                    view.get (addr.to_address (),
+                              sizeof (internal_node) - sizeof (internal_node::children_)));
+                if (base->get_bitmap () == 0) {
+                    raise (error_code::index_corrupt, view.db ().path ());
+                }
+                auto const * const resl = static_cast<internal_node const *> (
+                    view.get (addr.to_address (), internal_node::size_bytes (base->size ())));
+                if (!validate_after_load (*resl, addr)) {
+                    raise (error_code::index_corrupt, view.db ().path ());
+                }
+                return resl;
+            }
+
             // get_node [static]
             // ~~~~~~~~
             auto internal_node::get_node (database const & db, index_pointer const node)
@@ -295,6 +517,14 @@ namespace pstore {
                 return {std::move (store_internal), p};
             }
 
+            internal_node const * internal_node::get_node (database::read_view & view,
+                                                           index_pointer const node) {
+                if (node.is_heap ()) {
+                    return node.untag_node<internal_node *> ();
+                }
+                return internal_node::read_node (view, node.untag_internal_address ());
+            }
+
             // insert_child
             // ~~~~~~~~~~~~
             void internal_node::insert_child (hash_type const hash, index_pointer const leaf,
@@ -343,6 +573,26 @@ namespace pstore {
                 return result;
             }
 
+            // write_node [static]
+            // ~~~~~~~~~~
+            address internal_node::write_node (transaction_base & transaction,
+                                               hash_type const bitmap,
+                                               gsl::span<index_pointer const> const children) {
+                auto const size = static_cast<std::size_t> (children.size ());
+                PSTORE_ASSERT (size > 0U && bit_count::pop_count (bitmap) == size);
+                PSTORE_ASSERT (std::none_of (std::begin (children), std::end (children),
+                                             [] (index_pointer const & c) { return c.is_heap (); }));
+
+                std::shared_ptr<void> ptr;
+                address result;
+                std::tie (ptr, result) =
+                    transaction.alloc_rw (internal_node::size_bytes (size), alignof (internal_node));
+                auto * const node = new (ptr.get ()) internal_node (children[0], 0U);
+                node->bitmap_ = bitmap;
+                std::copy (std::begin (children), std::end (children), &node->children_[0]);
+                return result | internal_node_bit;
+            }
+
             // flush
             // ~~~~~
             address internal_node::flush (transaction_base & transaction, unsigned shifts) {
@@ -361,7 +611,7 @@ namespace pstore {
                             PSTORE_ASSERT (p.is_linear ());
                             auto * const linear = p.untag_node<linear_node *> ();
                             p = linear->flush (transaction) | internal_node_bit;
-                            delete linear;
+                            // Like this node, the linear node is owned by the index's node arena.
                         }
                     }
                 }
@@ -369,6 +619,167 @@ namespace pstore {
                 return this->store_node (transaction) | internal_node_bit;
             }
 
+            // flush_size
+            // ~~~~~~~~~~
+            std::uint64_t internal_node::flush_size (unsigned shifts) const {
+                static_assert (alignof (internal_node) <= node_alignment &&
+                                   alignof (linear_node) <= node_alignment,
+                               "node_alignment must be sufficient for both node types");
+                shifts += hash_index_bits;
+                auto result = aligned (std::uint64_t{internal_node::size_bytes (this->size ())},
+                                       node_alignment);
+                for (auto const & p : *this) {
+                    if (p.is_heap ()) {
+                        if (shifts < max_hash_bits) {
+                            result += p.untag_node<internal_node const *> ()->flush_size (shifts);
+                        } else {
+                            auto const * const linear = p.untag_node<linear_node const *> ();
+                            result += aligned (std::uint64_t{linear->size_bytes ()},
+                                               node_alignment);
+                        }
+                    }
+                }
+                return result;
+            }
+
+
+            // prefetch_node
+            // ~~~~~~~~~~~~~
+            void prefetch_node (database const & db, index_pointer const node) {
+                if (node.is_heap ()) {
+                    PSTORE_PREFETCH (node.untag_node<void const *> ());
+                    return;
+                }
+                // Leaf addresses don't carry the internal-node tag so clearing it is harmless.
+                auto const addr = address{node.addr.absolute () & ~internal_node_bit};
+                if (addr.absolute () < db.size ()) {
+                    // Only the first byte is requested so that the pointer is always into a mapped
+                    // region rather than a freshly allocated spanning copy.
+                    PSTORE_PREFETCH (database::read_view{db}.get (addr, std::size_t{1}));
+                }
+            }
+
+
+            //*               _                  _         *
+            //*  _ _  ___  __| |___   __ __ _ __| |_  ___  *
+            //* | ' \/ _ \/ _` / -_) / _/ _` / _| ' \/ -_) *
+            //* |_||_\___/\__,_\___| \__\__,_\__|_||_\___| *
+            //*                                            *
+            constexpr std::uint32_t node_cache::none;
+            constexpr std::size_t node_cache::cache_line_size;
+
+            // (ctor)
+            // ~~~~~~
+            node_cache::node_cache (database const & db, index_pointer const root,
+                                    unsigned const levels) {
+                PSTORE_ASSERT (root.is_internal () && root.is_address () && levels > 0U);
+                PSTORE_STATIC_ASSERT (sizeof (entry) == 32U);
+
+                // Load the nodes one level at a time. The children of the nodes in [0,
+                // expanded_end) are also in the cache.
+                std::vector<index_pointer> addrs{root};
+                std::vector<std::shared_ptr<internal_node const>> loaded;
+                auto expanded_end = std::size_t{0};
+                auto num_children = std::size_t{0};
+                auto level_begin = std::size_t{0};
+                auto shifts = 0U;
+                for (; levels_ < levels && level_begin < addrs.size (); ++levels_) {
+                    auto const level_end = addrs.size ();
+                    shifts += hash_index_bits;
+                    // Nodes below max_hash_bits are linear nodes which aren't cached.
+                    bool const expand = levels_ + 1U < levels && depth_is_internal_node (shifts);
+                    for (auto n = level_begin; n < level_end; ++n) {
+                        loaded.push_back (
+                            internal_node::read_node (db, addrs[n].untag_internal_address ()));
+                        num_children += loaded.back ()->size ();
+                        if (expand) {
+                            std::copy_if (
+                                loaded.back ()->begin (), loaded.back ()->end (),
+                                std::back_inserter (addrs),
+                                [] (index_pointer const & c) { return c.is_internal (); });
+                        }
+                    }
+                    if (expand) {
+                        expanded_end = level_end;
+                    }
+                    level_begin = level_end;
+                }
+                PSTORE_ASSERT (addrs.size () == loaded.size ());
+                PSTORE_ASSERT (num_children < none);
+                size_ = loaded.size ();
+
+                // Place the nodes and their children in a single block whose start is aligned to a
+                // cache line.
+                auto const nodes_bytes = size_ * sizeof (entry);
+                auto space = nodes_bytes + num_children * sizeof (index_pointer) + cache_line_size;
+                storage_ = std::make_unique<std::uint8_t[]> (space);
+                void * ptr = storage_.get ();
+                ptr = std::align (cache_line_size, space - cache_line_size, ptr, space);
+                PSTORE_ASSERT (ptr != nullptr);
+                nodes_ = static_cast<entry *> (ptr);
+                children_ = reinterpret_cast<index_pointer *> (static_cast<std::uint8_t *> (ptr) +
+                                                               nodes_bytes);
+
+                auto child_pos = std::uint32_t{0};
+                auto next_node = std::uint32_t{1};
+                for (auto n = std::size_t{0}; n < size_; ++n) {
+                    internal_node const & internal = *loaded[n];
+                    auto * const e = new (&nodes_[n]) entry;
+                    e->bitmap = internal.get_bitmap ();
+                    e->cached = 0U;
+                    e->self = addrs[n];
+                    e->first_child = child_pos;
+                    e->first_node = n < expanded_end ? next_node : none;
+
+                    // Visit the children in bitmap order.
+                    auto bitmap = e->bitmap;
+                    for (index_pointer const & child : internal) {
+                        auto const bit_pos = bitmap & (~bitmap + 1U); // The lowest set bit.
+                        bitmap &= bitmap - 1U;
+                        new (&children_[child_pos++]) index_pointer{child};
+                        if (n < expanded_end && child.is_internal ()) {
+                            e->cached |= bit_pos;
+                            ++next_node;
+                        }
+                    }
+                }
+                PSTORE_ASSERT (next_node == size_);
+            }
+
         } // namespace details
-    }     // namespace index
+
+
+        //*  _                  _              _            _ _       *
+        //* | |_____ _  _  __ _(_)_____ __ __ | |_ _ _ __ _(_) |_ ___ *
+        //* | / / -_) || | \ V / / -_) V  V / |  _| '_/ _` | |  _(_-< *
+        //* |_\_\___|\_, |  \_/|_\___|\_/\_/   \__|_| \__,_|_|\__/__/ *
+        //*          |__/                                             *
+        constexpr bool key_view_traits<std::string, std::equal_to<std::string>>::enabled;
+
+        // load
+        // ~~~~
+        shared_sstring_view
+        key_view_traits<std::string, std::equal_to<std::string>>::load (database const & db,
+                                                                         address const addr) {
+            serialize::archive::database_reader reader{db, addr};
+            auto const length = serialize::string_helper::read_length (reader);
+            if (length == 0U) {
+                return {};
+            }
+            return {std::static_pointer_cast<char const> (db.getro (reader.get_address (), length)),
+                    length};
+        }
+
+        raw_sstring_view
+        key_view_traits<std::string, std::equal_to<std::string>>::load (database::read_view & view,
+                                                                         address const addr) {
+            serialize::archive::database_reader reader{view, addr};
+            auto const length = serialize::string_helper::read_length (reader);
+            if (length == 0U) {
+                return {};
+            }
+            return {static_cast<char const *> (view.get (reader.get_address (), length)), length};
+        }
+
+    } // namespace index
 } // namespace pstore
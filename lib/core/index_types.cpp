@@ -16,7 +16,11 @@
 
 #include "pstore/core/index_types.hpp"
 
+#include <functional>
+#include <vector>
+
 #include "pstore/core/hamt_set.hpp"
+#include "pstore/support/parallel_for_each.hpp"
 
 namespace {
 
@@ -25,13 +29,26 @@ namespace {
         return static_cast<std::underlying_type<pstore::trailer::indices>::type> (idx);
     }
 
+    /// A loaded index which is to be written to the store.
+    struct flush_job {
+        pstore::trailer::indices kind;
+        /// An upper bound on the number of bytes that the index will occupy in the store.
+        std::uint64_t size;
+        /// Writes the index to a transaction and returns the address of its header block.
+        std::function<pstore::typed_address<pstore::index::header_block> (
+            pstore::transaction_base &)>
+            flush;
+    };
+
     template <pstore::trailer::indices Index>
-    void flush_index (pstore::transaction_base & transaction,
-                      pstore::trailer::index_records_array * const locations,
-                      unsigned const generation) {
-        pstore::database & db = transaction.db ();
+    void add_flush_job (pstore::database & db, unsigned const generation,
+                        std::vector<flush_job> * const jobs) {
         if (auto const index = pstore::index::get_index<Index> (db, false /*create*/)) {
-            (*locations)[index_integral (Index)] = index->flush (transaction, generation);
+            jobs->push_back (flush_job{
+                Index, index->flush_size (),
+                [index, generation] (pstore::transaction_base & transaction) {
+                    return index->flush (transaction, generation);
+                }});
         }
     }
 
@@ -45,9 +62,11 @@ namespace pstore {
         void flush_indices (transaction_base & transaction,
                             trailer::index_records_array * const locations,
                             unsigned const generation) {
+            std::vector<flush_job> jobs;
+            jobs.reserve (index_integral (trailer::indices::last));
 #define X(k)                                                                                       \
     case trailer::indices::k:                                                                      \
-        flush_index<trailer::indices::k> (transaction, locations, generation);                     \
+        add_flush_job<trailer::indices::k> (transaction.db (), generation, &jobs);                 \
         break;
 
             for (auto ctr = std::underlying_type<trailer::indices>::type{0};
@@ -59,6 +78,31 @@ namespace pstore {
             }
 #undef X
             PSTORE_ASSERT (locations->size () == index_integral (trailer::indices::last));
+
+            if (jobs.size () < 2U) {
+                for (flush_job const & job : jobs) {
+                    (*locations)[index_integral (job.kind)] = job.flush (transaction);
+                }
+                return;
+            }
+
+            // Reserve a block of the transaction big enough for all of the indices. This is the
+            // only point at which the store grows so the indices can then be written
+            // concurrently. They share the block: each allocation is carved from the next free
+            // space so the indices' data is packed together.
+            auto size = std::uint64_t{0};
+            for (flush_job const & job : jobs) {
+                size += job.size;
+            }
+            address const first =
+                transaction.allocate (size, details::internal_node::node_alignment);
+            block_transaction block{transaction, first, size};
+            parallel_for_each (std::begin (jobs), std::end (jobs),
+                               [&block, locations] (flush_job const & job) {
+                                   (*locations)[index_integral (job.kind)] = job.flush (block);
+                               });
+            // The sizes are upper bounds. Return the part of the block that was not used.
+            transaction.trim (first + block.used ());
         }
 
     } // end namespace index
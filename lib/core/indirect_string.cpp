@@ -97,13 +97,11 @@ namespace pstore {
                                                    typed_address<address> const address_to_patch) {
         PSTORE_ASSERT (address_to_patch != typed_address<address>::null ());
 
-        // Make sure the alignment of the string is 2 to ensure that the LSB is clear.
-        constexpr auto aligned_to = std::size_t{1U << in_heap_mask};
-        transaction.allocate (0, aligned_to);
-
         // Write the string body.
-        auto const body_address =
-            serialize::write (serialize::archive::make_writer (transaction), str);
+        serialize::archive::buffered_database_writer writer{transaction};
+        auto const offset = write_body (writer, str);
+        writer.flush ();
+        address const body_address = writer.address_of (offset);
 
         // Modify the in-store address field so that it points to the string body.
         auto const addr = transaction.getrw (address_to_patch);
@@ -111,6 +109,16 @@ namespace pstore {
         return body_address;
     }
 
+    // write body
+    // ~~~~~~~~~~
+    std::size_t indirect_string::write_body (serialize::archive::buffered_database_writer & writer,
+                                             raw_sstring_view const & str) {
+        // Make sure the alignment of the string is 2 to ensure that the LSB is clear.
+        constexpr auto aligned_to = std::size_t{1U << in_heap_mask};
+        writer.align (aligned_to);
+        return serialize::write (writer, str);
+    }
+
 
     namespace serialize {
 
@@ -157,12 +165,24 @@ namespace pstore {
     // flush
     // ~~~~~
     void indirect_string_adder::flush (transaction_base & transaction) {
+        if (views_.empty ()) {
+            return;
+        }
+        // Write all of the string bodies to the store with a single allocation.
+        std::vector<std::size_t> offsets;
+        offsets.reserve (views_.size ());
+        serialize::archive::buffered_database_writer writer{transaction};
+        for (auto const & v : views_) {
+            offsets.push_back (indirect_string::write_body (writer, *std::get<0> (v)));
+        }
+        writer.flush ();
+
+        // Now patch the in-store addresses so that they point to the string bodies.
+        auto offset_it = std::begin (offsets);
         for (auto const & v : views_) {
             PSTORE_ASSERT (v.second != typed_address<address>::null ());
-            indirect_string::write_body_and_patch_address (transaction,
-                                                           *std::get<0> (v), // string body
-                                                           std::get<1> (v)   // address to patch
-            );
+            *transaction.getrw (std::get<1> (v)) = writer.address_of (*offset_it);
+            ++offset_it;
         }
         views_.clear ();
     }
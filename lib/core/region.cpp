@@ -42,6 +42,12 @@ namespace pstore {
         //*                          |__/  *
         factory::~factory () noexcept = default;
 
+        // contiguous bytes
+        // ~~~~~~~~~~~~~~~~
+        std::uint64_t factory::contiguous_bytes (std::vector<memory_mapper_ptr> const &) const {
+            return 0U;
+        }
+
         //*   __ _ _       _                     _    __         _                 *
         //*  / _(_) |___  | |__  __ _ ___ ___ __| |  / _|__ _ __| |_ ___ _ _ _  _  *
         //* |  _| | / -_) | '_ \/ _` (_-</ -_) _` | |  _/ _` / _|  _/ _ \ '_| || | *
@@ -53,12 +59,24 @@ namespace pstore {
                                                 std::uint64_t const full_size,
                                                 std::uint64_t const min_size)
                 : factory{full_size, min_size}
-                , file_{std::move (file)} {}
+                , file_{std::move (file)} {
+
+            // A reservation is of no use unless it can hold at least a couple of regions. On a
+            // 32-bit host, there's no address space to spare.
+            if (sizeof (void *) >= 8U) {
+                auto reservation = std::make_shared<address_reservation> (reservation_size);
+                if (reservation->valid ()) {
+                    reservation_ = std::move (reservation);
+                }
+            }
+        }
+
+        constexpr std::uint64_t file_based_factory::reservation_size;
 
         // init
         // ~~~~
         auto file_based_factory::init () -> std::vector<memory_mapper_ptr> {
-            return this->create<file::file_handle, memory_mapper> (file_);
+            return this->create<file::file_handle, memory_mapper> (file_, reservation_);
         }
 
         // add
@@ -67,7 +85,30 @@ namespace pstore {
                                       std::uint64_t const original_size,
                                       std::uint64_t const new_size) {
             this->append<file::file_handle, memory_mapper> (file_, regions, original_size,
-                                                            new_size);
+                                                            new_size, reservation_);
+        }
+
+        // contiguous bytes
+        // ~~~~~~~~~~~~~~~~
+        std::uint64_t file_based_factory::contiguous_bytes (
+            std::vector<memory_mapper_ptr> const & regions) const {
+            if (reservation_ == nullptr) {
+                return 0U;
+            }
+            // The regions are sorted by file offset. Each region which was placed within the
+            // reservation lies at the reservation's base address plus its file offset; stop at
+            // the first which was not.
+            auto const * const base = static_cast<std::uint8_t const *> (reservation_->base ());
+            std::uint64_t result = 0U;
+            for (memory_mapper_ptr const & region : regions) {
+                if (region->offset () != result ||
+                    static_cast<std::uint8_t const *> (region->data ().get ()) !=
+                        base + region->offset ()) {
+                    break;
+                }
+                result = region->end ();
+            }
+            return result;
         }
 
         // file
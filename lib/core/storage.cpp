@@ -72,12 +72,16 @@ namespace pstore {
     // shrink
     // ~~~~~~
     void storage::shrink (std::uint64_t const new_size) {
+        // Withdraw the contiguous range before the regions that it covers are unmapped.
+        if (contiguous_bytes_.load (std::memory_order_relaxed) > new_size) {
+            contiguous_bytes_.store (new_size, std::memory_order_release);
+        }
         // We now look backwards through the regions, discarding segments and regions introduced
         // by this transaction
         while (regions_.size () > 0) {
             auto const region = regions_.back ();
             if (region->offset () <= new_size) {
-                return;
+                break;
             }
 
             // remove segments
@@ -92,6 +96,8 @@ namespace pstore {
             // remove region
             regions_.pop_back ();
         }
+        contiguous_bytes_.store (region_factory_->contiguous_bytes (regions_),
+                                 std::memory_order_release);
     }
 
     // update master pointers
@@ -134,6 +140,8 @@ namespace pstore {
             PSTORE_ASSERT (segment_it->value == nullptr && segment_it->region == nullptr);
         }
 #endif
+        contiguous_bytes_.store (region_factory_->contiguous_bytes (regions_),
+                                 std::memory_order_release);
     }
 
     // slice region into segments
@@ -196,4 +204,30 @@ namespace pstore {
         }
     }
 
+    // flush
+    // ~~~~~
+    void storage::flush (address first, address last) {
+        std::uint64_t const page_size = memory_mapper::page_size (*page_size_);
+        PSTORE_ASSERT (page_size > 0 && is_power_of_two (page_size));
+
+        // The flushed range must start on a page boundary but, unlike protect(), partial pages at
+        // either end must be included.
+        first = round_down (first, page_size);
+
+        for (std::shared_ptr<memory_mapper_base> & region : regions_) {
+            PSTORE_ASSERT (region->offset () % page_size == 0);
+            std::uint64_t const first_offset = std::max (region->offset (), first.absolute ());
+            std::uint64_t const last_offset =
+                std::min (region->offset () + region->size (), last.absolute ());
+            if (first_offset >= last.absolute ()) {
+                break;
+            }
+            if (last_offset > first_offset) {
+                auto * const base = static_cast<std::uint8_t *> (region->data ().get ());
+                region->flush (base + (first_offset - region->offset ()),
+                               last_offset - first_offset);
+            }
+        }
+    }
+
 } // end namespace pstore
@@ -17,6 +17,7 @@
 /// \brief Data store transaction implementation
 #include "pstore/core/transaction.hpp"
 
+#include <algorithm>
 #include <utility>
 
 #include "pstore/core/index_types.hpp"
@@ -30,6 +31,11 @@ namespace pstore {
         if (!db.is_writable ()) {
             raise (error_code::transaction_on_read_only_database);
         }
+        // The transaction lock is held. If vacuum replaced the store whilst we were waiting for
+        // it then anything that we commit would be lost.
+        if (db.is_replaced ()) {
+            raise (error_code::store_replaced);
+        }
 
         // First thing that creating a transaction does is update the view
         // to that of the head revision.
@@ -41,35 +47,89 @@ namespace pstore {
             : db_{rhs.db_}
             , size_{rhs.size_}
             , dbsize_{rhs.dbsize_}
-            , first_ (rhs.first_) {
+            , first_ (rhs.first_)
+            , next_{rhs.next_}
+            , reserved_end_{rhs.reserved_end_} {
         rhs.first_ = address::null ();
+        rhs.next_ = address::null ();
+        rhs.reserved_end_ = address::null ();
 
         PSTORE_ASSERT (!rhs.is_open ()); //! OCLINT(PH - don't warn about the assert macro)
     }
 
+    constexpr std::uint64_t transaction_base::reserve_size;
+
+    // reserve
+    // ~~~~~~~
+    void transaction_base::reserve (std::uint64_t const size) {
+        database & db = this->db ();
+        auto const db_size = db.size ();
+        PSTORE_ASSERT (reserved_end_.absolute () == db_size && next_ <= reserved_end_);
+        std::uint64_t const available = db_size - next_.absolute ();
+        PSTORE_ASSERT (size > available);
+        std::uint64_t request = size - available;
+
+        // Round the request up to reserve_size but don't go beyond the memory that is already
+        // mapped: the surplus would only be trimmed at commit, and mapping it could grow an
+        // in-memory store beyond its capacity. A request which needs more memory to be mapped
+        // asks for exactly what it needs.
+        std::uint64_t const mapped = db.mapped_size ();
+        if (db_size + request <= mapped) {
+            request = std::max (request, std::min (reserve_size, mapped - db_size));
+        }
+
+        // Alignment is handled by this transaction: the reserved space is simply appended to
+        // the end of the database.
+        address const start = db.allocate (request, 1U /*align*/);
+        PSTORE_ASSERT (start.absolute () == db_size);
+        (void) start;
+        reserved_end_ = address{db.size ()};
+    }
+
     // allocate
     // ~~~~~~~~
     address transaction_base::allocate (std::uint64_t const size, unsigned const align) {
-        database & db = this->db ();
-        auto const old_size = db.size ();
-        address const result = db.allocate (size, align);
+        PSTORE_ASSERT (is_power_of_two (align));
+        if (first_ == address::null () && size_ != 0) {
+            // Cannot allocate data after a transaction has been committed
+            raise (error_code::cannot_allocate_after_commit);
+        }
+
+        auto const db_size = this->db ().size ();
+        if (reserved_end_ == address::null () || reserved_end_.absolute () != db_size) {
+            // This is the first allocation or something other than this transaction has
+            // allocated from the database. Start again from its current end.
+            next_ = address{db_size};
+            reserved_end_ = next_;
+        }
+        std::uint64_t const extra_for_alignment =
+            calc_alignment (next_.absolute (), std::uint64_t{align});
+        if (reserved_end_.absolute () - next_.absolute () < extra_for_alignment + size) {
+            this->reserve (extra_for_alignment + size);
+        }
+
+        address const result = next_ + extra_for_alignment;
         if (first_ == address::null ()) {
-            if (size_ != 0) {
-                // Cannot allocate data after a transaction has been committed
-                raise (error_code::cannot_allocate_after_commit);
-            }
             first_ = result;
         }
 
         // Increase the transaction size by the actual number of bytes
         // allocated. This may be greater than the number requested to
         // allow for alignment.
-        auto const bytes_allocated = db.size () - old_size;
-        PSTORE_ASSERT (bytes_allocated >= size);
-        size_ += bytes_allocated;
+        size_ += extra_for_alignment + size;
+        next_ = result + size;
+        PSTORE_ASSERT (next_ <= reserved_end_);
         return result;
     }
 
+    // trim
+    // ~~~~
+    void transaction_base::trim (address const end) noexcept {
+        PSTORE_ASSERT (first_ != address::null () && first_ <= end && end <= next_);
+        size_ -= next_.absolute () - end.absolute ();
+        next_ = end;
+    }
+
     // alloc_rw
     // ~~~~~~~~
     std::pair<std::shared_ptr<void>, address> transaction_base::alloc_rw (std::size_t const size,
@@ -126,19 +186,39 @@ namespace pstore {
                 t->a.size = size_ - sizeof (trailer);
                 t->a.time = pstore::milliseconds_since_epoch ();
                 t->a.prev_generation = head.footer_pos;
+                t->a.skip_generation = db.older_revision_footer_pos (
+                    head.footer_pos.load (), trailer::skip_target (generation));
                 t->crc = t->get_crc ();
             }
         }
+        // Return any reserved space that the transaction didn't use so that the footer lies at
+        // the end of the database.
+        if (db.size () > next_.absolute ()) {
+            db.truncate (next_.absolute ());
+        }
+        reserved_end_ = address::null ();
+
+        address const last = (new_footer_pos + 1).to_address ();
+        // If the transaction is to be durable, its data and footer must reach the disk before
+        // the header that refers to them.
+        db.flush (first_, last);
+
         // Complete the transaction by making it available to other clients. This modifies the
         // footer pointer in the file's header record.
         db.set_new_footer (new_footer_pos);
 
         // Mark both this transaction's contents and its trailer as read-only.
-        db.protect (first_, (new_footer_pos + 1).to_address ());
+        db.protect (first_, last);
 
         // That's the end of this transaction.
         first_ = address::null ();
         PSTORE_ASSERT (!this->is_open ()); //! OCLINT(PH - don't warn about the assert macro)
+
+        if (db.get_durability () == database::durability::group) {
+            // Let other threads commit whilst we wait: they'll share the next header flush.
+            this->release_lock ();
+        }
+        db.flush_header ();
         return *this;
     }
 
@@ -147,6 +227,8 @@ namespace pstore {
     transaction_base & transaction_base::rollback () noexcept {
         if (this->is_open ()) {
             first_ = address::null ();
+            next_ = address::null ();
+            reserved_end_ = address::null ();
             PSTORE_ASSERT (!this->is_open ()); //! OCLINT(PH - don't warn about the assert macro)
             // if we grew the db, truncate it back
             if (db_.size () > dbsize_) {
@@ -158,6 +240,36 @@ namespace pstore {
     }
 
 
+    // *********************
+    // * block_transaction *
+    // *********************
+    // ctor
+    // ~~~~
+    block_transaction::block_transaction (transaction_base & parent, address const first,
+                                          std::uint64_t const size)
+            : transaction_base (parent.db (), nested_tag{})
+            , first_{first}
+            , next_{first.absolute ()}
+            , end_{first + size} {
+        PSTORE_ASSERT (parent.is_open () && end_.absolute () <= parent.db ().size ());
+    }
+
+    // allocate
+    // ~~~~~~~~
+    address block_transaction::allocate (std::uint64_t const size, unsigned const align) {
+        PSTORE_ASSERT (is_power_of_two (align));
+        std::uint64_t next = next_.load ();
+        std::uint64_t result = 0;
+        do {
+            result = next + calc_alignment (next, std::uint64_t{align});
+            if (result > end_.absolute () || end_.absolute () - result < size) {
+                raise (error_code::bad_address);
+            }
+        } while (!next_.compare_exchange_weak (next, result + size));
+        return address{result};
+    }
+
+
     // *********
     // * begin *
     // *********
@@ -78,6 +78,7 @@ namespace pstore {
                 {"size", make_value (trailer.a.size.load ())},
                 {"time", make_time (trailer.a.time, no_times)},
                 {"prev_generation", make_value (trailer.a.prev_generation)},
+                {"skip_generation", make_value (trailer.a.skip_generation)},
                 {"indices", make_value (std::begin (trailer.a.index_records),
                                         std::end (trailer.a.index_records))},
                 {"crc", make_value (trailer.crc)},
@@ -93,17 +93,15 @@ namespace pstore {
                     // The first (zeroth) transaction in the store is, by definition, empty.
                     return;
                 }
-                auto const * sep = "\n";
-
-                auto const out_fn = [&] (address const addr) {
+                std::vector<address> added;
+                diff (db, *compilations, generation - 1U, std::back_inserter (added));
+                emit_members (os, added, [&] (ostream_base & os1, address const addr) {
                     auto const & kvp = compilations->load_leaf_node (db, addr);
-                    os << sep << ind;
-                    emit_digest (os, kvp.first);
-                    os << ':';
-                    emit_compilation (os, ind, db, *db.getro (kvp.second), strings, comments);
-                    sep = ",\n";
-                };
-                diff (db, *compilations, generation - 1U, make_diff_out (&out_fn));
+                    os1 << ind;
+                    emit_digest (os1, kvp.first);
+                    os1 << ':';
+                    emit_compilation (os1, ind, db, *db.getro (kvp.second), strings, comments);
+                });
             }
 
         } // end namespace export_ns
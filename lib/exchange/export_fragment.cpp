@@ -53,19 +53,16 @@ namespace pstore {
                                  bool const comments) {
                 auto const fragments = index::get_index<trailer::indices::fragment> (db);
                 if (!fragments->empty ()) {
-                    auto const * fragment_sep = "\n";
                     PSTORE_ASSERT (generation > 0U);
-
-                    auto const out_fn = [&] (address const addr) {
+                    std::vector<address> added;
+                    diff (db, *fragments, generation - 1U, std::back_inserter (added));
+                    emit_members (os, added, [&] (ostream_base & os1, address const addr) {
                         auto const & kvp = fragments->load_leaf_node (db, addr);
-                        os << fragment_sep << ind;
-                        emit_digest (os, kvp.first);
-                        os << ':';
-                        emit_fragment (os, ind, db, strings, db.getro (kvp.second), comments);
-                        fragment_sep = ",\n";
-                    };
-
-                    diff (db, *fragments, generation - 1U, make_diff_out (&out_fn));
+                        os1 << ind;
+                        emit_digest (os1, kvp.first);
+                        os1 << ':';
+                        emit_fragment (os1, ind, db, strings, db.getro (kvp.second), comments);
+                    });
                 }
             }
 
@@ -20,9 +20,12 @@
 #include <functional>
 #include <iterator>
 #include <limits>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "pstore/http/http_date.hpp"
 #include "pstore/support/ctype.hpp"
 
 using pstore::http::header_info;
@@ -81,6 +84,18 @@ namespace {
 
 
 
+    /// Returns a pair of iterators which describe \p str without any leading or trailing
+    /// whitespace.
+    std::pair<std::string::const_iterator, std::string::const_iterator>
+    trim (std::string const & str) {
+        auto is_ws = [] (char const c) { return pstore::isspace (c); };
+        // Remove trailing whitespace.
+        auto const end = std::find_if_not (str.rbegin (), str.rend (), is_ws).base ();
+        // Skip leading whitespace.
+        auto const begin = std::find_if_not (str.begin (), end, is_ws);
+        return {begin, end};
+    }
+
     header_info upgrade (header_info hi, std::string const & value) {
         if (case_insensitive_equal ("websocket", value)) {
             hi.upgrade_to_websocket = true;
@@ -88,25 +103,85 @@ namespace {
         return hi;
     }
 
-    // The "connection" header is a comma-separated string. We're looking for the "upgrade" request.
+    // The "connection" header is a comma-separated string. We're looking for the "upgrade" and
+    // "close" options.
     header_info connection (header_info hi, std::string const & value) {
         static std::string const upgrade = "upgrade";
+        static std::string const close = "close";
 
         std::vector<std::string> strings;
         split (value, std::back_inserter (strings), ',');
 
         for (auto const & str : strings) {
-            auto is_ws = [] (char const c) { return pstore::isspace (c); };
-            // Remove trailing whitespace.
-            auto const end = std::find_if_not (str.rbegin (), str.rend (), is_ws).base ();
-            // Skip leading whitespace.
-            auto const begin = std::find_if_not (str.begin (), end, is_ws);
-
+            std::string::const_iterator begin;
+            std::string::const_iterator end;
+            std::tie (begin, end) = trim (str);
             if (case_insensitive_equal (upgrade, begin, end)) {
                 hi.connection_upgrade = true;
+            } else if (case_insensitive_equal (close, begin, end)) {
+                hi.connection_close = true;
+            }
+        }
+
+        return hi;
+    }
+
+    // The "accept-encoding" header is a comma-separated list of content codings, each of which
+    // may be followed by a weight (e.g. "gzip;q=0.5"). A weight of 0 means "not acceptable". An
+    // explicit gzip entry takes precedence over "*" wherever it appears in the list (RFC 7231
+    // section 5.3.4).
+    header_info accept_encoding (header_info hi, std::string const & value) {
+        static std::string const gzip = "gzip";
+        static std::string const x_gzip = "x-gzip";
+        static std::string const any = "*";
+
+        std::vector<std::string> strings;
+        split (value, std::back_inserter (strings), ',');
+
+        pstore::maybe<bool> explicit_gzip;
+        pstore::maybe<bool> wildcard;
+        for (auto const & str : strings) {
+            std::vector<std::string> parts;
+            split (str, std::back_inserter (parts), ';');
+
+            std::string::const_iterator begin;
+            std::string::const_iterator end;
+            std::tie (begin, end) = trim (parts.front ());
+            bool const is_wildcard = case_insensitive_equal (any, begin, end);
+            if (!is_wildcard && !case_insensitive_equal (gzip, begin, end) &&
+                !case_insensitive_equal (x_gzip, begin, end)) {
+                continue;
+            }
+
+            bool acceptable = true;
+            for (auto it = std::next (parts.begin ()); it != parts.end (); ++it) {
+                std::tie (begin, end) = trim (*it);
+                if (std::distance (begin, end) > 2 && (*begin == 'q' || *begin == 'Q') &&
+                    *std::next (begin) == '=') {
+                    // qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] )
+                    acceptable = std::any_of (std::next (begin, 2), end,
+                                              [] (char const c) { return c >= '1' && c <= '9'; });
+                }
             }
+            (is_wildcard ? wildcard : explicit_gzip) = acceptable;
+        }
+
+        if (explicit_gzip) {
+            hi.accept_gzip = *explicit_gzip;
+        } else if (wildcard) {
+            hi.accept_gzip = *wildcard;
         }
+        return hi;
+    }
+
+    header_info if_modified_since_handler (header_info hi, std::string const & value) {
+        // An invalid date is ignored.
+        hi.if_modified_since = pstore::http::parse_http_date (value);
+        return hi;
+    }
 
+    header_info if_none_match_handler (header_info hi, std::string const & value) {
+        hi.if_none_match = value;
         return hi;
     }
 
@@ -138,8 +213,10 @@ namespace {
 
 bool pstore::http::header_info::operator== (header_info const & rhs) const {
     return upgrade_to_websocket == rhs.upgrade_to_websocket &&
-           connection_upgrade == rhs.connection_upgrade && websocket_key == rhs.websocket_key &&
-           websocket_version == rhs.websocket_version;
+           connection_upgrade == rhs.connection_upgrade &&
+           connection_close == rhs.connection_close && websocket_key == rhs.websocket_key &&
+           websocket_version == rhs.websocket_version && if_none_match == rhs.if_none_match &&
+           if_modified_since == rhs.if_modified_since && accept_gzip == rhs.accept_gzip;
 }
 
 header_info pstore::http::header_info::handler (std::string const & key,
@@ -147,7 +224,10 @@ header_info pstore::http::header_info::handler (std::string const & key,
     static std::unordered_map<
         std::string, std::function<header_info (header_info, std::string const & value)>> const
         handlers = {
+            {"accept-encoding", accept_encoding},
             {"connection", connection},
+            {"if-modified-since", if_modified_since_handler},
+            {"if-none-match", if_none_match_handler},
             {"upgrade", upgrade},
             {"sec-websocket-key", sec_websocket_key},
             {"sec-websocket-version", sec_websocket_version},
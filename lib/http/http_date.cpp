@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <array>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
@@ -29,6 +30,43 @@ namespace {
         return std::min (static_cast<std::size_t> (std::max (v, T{0})), size - std::size_t{1});
     }
 
+    constexpr std::array<char const *, 7> days{{"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"}};
+    constexpr std::array<char const *, 12> months{
+        {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"}};
+
+    /// Returns the index of the three character name at \p str in \p names or -1 if there is
+    /// no match.
+    template <std::size_t Size>
+    int find_name (std::array<char const *, Size> const & names, char const * const str) {
+        auto const pos = std::find_if (
+            std::begin (names), std::end (names),
+            [str] (char const * const name) { return std::strncmp (name, str, 3) == 0; });
+        return pos == std::end (names) ? -1 : static_cast<int> (pos - std::begin (names));
+    }
+
+    /// Reads \p digits decimal digits starting at \p str.
+    pstore::maybe<int> read_number (char const * str, unsigned const digits) {
+        int result = 0;
+        for (auto d = 0U; d < digits; ++d, ++str) {
+            if (*str < '0' || *str > '9') {
+                return pstore::nothing<int> ();
+            }
+            result = result * 10 + (*str - '0');
+        }
+        return pstore::just (result);
+    }
+
+    /// Returns the number of days between 1970-01-01 and the given date in the proleptic
+    /// Gregorian calendar. (This is Howard Hinnant's days_from_civil() algorithm.)
+    std::int64_t days_from_civil (std::int64_t y, unsigned const m, unsigned const d) noexcept {
+        y -= m <= 2;
+        std::int64_t const era = (y >= 0 ? y : y - 399) / 400;
+        auto const yoe = static_cast<unsigned> (y - era * 400);                // [0, 399]
+        unsigned const doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1; // [0, 365]
+        unsigned const doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;           // [0, 146096]
+        return era * 146097 + static_cast<std::int64_t> (doe) - 719468;
+    }
+
 } // end anonymous namespace
 
 namespace pstore {
@@ -45,8 +83,6 @@ namespace pstore {
             //          / %x46.72.69 ; "Fri", case-sensitive
             //          / %x53.61.74 ; "Sat", case-sensitive
             //          / %x53.75.6E ; "Sun", case-sensitive
-            static constexpr std::array<char const *, 7> days{
-                {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"}};
             auto const day_name = days[as_index (t.tm_wday, days.size ())];
 
             // month = %x4A.61.6E ; "Jan", case-sensitive
@@ -61,9 +97,6 @@ namespace pstore {
             //       / %x4F.63.74 ; "Oct", case-sensitive
             //       / %x4E.6F.76 ; "Nov", case-sensitive
             //       / %x44.65.63 ; "Dec", case-sensitive
-            static constexpr std::array<char const *, 12> months{{"Jan", "Feb", "Mar", "Apr", "May",
-                                                                  "Jun", "Jul", "Aug", "Sep", "Oct",
-                                                                  "Nov", "Dec"}};
             auto const month = months[as_index (t.tm_mon, months.size ())];
 
             // hour         = 2DIGIT
@@ -88,5 +121,34 @@ namespace pstore {
             return http_date (std::chrono::system_clock::to_time_t (time));
         }
 
+        // IMF-fixdate = day-name "," SP date1 SP time-of-day SP GMT
+        // e.g., "Sun, 06 Nov 1994 08:49:37 GMT"
+        maybe<std::time_t> parse_http_date (std::string const & str) {
+            static constexpr auto fixdate_length = std::size_t{29};
+            if (str.length () != fixdate_length) {
+                return nothing<std::time_t> ();
+            }
+            char const * const s = str.c_str ();
+            if (find_name (days, s) < 0 || std::strncmp (s + 3, ", ", 2) != 0 || s[7] != ' ' ||
+                s[11] != ' ' || s[16] != ' ' || s[19] != ':' || s[22] != ':' ||
+                std::strcmp (s + 25, " GMT") != 0) {
+                return nothing<std::time_t> ();
+            }
+            int const month = find_name (months, s + 8);
+            maybe<int> const day = read_number (s + 5, 2);
+            maybe<int> const year = read_number (s + 12, 4);
+            maybe<int> const hour = read_number (s + 17, 2);
+            maybe<int> const minute = read_number (s + 20, 2);
+            maybe<int> const second = read_number (s + 23, 2);
+            if (month < 0 || !day || !year || !hour || !minute || !second || *day < 1 ||
+                *day > 31 || *hour > 23 || *minute > 59 || *second > 60) {
+                return nothing<std::time_t> ();
+            }
+            std::int64_t const days_since_epoch = days_from_civil (
+                *year, static_cast<unsigned> (month + 1), static_cast<unsigned> (*day));
+            return just (static_cast<std::time_t> (days_since_epoch * 86400 + *hour * 3600 +
+                                                   *minute * 60 + *second));
+        }
+
     } // end namespace http
 } // end namespace pstore
@@ -15,10 +15,15 @@
 //===----------------------------------------------------------------------===//
 #include "pstore/http/net_txrx.hpp"
 
+#include <algorithm>
+#include <vector>
+
 #ifdef _WIN32
 #    include <winsock2.h>
 #else
+#    include <climits>
 #    include <sys/socket.h>
+#    include <sys/uio.h>
 #endif // _WIN32
 
 #include "pstore/http/error.hpp"
@@ -93,6 +98,62 @@ namespace pstore {
                 return result_type{socket};
             }
 
+#ifdef _WIN32
+            error_or<socket_descriptor &>
+            network_gather_sender (socket_descriptor & socket,
+                                   gsl::span<gsl::span<std::uint8_t const> const> const buffers) {
+                using result_type = error_or<socket_descriptor &>;
+                for (gsl::span<std::uint8_t const> const & buffer : buffers) {
+                    result_type const eo = network_sender (socket, buffer);
+                    if (!eo) {
+                        return eo;
+                    }
+                }
+                return result_type{socket};
+            }
+#else
+            error_or<socket_descriptor &>
+            network_gather_sender (socket_descriptor & socket,
+                                   gsl::span<gsl::span<std::uint8_t const> const> const buffers) {
+                using result_type = error_or<socket_descriptor &>;
+
+                std::vector<iovec> iov;
+                iov.reserve (static_cast<std::size_t> (buffers.size ()));
+                for (gsl::span<std::uint8_t const> const & buffer : buffers) {
+                    if (!buffer.empty ()) {
+                        iov.push_back (iovec{const_cast<std::uint8_t *> (buffer.data ()),
+                                             static_cast<std::size_t> (buffer.size ())});
+                    }
+                }
+
+                auto first = iov.begin ();
+                while (first != iov.end ()) {
+                    auto const count =
+                        std::min (std::distance (first, iov.end ()), std::ptrdiff_t{IOV_MAX});
+                    ssize_t written =
+                        ::writev (socket.native_handle (), &*first, static_cast<int> (count));
+                    if (written < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        return result_type{get_last_error ()};
+                    }
+                    // Skip the buffers that were written in their entirety and adjust the first
+                    // of any that were written only in part.
+                    for (; first != iov.end () &&
+                           static_cast<std::size_t> (written) >= first->iov_len;
+                         ++first) {
+                        written -= static_cast<ssize_t> (first->iov_len);
+                    }
+                    if (first != iov.end ()) {
+                        first->iov_base = static_cast<std::uint8_t *> (first->iov_base) + written;
+                        first->iov_len -= static_cast<std::size_t> (written);
+                    }
+                }
+                return result_type{socket};
+            }
+#endif // _WIN32
+
         } // end namespace net
     }     // end namespace http
 } // end namespace pstore
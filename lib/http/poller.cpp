@@ -0,0 +1,135 @@
+//===- lib/http/poller.cpp ------------------------------------------------===//
+//*              _ _            *
+//*  _ __   ___ | | | ___ _ __  *
+//* | '_ \ / _ \| | |/ _ \ '__| *
+//* | |_) | (_) | | |  __/ |    *
+//* | .__/ \___/|_|_|\___|_|    *
+//* |_|                         *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file poller.cpp
+/// \brief Implements the poller class which waits for input on a set of descriptors.
+
+#include "pstore/http/poller.hpp"
+
+#ifndef _WIN32
+
+#    include <algorithm>
+#    include <array>
+#    include <cerrno>
+
+#    ifdef __linux__
+#        include <sys/epoll.h>
+#    endif
+
+#    include "pstore/support/error.hpp"
+
+namespace pstore {
+    namespace http {
+
+#    ifdef __linux__
+
+        // ctor
+        // ~~~~
+        poller::poller ()
+                : epoll_{::epoll_create1 (EPOLL_CLOEXEC)} {
+            if (!epoll_.valid ()) {
+                raise (errno_erc{errno}, "epoll_create1");
+            }
+        }
+
+        // add
+        // ~~~
+        void poller::add (int const fd) {
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            if (::epoll_ctl (epoll_.native_handle (), EPOLL_CTL_ADD, fd, &ev) != 0) {
+                raise (errno_erc{errno}, "epoll_ctl");
+            }
+        }
+
+        // remove
+        // ~~~~~~
+        void poller::remove (int const fd) {
+            // A non-null event pointer is required by kernels before 2.6.9.
+            epoll_event ev{};
+            if (::epoll_ctl (epoll_.native_handle (), EPOLL_CTL_DEL, fd, &ev) != 0) {
+                raise (errno_erc{errno}, "epoll_ctl");
+            }
+        }
+
+        // wait
+        // ~~~~
+        void poller::wait (std::vector<int> * const ready,
+                           std::chrono::milliseconds const timeout) {
+            std::array<epoll_event, 64> events;
+            int num = 0;
+            while ((num = ::epoll_wait (epoll_.native_handle (), events.data (),
+                                        static_cast<int> (events.size ()),
+                                        static_cast<int> (timeout.count ()))) == -1 &&
+                   errno == EINTR) {
+                continue; // Restart if interrupted by signal.
+            }
+            if (num == -1) {
+                raise (errno_erc{errno}, "epoll_wait");
+            }
+            std::for_each (events.data (), events.data () + num,
+                           [ready] (epoll_event const & ev) { ready->push_back (ev.data.fd); });
+        }
+
+#    else
+
+        // ctor
+        // ~~~~
+        poller::poller () = default;
+
+        // add
+        // ~~~
+        void poller::add (int const fd) {
+            pollfd pfd{};
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+            fds_.push_back (pfd);
+        }
+
+        // remove
+        // ~~~~~~
+        void poller::remove (int const fd) {
+            fds_.erase (std::remove_if (std::begin (fds_), std::end (fds_),
+                                        [fd] (pollfd const & pfd) { return pfd.fd == fd; }),
+                        std::end (fds_));
+        }
+
+        // wait
+        // ~~~~
+        void poller::wait (std::vector<int> * const ready,
+                           std::chrono::milliseconds const timeout) {
+            int num = 0;
+            while ((num = ::poll (fds_.data (), static_cast<nfds_t> (fds_.size ()),
+                                  static_cast<int> (timeout.count ()))) == -1 &&
+                   errno == EINTR) {
+                continue; // Restart if interrupted by signal.
+            }
+            if (num == -1) {
+                raise (errno_erc{errno}, "poll");
+            }
+            for (pollfd const & pfd : fds_) {
+                if (pfd.revents != 0) {
+                    ready->push_back (pfd.fd);
+                }
+            }
+        }
+
+#    endif // __linux__
+
+    } // end namespace http
+} // end namespace pstore
+
+#endif // _WIN32
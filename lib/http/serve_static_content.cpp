@@ -0,0 +1,107 @@
+//===- lib/http/serve_static_content.cpp ----------------------------------===//
+//*                                _        _   _       *
+//*  ___  ___ _ ____   _____   ___| |_ __ _| |_(_) ___  *
+//* / __|/ _ \ '__\ \ / / _ \ / __| __/ _` | __| |/ __| *
+//* \__ \  __/ |   \ V /  __/ \__ \ || (_| | |_| | (__  *
+//* |___/\___|_|    \_/ \___| |___/\__\__,_|\__|_|\___| *
+//*                                                     *
+//*                  _             _    *
+//*   ___ ___  _ __ | |_ ___ _ __ | |_  *
+//*  / __/ _ \| '_ \| __/ _ \ '_ \| __| *
+//* | (_| (_) | | | | ||  __/ | | | |_  *
+//*  \___\___/|_| |_|\__\___|_| |_|\__| *
+//*                                     *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+#include "pstore/http/serve_static_content.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "pstore/support/ctype.hpp"
+
+namespace {
+
+    /// Returns the opaque part of an entity tag: that is, without any weakness indicator.
+    std::string opaque_tag (std::string::const_iterator first,
+                            std::string::const_iterator const last) {
+        if (std::distance (first, last) >= 2 && *first == 'W' && *std::next (first) == '/') {
+            std::advance (first, 2);
+        }
+        return {first, last};
+    }
+
+    /// Returns true if the comma-separated list of entity tags \p tags contains one which
+    /// matches \p etag. As required for If-None-Match, the weak comparison function is used:
+    /// entity tags match if their opaque tags are the same regardless of whether either is
+    /// weak.
+    bool etag_list_matches (std::string const & tags, std::string const & etag) {
+        auto is_ws = [] (char const c) { return pstore::isspace (c) || c == ','; };
+        std::string const wanted = opaque_tag (std::begin (etag), std::end (etag));
+        auto first = std::begin (tags);
+        auto const last = std::end (tags);
+        for (;;) {
+            first = std::find_if_not (first, last, is_ws);
+            if (first == last) {
+                return false;
+            }
+            auto const end = std::find (first, last, ',');
+            // Remove trailing whitespace.
+            auto tag_end = end;
+            while (tag_end != first && pstore::isspace (*std::prev (tag_end))) {
+                --tag_end;
+            }
+            if (opaque_tag (first, tag_end) == wanted) {
+                return true;
+            }
+            first = end;
+        }
+    }
+
+} // end anonymous namespace
+
+namespace pstore {
+    namespace http {
+        namespace details {
+
+            // gzip etag
+            // ~~~~~~~~~
+            std::string gzip_etag (std::string const & etag) {
+                if (etag.length () < 2 || etag.back () != '"') {
+                    return etag;
+                }
+                std::string result = etag;
+                result.insert (result.length () - 1U, "-gzip");
+                return result;
+            }
+
+            // is not modified
+            // ~~~~~~~~~~~~~~~
+            bool is_not_modified (header_info const & request_headers, std::string const & etag,
+                                  std::time_t const mtime) {
+                // If-None-Match takes precedence over If-Modified-Since (RFC 7232 section 6).
+                if (request_headers.if_none_match) {
+                    std::string const & tags = *request_headers.if_none_match;
+                    auto const first_non_ws =
+                        std::find_if_not (std::begin (tags), std::end (tags),
+                                          [] (char const c) { return pstore::isspace (c); });
+                    if (first_non_ws != std::end (tags) && *first_non_ws == '*') {
+                        return true;
+                    }
+                    return !etag.empty () && etag_list_matches (tags, etag);
+                }
+                if (request_headers.if_modified_since) {
+                    return mtime <= *request_headers.if_modified_since;
+                }
+                return false;
+            }
+
+        } // end namespace details
+    }     // end namespace http
+} // end namespace pstore
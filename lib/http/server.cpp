@@ -15,11 +15,28 @@
 //===----------------------------------------------------------------------===//
 /// \file server.cpp
 /// \brief Implements the top-level HTTP server functions.
+///
+/// On POSIX systems the server is driven by an event loop. A single thread waits (using epoll
+/// on Linux) for new connections, for input on idle connections, and for messages published to
+/// the WebSockets channels. Each connection which becomes readable is handed to a fixed pool of
+/// worker threads which serves the requests that it has sent before returning it to the loop.
+/// HTTP/1.1 connections are kept open between requests and pipelined requests are served in
+/// turn. WebSockets sessions are multiplexed onto the same loop and workers. The loop limits
+/// the number of connections from each peer, closes persistent connections which stay idle,
+/// and disconnects a peer which doesn't finish sending a request in good time.
+///
+/// On Windows, connections are served one at a time and are closed after each request. Each
+/// WebSockets session has a thread of its own.
 #include "pstore/http/server.hpp"
 
 // Standard library includes
+#include <chrono>
 #include <cstring>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 // OS-specific includes
 #ifdef _WIN32
@@ -33,16 +50,22 @@
 #include "pstore/http/error_reporting.hpp"
 #include "pstore/http/headers.hpp"
 #include "pstore/http/net_txrx.hpp"
+#include "pstore/http/poller.hpp"
 #include "pstore/http/request.hpp"
 #include "pstore/http/serve_dynamic_content.hpp"
 #include "pstore/http/serve_static_content.hpp"
+#include "pstore/http/server_status.hpp"
 #include "pstore/http/wskey.hpp"
+#include "pstore/os/thread.hpp"
+#include "pstore/support/thread_pool.hpp"
 
 using namespace std::literals::string_literals;
 
 namespace {
 
     using socket_descriptor = pstore::socket_descriptor;
+    using reader_type =
+        pstore::http::buffered_reader<socket_descriptor &, decltype (&pstore::http::net::refiller)>;
 
     // initialize socket
     // ~~~~~~~~~~~~~~~~~
@@ -71,7 +94,7 @@ namespace {
         }
 
         // Get ready to accept connection requests.
-        if (::listen (fd.native_handle (), 5) < 0) { // allow 5 requests to queue up.
+        if (::listen (fd.native_handle (), SOMAXCONN) < 0) {
             return eo{pstore::http::get_last_error ()};
         }
 
@@ -98,12 +121,12 @@ namespace {
         return pstore::error_or<std::string>{pstore::in_place, host_name.data ()};
     }
 
-    template <typename Reader, typename IO>
-    pstore::error_or<std::unique_ptr<std::thread>>
-    upgrade_to_ws (Reader & reader, IO io, pstore::http::request_info const & request,
-                   pstore::http::header_info const & header_contents,
-                   pstore::http::channel_container const & channels) {
-        using return_type = pstore::error_or<std::unique_ptr<std::thread>>;
+    // accept ws upgrade
+    // ~~~~~~~~~~~~~~~~~
+    /// Validates a request to upgrade a connection to the WebSockets protocol and, if it is
+    /// acceptable, sends the server handshake response.
+    template <typename IO>
+    std::error_code accept_ws_upgrade (IO io, pstore::http::header_info const & header_contents) {
         using priority = pstore::logger::priority;
         PSTORE_ASSERT (header_contents.connection_upgrade && header_contents.upgrade_to_websocket);
 
@@ -111,108 +134,149 @@ namespace {
         // Validate the request headers
         if (!header_contents.websocket_key || !header_contents.websocket_version) {
             log (priority::error, "Missing WebSockets upgrade key or version header.");
-            return return_type{pstore::http::error_code::bad_request};
+            return make_error_code (pstore::http::error_code::bad_request);
         }
 
 
         if (*header_contents.websocket_version != pstore::http::ws_version) {
             log (priority::error, "Bad Websocket version number requested");
-            return return_type{pstore::http::error_code::bad_websocket_version};
+            return make_error_code (pstore::http::error_code::bad_websocket_version);
         }
 
 
         // Send back the server handshake response.
-        auto const accept_ws_connection = [&header_contents, &io] () {
-            log (priority::info, "Accepting WebSockets upgrade");
-
-            std::string const date = pstore::http::http_date (std::chrono::system_clock::now ());
-            std::string const accept = pstore::http::source_key (*header_contents.websocket_key);
-
-            std::array<pstore::http::czstring_pair, 5> headers{{
-                {"Upgrade", "WebSocket"},
-                {"Connection", "Upgrade"},
-                {"Sec-WebSocket-Accept", accept.c_str ()},
-                {"Date", date.c_str ()},
-                {"Last-Modified", date.c_str ()},
-            }};
-
-            auto const status_line = build_status_line (
-                pstore::http::http_status_code::switching_protocols, "Switching Protocols");
-
-            auto sender = pstore::http::net::network_sender;
-            return pstore::http::send (sender, io, status_line) >>= [&] (IO io2) {
-                return pstore::http::send (
-                    sender, io2,
-                    pstore::http::build_headers (std::begin (headers), std::end (headers)));
-            };
-        };
+        log (priority::info, "Accepting WebSockets upgrade");
+
+        std::string const date = pstore::http::http_date (std::chrono::system_clock::now ());
+        std::string const accept = pstore::http::source_key (*header_contents.websocket_key);
+
+        std::array<pstore::http::czstring_pair, 5> headers{{
+            {"Upgrade", "WebSocket"},
+            {"Connection", "Upgrade"},
+            {"Sec-WebSocket-Accept", accept.c_str ()},
+            {"Date", date.c_str ()},
+            {"Last-Modified", date.c_str ()},
+        }};
+
+        auto const status_line = build_status_line (
+            pstore::http::http_status_code::switching_protocols, "Switching Protocols");
+
+        auto sender = pstore::http::net::network_sender;
+        return (pstore::http::send (sender, io, status_line) >>= [&] (IO io2) {
+                   return pstore::http::send (
+                       sender, io2,
+                       pstore::http::build_headers (std::begin (headers), std::end (headers)));
+               }).get_error ();
+    }
 
-        auto server_loop_thread = [&channels] (Reader && reader2, socket_descriptor io2,
-                                               std::string const uri) {
-            PSTORE_TRY {
-                constexpr auto ident = "websocket";
-                pstore::threads::set_name (ident);
-                pstore::create_log_stream (ident);
+    // keep alive
+    // ~~~~~~~~~~
+    /// Returns true if the connection on which a request was received should be kept open once
+    /// the response has been sent. HTTP/1.1 connections are persistent unless the client asks
+    /// otherwise. Earlier versions of the protocol are always closed.
+    bool keep_alive (pstore::http::request_info const & request,
+                     pstore::http::header_info const & header_contents) {
+        return request.version () == "HTTP/1.1" && !header_contents.connection_close;
+    }
 
-                log (priority::info, "Started WebSockets session");
+    /// What should become of a connection once a request has been served.
+    enum class disposition {
+        /// Wait for the next request.
+        keep_alive,
+        /// Close the connection.
+        close,
+        /// The connection was upgraded to the WebSockets protocol.
+        websocket,
+    };
+
+    // serve request
+    // ~~~~~~~~~~~~~
+    /// Reads a single HTTP request from a connection and sends the response.
+    ///
+    /// \param reader  The buffered reader from which the request is read.
+    /// \param socket  The connection's socket.
+    /// \param file_system  The file system from which static content is served.
+    /// \param persistent  True if the server can keep the connection open once the response
+    ///   has been sent. If false, or if the client doesn't want a persistent connection, the
+    ///   response tells the client that the connection will be closed.
+    /// \param ws_uri  If the connection is upgraded to the WebSockets protocol, receives the
+    ///   request URI.
+    /// \returns  What should become of the connection.
+    disposition serve_request (reader_type & reader, socket_descriptor & socket,
+                               pstore::romfs::romfs & file_system, bool const persistent,
+                               pstore::gsl::not_null<std::string *> const ws_uri) {
+        using namespace pstore::http;
+        using priority = pstore::logger::priority;
 
-                PSTORE_ASSERT (io2.valid ());
-                ws_server_loop (std::move (reader2), pstore::http::net::network_sender,
-                                std::ref (io2), uri, channels);
+        // Get the HTTP request line.
+        PSTORE_ASSERT (socket.valid ());
+        pstore::error_or_n<socket_descriptor &, request_info> const eri =
+            read_request (reader, std::ref (socket));
+        if (!eri) {
+            // A peer which closes an idle persistent connection is not an error.
+            if (eri.get_error () != details::out_of_data_error ()) {
+                log (priority::error, "Failed reading HTTP request: ", eri.get_error ().message ());
+            }
+            return disposition::close;
+        }
+        request_info const & request = std::get<1> (eri);
+        log (priority::info, "Request: ",
+             request.method () + ' ' + request.version () + ' ' + request.uri ());
+
+        // We only currently support the GET method.
+        if (request.method () != "GET") {
+            report_error (make_error_code (pstore::http::error_code::not_implemented), request,
+                          socket);
+            return disposition::close;
+        }
 
-                log (priority::info, "Ended WebSockets session");
+        // Respond appropriately based on the request and headers.
+        auto result = disposition::close;
+        auto const serve_reply = [&] (socket_descriptor & io2,
+                                      header_info const & header_contents) -> std::error_code {
+            if (header_contents.connection_upgrade && header_contents.upgrade_to_websocket) {
+                std::error_code const err = accept_ws_upgrade (std::ref (io2), header_contents);
+                if (!err) {
+                    *ws_uri = request.uri ();
+                    result = disposition::websocket;
+                }
+                return err;
             }
-            // clang-format off
-            PSTORE_CATCH (std::exception const & ex, { //clang-format on
-                log (priority::error, "Error: ", ex.what ());
-            })
-            // clang-format off
-            PSTORE_CATCH (..., { // clang-format on
-                log (priority::error, "Unknown exception");
-            })
-        };
 
-        // Spawn a thread to manage this WebSockets session.
-        auto const create_ws_server = [&reader, server_loop_thread,
-                                       &request] (socket_descriptor & s) {
-            PSTORE_ASSERT (s.valid ());
-            return return_type{pstore::in_place,
-                               new std::thread (server_loop_thread, std::move (reader),
-                                                std::move (s), request.uri ())};
+            bool const keep = persistent && keep_alive (request, header_contents);
+            std::error_code const err =
+                !details::starts_with (request.uri (), dynamic_path)
+                    ? serve_static_content (net::network_sender, std::ref (io2), request.uri (),
+                                            file_system, header_contents, keep)
+                          .get_error ()
+                    : serve_dynamic_content (net::network_sender, std::ref (io2), request.uri (),
+                                             keep)
+                          .get_error ();
+            if (!err && keep) {
+                result = disposition::keep_alive;
+            }
+            return err;
         };
 
-        PSTORE_ASSERT (io.get ().valid ());
-        return accept_ws_connection () >>= create_ws_server;
-    }
-
-#ifndef NDEBUG
-    template <typename BufferedReader>
-    bool input_is_empty (BufferedReader const & reader, socket_descriptor const & fd) {
-        if (reader.available () == 0) {
-            return true;
-        }
-#    ifdef _WIN32
-        // TODO: not yet implemented for Windows.
-        (void) fd;
-        return true;
-#    else
-        // There should be nothing in the buffered-reader or the input socket waiting to be read.
-        errno = 0;
-        std::array<std::uint8_t, 256> buf;
-        ssize_t const nread = recv (fd.native_handle (), buf.data (),
-                                    static_cast<int> (buf.size ()), MSG_PEEK /*flags*/);
-        int const err = errno;
-        if (nread == -1) {
-            log (pstore::logger::priority::error, "error:", err);
-        }
-        return nread == 0 || nread == -1;
-#    endif
+        // Scan the HTTP headers.
+        std::error_code const err =
+            read_headers (
+                reader, std::ref (socket),
+                [] (header_info io, std::string const & key, std::string const & value) {
+                    return io.handler (key, value);
+                },
+                header_info ()) >>= serve_reply;
+        if (err) {
+            // Report the error to the user as an HTTP error.
+            report_error (err, request, socket);
+            return disposition::close;
+        }
+        return result;
     }
-#endif
 
-    // wait for connection
-    // ~~~~~~~~~~~~~~~~~~~
-    pstore::error_or<socket_descriptor> wait_for_connection (socket_descriptor const & parentfd) {
+    // accept connection
+    // ~~~~~~~~~~~~~~~~~
+    pstore::error_or<socket_descriptor> accept_connection (socket_descriptor const & parentfd) {
         using return_type = pstore::error_or<socket_descriptor>;
 
         using priority = pstore::logger::priority;
@@ -238,6 +302,40 @@ namespace {
 
 } // end anonymous namespace
 
+#ifdef _WIN32
+
+namespace {
+
+    // run ws session
+    // ~~~~~~~~~~~~~~
+    void run_ws_session (reader_type && reader, socket_descriptor io, std::string const uri,
+                         pstore::http::channel_container const & channels) {
+        using priority = pstore::logger::priority;
+        PSTORE_TRY {
+            constexpr auto ident = "websocket";
+            pstore::threads::set_name (ident);
+            pstore::create_log_stream (ident);
+
+            log (priority::info, "Started WebSockets session");
+
+            PSTORE_ASSERT (io.valid ());
+            ws_server_loop (std::move (reader), pstore::http::net::network_sender, std::ref (io),
+                            uri, channels);
+
+            log (priority::info, "Ended WebSockets session");
+        }
+        // clang-format off
+        PSTORE_CATCH (std::exception const & ex, { //clang-format on
+            log (priority::error, "Error: ", ex.what ());
+        })
+        // clang-format off
+        PSTORE_CATCH (..., { // clang-format on
+            log (priority::error, "Unknown exception");
+        })
+    }
+
+} // end anonymous namespace
+
 namespace pstore {
     namespace http {
 
@@ -257,7 +355,7 @@ namespace pstore {
 
             log (priority::info, "starting server-loop on port ", status->port ());
 
-            std::vector<std::unique_ptr<std::thread>> websockets_workers;
+            std::vector<std::thread> websockets_workers;
             notify_listening (status->port ());
 
             for (auto expected_state = server_status::http_state::initializing;
@@ -265,86 +363,496 @@ namespace pstore {
                  expected_state = server_status::http_state::listening) {
 
                 // Wait for a connection request.
-                error_or<socket_descriptor> echildfd = wait_for_connection (parentfd);
+                error_or<socket_descriptor> echildfd = accept_connection (parentfd);
                 if (!echildfd) {
-                    log (priority::error,
-                         "wait_for_connection: ", echildfd.get_error ().message ());
+                    log (priority::error, "accept_connection: ", echildfd.get_error ().message ());
                     continue;
                 }
                 socket_descriptor & childfd = *echildfd;
 
-                // Get the HTTP request line.
+                // Connections are served one at a time so they are not kept alive.
                 auto reader = make_buffered_reader<socket_descriptor &> (net::refiller);
-
-                PSTORE_ASSERT (childfd.valid ());
-                error_or_n<socket_descriptor &, request_info> eri =
-                    read_request (reader, std::ref (childfd));
-                if (!eri) {
-                    log (priority::error,
-                         "Failed reading HTTP request: ", eri.get_error ().message ());
-                    continue;
+                std::string uri;
+                if (serve_request (reader, childfd, file_system, false /*persistent*/, &uri) ==
+                    disposition::websocket) {
+                    websockets_workers.emplace_back (run_ws_session, std::move (reader),
+                                                     std::move (childfd), uri,
+                                                     std::cref (channels));
                 }
-                childfd = std::move (std::get<0> (eri));
-                request_info const & request = std::get<1> (eri);
-                log (priority::info, "Request: ",
-                     request.method () + ' ' + request.version () + ' ' + request.uri ());
-
-                // We only currently support the GET method.
-                if (request.method () != "GET") {
-                    report_error (make_error_code (pstore::http::error_code::not_implemented),
-                                  request, childfd);
-                    continue;
+            }
+
+            for (std::thread & worker : websockets_workers) {
+                worker.join ();
+            }
+            return 0;
+        }
+
+    } // end namespace http
+} // end namespace pstore
+
+#else // _WIN32
+
+namespace {
+
+    using time_point = std::chrono::steady_clock::time_point;
+
+    /// The time allowed for a worker to read a request, or a WebSockets frame, once the peer has
+    /// started to send it. A peer which stalls part way through is disconnected so that it can't
+    /// hold on to the worker.
+    constexpr auto request_deadline = std::chrono::seconds{10};
+    /// A connection on which no request arrives for this long is closed.
+    constexpr auto idle_timeout = std::chrono::seconds{30};
+    /// The maximum number of connections which may be open from a single peer address.
+    constexpr auto max_peer_connections = std::size_t{16};
+    /// The interval at which the event loop looks for connections whose time has run out.
+    constexpr auto timer_interval = std::chrono::seconds{1};
+
+    //*                          _   _           *
+    //*  __ ___ _ _  _ _  ___ __| |_(_)___ _ _   *
+    //* / _/ _ \ ' \| ' \/ -_) _|  _| / _ \ ' \  *
+    //* \__\___/_||_|_||_\___\__|\__|_\___/_||_| *
+    //*                                          *
+    /// The state of a client connection. Whilst a connection is being served by a worker it is
+    /// not watched by the event loop so at most one read is in progress at a time. Messages
+    /// published to a WebSockets channel may be sent concurrently with a read: the mutex
+    /// serializes them.
+    class connection {
+    public:
+        connection (socket_descriptor && socket, in_addr_t const peer)
+                : socket_{std::move (socket)}
+                , peer_{peer}
+                , reader_{pstore::http::make_buffered_reader<socket_descriptor &> (
+                      pstore::http::net::refiller)} {}
+
+        int fd () const noexcept { return socket_.native_handle (); }
+        /// Returns the address of the peer.
+        in_addr_t peer () const noexcept { return peer_; }
+
+        /// Serves the requests that the peer has sent.
+        disposition read (pstore::romfs::romfs & file_system,
+                          pstore::http::channel_container const & channels);
+        /// Sends any messages that are waiting for a WebSockets peer.
+        void push ();
+        /// Marks the connection as closed so that no more messages are sent to it.
+        void close ();
+
+        /// Returns the condition variable which is signalled when there are messages for a
+        /// WebSockets peer. This must only be called by the thread to which the connection was
+        /// handed back after its upgrade.
+        pstore::descriptor_condition_variable * cv () const noexcept { return subscription_.cv; }
+
+    private:
+        disposition read_frames ();
+
+        std::mutex mut_;
+        socket_descriptor socket_;
+        in_addr_t const peer_;
+        reader_type reader_;
+        bool closed_ = false;
+
+        // The state of a WebSockets session.
+        bool websocket_ = false;
+        pstore::http::ws_command command_;
+        pstore::http::ws_subscription subscription_;
+    };
+
+    // read
+    // ~~~~
+    disposition connection::read (pstore::romfs::romfs & file_system,
+                                  pstore::http::channel_container const & channels) {
+        std::lock_guard<std::mutex> const lock{mut_};
+        if (websocket_) {
+            return this->read_frames ();
+        }
+        // Serve the request and then any pipelined requests that are already buffered.
+        for (;;) {
+            std::string uri;
+            disposition const d =
+                serve_request (reader_, socket_, file_system, true /*persistent*/, &uri);
+            if (d == disposition::websocket) {
+                log (pstore::logger::priority::info, "Started WebSockets session");
+                websocket_ = true;
+                subscription_ = pstore::http::subscribe (uri, channels);
+                return reader_.available () > 0 ? this->read_frames () : d;
+            }
+            if (d != disposition::keep_alive || reader_.available () == 0) {
+                return d;
+            }
+        }
+    }
+
+    // read frames
+    // ~~~~~~~~~~~
+    disposition connection::read_frames () {
+        PSTORE_ASSERT (websocket_);
+        do {
+            bool done = false;
+            std::tie (std::ignore, done) = pstore::http::socket_read (
+                reader_, pstore::http::net::network_sender, std::ref (socket_), &command_);
+            if (done) {
+                log (pstore::logger::priority::info, "Ended WebSockets session");
+                return disposition::close;
+            }
+        } while (reader_.available () > 0);
+        return disposition::websocket;
+    }
+
+    // push
+    // ~~~~
+    void connection::push () {
+        std::lock_guard<std::mutex> const lock{mut_};
+        if (!closed_) {
+            push_messages (pstore::http::net::network_sender, std::ref (socket_), subscription_);
+        }
+    }
+
+    // close
+    // ~~~~~
+    void connection::close () {
+        std::lock_guard<std::mutex> const lock{mut_};
+        closed_ = true;
+    }
+
+
+    //*                  _     _                *
+    //*  _____ _____ _ _| |_  | |___  ___ _ __  *
+    //* / -_) V / -_) ' \  _| | / _ \/ _ \ '_ \ *
+    //* \___|\_/\___|_||_\__| |_\___/\___/ .__/ *
+    //*                                  |_|    *
+    /// Waits for activity on the listening socket, the client connections, and the WebSockets
+    /// channels and hands the resulting work to a pool of worker threads.
+    class event_loop {
+    public:
+        event_loop (socket_descriptor const & listener, pstore::romfs::romfs & file_system,
+                    pstore::http::channel_container const & channels, unsigned workers);
+        event_loop (event_loop const &) = delete;
+        event_loop (event_loop &&) = delete;
+        ~event_loop () noexcept = default;
+
+        event_loop & operator= (event_loop const &) = delete;
+        event_loop & operator= (event_loop &&) = delete;
+
+        /// Runs the loop until the server status leaves the listening state.
+        void run (pstore::gsl::not_null<pstore::http::server_status *> status);
+
+    private:
+        void accept ();
+        /// Hands a connection which has input waiting to a worker.
+        void dispatch (std::shared_ptr<connection> const & c);
+        /// Called by a worker once it has finished reading from a connection.
+        void hand_back (std::shared_ptr<connection> c, disposition d);
+        /// Resumes watching the connections which workers have handed back.
+        void resume ();
+        /// Pushes newly published messages to the peers subscribed to a channel.
+        void publish (pstore::descriptor_condition_variable * cv);
+        /// Closes a connection which is not being served by a worker.
+        void close (int fd);
+        /// Closes idle connections and stops reading from those whose peers have not sent a
+        /// request before the deadline.
+        void expire ();
+
+        /// Runs \p fn on a worker thread.
+        template <typename Function>
+        void submit (Function fn);
+
+        socket_descriptor const & listener_;
+        pstore::romfs::romfs & file_system_;
+        pstore::http::channel_container const & channels_;
+        bool const logging_;
+
+        pstore::http::poller poller_;
+        std::unordered_map<int, std::shared_ptr<connection>> connections_;
+        /// The channel condition variable of each WebSockets connection.
+        std::unordered_map<int, pstore::descriptor_condition_variable *> subscribers_;
+        /// Maps from the descriptor of a channel's condition variable to the variable itself.
+        std::unordered_map<int, pstore::descriptor_condition_variable *> channel_cvs_;
+        /// The number of connections open from each peer address.
+        std::unordered_map<in_addr_t, std::size_t> peers_;
+        /// The time at which each connection which is waiting for a request will be closed.
+        std::unordered_map<int, time_point> idle_;
+        /// The time by which each connection which is being served by a worker must have been
+        /// read.
+        std::unordered_map<int, time_point> busy_;
+        /// The time at which expire() will next look for connections whose time has run out.
+        time_point next_expiry_;
+
+        /// Signalled when a worker hands back a connection.
+        pstore::descriptor_condition_variable wake_;
+        std::mutex hand_back_mut_;
+        std::vector<std::pair<std::shared_ptr<connection>, disposition>> hand_backs_;
+
+        // The pool is destroyed first so that its workers may use the other members until they
+        // finish.
+        pstore::thread_pool pool_;
+    };
+
+    // ctor
+    // ~~~~
+    event_loop::event_loop (socket_descriptor const & listener,
+                            pstore::romfs::romfs & file_system,
+                            pstore::http::channel_container const & channels,
+                            unsigned const workers)
+            : listener_{listener}
+            , file_system_{file_system}
+            , channels_{channels}
+            , logging_{pstore::logging_enabled ()}
+            , pool_{workers} {
+        poller_.add (listener_.native_handle ());
+        poller_.add (wake_.wait_descriptor ().native_handle ());
+        for (auto const & kvp : channels_) {
+            pstore::descriptor_condition_variable * const cv = std::get<1> (kvp.second);
+            int const fd = cv->wait_descriptor ().native_handle ();
+            if (channel_cvs_.emplace (fd, cv).second) {
+                poller_.add (fd);
+            }
+        }
+    }
+
+    // submit
+    // ~~~~~~
+    template <typename Function>
+    void event_loop::submit (Function fn) {
+        pool_.submit ([this, fn] () {
+            using priority = pstore::logger::priority;
+            PSTORE_TRY {
+                if (logging_ && !pstore::logging_enabled ()) {
+                    pstore::create_log_stream ("http");
                 }
+                fn ();
+            }
+            // clang-format off
+            PSTORE_CATCH (std::exception const & ex, { //clang-format on
+                log (priority::error, "Error: ", ex.what ());
+            })
+            // clang-format off
+            PSTORE_CATCH (..., { // clang-format on
+                log (priority::error, "Unknown exception");
+            })
+        });
+    }
 
-                // Respond appropriately based on the request and headers.
-                auto const serve_reply =
-                    [&] (socket_descriptor & io2,
-                         header_info const & header_contents) -> std::error_code {
-                    if (header_contents.connection_upgrade &&
-                        header_contents.upgrade_to_websocket) {
-
-                        error_or<std::unique_ptr<std::thread>> p = upgrade_to_ws (
-                            reader, std::ref (childfd), request, header_contents, channels);
-                        if (p) {
-                            websockets_workers.emplace_back (std::move (*p));
-                        }
-                        return p.get_error ();
+    // run
+    // ~~~
+    void event_loop::run (pstore::gsl::not_null<pstore::http::server_status *> const status) {
+        using pstore::http::server_status;
+        std::vector<int> ready;
+        for (auto expected_state = server_status::http_state::initializing;
+             status->listening (expected_state);
+             expected_state = server_status::http_state::listening) {
+
+            ready.clear ();
+            poller_.wait (&ready, timer_interval);
+            for (int const fd : ready) {
+                if (fd == listener_.native_handle ()) {
+                    this->accept ();
+                } else if (fd == wake_.wait_descriptor ().native_handle ()) {
+                    this->resume ();
+                } else {
+                    auto const cv_pos = channel_cvs_.find (fd);
+                    if (cv_pos != channel_cvs_.end ()) {
+                        this->publish (cv_pos->second);
+                        continue;
                     }
-
-                    if (!details::starts_with (request.uri (), dynamic_path)) {
-                        return serve_static_content (net::network_sender, std::ref (io2),
-                                                     request.uri (), file_system)
-                            .get_error ();
+                    auto const c_pos = connections_.find (fd);
+                    if (c_pos != connections_.end ()) {
+                        this->dispatch (c_pos->second);
                     }
+                }
+            }
+            this->expire ();
+        }
+
+        // Shut down the open connections. This causes any reads in progress to fail so that the
+        // workers are quickly released.
+        for (auto const & kvp : connections_) {
+            ::shutdown (kvp.first, SHUT_RDWR);
+        }
+    }
+
+    // accept
+    // ~~~~~~
+    void event_loop::accept () {
+        using priority = pstore::logger::priority;
+        pstore::error_or<socket_descriptor> echildfd = accept_connection (listener_);
+        if (!echildfd) {
+            log (priority::error, "accept_connection: ", echildfd.get_error ().message ());
+            return;
+        }
 
-                    return serve_dynamic_content (net::network_sender, std::ref (io2),
-                                                  request.uri ())
-                        .get_error ();
-                };
-
-                // Scan the HTTP headers.
-                PSTORE_ASSERT (childfd.valid ());
-                std::error_code const err = read_headers (
-                    reader, std::ref (childfd),
-                    [] (header_info io, std::string const & key, std::string const & value) {
-                        return io.handler (key, value);
-                    },
-                    header_info ()) >>= serve_reply;
-
-                if (err) {
-                    // Report the error to the user as an HTTP error.
-                    report_error (err, request, childfd);
+        sockaddr_in peer_addr{};
+        auto peer_len = static_cast<socklen_t> (sizeof (peer_addr));
+        if (::getpeername (echildfd->native_handle (), reinterpret_cast<sockaddr *> (&peer_addr),
+                           &peer_len) != 0) {
+            log (priority::error, "getpeername: ", pstore::http::get_last_error ().message ());
+            return;
+        }
+        // Don't allow a single peer to use up the server's descriptors.
+        std::size_t & peer_connections = peers_[peer_addr.sin_addr.s_addr];
+        if (peer_connections >= max_peer_connections) {
+            log (priority::error, "Too many connections from peer: connection closed");
+            return;
+        }
+        ++peer_connections;
+
+        auto c = std::make_shared<connection> (std::move (*echildfd), peer_addr.sin_addr.s_addr);
+        int const fd = c->fd ();
+        connections_[fd] = std::move (c);
+        idle_[fd] = std::chrono::steady_clock::now () + idle_timeout;
+        poller_.add (fd);
+    }
+
+    // dispatch
+    // ~~~~~~~~
+    void event_loop::dispatch (std::shared_ptr<connection> const & c) {
+        // The connection is not watched whilst a worker is reading from it.
+        int const fd = c->fd ();
+        poller_.remove (fd);
+        idle_.erase (fd);
+        busy_[fd] = std::chrono::steady_clock::now () + request_deadline;
+        this->submit ([this, c] () {
+            auto d = disposition::close;
+            PSTORE_TRY { d = c->read (file_system_, channels_); }
+            // clang-format off
+            PSTORE_CATCH (..., { // clang-format on
+                this->hand_back (c, disposition::close);
+                throw;
+            })
+            this->hand_back (c, d);
+        });
+    }
+
+    // hand back
+    // ~~~~~~~~~
+    void event_loop::hand_back (std::shared_ptr<connection> c, disposition const d) {
+        if (d == disposition::close) {
+            c->close ();
+        }
+        {
+            std::lock_guard<std::mutex> const lock{hand_back_mut_};
+            hand_backs_.emplace_back (std::move (c), d);
+        }
+        wake_.notify_all ();
+    }
+
+    // resume
+    // ~~~~~~
+    void event_loop::resume () {
+        wake_.reset ();
+        std::vector<std::pair<std::shared_ptr<connection>, disposition>> hand_backs;
+        {
+            std::lock_guard<std::mutex> const lock{hand_back_mut_};
+            hand_backs.swap (hand_backs_);
+        }
+        for (auto const & hb : hand_backs) {
+            int const fd = hb.first->fd ();
+            busy_.erase (fd);
+            switch (hb.second) {
+            case disposition::close: this->close (fd); break;
+            case disposition::websocket:
+                if (pstore::descriptor_condition_variable * const cv = hb.first->cv ()) {
+                    subscribers_[fd] = cv;
                 }
+                poller_.add (fd);
+                break;
+            case disposition::keep_alive:
+                idle_[fd] = std::chrono::steady_clock::now () + idle_timeout;
+                poller_.add (fd);
+                break;
+            }
+        }
+    }
 
-                PSTORE_ASSERT (input_is_empty (reader, childfd));
+    // publish
+    // ~~~~~~~
+    void event_loop::publish (pstore::descriptor_condition_variable * const cv) {
+        cv->reset ();
+        for (auto const & kvp : subscribers_) {
+            if (kvp.second == cv) {
+                std::shared_ptr<connection> const c = connections_.at (kvp.first);
+                this->submit ([c] () { c->push (); });
             }
+        }
+    }
+
+    // close
+    // ~~~~~
+    void event_loop::close (int const fd) {
+        auto const pos = connections_.find (fd);
+        PSTORE_ASSERT (pos != connections_.end ());
+        auto const peer = peers_.find (pos->second->peer ());
+        PSTORE_ASSERT (peer != peers_.end () && peer->second > 0U);
+        if (--peer->second == 0U) {
+            peers_.erase (peer);
+        }
+        subscribers_.erase (fd);
+        idle_.erase (fd);
+        connections_.erase (pos);
+    }
+
+    // expire
+    // ~~~~~~
+    void event_loop::expire () {
+        using priority = pstore::logger::priority;
+        auto const now = std::chrono::steady_clock::now ();
+        if (now < next_expiry_) {
+            return;
+        }
+        next_expiry_ = now + timer_interval;
+
+        // Stop reading from connections whose peers have stalled. The worker's read fails and it
+        // hands the connection back to be closed.
+        for (auto it = std::begin (busy_); it != std::end (busy_);) {
+            if (it->second <= now) {
+                log (priority::info, "Request deadline passed: disconnecting");
+                ::shutdown (it->first, SHUT_RD);
+                it = busy_.erase (it);
+            } else {
+                ++it;
+            }
+        }
+
+        std::vector<int> idle;
+        for (auto const & kvp : idle_) {
+            if (kvp.second <= now) {
+                idle.push_back (kvp.first);
+            }
+        }
+        for (int const fd : idle) {
+            log (priority::info, "Closing idle connection");
+            poller_.remove (fd);
+            this->close (fd);
+        }
+    }
+
+} // end anonymous namespace
+
+namespace pstore {
+    namespace http {
 
-            for (std::unique_ptr<std::thread> const & worker : websockets_workers) {
-                worker->join ();
+        int server (romfs::romfs & file_system, gsl::not_null<server_status *> const status,
+                    channel_container const & channels,
+                    std::function<void (in_port_t)> notify_listening) {
+            using priority = logger::priority;
+
+            error_or<socket_descriptor> const eparentfd = initialize_socket (status->port ());
+            if (!eparentfd) {
+                log (priority::error, "opening socket: ", eparentfd.get_error ().message ());
+                return 0;
             }
 
+            socket_descriptor const & parentfd = eparentfd.get ();
+            status->set_real_port_number (parentfd);
+
+            log (priority::info, "starting server-loop on port ", status->port ());
+
+            event_loop loop{parentfd, file_system, channels,
+                            std::max (std::thread::hardware_concurrency (), 2U)};
+            notify_listening (status->port ());
+            loop.run (status);
             return 0;
         }
 
     } // end namespace http
 } // end namespace pstore
+
+#endif // _WIN32
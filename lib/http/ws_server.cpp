@@ -113,5 +113,20 @@ namespace pstore {
             return return_type{in_place, payload};
         }
 
+        ws_subscription subscribe (std::string const & uri, channel_container const & channels) {
+            ws_subscription result;
+            if (uri.length () > 0 && uri[0] == '/') {
+                std::string const name = uri.substr (1);
+                auto const pos = channels.find (name);
+                if (pos != channels.end ()) {
+                    result.subscriber = std::get<0> (pos->second)->new_subscriber ();
+                    result.cv = std::get<1> (pos->second);
+                } else {
+                    log (logger::priority::error, "No channel named: ", name);
+                }
+            }
+            return result;
+        }
+
     } // end namespace http
 } // end namespace pstore
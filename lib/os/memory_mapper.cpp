@@ -22,6 +22,8 @@
 /// \file memory_mapper.cpp
 
 #include "pstore/os/memory_mapper.hpp"
+
+#include <algorithm>
 #include <ostream>
 
 namespace pstore {
@@ -40,6 +42,17 @@ namespace pstore {
         this->read_only_impl (addr, len);
     }
 
+    void memory_mapper_base::flush (void * const addr, std::size_t const len) {
+#ifndef NDEBUG
+        {
+            auto * const addr8 = static_cast<std::uint8_t *> (addr);
+            auto * const data8 = static_cast<std::uint8_t *> (this->data ().get ());
+            PSTORE_ASSERT (addr8 >= data8 && addr8 + len <= data8 + this->size ());
+        }
+#endif
+        this->flush_impl (addr, len);
+    }
+
 
     // (dtor)
     // ~~~~~~
@@ -58,4 +71,52 @@ namespace pstore {
 
     in_memory_mapper::~in_memory_mapper () noexcept = default;
 
+
+    // (ctor)
+    // ~~~~~~
+    address_reservation::address_reservation (std::uint64_t const size)
+            : size_{size}
+            , base_{reserve (size)} {}
+
+    // (dtor)
+    // ~~~~~~
+    address_reservation::~address_reservation () noexcept {
+        if (base_ != nullptr) {
+            unreserve (base_, size_);
+        }
+    }
+
+    // acquire
+    // ~~~~~~~
+    void * address_reservation::acquire (std::uint64_t const offset, std::uint64_t const length) {
+        if (base_ == nullptr || offset > size_ || length > size_ - offset) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> const lock{mut_};
+        auto const overlaps = [offset, length] (std::pair<std::uint64_t, std::uint64_t> const & r) {
+            return offset < r.first + r.second && r.first < offset + length;
+        };
+        if (std::any_of (std::begin (in_use_), std::end (in_use_), overlaps)) {
+            return nullptr;
+        }
+        in_use_.emplace_back (offset, length);
+        return static_cast<std::uint8_t *> (base_) + offset;
+    }
+
+    // release
+    // ~~~~~~~
+    void address_reservation::release (std::uint64_t const offset,
+                                       std::uint64_t const length) noexcept {
+        PSTORE_ASSERT (base_ != nullptr);
+        reset (static_cast<std::uint8_t *> (base_) + offset, length);
+
+        std::lock_guard<std::mutex> const lock{mut_};
+        auto const pos = std::find (std::begin (in_use_), std::end (in_use_),
+                                    std::make_pair (offset, length));
+        PSTORE_ASSERT (pos != std::end (in_use_));
+        if (pos != std::end (in_use_)) {
+            in_use_.erase (pos);
+        }
+    }
+
 } // namespace pstore
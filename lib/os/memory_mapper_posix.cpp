@@ -113,6 +113,14 @@ namespace pstore {
         }
     }
 
+    // flush
+    // ~~~~~
+    void memory_mapper_base::flush_impl (void * const addr, std::size_t const len) {
+        if (::msync (addr, len, MS_SYNC) == -1) {
+            raise (errno_erc{errno}, "msync");
+        }
+    }
+
 
     //*   _ __ ___   ___ _ __ ___   ___  _ __ _   _    _ __ ___   __ _ _ __  _ __   ___ _ __   *
     //*  | '_ ` _ \ / _ \ '_ ` _ \ / _ \| '__| | | |  | '_ ` _ \ / _` | '_ \| '_ \ / _ \ '__|  *
@@ -123,8 +131,14 @@ namespace pstore {
     // ~~~~~~
     memory_mapper::memory_mapper (file::file_handle & file, bool const write_enabled,
                                   std::uint64_t const offset, std::uint64_t const length)
-            : memory_mapper_base (mmap (file, write_enabled, offset, length), write_enabled, offset,
-                                  length) {}
+            : memory_mapper (file, write_enabled, offset, length, nullptr) {}
+
+    memory_mapper::memory_mapper (file::file_handle & file, bool const write_enabled,
+                                  std::uint64_t const offset, std::uint64_t const length,
+                                  std::shared_ptr<address_reservation> reservation)
+            : memory_mapper_base (mmap (file, write_enabled, offset, length,
+                                        std::move (reservation)),
+                                  write_enabled, offset, length) {}
 
     // (dtor)
     // ~~~~~~
@@ -134,19 +148,40 @@ namespace pstore {
     // ~~~~
     std::shared_ptr<void> memory_mapper::mmap (file::file_handle & file, bool const write_enabled,
                                                std::uint64_t const offset,
-                                               std::uint64_t const length) {
-        void * const ptr = ::mmap (nullptr, // base address
+                                               std::uint64_t const length,
+                                               std::shared_ptr<address_reservation> reservation) {
+        // If we have an address reservation, try to place this mapping at the corresponding
+        // position within it.
+        void * const fixed =
+            reservation != nullptr ? reservation->acquire (offset, length) : nullptr;
+        if (fixed == nullptr) {
+            reservation.reset ();
+        }
+
+        void * const ptr = ::mmap (fixed, // base address
                                    length,
                                    PROT_READ | (write_enabled ? PROT_WRITE : 0), // protection flags
-                                   MAP_SHARED, file.raw_handle (), checked_offset (offset));
+                                   MAP_SHARED | (fixed != nullptr ? MAP_FIXED : 0),
+                                   file.raw_handle (), checked_offset (offset));
         void const * const map_failed = MAP_FAILED; // NOLINT
         if (ptr == map_failed) {
             int const last_error = errno;
+            if (reservation) {
+                reservation->release (offset, length);
+            }
             std::ostringstream message;
             message << "Could not memory map file " << pstore::quoted (file.path ());
             raise (errno_erc{last_error}, message.str ());
         }
 
+        if (reservation) {
+            // Unmapping a region within the reservation returns its addresses to the reservation
+            // rather than to the operating system. Note that the deleter's copy of the
+            // reservation pointer keeps it alive for as long as the mapping exists.
+            return std::shared_ptr<void> (ptr, [reservation, offset, length] (void * const) {
+                reservation->release (offset, length);
+            });
+        }
         return std::shared_ptr<void> (ptr, [length] (void * const p) {
             if (::munmap (p, length) == -1) {
                 raise (errno_erc{errno}, "munmap");
@@ -154,5 +189,46 @@ namespace pstore {
         });
     }
 
+
+    //*          _    _                                              _   _           *
+    //*  __ _ __| |__| |_ _ ___ ______  _ _ ___ ___ ___ _ ___ ____ _| |_(_)___ _ _   *
+    //* / _` / _` / _` | '_/ -_|_-<_-< | '_/ -_|_-</ -_) '_\ V / _` |  _| / _ \ ' \  *
+    //* \__,_\__,_\__,_|_| \___/__/__/ |_| \___/__/\___|_|  \_/\__,_|\__|_\___/_||_| *
+    //*                                                                              *
+#    ifdef __linux__
+    // reserve [static]
+    // ~~~~~~~~~~~~~~~~
+    void * address_reservation::reserve (std::uint64_t const size) noexcept {
+        if (size > std::numeric_limits<std::size_t>::max ()) {
+            return nullptr;
+        }
+        void * const ptr = ::mmap (nullptr, static_cast<std::size_t> (size), PROT_NONE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        void const * const map_failed = MAP_FAILED; // NOLINT
+        return ptr == map_failed ? nullptr : ptr;
+    }
+
+    // unreserve [static]
+    // ~~~~~~~~~~~~~~~~~~
+    void address_reservation::unreserve (void * const addr, std::uint64_t const size) noexcept {
+        ::munmap (addr, static_cast<std::size_t> (size));
+    }
+
+    // reset [static]
+    // ~~~~~~~~~~~~~~
+    void address_reservation::reset (void * const addr, std::uint64_t const size) noexcept {
+        // Mapping over the range atomically discards the existing mapping without opening a
+        // window in which another mmap() call could be given the same addresses.
+        ::mmap (addr, static_cast<std::size_t> (size), PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    }
+#    else
+    // Other POSIX systems don't reliably support MAP_NORESERVE so reserving a large address range
+    // could commit swap space for it. Reservations always fail there.
+    void * address_reservation::reserve (std::uint64_t) noexcept { return nullptr; }
+    void address_reservation::unreserve (void *, std::uint64_t) noexcept {}
+    void address_reservation::reset (void *, std::uint64_t) noexcept {}
+#    endif // __linux__
+
 } // end namespace pstore
 #endif //! defined (_WIN32)
@@ -130,12 +130,29 @@ namespace pstore {
         }
     }
 
+    // flush_impl
+    // ~~~~~~~~~~
+    void memory_mapper_base::flush_impl (void * addr, std::size_t len) {
+        // Note that FlushViewOfFile() writes the dirty pages to the file but doesn't wait for the
+        // disk's own cache to be flushed.
+        if (::FlushViewOfFile (addr, len) == 0) {
+            DWORD const last_error = ::GetLastError ();
+            raise (win32_erc{last_error}, "FlushViewOfFile");
+        }
+    }
+
     // (ctor)
     // ~~~~~~
     memory_mapper::memory_mapper (file::file_handle & file, bool write_enabled,
                                   std::uint64_t offset, std::uint64_t length)
-            : memory_mapper_base (mmap (file, write_enabled, offset, length), write_enabled, offset,
-                                  length) {}
+            : memory_mapper (file, write_enabled, offset, length, nullptr) {}
+
+    memory_mapper::memory_mapper (file::file_handle & file, bool write_enabled,
+                                  std::uint64_t offset, std::uint64_t length,
+                                  std::shared_ptr<address_reservation> reservation)
+            : memory_mapper_base (mmap (file, write_enabled, offset, length,
+                                        std::move (reservation)),
+                                  write_enabled, offset, length) {}
 
     // (dtor)
     // ~~~~~~
@@ -144,7 +161,9 @@ namespace pstore {
     // mmap [static]
     // ~~~~~~~~~~~~~
     std::shared_ptr<void> memory_mapper::mmap (file::file_handle & file, bool write_enabled,
-                                               std::uint64_t offset, std::uint64_t length) {
+                                               std::uint64_t offset, std::uint64_t length,
+                                               std::shared_ptr<address_reservation>) {
+        // Address reservations are not supported on Windows (see address_reservation::reserve()).
         file_mapping mapping (file, write_enabled, offset + length);
         void * mapped_ptr =
             ::MapViewOfFile (mapping.handle (), write_enabled ? FILE_MAP_WRITE : FILE_MAP_READ,
@@ -167,6 +186,13 @@ namespace pstore {
         return std::shared_ptr<void> (mapped_ptr, unmap_deleter);
     }
 
+
+    // Reserving an address range with VirtualAlloc(MEM_RESERVE) doesn't allow file views to be
+    // placed within it, so reservations always fail on Windows.
+    void * address_reservation::reserve (std::uint64_t) noexcept { return nullptr; }
+    void address_reservation::unreserve (void *, std::uint64_t) noexcept {}
+    void address_reservation::reset (void *, std::uint64_t) noexcept {}
+
 } // namespace pstore
 
 #endif // defined (_WIN32)
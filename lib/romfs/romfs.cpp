@@ -274,6 +274,13 @@ namespace pstore {
                    [] (dirent_ptr const de) { return error_or<struct stat>{de->stat ()}; };
         }
 
+        // lookup
+        // ~~~~~~
+        auto romfs::lookup (gsl::czstring PSTORE_NONNULL const path) const
+            -> error_or<dirent_ptr> {
+            return this->parse_path (path);
+        }
+
         // getcwd
         // ~~~~~~
         error_or<std::string> romfs::getcwd () const { return dir_to_string (cwd_); }
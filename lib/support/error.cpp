@@ -72,6 +72,9 @@ std::string pstore::error_category::message (int const error) const {
     case error_code::unable_to_open_named_pipe: result = "unable to open named pipe"; break;
     case error_code::pipe_write_timeout: result = "pipe write timeout"; break;
     case error_code::write_failed: result = "write failed"; break;
+    case error_code::store_replaced:
+        result = "the store was replaced by vacuum and must be reopened";
+        break;
     }
     return result;
 }
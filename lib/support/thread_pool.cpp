@@ -0,0 +1,145 @@
+//===- lib/support/thread_pool.cpp ----------------------------------------===//
+//*  _   _                        _                     _  *
+//* | |_| |__  _ __ ___  __ _  __| |  _ __   ___   ___ | | *
+//* | __| '_ \| '__/ _ \/ _` |/ _` | | '_ \ / _ \ / _ \| | *
+//* | |_| | | | | |  __/ (_| | (_| | | |_) | (_) | (_) | | *
+//*  \__|_| |_|_|  \___|\__,_|\__,_| | .__/ \___/ \___/|_| *
+//*                                  |_|                   *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file thread_pool.cpp
+/// \brief A persistent, work-stealing pool of worker threads.
+
+#include "pstore/support/thread_pool.hpp"
+
+#include <algorithm>
+
+#include "pstore/support/assert.hpp"
+
+namespace {
+
+    // The pool to which the current thread belongs (or nullptr if it is not a pool worker) and
+    // its index within that pool.
+    thread_local pstore::thread_pool const * this_pool = nullptr;
+    thread_local unsigned this_index = 0;
+
+} // end anonymous namespace
+
+namespace pstore {
+
+    // (ctor)
+    // ~~~~~~
+    thread_pool::thread_pool (unsigned const num_threads) {
+        PSTORE_ASSERT (num_threads > 0U);
+        queues_.reserve (num_threads);
+        for (auto ctr = 0U; ctr < num_threads; ++ctr) {
+            queues_.emplace_back (new queue);
+        }
+        threads_.reserve (num_threads);
+        for (auto ctr = 0U; ctr < num_threads; ++ctr) {
+            threads_.emplace_back (&thread_pool::worker, this, ctr);
+        }
+    }
+
+    // (dtor)
+    // ~~~~~~
+    thread_pool::~thread_pool () noexcept {
+        {
+            std::lock_guard<std::mutex> const lock{wake_mut_};
+            done_ = true;
+        }
+        wake_cv_.notify_all ();
+        for (std::thread & t : threads_) {
+            t.join ();
+        }
+    }
+
+    // global [static]
+    // ~~~~~~
+    thread_pool & thread_pool::global () {
+        static thread_pool pool{std::max (std::thread::hardware_concurrency (), 1U)};
+        return pool;
+    }
+
+    // submit
+    // ~~~~~~
+    void thread_pool::submit (task t) {
+        {
+            std::lock_guard<std::mutex> const lock{wake_mut_};
+            unsigned index;
+            if (this_pool == this) {
+                index = this_index;
+            } else {
+                index = next_;
+                next_ = (next_ + 1U) % this->size ();
+            }
+            queue & q = *queues_[index];
+            {
+                std::lock_guard<std::mutex> const qlock{q.mut};
+                q.tasks.push_back (std::move (t));
+            }
+            ++pending_;
+        }
+        wake_cv_.notify_one ();
+    }
+
+    // pop
+    // ~~~
+    bool thread_pool::pop (unsigned const index, task & t) {
+        auto const num_queues = this->size ();
+        // Our own queue is treated as a stack so that the most recently queued (and probably
+        // cache-warm) work is run first. Other workers' queues are treated as FIFOs so that a
+        // thief takes the oldest work.
+        {
+            queue & q = *queues_[index];
+            std::lock_guard<std::mutex> const lock{q.mut};
+            if (!q.tasks.empty ()) {
+                t = std::move (q.tasks.back ());
+                q.tasks.pop_back ();
+                return true;
+            }
+        }
+        for (auto ctr = 1U; ctr < num_queues; ++ctr) {
+            queue & q = *queues_[(index + ctr) % num_queues];
+            std::lock_guard<std::mutex> const lock{q.mut};
+            if (!q.tasks.empty ()) {
+                t = std::move (q.tasks.front ());
+                q.tasks.pop_front ();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // worker
+    // ~~~~~~
+    void thread_pool::worker (unsigned const index) {
+        this_pool = this;
+        this_index = index;
+        for (;;) {
+            task t;
+            if (this->pop (index, t)) {
+                {
+                    std::lock_guard<std::mutex> const lock{wake_mut_};
+                    PSTORE_ASSERT (pending_ > 0U);
+                    --pending_;
+                }
+                t ();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock{wake_mut_};
+            wake_cv_.wait (lock, [this] () { return pending_ > 0U || done_; });
+            if (done_ && pending_ == 0U) {
+                break;
+            }
+        }
+    }
+
+} // end namespace pstore
@@ -21,12 +21,13 @@
 #include <memory>
 #include <sstream>
 #include <thread>
+#include <vector>
 
-#include "pstore/core/hamt_map.hpp"
-#include "pstore/core/index_types.hpp"
+#include "pstore/core/transaction.hpp"
 #include "pstore/os/logging.hpp"
 #include "pstore/os/thread.hpp"
 #include "pstore/support/portab.hpp"
+#include "pstore/vacuum/copy_indices.hpp"
 #include "pstore/vacuum/status.hpp"
 #include "pstore/vacuum/user_options.hpp"
 #include "pstore/vacuum/watch.hpp"
@@ -73,6 +74,67 @@ namespace {
         }
     }
 
+
+    /// An incremental copy stops chasing the source once it is no more than this number of
+    /// revisions behind. The remainder is copied while writers are locked out.
+    constexpr unsigned small_delta = 4U;
+    /// The maximum number of catch-up rounds made before the copy gives up waiting for the source
+    /// to settle and locks out writers regardless.
+    constexpr unsigned max_catch_up_rounds = 8U;
+
+    // The watch thread uses the source database whilst holding start_watch_mutex, so we must
+    // hold it too when updating the source to its latest revision.
+    unsigned sync_source (pstore::database & source) {
+        auto & wst = vacuum::wst;
+        std::lock_guard<decltype (wst.start_watch_mutex)> const lock{wst.start_watch_mutex};
+        source.sync ();
+        return source.get_current_revision ();
+    }
+
+    // Copies the live contents of 'source' to 'destination' whilst other processes continue to
+    // append to the source. A snapshot of the source is copied first, followed by the revisions
+    // which were committed while that was happening until the destination is no more than
+    // small_delta revisions behind. The source's transaction lock is then taken and the final
+    // few revisions copied. The lock is returned to the caller which must hold it until the
+    // destination has replaced the source and the source has been marked as replaced: a writer
+    // which is waiting for the lock will then find the mark and fail rather than commit to the
+    // old file.
+    pstore::transaction_lock incremental_copy (pstore::database & source,
+                                               pstore::database & destination) {
+        using priority = pstore::logger::priority;
+        vacuum::index_copier copier{source};
+
+        auto copied = sync_source (source);
+        {
+            auto transaction = pstore::begin (destination);
+            copier.copy (transaction);
+            transaction.commit ();
+        }
+        log (priority::notice, "Copied revision ", copied);
+
+        for (auto round = 0U; round < max_catch_up_rounds; ++round) {
+            auto const head = sync_source (source);
+            if (head - copied <= small_delta) {
+                break;
+            }
+            auto transaction = pstore::begin (destination);
+            copier.copy_since (transaction, copied);
+            transaction.commit ();
+            log (priority::notice, "Caught up to revision ", head);
+            copied = head;
+        }
+
+        pstore::transaction_lock lock{pstore::transaction_mutex{source}};
+        auto const head = sync_source (source);
+        if (head != copied) {
+            auto transaction = pstore::begin (destination);
+            copier.copy_since (transaction, copied);
+            transaction.commit ();
+            log (priority::notice, "Locked. Caught up to revision ", head);
+        }
+        return lock;
+    }
+
 } // end anonymous namespace
 
 namespace vacuum {
@@ -101,6 +163,9 @@ namespace vacuum {
                 start_watching (source, st);
 
                 bool copy_aborted = false;
+                // In incremental mode, holds the source's transaction lock from the end of the
+                // copy until the destination has replaced it.
+                std::unique_ptr<pstore::transaction_lock> source_lock;
                 // TODO: a new constructor to make a uniquely named file in the same directory as
                 // 'from'
                 auto destination = std::make_unique<pstore::database> (
@@ -109,46 +174,21 @@ namespace vacuum {
                 // We don't want our pristine new store to be vacuumed; it doesn't need it.
                 destination->set_vacuum_mode (pstore::database::vacuum_mode::disabled);
 
-                std::shared_ptr<pstore::index::write_index const> const source_names =
-                    pstore::index::get_index<pstore::trailer::indices::write> (*source);
-                if (source_names == nullptr) {
-                    log (priority::error, "Names index was not found in source store");
-                    stop (st);
-                    return;
-                }
-
-                std::shared_ptr<pstore::index::write_index> const destination_names =
-                    pstore::index::get_index<pstore::trailer::indices::write> (*destination);
-
-                if (!st->done) {
+                if (!st->done && opt.incremental) {
+                    source_lock = std::make_unique<pstore::transaction_lock> (
+                        incremental_copy (*source, *destination));
+                    destination->close ();
+                } else if (!st->done) {
                     auto transaction = pstore::begin (*destination);
 
-                    for (auto const & kvp : source_names->make_range (*source)) {
-                        std::string const & key = kvp.first;
-                        pstore::extent<char> const & extent = kvp.second;
-
-                        pstore::address const addr =
-                            transaction.allocate (extent.size, 1 /*align*/);
-                        // Copy from the source file to the data store.
-                        std::memcpy (transaction.getrw (addr, extent.size).get (),
-                                     source->getro (extent).get (), extent.size);
-
-                        destination_names->insert_or_assign (
-                            transaction, key,
-                            make_extent (pstore::typed_address<char> (addr), extent.size));
-
-                        // Has the watch thread asked us to abort the copy?
-                        if (st->modified) {
-                            copy_aborted = true;
-                            log (priority::notice, "Store was modified during vacuuming: aborted.");
-                            break;
-                        }
-                    }
-
-                    if (copy_aborted) {
-                        transaction.rollback ();
-                    } else {
+                    // Copy the contents of all of the source's indices. Each of the destination's
+                    // indices is built in one go, without the cost of inserting each key.
+                    if (copy_indices (*source, transaction, *st)) {
                         transaction.commit ();
+                    } else {
+                        copy_aborted = true;
+                        log (priority::notice, "Store was modified during vacuuming: aborted.");
+                        transaction.rollback ();
                     }
 
                     destination->close ();
@@ -166,10 +206,22 @@ namespace vacuum {
                     pstore::file::file_handle destination_file{destination->path ()};
                     std::string const source_path = source->path ();
                     destination.reset (); // Close the target data store
-                    // assert that there's a single reference to the source pointer.
-                    source.reset ();
-
-                    destination_file.rename (source_path);
+                    if (source_lock != nullptr) {
+                        // Replace the source while its transaction lock is still held. A writer
+                        // that is waiting for the lock has the old file open and would commit to
+                        // it once the lock is released. Marking the old file as replaced makes
+                        // that writer's transaction fail with error_code::store_replaced
+                        // instead. The mark is set after the rename so that a crash can't leave
+                        // it on the live store.
+                        destination_file.rename (source_path);
+                        source->set_replaced ();
+                        source_lock.reset ();
+                        source.reset ();
+                    } else {
+                        // assert that there's a single reference to the source pointer.
+                        source.reset ();
+                        destination_file.rename (source_path);
+                    }
                 }
             }
         }
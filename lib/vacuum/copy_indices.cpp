@@ -0,0 +1,430 @@
+//===- lib/vacuum/copy_indices.cpp ----------------------------------------===//
+//*                            _           _ _                *
+//*   ___ ___  _ __  _   _    (_)_ __   __| (_) ___ ___  ___  *
+//*  / __/ _ \| '_ \| | | |   | | '_ \ / _` | |/ __/ _ \/ __| *
+//* | (_| (_) | |_) | |_| |   | | | | | (_| | | (_|  __/\__ \ *
+//*  \___\___/| .__/ \__, |   |_|_| |_|\__,_|_|\___\___||___/ *
+//*           |_|    |___/                                    *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file copy_indices.cpp
+/// \brief Copies the live contents of a store's indices to a new store.
+
+#include "pstore/vacuum/copy_indices.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "pstore/core/diff.hpp"
+#include "pstore/core/hamt_map.hpp"
+#include "pstore/core/hamt_set.hpp"
+#include "pstore/core/index_types.hpp"
+#include "pstore/core/transaction.hpp"
+#include "pstore/mcrepo/compilation.hpp"
+#include "pstore/mcrepo/fragment.hpp"
+#include "pstore/vacuum/status.hpp"
+
+namespace {
+
+    using pstore::address;
+    using pstore::database;
+    using pstore::extent;
+    using pstore::indirect_string;
+    using pstore::revision_number;
+    using pstore::transaction_base;
+    using pstore::typed_address;
+    using pstore::index::digest;
+    using vacuum::details::definition_link;
+
+    /// Passed as the 'since' revision to request that every record be copied.
+    constexpr revision_number all_records = pstore::head_revision;
+
+    using string_map = std::unordered_map<address, typed_address<indirect_string>>;
+    template <typename T>
+    using digest_map = std::unordered_map<digest, extent<T>>;
+
+    template <pstore::trailer::indices Index>
+    using index_type = typename pstore::index::enum_to_index<Index>::type;
+
+    /// The key/value pairs that will be used to populate one of the destination's indices.
+    template <pstore::trailer::indices Index>
+    using elements = std::vector<std::pair<typename index_type<Index>::key_type,
+                                           typename index_type<Index>::mapped_type>>;
+
+    bool abandoned (std::atomic<bool> const * const abandon) {
+        return abandon != nullptr && abandon->load ();
+    }
+
+    // leaves
+    // ~~~~~~
+    /// Returns the addresses of the leaves of \p index which were added after revision \p since
+    /// or all of its leaves if \p since is all_records.
+    template <typename Index>
+    std::vector<address> leaves (database const & db, Index const & index,
+                                 revision_number const since) {
+        std::vector<address> result;
+        if (since == all_records) {
+            result.reserve (index.size ());
+            for (auto it = index.begin (db), end = index.end (db); it != end; ++it) {
+                result.push_back (it.get_address ());
+            }
+        } else {
+            pstore::diff (db, index, since, std::back_inserter (result));
+        }
+        return result;
+    }
+
+    // new_string
+    // ~~~~~~~~~~
+    typed_address<indirect_string> new_string (string_map const & strings,
+                                               typed_address<indirect_string> const old) {
+        if (old == typed_address<indirect_string>::null ()) {
+            return old;
+        }
+        auto const pos = strings.find (old.to_address ());
+        if (pos == strings.end ()) {
+            raise (pstore::error_code::index_corrupt);
+        }
+        return pos->second;
+    }
+
+    // new_extent
+    // ~~~~~~~~~~
+    template <typename T>
+    extent<T> new_extent (digest_map<T> const & m, digest const & d) {
+        auto const pos = m.find (d);
+        if (pos == m.end ()) {
+            raise (pstore::error_code::index_corrupt);
+        }
+        return pos->second;
+    }
+
+    // copy_extent
+    // ~~~~~~~~~~~
+    /// Copies the bytes of \p ex from \p source to newly allocated storage in \p transaction.
+    /// \returns A writable pointer to the new copy and its extent.
+    template <typename T>
+    std::pair<std::shared_ptr<void>, extent<T>>
+    copy_extent (database const & source, transaction_base & transaction, extent<T> const & ex) {
+        std::pair<std::shared_ptr<void>, address> const storage =
+            transaction.alloc_rw (ex.size, alignof (T));
+        std::memcpy (storage.first.get (), source.getro (ex.addr.to_address (), ex.size).get (),
+                     ex.size);
+        return {storage.first, make_extent (typed_address<T> (storage.second), ex.size)};
+    }
+
+    // add_elements
+    // ~~~~~~~~~~~~
+    /// Adds the elements in \p el to \p index. An empty index is built in a single operation.
+    /// Otherwise the elements are added individually, replacing any existing value for the same
+    /// key.
+    template <typename Index, typename Elements>
+    void add_elements (transaction_base & transaction, Index & index, Elements const & el) {
+        if (index.empty ()) {
+            index.bulk_insert (transaction, std::begin (el), std::end (el));
+            return;
+        }
+        for (auto const & kvp : el) {
+            index.insert_or_assign (transaction, kvp.first, kvp.second);
+        }
+    }
+
+    // remember_headers
+    // ~~~~~~~~~~~~~~~~
+    /// Records the new locations of debug line headers; other kinds of record are ignored.
+    template <typename Elements>
+    void remember_headers (digest_map<std::uint8_t> * const, Elements const &) {}
+    void remember_headers (digest_map<std::uint8_t> * const headers,
+                           elements<pstore::trailer::indices::debug_line_header> const & el) {
+        headers->insert (std::begin (el), std::end (el));
+    }
+
+
+    // fragment_patcher
+    // ~~~~~~~~~~~~~~~~
+    /// Rewrites the addresses held by the sections of a fragment that has been copied byte-for-
+    /// byte. Each field is located by its offset from the start of the source fragment.
+    class fragment_patcher {
+    public:
+        fragment_patcher (pstore::repo::fragment const & src, void * const dst,
+                          address const dst_addr, string_map const & strings,
+                          digest_map<std::uint8_t> const & headers,
+                          std::vector<definition_link> * const links)
+                : src_{reinterpret_cast<std::uint8_t const *> (&src)}
+                , dst_{static_cast<std::uint8_t *> (dst)}
+                , dst_addr_{dst_addr}
+                , strings_{strings}
+                , headers_{headers}
+                , links_{links} {}
+
+        void operator() (pstore::repo::generic_section const & s) const {
+            for (pstore::repo::external_fixup const & xfx : s.xfixups ()) {
+                *this->dst (xfx.name) = new_string (strings_, xfx.name);
+            }
+        }
+        void operator() (pstore::repo::bss_section const &) const {}
+        void operator() (pstore::repo::debug_line_section const & s) const {
+            (*this) (s.generic ());
+            *this->dst (s.header_extent ()) = new_extent (headers_, s.header_digest ());
+        }
+        void operator() (pstore::repo::linked_definitions const & s) const {
+            for (pstore::repo::linked_definitions::value_type const & ld : s) {
+                links_->push_back (definition_link{dst_addr_ + this->offset (ld.pointer),
+                                                   ld.compilation, ld.index});
+            }
+        }
+
+    private:
+        template <typename T>
+        std::uint64_t offset (T const & src_field) const noexcept {
+            auto const * const p = reinterpret_cast<std::uint8_t const *> (&src_field);
+            PSTORE_ASSERT (p >= src_);
+            return static_cast<std::uint64_t> (p - src_);
+        }
+        template <typename T>
+        T * dst (T const & src_field) const noexcept {
+            return reinterpret_cast<T *> (dst_ + this->offset (src_field));
+        }
+
+        std::uint8_t const * const src_;
+        std::uint8_t * const dst_;
+        address const dst_addr_;
+        string_map const & strings_;
+        digest_map<std::uint8_t> const & headers_;
+        std::vector<definition_link> * const links_;
+    };
+
+    // patch_fragment
+    // ~~~~~~~~~~~~~~
+    void patch_fragment (pstore::repo::fragment const & src, fragment_patcher const & patcher) {
+        for (pstore::repo::section_kind const kind : src) {
+#define X(a)                                                                                       \
+    case pstore::repo::section_kind::a: patcher (src.at<pstore::repo::section_kind::a> ()); break;
+            switch (kind) {
+                PSTORE_MCREPO_SECTION_KINDS
+            case pstore::repo::section_kind::last:
+                // unreachable...
+                PSTORE_ASSERT (false);
+                break;
+            }
+#undef X
+        }
+    }
+
+} // end anonymous namespace
+
+namespace vacuum {
+
+    // (ctor)
+    // ~~~~~~
+    index_copier::index_copier (pstore::database const & source)
+            : source_{source} {}
+
+    // copy
+    // ~~~~
+    bool index_copier::copy (pstore::transaction_base & transaction,
+                             std::atomic<bool> const * const abandon) {
+        return this->copy_impl (transaction, all_records, abandon);
+    }
+
+    // copy_since
+    // ~~~~~~~~~~
+    void index_copier::copy_since (pstore::transaction_base & transaction,
+                                   pstore::revision_number const since) {
+        PSTORE_ASSERT (since != all_records);
+        this->copy_impl (transaction, since, nullptr);
+    }
+
+    // copy_impl
+    // ~~~~~~~~~
+    bool index_copier::copy_impl (pstore::transaction_base & transaction,
+                                  pstore::revision_number const since,
+                                  std::atomic<bool> const * const abandon) {
+        using pstore::trailer;
+        // The strings and debug line headers are copied first because the fragments and
+        // compilations refer to them.
+        if (!this->copy_strings<trailer::indices::name> (transaction, since, abandon) ||
+            !this->copy_strings<trailer::indices::path> (transaction, since, abandon) ||
+            !this->copy_blobs<trailer::indices::write> (transaction, since, abandon) ||
+            !this->copy_blobs<trailer::indices::debug_line_header> (transaction, since, abandon) ||
+            !this->copy_fragments (transaction, since, abandon) ||
+            !this->copy_compilations (transaction, since, abandon)) {
+            links_.clear ();
+            return false;
+        }
+
+        // Now that the compilations have been written, point the fragments' linked definitions at
+        // them.
+        for (definition_link const & link : links_) {
+            *transaction.getrw (typed_address<typed_address<pstore::repo::definition>>::make (
+                link.where)) = pstore::repo::compilation::index_address (
+                new_extent (compilations_, link.compilation).addr, link.index);
+        }
+        links_.clear ();
+        return true;
+    }
+
+    // copy_strings
+    // ~~~~~~~~~~~~
+    template <pstore::trailer::indices Index>
+    bool index_copier::copy_strings (pstore::transaction_base & transaction,
+                                     pstore::revision_number const since,
+                                     std::atomic<bool> const * const abandon) {
+        auto const src = pstore::index::get_index<Index> (source_);
+        std::vector<address> const src_leaves = leaves (source_, *src, since);
+        auto const size = src_leaves.size ();
+
+        // The bodies vector is sized up-front so that the views into it remain valid.
+        std::vector<std::string> bodies;
+        bodies.reserve (size);
+        for (address const leaf : src_leaves) {
+            pstore::shared_sstring_view owner;
+            bodies.emplace_back (
+                src->load_leaf_node (source_, leaf).as_db_string_view (&owner).to_string ());
+            if (abandoned (abandon)) {
+                return false;
+            }
+        }
+
+        database & db = transaction.db ();
+        std::vector<pstore::raw_sstring_view> views;
+        std::vector<indirect_string> keys;
+        views.reserve (size);
+        keys.reserve (size);
+        for (std::string const & body : bodies) {
+            views.emplace_back (pstore::make_sstring_view (body));
+            keys.emplace_back (db, &views.back ());
+        }
+
+        // Add the strings to the index and then, as indirect_string_adder does, write the string
+        // bodies and point the new index leaves at them.
+        auto const dest = pstore::index::get_index<Index> (db);
+        bool const bulk = dest->empty ();
+        if (bulk) {
+            dest->bulk_insert (transaction, std::begin (keys), std::end (keys));
+        }
+        for (auto ctr = std::size_t{0}; ctr < size; ++ctr) {
+            address leaf;
+            if (bulk) {
+                auto const pos = dest->find (db, keys[ctr]);
+                PSTORE_ASSERT (pos != dest->end (db));
+                leaf = pos.get_address ();
+            } else {
+                auto const res = dest->insert (transaction, keys[ctr]);
+                leaf = res.first.get_address ();
+                if (!res.second) {
+                    // The string is already present in the destination.
+                    strings_.emplace (src_leaves[ctr], typed_address<indirect_string>::make (leaf));
+                    continue;
+                }
+            }
+            indirect_string::write_body_and_patch_address (transaction, views[ctr],
+                                                           typed_address<address>::make (leaf));
+            strings_.emplace (src_leaves[ctr], typed_address<indirect_string>::make (leaf));
+        }
+        return true;
+    }
+
+    // copy_blobs
+    // ~~~~~~~~~~
+    /// Copies the records referenced by an index whose values are extents of plain data.
+    template <pstore::trailer::indices Index>
+    bool index_copier::copy_blobs (pstore::transaction_base & transaction,
+                                   pstore::revision_number const since,
+                                   std::atomic<bool> const * const abandon) {
+        auto const src = pstore::index::get_index<Index> (source_);
+        elements<Index> out;
+        for (address const leaf : leaves (source_, *src, since)) {
+            auto const kvp = src->load_leaf_node (source_, leaf);
+            out.emplace_back (kvp.first, copy_extent (source_, transaction, kvp.second).second);
+            if (abandoned (abandon)) {
+                return false;
+            }
+        }
+        add_elements (transaction, *pstore::index::get_index<Index> (transaction.db ()), out);
+        remember_headers (&headers_, out);
+        return true;
+    }
+
+    // copy_fragments
+    // ~~~~~~~~~~~~~~
+    bool index_copier::copy_fragments (pstore::transaction_base & transaction,
+                                       pstore::revision_number const since,
+                                       std::atomic<bool> const * const abandon) {
+        constexpr auto fragment_kind = pstore::trailer::indices::fragment;
+        auto const src = pstore::index::get_index<fragment_kind> (source_);
+        elements<fragment_kind> out;
+        for (address const leaf : leaves (source_, *src, since)) {
+            auto const kvp = src->load_leaf_node (source_, leaf);
+            std::shared_ptr<pstore::repo::fragment const> const f =
+                pstore::repo::fragment::load (source_, kvp.second);
+            auto const copy = copy_extent (source_, transaction, kvp.second);
+            patch_fragment (*f, fragment_patcher{*f, copy.first.get (),
+                                                 copy.second.addr.to_address (), strings_,
+                                                 headers_, &links_});
+            out.emplace_back (kvp.first, copy.second);
+            fragments_[kvp.first] = copy.second;
+            if (abandoned (abandon)) {
+                return false;
+            }
+        }
+        add_elements (transaction, *pstore::index::get_index<fragment_kind> (transaction.db ()),
+                      out);
+        return true;
+    }
+
+    // copy_compilations
+    // ~~~~~~~~~~~~~~~~~
+    bool index_copier::copy_compilations (pstore::transaction_base & transaction,
+                                          pstore::revision_number const since,
+                                          std::atomic<bool> const * const abandon) {
+        constexpr auto compilation_kind = pstore::trailer::indices::compilation;
+        auto const src = pstore::index::get_index<compilation_kind> (source_);
+        elements<compilation_kind> out;
+        std::vector<pstore::repo::definition> definitions;
+        for (address const leaf : leaves (source_, *src, since)) {
+            auto const kvp = src->load_leaf_node (source_, leaf);
+            std::shared_ptr<pstore::repo::compilation const> const c =
+                pstore::repo::compilation::load (source_, kvp.second);
+            // The definitions are kept in their original order: linked-definitions sections
+            // refer to them by index.
+            definitions.assign (c->begin (), c->end ());
+            for (pstore::repo::definition & d : definitions) {
+                d.fext = new_extent (fragments_, d.digest);
+                d.name = new_string (strings_, d.name);
+            }
+            extent<pstore::repo::compilation> const ex = pstore::repo::compilation::alloc (
+                transaction, new_string (strings_, c->triple ()), std::begin (definitions),
+                std::end (definitions));
+            out.emplace_back (kvp.first, ex);
+            compilations_[kvp.first] = ex;
+            if (abandoned (abandon)) {
+                return false;
+            }
+        }
+        add_elements (transaction,
+                      *pstore::index::get_index<compilation_kind> (transaction.db ()), out);
+        return true;
+    }
+
+
+    // copy_indices
+    // ~~~~~~~~~~~~
+    bool copy_indices (pstore::database const & source, pstore::transaction_base & transaction,
+                       status const & st) {
+        index_copier copier{source};
+        return copier.copy (transaction, &st.modified);
+    }
+
+} // end namespace vacuum
@@ -22,10 +22,16 @@
 #include <sstream>
 #include <stdexcept>
 #include <tuple>
+#include <vector>
+
+#ifdef PSTORE_GENROMFS_ZLIB
+#    include <zlib.h>
+#endif
 
 // pstore includes
 #include "pstore/support/array_elements.hpp"
 #include "pstore/support/error.hpp"
+#include "pstore/support/fnv.hpp"
 #include "pstore/support/portab.hpp"
 #include "pstore/support/quoted.hpp"
 #include "pstore/support/utf.hpp"
@@ -75,46 +81,50 @@ namespace {
         pstore::raise_exception (read_failed_error{str.str ()});
     }
 
-} // end anonymous namespace
-
-void copy (std::string const & path, unsigned file_no) {
-    static constexpr auto indent_size = pstore::array_elements (indent) - 1U;
-    static constexpr auto crindent_size = pstore::array_elements (crindent) - 1U;
-    static constexpr auto line_width = std::size_t{80} - indent_size;
-    static constexpr auto separator_size = std::size_t{1};  // empty or comma
-    static constexpr auto byte_value_size = std::size_t{3}; // base10: 0-255.
-
-    std::ostream & os = std::cout;
-
-    auto getcr = [] (std::size_t width) {
-        return width >= line_width ? std::make_pair (std::size_t{0}, crindent)
-                                   : std::make_pair (width, "");
-    };
-
-    constexpr auto buffer_size = std::size_t{1024};
-    std::uint8_t buffer[buffer_size] = {0};
-    std::unique_ptr<FILE, decltype (&file_close)> file (file_open (path), &file_close);
-    if (!file) {
-        open_failed (errno, path);
-    }
-    os << "std::uint8_t const " << file_var (file_no) << "[] = {\n" << indent;
-    std::size_t width = indent_size;
-    char const * separator = "";
-    auto num_read = std::size_t{0};
-    do {
-        num_read = std::fread (&buffer[0], sizeof (buffer[0]), buffer_size, file.get ());
-        num_read = std::min (buffer_size, num_read);
-        if (std::ferror (file.get ())) {
-            read_failed (path);
+    std::vector<std::uint8_t> read_file (std::string const & path) {
+        constexpr auto buffer_size = std::size_t{1024};
+        std::uint8_t buffer[buffer_size] = {0};
+        std::unique_ptr<FILE, decltype (&file_close)> file (file_open (path), &file_close);
+        if (!file) {
+            open_failed (errno, path);
         }
-        for (auto n = std::size_t{0}; n < num_read; ++n) {
+        std::vector<std::uint8_t> result;
+        auto num_read = std::size_t{0};
+        do {
+            num_read = std::fread (&buffer[0], sizeof (buffer[0]), buffer_size, file.get ());
+            num_read = std::min (buffer_size, num_read);
+            if (std::ferror (file.get ())) {
+                read_failed (path);
+            }
+            result.insert (std::end (result), &buffer[0], &buffer[0] + num_read);
+        } while (num_read >= buffer_size);
+        return result;
+    }
+
+    void write_array (std::ostream & os, std::string const & name,
+                      std::vector<std::uint8_t> const & contents) {
+        static constexpr auto indent_size = pstore::array_elements (indent) - 1U;
+        static constexpr auto crindent_size = pstore::array_elements (crindent) - 1U;
+        static constexpr auto line_width = std::size_t{80} - indent_size;
+        static constexpr auto separator_size = std::size_t{1};  // empty or comma
+        static constexpr auto byte_value_size = std::size_t{3}; // base10: 0-255.
+
+        auto getcr = [] (std::size_t width) {
+            return width >= line_width ? std::make_pair (std::size_t{0}, crindent)
+                                       : std::make_pair (width, "");
+        };
+
+        os << "std::uint8_t const " << name << "[] = {\n" << indent;
+        std::size_t width = indent_size;
+        char const * separator = "";
+        for (std::uint8_t const v : contents) {
             char const * cr;
             std::tie (width, cr) = getcr (width);
 
             PSTORE_ASSERT (std::strlen (separator) <= separator_size);
             std::array<char, separator_size + crindent_size + byte_value_size + 1> vbuf{{0}};
             int written = std::snprintf (vbuf.data (), vbuf.size (), "%s%s%u", separator, cr,
-                                         static_cast<unsigned> (buffer[n]));
+                                         static_cast<unsigned> (v));
             if (written < 0) {
                 // Is there anything more sensible we can do?
                 pstore::raise_exception (snprintf_failed_error ());
@@ -127,6 +137,75 @@ void copy (std::string const & path, unsigned file_no) {
             width += static_cast<std::make_unsigned<decltype (written)>::type> (written);
             separator = ",";
         }
-    } while (num_read >= buffer_size);
-    os << "\n};\n";
+        os << "\n};\n";
+    }
+
+    // The entity tag is derived from the file's contents so that it changes if, and only if,
+    // the file does.
+    std::string make_etag (std::vector<std::uint8_t> const & contents) {
+        std::array<char, 2 + 16 + 1> buffer{{0}};
+        std::snprintf (buffer.data (), buffer.size (), "\"%016llx\"",
+                       static_cast<unsigned long long> (
+                           pstore::fnv_64a_buf (contents.data (), contents.size ())));
+        return std::string{buffer.data ()};
+    }
+
+#ifdef PSTORE_GENROMFS_ZLIB
+    class compress_failed_error : public std::runtime_error {
+    public:
+        explicit compress_failed_error (std::string const & message)
+                : std::runtime_error (message) {}
+    };
+
+    /// Returns the contents of a file compressed in the gzip format.
+    std::vector<std::uint8_t> gzip (std::string const & path,
+                                    std::vector<std::uint8_t> const & contents) {
+        z_stream strm{};
+        // A window size of 15 plus 16 selects a gzip (rather than zlib) wrapper. The header's
+        // time field is left as 0 so that the output is reproducible.
+        constexpr int window_bits = 15 + 16;
+        constexpr int mem_level = 9;
+        if (deflateInit2 (&strm, Z_BEST_COMPRESSION, Z_DEFLATED, window_bits, mem_level,
+                          Z_DEFAULT_STRATEGY) != Z_OK) {
+            pstore::raise_exception (compress_failed_error{"deflateInit2 failed"});
+        }
+        std::vector<std::uint8_t> result (
+            deflateBound (&strm, static_cast<uLong> (contents.size ())));
+        strm.next_in = const_cast<Bytef *> (contents.data ());
+        strm.avail_in = static_cast<uInt> (contents.size ());
+        strm.next_out = result.data ();
+        strm.avail_out = static_cast<uInt> (result.size ());
+        int const erc = deflate (&strm, Z_FINISH);
+        result.resize (result.size () - strm.avail_out);
+        deflateEnd (&strm);
+        if (erc != Z_STREAM_END) {
+            std::stringstream str;
+            str << "compression of file " << pstore::quoted (path) << " failed";
+            pstore::raise_exception (compress_failed_error{str.str ()});
+        }
+        return result;
+    }
+#endif // PSTORE_GENROMFS_ZLIB
+
+} // end anonymous namespace
+
+file_attributes copy (std::string const & path, unsigned file_no) {
+    std::ostream & os = std::cout;
+
+    std::vector<std::uint8_t> const contents = read_file (path);
+    std::string const name = file_var (file_no).as_string ();
+    write_array (os, name, contents);
+
+    file_attributes attributes;
+    attributes.etag = make_etag (contents);
+#ifdef PSTORE_GENROMFS_ZLIB
+    // Only keep the compressed copy if it saves at least an eighth of the original size: it isn't
+    // worth the space (or the client's effort) otherwise.
+    std::vector<std::uint8_t> const compressed = gzip (path, contents);
+    if (compressed.size () < contents.size () - contents.size () / 8U) {
+        write_array (os, gzip_var (file_no).as_string (), compressed);
+        attributes.gzip = true;
+    }
+#endif // PSTORE_GENROMFS_ZLIB
+    return attributes;
 }
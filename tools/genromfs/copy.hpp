@@ -18,6 +18,16 @@
 
 #include <string>
 
-void copy (std::string const & path, unsigned file_no);
+/// Describes the definitions that copy() wrote for a file.
+struct file_attributes {
+    /// A strong entity tag, including its surrounding quotes, derived from the file's contents.
+    std::string etag;
+    /// True if a gzip-compressed copy of the file's contents was written.
+    bool gzip = false;
+};
+
+/// Writes the definition of an array containing the contents of the file at \p path. If the
+/// file compresses well, a second array containing its gzip-compressed contents is also written.
+file_attributes copy (std::string const & path, unsigned file_no);
 
 #endif // PSTORE_GENROMFS_COPY_HPP
@@ -41,6 +41,10 @@ struct directory_entry {
     unsigned contents;
     std::time_t modtime;
     std::unique_ptr<directory_container> children;
+    /// The file's entity tag (files only).
+    std::string etag;
+    /// True if a gzip-compressed copy of the file's contents was written (files only).
+    bool gzip = false;
 };
 
 
@@ -33,6 +33,18 @@ namespace {
         }
     }
 
+    /// Writes \p str as a C++ string literal.
+    void string_literal (std::ostream & os, std::string const & str) {
+        os << '"';
+        for (char const c : str) {
+            if (c == '"' || c == '\\') {
+                os << '\\';
+            }
+            os << c;
+        }
+        os << '"';
+    }
+
 } // end anonymous namespace
 
 
@@ -67,7 +79,14 @@ void dump_tree (std::ostream & os, std::unordered_set<unsigned> & forwards,
             auto const contents_name = file_var (de.contents);
             os << indent << "{\"" << de.name << "\", " << contents_name
                << ", pstore::romfs::stat{sizeof (" << contents_name << "), " << de.modtime
-               << ", pstore::romfs::mode_t::file}";
+               << ", pstore::romfs::mode_t::file}, ";
+            string_literal (os, de.etag);
+            if (de.gzip) {
+                auto const gzip_name = gzip_var (de.contents);
+                os << ", " << gzip_name << ", sizeof (" << gzip_name << ')';
+            } else {
+                os << ", nullptr, 0";
+            }
         }
         os << "},\n";
     }
@@ -49,7 +49,10 @@ namespace {
     unsigned add_file (directory_container & directory, std::string const & path_name,
                        std::string const & file_name, unsigned count, std::time_t modtime) {
         directory.emplace_back (file_name, count, modtime);
-        copy (path_name, directory.back ().contents);
+        directory_entry & de = directory.back ();
+        file_attributes const attributes = copy (path_name, de.contents);
+        de.etag = attributes.etag;
+        de.gzip = attributes.gzip;
         return count + 1U;
     }
 
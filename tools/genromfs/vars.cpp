@@ -17,3 +17,4 @@
 
 std::string const directory_var_policy::name_ = "d";
 std::string const file_var_policy::name_ = "f";
+std::string const gzip_var_policy::name_ = "g";
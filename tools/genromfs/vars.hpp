@@ -72,7 +72,16 @@ private:
     static std::string const name_;
 };
 
+class gzip_var_policy {
+public:
+    static std::string const & name () noexcept { return name_; }
+
+private:
+    static std::string const name_;
+};
+
 using directory_var = variable_name<directory_var_policy>;
 using file_var = variable_name<file_var_policy>;
+using gzip_var = variable_name<gzip_var_policy>;
 
 #endif // PSTORE_GENROMFS_VARS_HPP
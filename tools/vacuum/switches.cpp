@@ -23,6 +23,10 @@ namespace {
 
     opt<std::string> path (positional, usage ("repository"),
                            desc ("Path of the pstore repository to be vacuumed."));
+    opt<bool> incremental ("incremental",
+                           desc ("Copy the repository while other processes continue to write to "
+                                 "it. Writers are blocked only while the final few transactions "
+                                 "are copied."));
 
 } // end anonymous namespace
 
@@ -31,5 +35,6 @@ std::pair<vacuum::user_options, int> get_switches (int argc, tchar * argv[]) {
 
     vacuum::user_options opt;
     opt.src_path = path.get ();
+    opt.incremental = incremental.get ();
     return {opt, EXIT_SUCCESS};
 }
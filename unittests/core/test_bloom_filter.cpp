@@ -0,0 +1,263 @@
+//===- unittests/core/test_bloom_filter.cpp -------------------------------===//
+//*  _     _                          __ _ _ _             *
+//* | |__ | | ___   ___  _ __ ___    / _(_) | |_ ___ _ __  *
+//* | '_ \| |/ _ \ / _ \| '_ ` _ \  | |_| | | __/ _ \ '__| *
+//* | |_) | | (_) | (_) | | | | | | |  _| | | ||  __/ |    *
+//* |_.__/|_|\___/ \___/|_| |_| |_| |_| |_|_|\__\___|_|    *
+//*                                                        *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file test_bloom_filter.cpp
+#include "pstore/core/bloom_filter.hpp"
+
+#include <mutex>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "pstore/core/transaction.hpp"
+
+#include "check_for_error.hpp"
+#include "empty_store.hpp"
+
+namespace {
+
+    class BloomFilter : public EmptyStore {
+    public:
+        BloomFilter ()
+                : db_{this->file ()} {
+            db_.set_vacuum_mode (pstore::database::vacuum_mode::disabled);
+        }
+
+    protected:
+        using lock_guard = std::unique_lock<mock_mutex>;
+        mock_mutex mutex_;
+        pstore::database db_;
+    };
+
+    // The test keys are described to the filter by the pair (key, ~key).
+    constexpr std::uint64_t other (std::uint64_t const key) noexcept { return ~key; }
+
+} // end anonymous namespace
+
+TEST_F (BloomFilter, Empty) {
+    pstore::index::bloom_filter const filter{0U};
+    pstore::database::read_view view{db_};
+    EXPECT_EQ (0U, filter.size ());
+    EXPECT_GT (filter.capacity (), 0U);
+    EXPECT_FALSE (filter.may_contain (view, 1U, other (1U)));
+}
+
+TEST_F (BloomFilter, Capacity) {
+    pstore::index::bloom_filter const filter{1000U};
+    EXPECT_GE (filter.capacity (), 1000U);
+}
+
+TEST_F (BloomFilter, NoFalseNegatives) {
+    constexpr auto num_keys = std::uint64_t{1000};
+    pstore::index::bloom_filter filter{num_keys};
+    for (auto key = std::uint64_t{0}; key < num_keys; ++key) {
+        filter.insert (key, other (key));
+    }
+    EXPECT_EQ (num_keys, filter.size ());
+
+    pstore::database::read_view view{db_};
+    auto false_positives = 0U;
+    for (auto key = std::uint64_t{0}; key < 2 * num_keys; ++key) {
+        bool const present = filter.may_contain (view, key, other (key));
+        if (key < num_keys) {
+            EXPECT_TRUE (present) << "key " << key;
+        } else if (present) {
+            ++false_positives;
+        }
+    }
+    // The filter is designed for a false positive rate of around 1%.
+    EXPECT_LT (false_positives, num_keys / 20U);
+}
+
+TEST_F (BloomFilter, StoreRoundTrip) {
+    constexpr auto num_keys = std::uint64_t{300};
+    pstore::index::bloom_filter filter{num_keys};
+    for (auto key = std::uint64_t{0}; key < num_keys; ++key) {
+        filter.insert (key, other (key));
+    }
+
+    pstore::address addr;
+    {
+        auto t = begin (db_, lock_guard{mutex_});
+        addr = filter.flush (t);
+        t.commit ();
+    }
+    // Each block of the filter should be cache-line aligned.
+    EXPECT_EQ (0U, addr.absolute () % 64U);
+
+    pstore::index::bloom_filter::stored const stored{db_, addr};
+    EXPECT_EQ (addr, stored.addr ());
+    EXPECT_EQ (num_keys, stored.size ());
+
+    pstore::index::bloom_filter const extended{stored};
+    EXPECT_EQ (num_keys, extended.size ());
+    EXPECT_EQ (filter.capacity (), extended.capacity ());
+
+    pstore::database::read_view view{db_};
+    for (auto key = std::uint64_t{0}; key < 2 * num_keys; ++key) {
+        bool const expected = filter.may_contain (view, key, other (key));
+        EXPECT_EQ (expected, stored.may_contain (view, key, other (key))) << "key " << key;
+        EXPECT_EQ (expected, extended.may_contain (view, key, other (key))) << "key " << key;
+    }
+}
+
+TEST_F (BloomFilter, GrowsBySegments) {
+    constexpr auto num_keys = std::uint64_t{5000};
+    pstore::index::bloom_filter filter{100U};
+    auto const initial_capacity = filter.capacity ();
+    for (auto key = std::uint64_t{0}; key < num_keys; ++key) {
+        filter.insert (key, other (key));
+    }
+    EXPECT_EQ (num_keys, filter.size ());
+    EXPECT_GE (filter.capacity (), num_keys);
+
+    pstore::address addr;
+    {
+        auto t = begin (db_, lock_guard{mutex_});
+        addr = filter.flush (t);
+        t.commit ();
+    }
+    pstore::index::bloom_filter::stored const stored{db_, addr};
+    EXPECT_EQ (num_keys, stored.size ());
+    EXPECT_LT (initial_capacity, pstore::index::bloom_filter{stored}.capacity ());
+
+    pstore::database::read_view view{db_};
+    auto false_positives = 0U;
+    for (auto key = std::uint64_t{0}; key < 2 * num_keys; ++key) {
+        bool const present = stored.may_contain (view, key, other (key));
+        if (key < num_keys) {
+            EXPECT_TRUE (present) << "key " << key;
+        } else if (present) {
+            ++false_positives;
+        }
+    }
+    // Later segments allow more bits per key so the rate stays close to that of one segment.
+    EXPECT_LT (false_positives, num_keys / 20U);
+}
+
+TEST_F (BloomFilter, CommitsWriteDeltas) {
+    constexpr auto initial_keys = std::uint64_t{1000};
+    constexpr auto keys_per_commit = std::uint64_t{4};
+    constexpr auto commits = 40U;
+
+    pstore::address addr;
+    std::uint64_t whole_size = 0;
+    {
+        pstore::index::bloom_filter filter{initial_keys * 40U};
+        for (auto key = std::uint64_t{0}; key < initial_keys; ++key) {
+            filter.insert (key, other (key));
+        }
+        whole_size = filter.flush_size ();
+        auto t = begin (db_, lock_guard{mutex_});
+        addr = filter.flush (t);
+        t.commit ();
+    }
+
+    // Each commit adds a few keys to the filter written by the previous one.
+    auto key = initial_keys;
+    for (auto commit = 0U; commit < commits; ++commit) {
+        pstore::index::bloom_filter filter{pstore::index::bloom_filter::stored{db_, addr}};
+        for (auto ctr = std::uint64_t{0}; ctr < keys_per_commit; ++ctr, ++key) {
+            filter.insert (key, other (key));
+        }
+        auto const size = filter.flush_size ();
+        // Only the blocks which the keys changed should be written, however many deltas are
+        // merged on the way.
+        EXPECT_LT (size, whole_size / 4U) << "commit " << commit;
+
+        auto t = begin (db_, lock_guard{mutex_});
+        auto const first = t.allocate (0U, 1U);
+        addr = filter.flush (t);
+        EXPECT_LE ((t.allocate (0U, 1U) - first).absolute (), size) << "commit " << commit;
+        t.commit ();
+    }
+
+    pstore::index::bloom_filter::stored const stored{db_, addr};
+    EXPECT_EQ (key, stored.size ());
+    pstore::database::read_view view{db_};
+    for (auto k = std::uint64_t{0}; k < key; ++k) {
+        EXPECT_TRUE (stored.may_contain (view, k, other (k))) << "key " << k;
+    }
+}
+
+TEST_F (BloomFilter, DeltasAreMergedIntoTheSegment) {
+    pstore::address addr;
+    {
+        pstore::index::bloom_filter filter{1000U};
+        filter.insert (0U, other (0U));
+        auto t = begin (db_, lock_guard{mutex_});
+        addr = filter.flush (t);
+        t.commit ();
+    }
+    // Keep adding keys until the segment has been rewritten whole. Each key gets its own
+    // commit so that the segment gathers deltas.
+    auto key = std::uint64_t{1};
+    for (; key < 1000U; ++key) {
+        pstore::index::bloom_filter filter{pstore::index::bloom_filter::stored{db_, addr}};
+        filter.insert (key, other (key));
+        auto t = begin (db_, lock_guard{mutex_});
+        addr = filter.flush (t);
+        t.commit ();
+        auto const sig = db_.getro (pstore::typed_address<std::array<char, 8>>::make (addr));
+        if (std::string{std::begin (*sig), std::end (*sig)} == "IndxBlom") {
+            break;
+        }
+    }
+    EXPECT_LT (key, 1000U) << "The segment was never rewritten whole";
+
+    pstore::index::bloom_filter::stored const stored{db_, addr};
+    pstore::database::read_view view{db_};
+    for (auto k = std::uint64_t{0}; k <= key; ++k) {
+        EXPECT_TRUE (stored.may_contain (view, k, other (k))) << "key " << k;
+    }
+}
+
+TEST_F (BloomFilter, BadSignature) {
+    pstore::address addr;
+    {
+        auto t = begin (db_, lock_guard{mutex_});
+        auto const block = t.alloc_rw<std::uint64_t> (8U);
+        std::fill_n (block.first.get (), 8U, std::uint64_t{1});
+        addr = block.second.to_address ();
+        t.commit ();
+    }
+    check_for_error ([this, addr] () { pstore::index::bloom_filter::stored{db_, addr}; },
+                     pstore::error_code::index_corrupt);
+}
+
+TEST_F (BloomFilter, ZeroSegmentSize) {
+    pstore::index::bloom_filter filter{1U};
+    filter.insert (1U, other (1U));
+    pstore::address valid;
+    {
+        auto t = begin (db_, lock_guard{mutex_});
+        valid = filter.flush (t);
+        t.commit ();
+    }
+    // Copy the record's header and clear its segment_size field.
+    pstore::address addr;
+    {
+        auto t = begin (db_, lock_guard{mutex_});
+        auto const block = t.alloc_rw<std::uint64_t> (8U);
+        std::shared_ptr<std::uint64_t const> const src =
+            db_.getro (pstore::typed_address<std::uint64_t>::make (valid), 8U);
+        std::copy_n (src.get (), 8U, block.first.get ());
+        block.first.get ()[4] = 0U;
+        addr = block.second.to_address ();
+        t.commit ();
+    }
+    check_for_error ([this, addr] () { pstore::index::bloom_filter::stored{db_, addr}; },
+                     pstore::error_code::index_corrupt);
+}
@@ -24,6 +24,7 @@
 
 #include "gmock/gmock.h"
 
+#include "pstore/core/transaction.hpp"
 #include "pstore/support/portab.hpp"
 
 #include "check_for_error.hpp"
@@ -127,6 +128,25 @@ TEST_F (OpenCorruptStore, HeaderBadMinorVersion) {
     this->check_database_open (pstore::error_code::header_version_mismatch);
 }
 
+TEST_F (OpenCorruptStore, HeaderOlderMinorVersion) {
+    // A store with an older (but still supported) minor version can be opened. The first commit
+    // updates its version number.
+    auto * const h = this->get_header ();
+    h->a.version[1] = pstore::header::min_minor_version;
+    h->crc = h->get_crc ();
+
+    pstore::database db{this->file ()};
+    db.set_vacuum_mode (pstore::database::vacuum_mode::disabled);
+    EXPECT_EQ (pstore::header::min_minor_version, db.get_header ().version ()[1]);
+
+    mock_mutex mutex;
+    auto transaction = begin (db, std::unique_lock<mock_mutex>{mutex});
+    transaction.allocate (16U, 1U);
+    transaction.commit ();
+    EXPECT_EQ (pstore::header::minor_version, db.get_header ().version ()[1]);
+    EXPECT_TRUE (db.get_header ().is_valid ());
+}
+
 TEST_F (OpenCorruptStore, HeaderID) {
     // This test is only valid if CRC checking is enabled.
     if (pstore::database::crc_checks_enabled ()) {
@@ -226,6 +246,27 @@ TEST_F (Database, GetLocationOverflows) {
                      pstore::error_code::bad_address);
 }
 
+TEST_F (Database, ReadViewMatchesGetro) {
+    pstore::database db{this->file ()};
+    db.set_vacuum_mode (pstore::database::vacuum_mode::disabled);
+
+    pstore::database::read_view view{db};
+    auto const footer = db.footer_pos ();
+    EXPECT_EQ (db.getro (footer).get (), view.get (footer));
+    EXPECT_EQ (db.getro (footer).get (), view.get (footer.to_address (), sizeof (pstore::trailer)));
+}
+
+TEST_F (Database, ReadViewPastLogicalEOF) {
+    pstore::database db{this->file ()};
+    db.set_vacuum_mode (pstore::database::vacuum_mode::disabled);
+
+    pstore::database::read_view view{db};
+    auto const addr = pstore::address::null ();
+    std::size_t size = db.size () + 1;
+    check_for_error ([&view, addr, size] () { view.get (addr, size); },
+                     pstore::error_code::bad_address);
+}
+
 TEST_F (Database, Allocate16Bytes) {
     pstore::database db{this->file ()};
     db.set_vacuum_mode (pstore::database::vacuum_mode::disabled);
@@ -183,6 +183,45 @@ TEST_F (DbArchiveWriteSpan, WriteUint64Span) {
     write (archive::make_writer (transaction), span);
 }
 
+TEST_F (DbArchiveWriteSpan, BufferedWriterMakesOneAllocation) {
+    using ::testing::_;
+    using ::testing::Invoke;
+
+    pstore::database db{this->file ()};
+    db.set_vacuum_mode (pstore::database::vacuum_mode::disabled);
+
+    mock_mutex mutex;
+    mock_transaction transaction (db, std::unique_lock<mock_mutex>{mutex});
+    // The buffer holds a uint8_t, 7 bytes of padding, a uint64_t and two uint32_t values. It must
+    // be written with a single allocation which has the greatest alignment of those types.
+    auto invoke_base_allocate = Invoke (&transaction, &mock_transaction::base_allocate);
+    EXPECT_CALL (transaction, allocate (_, _)).Times (0);
+    EXPECT_CALL (transaction, allocate (24U, alignof (std::uint64_t)))
+        .Times (1)
+        .WillOnce (invoke_base_allocate);
+
+    std::array<std::uint32_t, 2> const original{{UINT32_C (0xCAFEBEEF), UINT32_C (0xFEEDFACE)}};
+
+    using namespace pstore::serialize;
+    archive::buffered_database_writer writer{transaction};
+    std::size_t const o1 = write (writer, std::uint8_t{0x7F});
+    std::size_t const o2 = write (writer, UINT64_C (0xF0F0F0F0F0F0F0F0));
+    std::size_t const o3 = write (writer, ::pstore::gsl::make_span (original));
+    EXPECT_EQ (o1, 0U);
+    EXPECT_EQ (o2, 8U);
+    EXPECT_EQ (o3, 16U);
+    writer.flush ();
+
+    EXPECT_EQ (*db.getro (pstore::typed_address<std::uint8_t>::make (writer.address_of (o1))),
+               0x7F);
+    EXPECT_EQ (*db.getro (pstore::typed_address<std::uint64_t>::make (writer.address_of (o2))),
+               UINT64_C (0xF0F0F0F0F0F0F0F0));
+    std::shared_ptr<std::uint32_t const> const actual =
+        db.getro (pstore::typed_address<std::uint32_t>::make (writer.address_of (o3)), 2);
+    EXPECT_EQ (actual.get ()[0], original[0]);
+    EXPECT_EQ (actual.get ()[1], original[1]);
+}
+
 namespace {
 
     class DbArchiveReadSpan : public EmptyStore {
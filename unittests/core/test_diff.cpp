@@ -201,3 +201,84 @@ TEST_F (Diff, UncomittedTransaction) {
 
     t2.commit ();
 }
+
+namespace {
+
+    /// Returns the keys of the leaves named by a collection of index_change records.
+    template <typename Index>
+    std::vector<std::string> changed_keys (pstore::database const & db, Index const & index,
+                                           std::vector<pstore::index_change> const & changes,
+                                           pstore::change_kind const kind) {
+        std::vector<std::string> keys;
+        for (pstore::index_change const & c : changes) {
+            if (c.kind == kind) {
+                auto const leaf = kind == pstore::change_kind::removed ? c.old_leaf : c.new_leaf;
+                keys.push_back (index.load_leaf_node (db, leaf).first);
+            }
+        }
+        return keys;
+    }
+
+} // end anonymous namespace
+
+TEST_F (Diff, DiffIndices) {
+    using ::testing::ElementsAre;
+    using ::testing::IsEmpty;
+    using ::testing::UnorderedElementsAre;
+    using ::testing::UnorderedElementsAreArray;
+
+    {
+        transaction_type t1 = begin (*db_, lock_guard{mutex_});
+        for (auto ctr = 0U; ctr < 500U; ++ctr) {
+            this->add (t1, "key " + std::to_string (ctr), "first value");
+        }
+        t1.commit ();
+    }
+    {
+        transaction_type t2 = begin (*db_, lock_guard{mutex_});
+        this->add (t2, "key 7", "second value");
+        this->add (t2, "key 301", "second value");
+        this->add (t2, "new key 1", "value");
+        this->add (t2, "new key 2", "value");
+        t2.commit ();
+    }
+
+    db_->sync (1U);
+    auto const r1 = pstore::index::get_index<pstore::trailer::indices::write> (*db_);
+    db_->sync (2U);
+    auto const r2 = pstore::index::get_index<pstore::trailer::indices::write> (*db_);
+    ASSERT_NE (r1, r2);
+
+    std::vector<pstore::index_change> forward;
+    pstore::diff_indices (*db_, *r1, *r2, std::back_inserter (forward));
+    EXPECT_THAT (changed_keys (*db_, *r2, forward, pstore::change_kind::added),
+                 UnorderedElementsAre ("new key 1", "new key 2"));
+    EXPECT_THAT (changed_keys (*db_, *r2, forward, pstore::change_kind::replaced),
+                 UnorderedElementsAre ("key 7", "key 301"));
+    EXPECT_THAT (changed_keys (*db_, *r1, forward, pstore::change_kind::removed), IsEmpty ());
+    for (pstore::index_change const & c : forward) {
+        if (c.kind == pstore::change_kind::replaced) {
+            EXPECT_EQ (r1->load_leaf_node (*db_, c.old_leaf).second.size,
+                       std::string{"first value"}.length ());
+        }
+    }
+
+    // The parallel comparison produces the same records in the same order.
+    std::vector<pstore::index_change> parallel;
+    pstore::parallel_diff_indices (*db_, *r1, *r2, std::back_inserter (parallel));
+    EXPECT_THAT (parallel, ::testing::ContainerEq (forward));
+
+    // Comparing in the opposite direction turns additions into removals.
+    std::vector<pstore::index_change> backward;
+    pstore::parallel_diff_indices (*db_, *r2, *r1, std::back_inserter (backward));
+    EXPECT_THAT (changed_keys (*db_, *r1, backward, pstore::change_kind::removed),
+                 UnorderedElementsAre ("new key 1", "new key 2"));
+    EXPECT_THAT (changed_keys (*db_, *r1, backward, pstore::change_kind::replaced),
+                 UnorderedElementsAre ("key 7", "key 301"));
+    EXPECT_THAT (changed_keys (*db_, *r2, backward, pstore::change_kind::added), IsEmpty ());
+
+    // An index is identical to itself.
+    std::vector<pstore::index_change> none;
+    pstore::parallel_diff_indices (*db_, *r2, *r2, std::back_inserter (none));
+    EXPECT_THAT (none, IsEmpty ());
+}
@@ -0,0 +1,123 @@
+//===- unittests/core/test_group_commit.cpp -------------------------------===//
+//*                                                             _ _    *
+//*   __ _ _ __ ___  _   _ _ __     ___ ___  _ __ ___  _ __ ___ (_) |_  *
+//*  / _` | '__/ _ \| | | | '_ \   / __/ _ \| '_ ` _ \| '_ ` _ \| | __| *
+//* | (_| | | | (_) | |_| | |_) | | (_| (_) | | | | | | | | | | | | |_  *
+//*  \__, |_|  \___/ \__,_| .__/   \___\___/|_| |_| |_|_| |_| |_|_|\__| *
+//*  |___/                |_|                                           *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file test_group_commit.cpp
+#include "group_commit.hpp"
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "pstore/config/config.hpp"
+
+TEST (GroupCommit, SharedByName) {
+    auto const a1 = pstore::group_commit::get ("a");
+    auto const a2 = pstore::group_commit::get ("a");
+    auto const b = pstore::group_commit::get ("b");
+    EXPECT_EQ (a1, a2);
+    EXPECT_NE (a1, b);
+}
+
+namespace {
+
+    using pstore::address;
+
+} // end anonymous namespace
+
+TEST (GroupCommit, SingleFlush) {
+    pstore::group_commit gc;
+    std::vector<std::pair<address, address>> calls;
+    auto const sync = [&calls] (address const first, address const last) {
+        calls.emplace_back (first, last);
+    };
+    gc.flush (address{16}, address{32}, sync);
+    gc.flush (address{32}, address{48}, sync);
+    EXPECT_EQ ((std::vector<std::pair<address, address>>{{address{16}, address{32}},
+                                                         {address{32}, address{48}}}),
+               calls);
+}
+
+TEST (GroupCommit, ConcurrentFlushes) {
+    pstore::group_commit gc;
+    std::promise<void> release;
+    std::shared_future<void> const released = release.get_future ().share ();
+    std::atomic<unsigned> calls{0};
+    std::atomic<unsigned> started{0};
+
+    // The first thread becomes the leader of a batch and blocks whilst the others join the next
+    // batch.
+    std::thread leader{[&] () {
+        gc.flush (address{0}, address{16}, [&] (address, address) {
+            ++calls;
+            ++started;
+            released.wait ();
+        });
+    }};
+    while (started.load () == 0U) {
+        std::this_thread::yield ();
+    }
+
+    // Each follower adds a distinct range. The batch is flushed with a single call for their
+    // union using the sync function of the follower whose range ends last.
+    constexpr auto num_followers = 4U;
+    std::atomic<unsigned> queued{0};
+    std::atomic<unsigned> synced_by{num_followers};
+    address union_first;
+    address union_last;
+    std::vector<std::thread> followers;
+    for (auto ctr = 0U; ctr < num_followers; ++ctr) {
+        followers.emplace_back ([&, ctr] () {
+            ++queued;
+            gc.flush (address{16U + ctr * 16U}, address{32U + ctr * 16U},
+                      [&, ctr] (address const first, address const last) {
+                          ++calls;
+                          synced_by = ctr;
+                          union_first = first;
+                          union_last = last;
+                      });
+        });
+    }
+    while (queued.load () < num_followers) {
+        std::this_thread::yield ();
+    }
+    release.set_value ();
+
+    leader.join ();
+    for (std::thread & t : followers) {
+        t.join ();
+    }
+    EXPECT_EQ (2U, calls.load ());
+    EXPECT_EQ (num_followers - 1U, synced_by.load ());
+    EXPECT_EQ (address{16}, union_first);
+    EXPECT_EQ (address{16U + num_followers * 16U}, union_last);
+}
+
+#ifdef PSTORE_EXCEPTIONS
+TEST (GroupCommit, ErrorIsReported) {
+    pstore::group_commit gc;
+    EXPECT_THROW (gc.flush (address{0}, address{16},
+                            [] (address, address) { throw std::runtime_error ("flush failed"); }),
+                  std::runtime_error);
+    // A subsequent batch is unaffected.
+    auto calls = 0U;
+    gc.flush (address{0}, address{16}, [&calls] (address, address) { ++calls; });
+    EXPECT_EQ (1U, calls);
+}
+#endif // PSTORE_EXCEPTIONS
@@ -16,8 +16,13 @@
 #include "pstore/core/hamt_map.hpp"
 
 // Standard library
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
 #include <random>
 #include <list>
+#include <mutex>
 
 // 3rd party
 #include <gtest/gtest.h>
@@ -71,6 +76,25 @@ TEST_F (IndexFixture, InitAddress) {
     EXPECT_FALSE (index.is_heap ());
 }
 
+TEST (NodeArena, AllocationsAreAlignedAndAdjacent) {
+    using pstore::index::details::node_arena;
+    node_arena arena;
+    auto * const a = static_cast<std::uint8_t *> (arena.allocate (3U));
+    auto * const b = static_cast<std::uint8_t *> (arena.allocate (16U));
+    EXPECT_EQ (reinterpret_cast<std::uintptr_t> (a) % node_arena::alignment, 0U);
+    EXPECT_EQ (b, a + node_arena::alignment);
+    EXPECT_EQ (arena.size (), node_arena::alignment + 16U);
+
+    // A large allocation doesn't disturb the chunk from which small allocations are carved.
+    EXPECT_NE (arena.allocate (node_arena::chunk_size), nullptr);
+    EXPECT_EQ (arena.allocate (8U), b + 16U);
+
+    // Once cleared, the arena reuses its first chunk.
+    arena.clear ();
+    EXPECT_EQ (arena.size (), 0U);
+    EXPECT_EQ (arena.allocate (1U), a);
+}
+
 // Test initial pointer index pointer.
 TEST_F (IndexFixture, InternalSizeBytes) {
     EXPECT_EQ (24U, internal_node::size_bytes (1));
@@ -250,6 +274,296 @@ TEST_F (DefaultIndexFixture, UpsertInternalStore) {
     EXPECT_FALSE (itp3.second);
 }
 
+// test bulk_insert: an empty index is built bottom-up.
+TEST_F (DefaultIndexFixture, BulkInsertEmpty) {
+    std::vector<std::pair<std::string, std::string>> values;
+    for (auto ctr = 0U; ctr < 1000U; ++ctr) {
+        values.emplace_back ("key "s + std::to_string (ctr), "value "s + std::to_string (ctr));
+    }
+
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    EXPECT_EQ (values.size (), index_->bulk_insert (t1, std::begin (values), std::end (values)));
+    EXPECT_EQ (values.size (), index_->size ());
+    EXPECT_TRUE (index_->root ().is_address ())
+        << "bulk_insert should write all of the nodes to the store";
+
+    // Build the same index one key at a time. It should contain the same keys in the same order.
+    default_index expected{*db_};
+    for (auto const & v : values) {
+        expected.insert (t1, v);
+    }
+    auto actual_it = index_->begin (*db_);
+    for (auto const & kvp : expected.make_range (*db_)) {
+        ASSERT_NE (actual_it, index_->end (*db_));
+        EXPECT_EQ (kvp.first, actual_it->first);
+        EXPECT_EQ (kvp.second, actual_it->second);
+        ++actual_it;
+    }
+    EXPECT_EQ (actual_it, index_->end (*db_));
+
+    index_->flush (t1, db_->get_current_revision ());
+    for (auto const & v : values) {
+        auto const it = index_->find (*db_, v.first);
+        ASSERT_NE (it, index_->cend (*db_)) << "key '" << v.first << "' was not found";
+        EXPECT_EQ (v.second, it->second);
+    }
+}
+
+// test bulk_insert: only the first of any duplicate keys is inserted.
+TEST_F (DefaultIndexFixture, BulkInsertDuplicates) {
+    std::vector<std::pair<std::string, std::string>> const values{
+        {"a", "first a"}, {"b", "b"}, {"a", "second a"}};
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    EXPECT_EQ (2U, index_->bulk_insert (t1, std::begin (values), std::end (values)));
+    EXPECT_EQ (2U, index_->size ());
+    auto const it = index_->find (*db_, "a"s);
+    ASSERT_NE (it, index_->cend (*db_));
+    EXPECT_EQ ("first a", it->second);
+}
+
+// test bulk_insert: a non-empty index behaves as if each element were inserted.
+TEST_F (DefaultIndexFixture, BulkInsertNotEmpty) {
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    index_->insert (t1, std::make_pair ("a"s, "original a"s));
+    std::vector<std::pair<std::string, std::string>> const values{{"a", "new a"}, {"b", "b"}};
+    EXPECT_EQ (1U, index_->bulk_insert (t1, std::begin (values), std::end (values)));
+    EXPECT_EQ (2U, index_->size ());
+    EXPECT_EQ ("original a", index_->find (*db_, "a"s)->second);
+    EXPECT_EQ ("b", index_->find (*db_, "b"s)->second);
+}
+
+// test find_batch: an empty index produces end iterators.
+TEST_F (DefaultIndexFixture, FindBatchEmpty) {
+    std::vector<std::string> const keys{"a", "b"};
+    auto const actual = index_->find_batch (*db_, std::begin (keys), std::end (keys));
+    ASSERT_EQ (2U, actual.size ());
+    EXPECT_EQ (index_->cend (*db_), actual[0]);
+    EXPECT_EQ (index_->cend (*db_), actual[1]);
+}
+
+// test find_batch: the results match find() for both heap and store nodes and are returned in
+// the order of the input keys.
+TEST_F (DefaultIndexFixture, FindBatch) {
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    auto const num_keys = 3000U;
+    for (auto ctr = 0U; ctr < num_keys; ++ctr) {
+        if (ctr == num_keys / 2U) {
+            // Write the first half of the index to the store so that the remaining inserts
+            // leave a mixture of heap and store nodes.
+            index_->flush (t1, db_->get_current_revision ());
+        }
+        index_->insert (t1, std::make_pair ("key "s + std::to_string (ctr),
+                                            "value "s + std::to_string (ctr)));
+    }
+
+    // Every third key is one which was never inserted.
+    std::vector<std::string> keys;
+    for (auto ctr = 0U; ctr < num_keys * 3U / 2U; ++ctr) {
+        keys.push_back ((ctr % 3U == 0U ? "missing "s : "key "s) + std::to_string (ctr));
+    }
+
+    auto const check = [this, &keys] (std::vector<default_index::const_iterator> const & actual) {
+        ASSERT_EQ (keys.size (), actual.size ());
+        for (auto ctr = std::size_t{0}; ctr < keys.size (); ++ctr) {
+            auto const expected = index_->find (*db_, keys[ctr]);
+            EXPECT_EQ (expected, actual[ctr]) << "key '" << keys[ctr] << "'";
+            if (expected != index_->cend (*db_) && actual[ctr] != index_->cend (*db_)) {
+                EXPECT_EQ (expected->second, actual[ctr]->second);
+            }
+        }
+    };
+    check (index_->find_batch (*db_, std::begin (keys), std::end (keys)));
+    check (index_->parallel_find_batch (*db_, std::begin (keys), std::end (keys)));
+}
+
+// test that lookups which use the node cache give the same results as those which don't.
+TEST_F (DefaultIndexFixture, NodeCache) {
+    EXPECT_EQ (0U, index_->node_cache_levels ());
+
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    auto const num_keys = 3000U;
+    for (auto ctr = 0U; ctr < num_keys; ++ctr) {
+        index_->insert (t1, std::make_pair ("key "s + std::to_string (ctr),
+                                            "value "s + std::to_string (ctr)));
+    }
+    auto const header = index_->flush (t1, db_->get_current_revision ());
+    t1.commit ();
+
+    // The cache holds copies of the top levels of the trie.
+    {
+        auto const root = index_->root ();
+        pstore::index::details::node_cache const cache{*db_, root, 2U};
+        EXPECT_EQ (2U, cache.levels ());
+        EXPECT_EQ (root, cache.node (0U));
+        auto const internal = internal_node::read_node (*db_, root.untag_internal_address ());
+        for (auto digit = 0U; digit < pstore::index::details::hash_size; ++digit) {
+            auto next = std::uint32_t{0};
+            EXPECT_EQ (internal->lookup (digit), cache.lookup (0U, digit, &next));
+            if (next != pstore::index::details::node_cache::none) {
+                EXPECT_EQ (internal->lookup (digit).first, cache.node (next));
+            }
+        }
+    }
+
+    db_->set_index_node_cache_levels (3U);
+    default_index cached{*db_, header};
+    EXPECT_EQ (3U, cached.node_cache_levels ());
+
+    // Every third key is one which was never inserted.
+    std::vector<std::string> keys;
+    for (auto ctr = 0U; ctr < num_keys * 3U / 2U; ++ctr) {
+        keys.push_back ((ctr % 3U == 0U ? "missing "s : "key "s) + std::to_string (ctr));
+    }
+    auto const batch = cached.find_batch (*db_, std::begin (keys), std::end (keys));
+    ASSERT_EQ (keys.size (), batch.size ());
+    for (auto ctr = std::size_t{0}; ctr < keys.size (); ++ctr) {
+        auto const expected = index_->find (*db_, keys[ctr]);
+        auto const actual = cached.find (*db_, keys[ctr]);
+        bool const found = expected != index_->cend (*db_);
+        EXPECT_EQ (found, actual != cached.cend (*db_)) << "key '" << keys[ctr] << "'";
+        EXPECT_EQ (found, batch[ctr] != cached.cend (*db_)) << "key '" << keys[ctr] << "'";
+        if (found && actual != cached.cend (*db_)) {
+            EXPECT_EQ (expected.get_address (), actual.get_address ());
+            EXPECT_EQ (expected->second, actual->second);
+        }
+    }
+
+    // Modifying the index discards the cache.
+    transaction_type t2 = begin (*db_, lock_guard{mutex_});
+    cached.insert (t2, std::make_pair ("new key"s, "new value"s));
+    auto const it = cached.find (*db_, "new key"s);
+    ASSERT_NE (cached.cend (*db_), it);
+    EXPECT_EQ ("new value", it->second);
+    EXPECT_NE (cached.cend (*db_), cached.find (*db_, "key 1"s));
+}
+
+// test that the runs produced by partition() cover each member of the index exactly once and in
+// iteration order.
+TEST_F (DefaultIndexFixture, Partition) {
+    EXPECT_TRUE (index_->partition (*db_, 4U).empty ());
+
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    auto const num_keys = 3000U;
+    for (auto ctr = 0U; ctr < num_keys; ++ctr) {
+        index_->insert (t1, std::make_pair ("key "s + std::to_string (ctr),
+                                            "value "s + std::to_string (ctr)));
+    }
+
+    std::vector<std::string> expected;
+    for (auto const & kvp : index_->make_range (*db_)) {
+        expected.push_back (kvp.first);
+    }
+    ASSERT_EQ (num_keys, expected.size ());
+
+    auto check = [this, &expected] (std::size_t const min_parts) {
+        auto const parts = index_->partition (*db_, min_parts);
+        EXPECT_GE (parts.size (), std::min (min_parts, std::size_t{num_keys}));
+        std::vector<std::string> actual;
+        for (auto const & part : parts) {
+            EXPECT_NE (part.begin (), part.end ()) << "runs should not be empty";
+            for (auto const & kvp : part) {
+                actual.push_back (kvp.first);
+            }
+        }
+        EXPECT_EQ (expected, actual) << "min_parts=" << min_parts;
+    };
+    // Partition both the in-memory trie and, after it has been flushed, the stored trie.
+    for (auto const min_parts : {1U, 2U, 64U, 100U, 5000U}) {
+        check (min_parts);
+    }
+    index_->flush (t1, db_->get_current_revision ());
+    t1.commit ();
+    for (auto const min_parts : {1U, 2U, 64U, 100U, 5000U}) {
+        check (min_parts);
+    }
+
+    std::vector<std::string> actual;
+    for (auto const & part : index_->parallel_partition (*db_)) {
+        for (auto const & kvp : part) {
+            actual.push_back (kvp.first);
+        }
+    }
+    EXPECT_EQ (expected, actual) << "parallel_partition";
+}
+
+TEST_F (DefaultIndexFixture, ParallelVisit) {
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    auto const num_keys = 1000U;
+    for (auto ctr = 0U; ctr < num_keys; ++ctr) {
+        index_->insert (t1, std::make_pair ("key "s + std::to_string (ctr),
+                                            "value "s + std::to_string (ctr)));
+    }
+    index_->flush (t1, db_->get_current_revision ());
+    t1.commit ();
+
+    std::mutex mut;
+    std::vector<std::string> visited;
+    index_->parallel_visit (*db_, [&] (default_index::const_iterator const & it) {
+        EXPECT_EQ ("value "s + it->first.substr (4U), it->second);
+        std::lock_guard<std::mutex> const lock{mut};
+        visited.push_back (it->first);
+    });
+    std::vector<std::string> expected;
+    for (auto ctr = 0U; ctr < num_keys; ++ctr) {
+        expected.push_back ("key "s + std::to_string (ctr));
+    }
+    std::sort (std::begin (expected), std::end (expected));
+    std::sort (std::begin (visited), std::end (visited));
+    EXPECT_EQ (expected, visited);
+}
+
+TEST_F (DefaultIndexFixture, StringKeyView) {
+    using traits = pstore::index::key_view_traits<std::string, std::equal_to<std::string>>;
+    static_assert (traits::enabled, "std::string keys should be compared in place");
+
+    // An empty string, a short string, and one whose length needs a three byte varint.
+    std::array<std::string, 3> const strings{{""s, "short"s, std::string (20000U, 'x')}};
+    std::array<pstore::address, 3> addrs;
+    {
+        transaction_type t1 = begin (*db_, lock_guard{mutex_});
+        for (auto ctr = std::size_t{0}; ctr < strings.size (); ++ctr) {
+            addrs[ctr] = pstore::serialize::write (
+                pstore::serialize::archive::make_writer (t1), strings[ctr]);
+        }
+        t1.commit ();
+    }
+
+    pstore::database::read_view view{*db_};
+    for (auto ctr = std::size_t{0}; ctr < strings.size (); ++ctr) {
+        EXPECT_TRUE (traits::load (*db_, addrs[ctr]) == strings[ctr]);
+        EXPECT_TRUE (traits::load (view, addrs[ctr]) == strings[ctr]);
+        EXPECT_EQ (traits::load (view, addrs[ctr]).length (), strings[ctr].length ());
+    }
+    EXPECT_TRUE (traits::load (*db_, addrs[0]) < strings[1]);
+    EXPECT_FALSE (traits::load (view, addrs[2]) == strings[1]);
+}
+
+// test that each leaf of a string-keyed index is preceded by its key's hash.
+TEST_F (DefaultIndexFixture, LeafHashes) {
+    EXPECT_TRUE (index_->leaf_hashes ());
+
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    index_->insert (t1, std::make_pair ("a"s, "b"s));
+    index_->insert (t1, std::make_pair ("c"s, "d"s));
+    auto const header = index_->flush (t1, db_->get_current_revision ());
+    t1.commit ();
+
+    std::hash<std::string> const hasher;
+    auto count = std::size_t{0};
+    for (auto it = index_->cbegin (*db_), end = index_->cend (*db_); it != end; ++it) {
+        auto const hash = *db_->getro (pstore::typed_address<std::uint64_t>::make (
+            it.get_address () - sizeof (std::uint64_t)));
+        EXPECT_EQ (hasher ((*it).first), hash);
+        ++count;
+    }
+    EXPECT_EQ (2U, count);
+
+    // An index loaded from the store keeps the format with which it was written.
+    default_index const reloaded{*db_, header};
+    EXPECT_TRUE (reloaded.leaf_hashes ());
+    EXPECT_NE (reloaded.find (*db_, "c"s), reloaded.cend (*db_));
+}
+
 // *******************************************
 // *                                         *
 // *             hash_function               *
@@ -718,6 +1032,11 @@ namespace {
         {"g", 0},
         {"h", 0},
         {"i", 0},
+        // Keys which collide in all hash bits and share an eight character prefix.
+        {"prefix_a", 0},
+        {"prefix_b", 0},
+        {"prefix_c", 0},
+        {"prefix_d", 0},
     };
 
     void TwoValuesWithHashCollision::check_collision (std::uint64_t const first_hash,
@@ -1192,7 +1511,7 @@ TEST_F (TwoValuesWithHashCollision, LeafLevelLinearCase) {
         EXPECT_TRUE ((*level10_internal)[0].is_linear ());
         auto const level11_linear = (*level10_internal)[0].untag_node<linear_node *> ();
         EXPECT_EQ (level11_linear->size (), 3U);
-        EXPECT_EQ (level11_linear->size_bytes (), 40U);
+        EXPECT_EQ (level11_linear->size_bytes (), 64U);
         EXPECT_NE ((*level11_linear)[0], pstore::address::null ());
         index_->flush (t1, db_->get_current_revision ());
     }
@@ -1362,6 +1681,403 @@ TEST_F (TwoValuesWithHashCollision, LeafLevelLinearInsertIterator) {
     std::string const & v = (*itp.first).second;
     EXPECT_EQ ("value g", v);
 }
+
+TEST_F (TwoValuesWithHashCollision, LeafLevelLinearSorted) {
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    this->insert_or_assign (*index_, t1, "prefix_c");
+    this->insert_or_assign (*index_, t1, "i");
+    this->insert_or_assign (*index_, t1, "prefix_a");
+    this->insert_or_assign (*index_, t1, "g");
+    this->insert_or_assign (*index_, t1, "prefix_b");
+    this->insert_or_assign (*index_, t1, "h");
+
+    auto const check = [this] (char const * const where) {
+        std::vector<std::string> keys;
+        for (auto it = index_->begin (*db_), end = index_->end (*db_); it != end; ++it) {
+            keys.push_back (it->first);
+        }
+        EXPECT_EQ (keys, (std::vector<std::string>{"g", "h", "i", "prefix_a", "prefix_b",
+                                                   "prefix_c"}))
+            << "linear node children should be ordered by key (" << where << ")";
+        for (auto const & key : keys) {
+            EXPECT_TRUE (this->is_found (*index_, key)) << "key '" << key << "' (" << where << ")";
+        }
+        EXPECT_FALSE (this->is_found (*index_, "prefix_d")) << where;
+    };
+
+    check ("heap");
+    index_->flush (t1, db_->get_current_revision ());
+    check ("store");
+}
+
+TEST_F (TwoValuesWithHashCollision, BulkInsert) {
+    std::vector<std::pair<std::string, std::string>> values;
+    for (auto const * key : {"prefix_b", "i", "f", "a", "g", "prefix_a", "e", "h", "c", "b"}) {
+        values.emplace_back (key, "value "s + key);
+    }
+
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    EXPECT_EQ (values.size (), index_->bulk_insert (t1, std::begin (values), std::end (values)));
+    index_->flush (t1, db_->get_current_revision ());
+
+    // The bulk-built trie should match one built by inserting each key in turn.
+    test_trie expected{*db_, pstore::typed_address<pstore::index::header_block>::null (), hash_};
+    for (auto const & v : values) {
+        expected.insert (t1, v);
+    }
+    std::vector<std::string> actual_keys;
+    for (auto const & kvp : index_->make_range (*db_)) {
+        actual_keys.push_back (kvp.first);
+        EXPECT_EQ ("value "s + kvp.first, kvp.second);
+    }
+    std::vector<std::string> expected_keys;
+    for (auto const & kvp : expected.make_range (*db_)) {
+        expected_keys.push_back (kvp.first);
+    }
+    EXPECT_EQ (expected_keys, actual_keys);
+    for (auto const & v : values) {
+        EXPECT_TRUE (this->is_found (*index_, v.first)) << "key '" << v.first << "'";
+    }
+    EXPECT_FALSE (this->is_found (*index_, "prefix_c"));
+}
+
+TEST_F (TwoValuesWithHashCollision, FindBatch) {
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    for (auto const * key : {"a", "b", "e", "f", "g", "h", "prefix_a", "prefix_b"}) {
+        index_->insert (t1, std::make_pair (std::string{key}, "value "s + key));
+    }
+    index_->flush (t1, db_->get_current_revision ());
+    index_->insert (t1, std::make_pair ("i"s, "value i"s));
+
+    std::vector<std::string> const keys{"prefix_c", "h", "c", "a",        "i",
+                                        "f",        "g", "b", "prefix_b", "e"};
+    auto const actual = index_->find_batch (*db_, std::begin (keys), std::end (keys));
+    ASSERT_EQ (keys.size (), actual.size ());
+    for (auto ctr = std::size_t{0}; ctr < keys.size (); ++ctr) {
+        auto const & key = keys[ctr];
+        if (key == "prefix_c" || key == "c") {
+            EXPECT_EQ (index_->cend (*db_), actual[ctr]) << "key '" << key << "'";
+        } else {
+            ASSERT_NE (index_->cend (*db_), actual[ctr]) << "key '" << key << "'";
+            EXPECT_EQ (key, actual[ctr]->first);
+            EXPECT_EQ ("value "s + key, actual[ctr]->second);
+        }
+    }
+}
+
+TEST_F (IndexFixture, LinearNodeUnsortedFormat) {
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+
+    // Write two keys to the store followed by a linear node in the original (unsorted) format
+    // which references them.
+    pstore::address const addr_b =
+        pstore::serialize::write (pstore::serialize::archive::make_writer (t1), "b"s);
+    pstore::address const addr_a =
+        pstore::serialize::write (pstore::serialize::archive::make_writer (t1), "a"s);
+
+    auto const node_size = linear_node::size_bytes (2U, false);
+    EXPECT_EQ (32U, node_size);
+    std::shared_ptr<void> ptr;
+    pstore::address node_addr;
+    std::tie (ptr, node_addr) = t1.alloc_rw (node_size, alignof (linear_node));
+    {
+        auto * const raw = static_cast<std::uint64_t *> (ptr.get ());
+        std::array<char, 8> const signature{{'I', 'n', 'd', 'x', 'L', 'n', 'e', 'r'}};
+        std::memcpy (raw, signature.data (), signature.size ());
+        raw[1] = 2U;
+        raw[2] = addr_b.absolute ();
+        raw[3] = addr_a.absolute ();
+    }
+
+    std::shared_ptr<linear_node const> sptr;
+    linear_node const * node = nullptr;
+    std::tie (sptr, node) = linear_node::get_node (
+        *db_, index_pointer{pstore::typed_address<linear_node>{node_addr}});
+    ASSERT_NE (node, nullptr);
+    EXPECT_FALSE (node->is_sorted ());
+    EXPECT_EQ (2U, node->size ());
+    EXPECT_EQ (node_size, node->size_bytes ());
+
+    std::equal_to<std::string> const equal;
+    EXPECT_EQ (0U, (node->lookup<std::string> (*db_, "b"s, equal).second));
+    EXPECT_EQ (1U, (node->lookup<std::string> (*db_, "a"s, equal).second));
+    EXPECT_EQ (pstore::index::details::not_found,
+               (node->lookup<std::string> (*db_, "c"s, equal).second));
+
+    std::unique_ptr<linear_node> const sorted =
+        linear_node::allocate_sorted<std::string> (*db_, *node);
+    EXPECT_TRUE (sorted->is_sorted ());
+    ASSERT_EQ (2U, sorted->size ());
+    EXPECT_EQ (addr_a, (*sorted)[0]);
+    EXPECT_EQ (addr_b, (*sorted)[1]);
+    EXPECT_LT (sorted->prefix (0), sorted->prefix (1));
+    EXPECT_EQ (0U, (sorted->lookup<std::string> (*db_, "a"s, equal).second));
+    EXPECT_EQ (1U, (sorted->lookup<std::string> (*db_, "b"s, equal).second));
+}
+
+TEST_F (IndexFixture, DigestLinearNode) {
+    using pstore::index::digest;
+    using digest_index = pstore::index::hamt_map<digest, std::uint64_t, pstore::index::u128_hash>;
+
+    // Digests whose high halves are equal have the same hash and share a linear node.
+    std::array<digest, 4> const keys{{{7U, 3U}, {7U, 1U}, {8U, 1U}, {7U, 2U}}};
+    digest_index index{*db_};
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    for (auto ctr = std::size_t{0}; ctr < keys.size (); ++ctr) {
+        EXPECT_TRUE (index.insert (t1, std::make_pair (keys[ctr], std::uint64_t{ctr})).second);
+    }
+    EXPECT_FALSE (index.insert (t1, std::make_pair (digest{7U, 2U}, std::uint64_t{0})).second);
+
+    auto const check = [&] (char const * const where) {
+        for (auto ctr = std::size_t{0}; ctr < keys.size (); ++ctr) {
+            auto const pos = index.find (*db_, keys[ctr]);
+            ASSERT_NE (pos, index.cend (*db_)) << where;
+            EXPECT_EQ (keys[ctr], pos->first) << where;
+            EXPECT_EQ (ctr, pos->second) << where;
+        }
+        EXPECT_EQ (index.find (*db_, digest{7U, 4U}), index.cend (*db_)) << where;
+        EXPECT_EQ (index.find (*db_, digest{7U, 0U}), index.cend (*db_)) << where;
+    };
+    check ("heap");
+    index.flush (t1, db_->get_current_revision ());
+    check ("store");
+}
+
+namespace {
+
+    // Every key has the same hash so that they all share a linear node.
+    struct constant_hash {
+        std::uint64_t operator() (std::string const &) const noexcept { return 0U; }
+    };
+    // A key comparison which disagrees with std::string's operator<.
+    struct case_insensitive_equal {
+        bool operator() (std::string const & lhs, std::string const & rhs) const {
+            return std::equal (std::begin (lhs), std::end (lhs), std::begin (rhs), std::end (rhs),
+                               [] (char const a, char const b) {
+                                   return std::tolower (static_cast<unsigned char> (a)) ==
+                                          std::tolower (static_cast<unsigned char> (b));
+                               });
+        }
+    };
+
+} // end anonymous namespace
+
+TEST_F (IndexFixture, LinearNodeWithCustomKeyEqual) {
+    using index_type =
+        pstore::index::hamt_map<std::string, int, constant_hash, case_insensitive_equal>;
+    static_assert (
+        !pstore::index::sorted_linear_nodes<std::string, case_insensitive_equal>::value,
+        "keys compared with case_insensitive_equal can't be kept sorted by operator<");
+
+    index_type index{*db_};
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    EXPECT_TRUE (index.insert (t1, std::make_pair ("b"s, 1)).second);
+    EXPECT_TRUE (index.insert (t1, std::make_pair ("A"s, 2)).second);
+    EXPECT_TRUE (index.insert (t1, std::make_pair ("c"s, 3)).second);
+    EXPECT_FALSE (index.insert (t1, std::make_pair ("B"s, 4)).second);
+
+    auto const check = [&] (char const * const where) {
+        EXPECT_EQ (3U, index.size ()) << where;
+        for (auto const * key : {"a", "B", "C"}) {
+            auto const pos = index.find (*db_, std::string{key});
+            ASSERT_NE (pos, index.cend (*db_)) << "key '" << key << "' (" << where << ")";
+            EXPECT_TRUE (case_insensitive_equal{}(key, pos->first)) << where;
+        }
+        EXPECT_EQ (index.find (*db_, "d"s), index.cend (*db_)) << where;
+    };
+    check ("heap");
+    index.flush (t1, db_->get_current_revision ());
+    check ("store");
+    EXPECT_TRUE (index.insert (t1, std::make_pair ("D"s, 5)).second);
+    EXPECT_FALSE (index.insert (t1, std::make_pair ("d"s, 6)).second);
+
+    std::vector<std::pair<std::string, int>> const values{
+        {"x", 1}, {"Y", 2}, {"X", 3}, {"y", 4}, {"z", 5}};
+    index_type bulk{*db_};
+    EXPECT_EQ (3U, bulk.bulk_insert (t1, std::begin (values), std::end (values)));
+    bulk.flush (t1, db_->get_current_revision ());
+    for (auto const * key : {"X", "y", "Z"}) {
+        EXPECT_NE (bulk.find (*db_, std::string{key}), bulk.cend (*db_)) << "key '" << key << "'";
+    }
+    EXPECT_EQ (1, bulk.find (*db_, "X"s)->second);
+    EXPECT_EQ (2, bulk.find (*db_, "y"s)->second);
+}
+
+TEST_F (IndexFixture, DigestKeyFilter) {
+    using pstore::index::digest;
+    using digest_index = pstore::index::hamt_map<digest, std::uint64_t, pstore::index::u128_hash>;
+    auto const signature = [this] (pstore::typed_address<pstore::index::header_block> addr) {
+        auto const sig = db_->getro (addr)->signature;
+        return std::string{std::begin (sig), std::end (sig)};
+    };
+    auto const key = [] (std::uint64_t const n) { return digest{n * 0x9E3779B97F4A7C15, n}; };
+    constexpr auto num_keys = std::uint64_t{500};
+
+    digest_index index{*db_};
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    for (auto n = std::uint64_t{0}; n < num_keys; ++n) {
+        index.insert (t1, std::make_pair (key (n), n));
+    }
+    EXPECT_EQ (index.find (*db_, key (num_keys)), index.cend (*db_));
+    auto const header = index.flush (t1, db_->get_current_revision ());
+    EXPECT_EQ ("IndxFltr", signature (header));
+
+    // Reload the index so that lookups use the filter in the store.
+    digest_index const reloaded{*db_, header};
+    for (auto n = std::uint64_t{0}; n < 2 * num_keys; ++n) {
+        auto const pos = reloaded.find (*db_, key (n));
+        if (n < num_keys) {
+            ASSERT_NE (pos, reloaded.cend (*db_)) << "key " << n;
+            EXPECT_EQ (n, pos->second);
+        } else {
+            EXPECT_EQ (pos, reloaded.cend (*db_)) << "key " << n;
+        }
+    }
+}
+
+TEST_F (IndexFixture, DigestKeyFilterAcrossCommits) {
+    using pstore::index::digest;
+    using digest_index = pstore::index::hamt_map<digest, std::uint64_t, pstore::index::u128_hash>;
+    auto const key = [] (std::uint64_t const n) { return digest{n * 0x9E3779B97F4A7C15, n}; };
+    constexpr auto commits = 30U;
+    constexpr auto keys_per_commit = std::uint64_t{40};
+
+    // Each commit adds keys to the index written by the previous one. The filter gains deltas
+    // and, as the index grows past its first segment's capacity, further segments.
+    auto header = pstore::typed_address<pstore::index::header_block>::null ();
+    auto n = std::uint64_t{0};
+    for (auto commit = 0U; commit < commits; ++commit) {
+        transaction_type t = begin (*db_, lock_guard{mutex_});
+        digest_index index{*db_, header};
+        for (auto ctr = std::uint64_t{0}; ctr < keys_per_commit; ++ctr, ++n) {
+            index.insert (t, std::make_pair (key (n), n));
+        }
+        header = index.flush (t, db_->get_current_revision ());
+        t.commit ();
+    }
+
+    digest_index const reloaded{*db_, header};
+    for (auto k = std::uint64_t{0}; k < 2 * n; ++k) {
+        auto const pos = reloaded.find (*db_, key (k));
+        if (k < n) {
+            ASSERT_NE (pos, reloaded.cend (*db_)) << "key " << k;
+            EXPECT_EQ (k, pos->second);
+        } else {
+            EXPECT_EQ (pos, reloaded.cend (*db_)) << "key " << k;
+        }
+    }
+}
+
+TEST_F (IndexFixture, DigestKeyFilterNotAddedToUnfilteredIndex) {
+    using pstore::index::digest;
+    using digest_index = pstore::index::hamt_map<digest, std::uint64_t, pstore::index::u128_hash>;
+
+    // Write an index and then a header in the original format which refers to the same trie.
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    pstore::typed_address<pstore::index::header_block> unfiltered;
+    {
+        digest_index index{*db_};
+        index.insert (t1, std::make_pair (digest{1U, 1U}, std::uint64_t{1}));
+        index.insert (t1, std::make_pair (digest{2U, 2U}, std::uint64_t{2}));
+        auto const filtered = db_->getro (index.flush (t1, db_->get_current_revision ()));
+        auto const pos = t1.alloc_rw<pstore::index::header_block> ();
+        *pos.first = *filtered;
+        pos.first->signature = {{'I', 'n', 'd', 'x', 'H', 'e', 'd', 'r'}};
+        unfiltered = pos.second;
+    }
+
+    // Building a filter for an index without one would mean visiting all of its keys so the
+    // index stays unfiltered when keys are added to it.
+    digest_index index{*db_, unfiltered};
+    EXPECT_NE (index.find (*db_, digest{1U, 1U}), index.cend (*db_));
+    EXPECT_EQ (index.find (*db_, digest{3U, 3U}), index.cend (*db_));
+    index.insert (t1, std::make_pair (digest{3U, 3U}, std::uint64_t{3}));
+    EXPECT_NE (index.find (*db_, digest{3U, 3U}), index.cend (*db_));
+    auto const header = index.flush (t1, db_->get_current_revision ());
+    auto const sig = db_->getro (header)->signature;
+    EXPECT_EQ ("IndxHedr", (std::string{std::begin (sig), std::end (sig)}));
+
+    digest_index const reloaded{*db_, header};
+    for (auto n = std::uint64_t{1}; n <= 3U; ++n) {
+        EXPECT_NE (reloaded.find (*db_, digest{n, n}), reloaded.cend (*db_)) << "key " << n;
+    }
+    EXPECT_EQ (reloaded.find (*db_, digest{4U, 4U}), reloaded.cend (*db_));
+}
+
+TEST_F (IndexFixture, FlushSizeIsAnUpperBound) {
+    using pstore::index::digest;
+    using digest_index = pstore::index::hamt_map<digest, std::uint64_t, pstore::index::u128_hash>;
+    auto const key = [] (std::uint64_t const n) { return digest{n * 0x9E3779B97F4A7C15, n}; };
+    constexpr auto num_keys = std::uint64_t{2000};
+
+    digest_index index{*db_};
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    for (auto n = std::uint64_t{0}; n < num_keys; ++n) {
+        index.insert (t1, std::make_pair (key (n), n));
+    }
+
+    // Flush into a block which is exactly the predicted size: the block transaction raises if
+    // the index needs more.
+    auto const size = index.flush_size ();
+    pstore::address const first = t1.allocate (size, internal_node::node_alignment);
+    pstore::block_transaction block{t1, first, size};
+    auto const header = index.flush (block, db_->get_current_revision ());
+    EXPECT_LE (block.used (), size);
+    // The 2000 keys fill several filter segments, each of which may need up to a block of
+    // alignment padding.
+    EXPECT_GT (block.used () + 512U, size) << "The bound should be close to the bytes used";
+
+    digest_index const reloaded{*db_, header};
+    EXPECT_EQ (reloaded.size (), num_keys);
+    for (auto n = std::uint64_t{0}; n < num_keys; ++n) {
+        auto const pos = reloaded.find (*db_, key (n));
+        ASSERT_NE (pos, reloaded.cend (*db_)) << "key " << n;
+        EXPECT_EQ (n, pos->second);
+    }
+}
+
+TEST_F (IndexFixture, FlushIndicesConcurrently) {
+    using pstore::trailer;
+    using pstore::index::digest;
+    auto const key = [] (std::uint64_t const n) { return digest{n * 0x9E3779B97F4A7C15, n}; };
+    auto const value = [] (std::uint64_t const n) {
+        return pstore::make_extent (pstore::typed_address<std::uint8_t>::make (n), n);
+    };
+    constexpr auto num_keys = std::uint64_t{1000};
+    {
+        // Modify two indices so that the commit writes them concurrently.
+        transaction_type t1 = begin (*db_, lock_guard{mutex_});
+        auto const debug_lines =
+            pstore::index::get_index<trailer::indices::debug_line_header> (*db_);
+        auto const writes = pstore::index::get_index<trailer::indices::write> (*db_);
+        for (auto n = std::uint64_t{0}; n < num_keys; ++n) {
+            debug_lines->insert (t1, std::make_pair (key (n), value (n)));
+            writes->insert (t1, std::make_pair (std::to_string (n),
+                                                pstore::make_extent (
+                                                    pstore::typed_address<char>::make (n), n)));
+        }
+        t1.commit ();
+    }
+
+    // Load the indices from the new footer.
+    auto const footer = db_->getro (db_->footer_pos ());
+    auto const location = [&footer] (trailer::indices const idx) {
+        return footer->a.index_records[static_cast<std::size_t> (idx)];
+    };
+    pstore::index::debug_line_header_index const debug_lines{
+        *db_, location (trailer::indices::debug_line_header)};
+    pstore::index::write_index const writes{*db_, location (trailer::indices::write)};
+    ASSERT_EQ (debug_lines.size (), num_keys);
+    ASSERT_EQ (writes.size (), num_keys);
+    for (auto n = std::uint64_t{0}; n < num_keys; ++n) {
+        auto const dl = debug_lines.find (*db_, key (n));
+        ASSERT_NE (dl, debug_lines.cend (*db_)) << "key " << n;
+        EXPECT_EQ (dl->second, value (n));
+        auto const w = writes.find (*db_, std::to_string (n));
+        ASSERT_NE (w, writes.cend (*db_)) << "key " << n;
+        EXPECT_EQ (w->second.size, n);
+    }
+}
 // *******************************************
 // *                                         *
 // *         FourNodesOnTwoLevels            *
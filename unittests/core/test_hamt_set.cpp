@@ -15,6 +15,7 @@
 //===----------------------------------------------------------------------===//
 #include "pstore/core/hamt_set.hpp"
 
+#include <algorithm>
 #include <random>
 #include "gtest/gtest.h"
 #include "pstore/core/transaction.hpp"
@@ -213,3 +214,24 @@ TEST_F (SetFixture, FindInternal) {
     EXPECT_EQ (*it, ini);
     EXPECT_EQ (it->size (), 14U); // Check operator ->
 }
+
+// test that the runs produced by partition() together hold each member of the set once.
+TEST_F (SetFixture, Partition) {
+    transaction_type t1 = begin (*db_, lock_guard{mutex_});
+    std::vector<std::string> expected;
+    for (auto ctr = 0U; ctr < 500U; ++ctr) {
+        expected.push_back ("member "s + std::to_string (ctr));
+        index_->insert (t1, expected.back ());
+    }
+    index_->flush (t1, db_->get_current_revision ());
+
+    std::vector<std::string> actual;
+    auto const parts = index_->partition (*db_, 16U);
+    EXPECT_GE (parts.size (), 16U);
+    for (auto const & part : parts) {
+        actual.insert (std::end (actual), part.begin (), part.end ());
+    }
+    std::sort (std::begin (expected), std::end (expected));
+    std::sort (std::begin (actual), std::end (actual));
+    EXPECT_EQ (expected, actual);
+}
@@ -221,7 +221,8 @@ TEST_F (IndirectStringAdder, NewString) {
                 EXPECT_EQ (res2.first->as_string_view (&res2_owner), sstring1);
                 EXPECT_FALSE (res2.second);
             }
-            EXPECT_EQ (transaction.size (), sizeof (pstore::address));
+            // The index leaf: the string's hash followed by its address.
+            EXPECT_EQ (transaction.size (), sizeof (std::uint64_t) + sizeof (pstore::address));
             adder.flush (transaction);
         }
         transaction.commit ();
@@ -93,6 +93,34 @@ TEST_F (RequestSpansRegions, MinRegionSize) {
     }
 }
 
+#    ifdef __linux__
+// A file-backed store maps its regions into a single reserved range of addresses so a request which
+// crosses the boundary between two regions doesn't span them.
+TEST_F (RequestSpansRegions, FileRegionsAreContiguous) {
+    auto const region_size = pstore::address{pstore::storage::min_region_size};
+    auto file = std::make_shared<pstore::file::file_handle> ();
+    file->open (pstore::file::file_handle::temporary ());
+    pstore::database::build_new_store (*file);
+
+    pstore::database db{file};
+    db.set_vacuum_mode (pstore::database::vacuum_mode::disabled);
+    this->allocate (db, region_size.absolute () + 1U);
+    pstore::storage const & st = db.storage ();
+
+    ASSERT_EQ (st.regions ().size (), 2U)
+        << "The allocate() should should require a second region to be created.";
+    pstore::storage::region_container const & regions = st.regions ();
+    EXPECT_EQ (static_cast<std::uint8_t const *> (regions[0]->data ().get ()) +
+                   pstore::storage::min_region_size,
+               regions[1]->data ().get ());
+
+    EXPECT_FALSE (st.request_spans_regions (region_size - 1U, std::size_t{1}));
+    EXPECT_FALSE (st.request_spans_regions (region_size - 1U, std::size_t{2}));
+    EXPECT_FALSE (
+        st.request_spans_regions (pstore::address::null (), region_size.absolute () + 1U));
+}
+#    endif // __linux__
+
 // The FullRegionSize test is slow and can exhaust memory on some systems with tightly
 // constrained memory limits (e.g. inside a docker container).
 #    ifdef PSTORE_FULL_REGION_SIZE_TEST_ENABLED
@@ -16,9 +16,11 @@
 
 #include "pstore/core/transaction.hpp"
 
+#include <atomic>
 #include <limits>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <vector>
 
 // 3rd party includes
@@ -32,6 +34,8 @@
 #include "check_for_error.hpp"
 #include "empty_store.hpp"
 
+using namespace std::string_literals;
+
 namespace {
     class SyncFixture : public EmptyStore {
     public:
@@ -170,3 +174,86 @@ TEST_F (SyncFixture, SyncToBadVersions) {
 
     check_for_error ([this] () { db_->sync (3); }, pstore::error_code::unknown_revision);
 }
+
+TEST_F (SyncFixture, SyncAcrossManyVersions) {
+    constexpr auto num_revisions = 100U;
+    for (auto ctr = 1U; ctr <= num_revisions; ++ctr) {
+        transaction_type t = begin (*db_, lock_guard{mutex_});
+        this->add (t, "key", std::to_string (ctr));
+        t.commit ();
+    }
+    ASSERT_EQ (db_->get_current_revision (), num_revisions);
+
+    // Each trailer's skip pointer must refer to the expected generation.
+    for (auto revision = 1U; revision <= num_revisions; ++revision) {
+        auto const footer = db_->getro (db_->older_revision_footer_pos (revision));
+        ASSERT_EQ (footer->a.generation, revision);
+        ASSERT_NE (footer->a.skip_generation, pstore::typed_address<pstore::trailer>::null ());
+        EXPECT_EQ (db_->getro (footer->a.skip_generation)->a.generation,
+                   pstore::trailer::skip_target (revision));
+    }
+
+    // Visit the revisions in an order that forces searches from both the head and from older
+    // revisions.
+    std::string value;
+    for (auto const revision : {57U, 3U, 100U, 64U, 1U, 99U, 32U, 31U, 33U, 0U, 77U}) {
+        db_->sync (revision);
+        EXPECT_EQ (db_->get_current_revision (), revision);
+        if (revision == 0U) {
+            EXPECT_FALSE (this->is_found ("key"));
+        } else {
+            this->read ("key", &value);
+            EXPECT_EQ (value, std::to_string (revision));
+        }
+    }
+}
+
+// Many threads read from a single database whilst another repeatedly syncs it to different
+// revisions. Each lookup must see a consistent revision.
+TEST_F (SyncFixture, ConcurrentReadersAndSync) {
+    constexpr auto num_revisions = 20U;
+    for (auto ctr = 1U; ctr <= num_revisions; ++ctr) {
+        transaction_type t = begin (*db_, lock_guard{mutex_});
+        this->add (t, "key", std::to_string (ctr));
+        this->add (t, "key" + std::to_string (ctr), std::to_string (ctr));
+        t.commit ();
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<unsigned> errors{0};
+    auto const reader = [this, &done, &errors] () {
+        while (!done.load ()) {
+            auto const index = pstore::index::get_index<pstore::trailer::indices::write> (*db_);
+            if (index == nullptr || index->empty ()) {
+                continue; // Revision 0 has no index.
+            }
+            // The value of "key" is the revision at which the index was written. Every key
+            // added up to that revision must be present and none added later.
+            auto const it = index->find (*db_, "key"s);
+            if (it == index->cend (*db_)) {
+                ++errors;
+                continue;
+            }
+            pstore::extent<char> const & ex = it->second;
+            auto const revision = static_cast<unsigned> (
+                std::stoul (std::string{db_->getro (ex).get (), ex.size}));
+            if (!index->contains (*db_, "key" + std::to_string (revision)) ||
+                index->contains (*db_, "key" + std::to_string (revision + 1U))) {
+                ++errors;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (auto ctr = 0U; ctr < 4U; ++ctr) {
+        threads.emplace_back (reader);
+    }
+    for (auto ctr = 0U; ctr < 500U; ++ctr) {
+        db_->sync ((ctr * 7U) % (num_revisions + 1U));
+    }
+    done = true;
+    for (std::thread & t : threads) {
+        t.join ();
+    }
+    EXPECT_EQ (0U, errors.load ());
+}
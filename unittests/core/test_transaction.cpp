@@ -15,11 +15,18 @@
 //===----------------------------------------------------------------------===//
 #include "pstore/core/transaction.hpp"
 
+#include <algorithm>
+#include <future>
 #include <mutex>
 #include <numeric>
+#include <thread>
 
 #include "gmock/gmock.h"
 
+#include "pstore/core/hamt_map.hpp"
+#include "pstore/core/index_types.hpp"
+
+#include "check_for_error.hpp"
 #include "empty_store.hpp"
 
 namespace {
@@ -491,8 +498,11 @@ TEST_F (Transaction, GetRwInt) {
         using ::testing::Ge;
         using ::testing::Invoke;
 
-        Expectation allocate_int = EXPECT_CALL (*database, allocate (sizeof (int), alignof (int)))
-                                       .WillOnce (Invoke (database, &mock_database::base_allocate));
+        // The transaction reserves space from the database in bulk: a single call to allocate()
+        // must provide enough for both the int and the transaction's trailer.
+        Expectation allocate_int =
+            EXPECT_CALL (*database, allocate (Ge (sizeof (int) + sizeof (pstore::trailer)), 1U))
+                .WillOnce (Invoke (database, &mock_database::base_allocate));
 
         // A call to get(). First argument (address) must lie beyond the initial transaction
         // and must request a writable int.
@@ -511,6 +521,32 @@ TEST_F (Transaction, GetRwInt) {
     }
 }
 
+TEST_F (Transaction, SmallAllocationsShareAReservation) {
+    mock_database * const database = this->db ();
+    {
+        using ::testing::_;
+        using ::testing::Invoke;
+        EXPECT_CALL (*database, allocate (_, 1U))
+            .WillOnce (Invoke (database, &mock_database::base_allocate));
+    }
+    {
+        mock_mutex mutex;
+        auto transaction = begin (*database, std::unique_lock<mock_mutex>{mutex});
+        for (auto ctr = 0; ctr < 1000; ++ctr) {
+            *transaction.alloc_rw<int> ().first = ctr;
+        }
+        transaction.commit ();
+    }
+    // The unused part of the reservation must have been returned so that the new footer is the
+    // last thing in the store.
+    EXPECT_EQ (database->footer_pos ().absolute () + sizeof (pstore::trailer), database->size ());
+    // The ints are packed together immediately after the r0 footer.
+    auto const data_size = database->footer_pos ().absolute () -
+                           (pstore::leader_size + sizeof (pstore::trailer));
+    EXPECT_GE (data_size, 1000U * sizeof (int));
+    EXPECT_LT (data_size, 1000U * sizeof (int) + alignof (pstore::trailer));
+}
+
 // Use the getro<> method to return a address to the first int in the store.
 TEST_F (Transaction, GetRoInt) {
     mock_database * const database = this->db ();
@@ -550,3 +586,292 @@ TEST_F (Transaction, GetRwUInt64) {
     }
     EXPECT_EQ (expected, *database->getro (extent));
 }
+
+TEST_F (Transaction, BlockTransactionAllocatesWithinItsBlock) {
+    mock_database * const database = this->db ();
+    mock_mutex mutex;
+    auto transaction = begin (*database, std::unique_lock<mock_mutex>{mutex});
+    pstore::address const first = transaction.allocate (64U, 16U);
+    auto const db_size = database->size ();
+    {
+        // The block transaction must not extend the database.
+        using ::testing::_;
+        EXPECT_CALL (*database, allocate (_, _)).Times (0);
+    }
+
+    pstore::block_transaction block{transaction, first, 64U};
+    EXPECT_FALSE (block.is_open ());
+    EXPECT_EQ (block.allocate (1U, 1U), first);
+    EXPECT_EQ (block.allocate (8U, 8U), first + 8U);
+    EXPECT_EQ (block.allocate (16U, 16U), first + 16U);
+    EXPECT_EQ (block.used (), 32U);
+    check_for_error ([&block] () { block.allocate (33U, 1U); }, pstore::error_code::bad_address);
+    EXPECT_EQ (block.allocate (32U, 1U), first + 32U);
+    EXPECT_EQ (block.used (), 64U);
+    EXPECT_EQ (database->size (), db_size);
+}
+
+TEST_F (Transaction, BlockTransactionSharedByThreads) {
+    mock_database * const database = this->db ();
+    mock_mutex mutex;
+    auto transaction = begin (*database, std::unique_lock<mock_mutex>{mutex});
+    constexpr auto num_threads = 4U;
+    constexpr auto allocs_per_thread = std::size_t{100};
+    constexpr auto block_size = std::uint64_t{num_threads * allocs_per_thread * 8U};
+    pstore::address const first = transaction.allocate (block_size, 8U);
+
+    // Threads which share a block transaction allocate one after another from its start.
+    pstore::block_transaction block{transaction, first, block_size};
+    std::vector<std::vector<pstore::address>> addresses (num_threads);
+    std::vector<std::thread> threads;
+    for (auto ctr = 0U; ctr < num_threads; ++ctr) {
+        threads.emplace_back ([&block, &addresses, ctr] () {
+            for (auto a = std::size_t{0}; a < allocs_per_thread; ++a) {
+                addresses[ctr].push_back (block.allocate (8U, 8U));
+            }
+        });
+    }
+    for (std::thread & t : threads) {
+        t.join ();
+    }
+    EXPECT_EQ (block_size, block.used ());
+
+    std::vector<pstore::address> all;
+    for (std::vector<pstore::address> const & a : addresses) {
+        all.insert (std::end (all), std::begin (a), std::end (a));
+    }
+    std::sort (std::begin (all), std::end (all));
+    for (auto ctr = std::size_t{0}; ctr < all.size (); ++ctr) {
+        EXPECT_EQ (first + ctr * 8U, all[ctr]) << "allocation " << ctr;
+    }
+}
+
+TEST_F (Transaction, FlushIndicesLeavesNoGaps) {
+    using pstore::index::digest;
+    mock_database * const database = this->db ();
+    mock_mutex mutex;
+    auto transaction = begin (*database, std::unique_lock<mock_mutex>{mutex});
+    constexpr auto num_keys = std::uint64_t{500};
+    auto const key = [] (std::uint64_t const n) { return digest{n * 0x9E3779B97F4A7C15, n}; };
+
+    // Two of the store's indices are dirty so flush_indices() writes them concurrently.
+    auto const fragments =
+        pstore::index::get_index<pstore::trailer::indices::fragment> (*database);
+    auto const debug_line_headers =
+        pstore::index::get_index<pstore::trailer::indices::debug_line_header> (*database);
+    // A copy of each which is written serially to find the bytes that the indices need.
+    pstore::index::fragment_index fragments_copy{*database};
+    pstore::index::debug_line_header_index debug_line_headers_copy{*database};
+    for (auto n = std::uint64_t{0}; n < num_keys; ++n) {
+        auto const fragment = std::make_pair (key (n), pstore::extent<pstore::repo::fragment>{});
+        auto const debug_line_header = std::make_pair (key (n), pstore::extent<std::uint8_t>{});
+        fragments->insert (transaction, fragment);
+        fragments_copy.insert (transaction, fragment);
+        debug_line_headers->insert (transaction, debug_line_header);
+        debug_line_headers_copy.insert (transaction, debug_line_header);
+    }
+    auto const generation = database->get_current_revision () + 1U;
+    auto const bound = fragments->flush_size () + debug_line_headers->flush_size ();
+
+    auto const serial_start = transaction.size ();
+    fragments_copy.flush (transaction, generation);
+    debug_line_headers_copy.flush (transaction, generation);
+    auto const serial_size = transaction.size () - serial_start;
+
+    auto const start = transaction.size ();
+    pstore::trailer::index_records_array locations{};
+    pstore::index::flush_indices (transaction, &locations, generation);
+    auto const size = transaction.size () - start;
+
+    // The transaction grows by the bytes written, not by the upper bounds used to reserve space
+    // for them: the indices are packed together with only alignment padding between records.
+    EXPECT_GT (bound, serial_size + 128U) << "The test needs the bounds to have some slack";
+    EXPECT_LE (size, serial_size + 64U);
+    using pstore::trailer;
+    EXPECT_NE (locations[static_cast<std::size_t> (trailer::indices::fragment)],
+               pstore::typed_address<pstore::index::header_block>::null ());
+    EXPECT_NE (locations[static_cast<std::size_t> (trailer::indices::debug_line_header)],
+               pstore::typed_address<pstore::index::header_block>::null ());
+}
+
+namespace {
+
+    // Writes a single integer to the store in its own transaction and returns its address.
+    pstore::typed_address<int> commit_int (pstore::database & db, int const value) {
+        mock_mutex mutex;
+        auto transaction = begin (db, std::unique_lock<mock_mutex>{mutex});
+        std::pair<std::shared_ptr<int>, pstore::typed_address<int>> const rw =
+            transaction.alloc_rw<int> ();
+        *rw.first = value;
+        transaction.commit ();
+        return rw.second;
+    }
+
+} // end anonymous namespace
+
+TEST_F (TransactionFile, CommitDurableEachCommit) {
+    mock_database_file * const db = this->db ();
+    db->set_durability (pstore::database::durability::each_commit);
+    EXPECT_EQ (pstore::database::durability::each_commit, db->get_durability ());
+
+    auto const addr1 = commit_int (*db, 17);
+    auto const addr2 = commit_int (*db, 19);
+    EXPECT_EQ (2U, db->get_current_revision ());
+    EXPECT_EQ (17, *db->getro (addr1));
+    EXPECT_EQ (19, *db->getro (addr2));
+}
+
+TEST_F (TransactionFile, CommitDurableGroup) {
+    mock_database_file * const db = this->db ();
+    db->set_durability (pstore::database::durability::group);
+
+    auto const addr = commit_int (*db, 23);
+    EXPECT_EQ (1U, db->get_current_revision ());
+    EXPECT_EQ (23, *db->getro (addr));
+}
+
+namespace {
+
+    // A database which records each range that it flushes together with the footer to which the
+    // file header referred at the time.
+    class flush_recording_database : public pstore::database {
+    public:
+        struct flush_record {
+            pstore::address first;
+            pstore::address last;
+            pstore::typed_address<pstore::trailer> footer;
+        };
+
+        explicit flush_recording_database (std::shared_ptr<pstore::file::file_handle> const & file)
+                : pstore::database (file) {
+            this->set_vacuum_mode (pstore::database::vacuum_mode::disabled);
+        }
+
+        void flush (pstore::address const first, pstore::address const last) override {
+            flushes.push_back ({first, last, this->get_header ().footer_pos.load ()});
+            pstore::database::flush (first, last);
+        }
+
+        std::vector<flush_record> flushes;
+    };
+
+} // end anonymous namespace
+
+TEST_F (TransactionFile, CommitDurableFlushesDataBeforeHeader) {
+    for (auto const mode :
+         {pstore::database::durability::each_commit, pstore::database::durability::group}) {
+        flush_recording_database db{this->file ()};
+        db.set_durability (mode);
+        auto const old_footer = db.footer_pos ();
+        auto const addr = commit_int (db, 41);
+        auto const new_footer = db.footer_pos ();
+        EXPECT_NE (old_footer, new_footer);
+
+        ASSERT_EQ (2U, db.flushes.size ());
+        // The data and the new footer are flushed whilst the header still refers to the previous
+        // footer...
+        EXPECT_LE (db.flushes[0].first, addr.to_address ());
+        EXPECT_GE (db.flushes[0].last, (new_footer + 1).to_address ());
+        EXPECT_EQ (old_footer, db.flushes[0].footer);
+        // ...and only then is the header, which now refers to the new footer, flushed.
+        EXPECT_EQ (pstore::address::null (), db.flushes[1].first);
+        EXPECT_EQ (pstore::address{sizeof (pstore::header)}, db.flushes[1].last);
+        EXPECT_EQ (new_footer, db.flushes[1].footer);
+    }
+}
+
+namespace {
+
+    // A mutex which records whether it is held.
+    class recording_mutex {
+    public:
+        explicit recording_mutex (bool * const locked) noexcept
+                : locked_{locked} {}
+        void lock () { *locked_ = true; }
+        void unlock () { *locked_ = false; }
+
+    private:
+        bool * locked_;
+    };
+
+} // end anonymous namespace
+
+TEST_F (TransactionFile, CommitDurableGroupReleasesLock) {
+    mock_database_file * const db = this->db ();
+    db->set_durability (pstore::database::durability::group);
+
+    // The lock is released before a group commit waits for its flush so that other threads can
+    // commit and join the next batch.
+    bool locked = false;
+    recording_mutex mutex{&locked};
+    using lock_type = std::unique_lock<recording_mutex>;
+    pstore::transaction<lock_type> transaction{*db, lock_type{mutex}};
+    EXPECT_TRUE (locked);
+    std::pair<std::shared_ptr<int>, pstore::typed_address<int>> const rw =
+        transaction.alloc_rw<int> ();
+    *rw.first = 31;
+    transaction.commit ();
+    EXPECT_FALSE (locked);
+    EXPECT_EQ (1U, db->get_current_revision ());
+    EXPECT_EQ (31, *db->getro (rw.second));
+    check_for_error ([&transaction] () { transaction.alloc_rw<int> (); },
+                     pstore::error_code::cannot_allocate_after_commit);
+}
+
+namespace {
+
+    // A mutex which announces when a thread starts to wait for it.
+    class announcing_mutex {
+    public:
+        explicit announcing_mutex (std::promise<void> * const waiting) noexcept
+                : waiting_{waiting} {}
+        void lock () {
+            waiting_->set_value ();
+            mut_.lock ();
+        }
+        void unlock () { mut_.unlock (); }
+
+        std::mutex & underlying () noexcept { return mut_; }
+
+    private:
+        std::promise<void> * waiting_;
+        std::mutex mut_;
+    };
+
+} // end anonymous namespace
+
+TEST_F (TransactionFile, WriterWaitingForLockSeesReplacedStore) {
+    mock_database_file * const db = this->db ();
+    std::promise<void> waiting;
+    announcing_mutex mutex{&waiting};
+
+    // Stand in for vacuum: hold the transaction lock whilst a writer waits for it, then mark the
+    // store as replaced before letting the writer go.
+    std::unique_lock<std::mutex> vacuum_lock{mutex.underlying ()};
+    std::thread writer{[db, &mutex] () {
+        using lock_type = std::unique_lock<announcing_mutex>;
+        check_for_error (
+            [db, &mutex] () {
+                pstore::transaction<lock_type> transaction{*db, lock_type{mutex}};
+                *transaction.alloc_rw<int> ().first = 37;
+                transaction.commit ();
+            },
+            pstore::error_code::store_replaced);
+    }};
+    waiting.get_future ().wait ();
+    EXPECT_FALSE (db->is_replaced ());
+    db->set_replaced ();
+    vacuum_lock.unlock ();
+    writer.join ();
+
+    EXPECT_TRUE (db->is_replaced ());
+    EXPECT_EQ (0U, db->get_current_revision ());
+}
+
+TEST_F (Transaction, CommitDurableInMemory) {
+    // An in-memory store has nothing to flush but must still accept durable commits.
+    mock_database * const db = this->db ();
+    db->set_durability (pstore::database::durability::each_commit);
+    auto const addr = commit_int (*db, 29);
+    EXPECT_EQ (29, *db->getro (addr));
+}
@@ -138,7 +138,7 @@ TEST (Database, Trailer) {
     addr->write (out);
 
     auto const lines = split_lines (out.str ());
-    ASSERT_EQ (8U, lines.size ());
+    ASSERT_EQ (9U, lines.size ());
 
     auto line = 0U;
     EXPECT_THAT (split_tokens (lines.at (line++)),
@@ -151,6 +151,7 @@ TEST (Database, Trailer) {
                  ElementsAre ("time", ":", "1970-01-01T00:00:00Z"));
 
     EXPECT_THAT (split_tokens (lines.at (line++)), ElementsAre ("prev_generation", ":", "0x0"));
+    EXPECT_THAT (split_tokens (lines.at (line++)), ElementsAre ("skip_generation", ":", "0x0"));
     EXPECT_THAT (
         split_tokens (lines.at (line++)),
         ElementsAre ("indices", ":", "[", "0x0,", "0x0,", "0x0,", "0x0,", "0x0,", "0x0", "]"));
@@ -15,7 +15,10 @@
 //===----------------------------------------------------------------------===//
 #include "pstore/exchange/export_emit.hpp"
 
+#include <numeric>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -83,3 +86,28 @@ TEST (ExportEmitArray, Array) {
     auto const actual = os.str ();
     EXPECT_EQ (actual, "[\n  2,\n  3,\n  5\n]");
 }
+
+TEST (ExportEmitMembers, Empty) {
+    pstore::exchange::export_ns::ostringstream os;
+    std::vector<int> const values{};
+    emit_members (os, values, [] (pstore::exchange::export_ns::ostream_base & os1, int v) {
+        os1 << v;
+    });
+    EXPECT_EQ (os.str (), "");
+}
+
+TEST (ExportEmitMembers, InOrder) {
+    // Enough members that they are formatted in several batches of runs.
+    std::vector<unsigned> values (100000U);
+    std::iota (std::begin (values), std::end (values), 0U);
+
+    pstore::exchange::export_ns::ostringstream os;
+    emit_members (os, values, [] (pstore::exchange::export_ns::ostream_base & os1, unsigned v) {
+        os1 << v;
+    });
+    std::string expected;
+    for (unsigned const v : values) {
+        expected += (v == 0U ? "\n" : ",\n") + std::to_string (v);
+    }
+    EXPECT_EQ (os.str (), expected);
+}
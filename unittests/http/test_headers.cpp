@@ -63,3 +63,45 @@ TEST (Headers, ExampleWSCaseInsensitive) {
     expected.connection_upgrade = true;
     EXPECT_EQ (hi, expected);
 }
+
+TEST (Headers, ConnectionClose) {
+    header_info const hi = header_info ().handler ("connection", "close");
+    header_info expected;
+    expected.connection_close = true;
+    EXPECT_EQ (hi, expected);
+}
+
+TEST (Headers, AcceptEncoding) {
+    EXPECT_TRUE (header_info ().handler ("accept-encoding", "gzip, deflate").accept_gzip);
+    EXPECT_TRUE (header_info ().handler ("accept-encoding", "deflate, GZIP;q=0.5").accept_gzip);
+    EXPECT_TRUE (header_info ().handler ("accept-encoding", "*").accept_gzip);
+    EXPECT_FALSE (header_info ().handler ("accept-encoding", "deflate, br").accept_gzip);
+    EXPECT_FALSE (header_info ().handler ("accept-encoding", "gzip;q=0, br").accept_gzip);
+    EXPECT_FALSE (header_info ().handler ("accept-encoding", "gzip; q=0.000").accept_gzip);
+}
+
+TEST (Headers, AcceptEncodingExplicitGzipBeatsWildcard) {
+    EXPECT_FALSE (header_info ().handler ("accept-encoding", "gzip;q=0, *").accept_gzip);
+    EXPECT_FALSE (header_info ().handler ("accept-encoding", "*, x-gzip;q=0").accept_gzip);
+    EXPECT_TRUE (header_info ().handler ("accept-encoding", "gzip, *;q=0").accept_gzip);
+    EXPECT_TRUE (header_info ().handler ("accept-encoding", "*;q=0, gzip").accept_gzip);
+    EXPECT_FALSE (header_info ().handler ("accept-encoding", "br, *;q=0").accept_gzip);
+}
+
+TEST (Headers, IfNoneMatch) {
+    header_info const hi = header_info ().handler ("if-none-match", R"("abc", W/"def")");
+    header_info expected;
+    expected.if_none_match = just (R"("abc", W/"def")"s);
+    EXPECT_EQ (hi, expected);
+}
+
+TEST (Headers, IfModifiedSince) {
+    header_info const hi =
+        header_info ().handler ("if-modified-since", "Tue, 23 Apr 2019 09:10:27 GMT");
+    header_info expected;
+    expected.if_modified_since = just (std::time_t{1556010627});
+    EXPECT_EQ (hi, expected);
+
+    // An invalid date is ignored.
+    EXPECT_EQ (header_info ().handler ("if-modified-since", "Tue, 23 Apr 2019"), header_info ());
+}
@@ -38,7 +38,7 @@ TEST (ServeDynamicContent, BadRequest) {
 
     int io = 0;
     pstore::error_or<int> const err = pstore::http::serve_dynamic_content (
-        sender, io, std::string{pstore::http::dynamic_path} + "bad_request");
+        sender, io, std::string{pstore::http::dynamic_path} + "bad_request", true);
     EXPECT_EQ (err.get_error (), make_error_code (pstore::http::error_code::bad_request));
 }
 
@@ -51,7 +51,22 @@ TEST (ServeDynamicContent, Version) {
     };
 
     pstore::error_or<int> const r = pstore::http::serve_dynamic_content (
-        sender, 0, std::string{pstore::http::dynamic_path} + "version");
+        sender, 0, std::string{pstore::http::dynamic_path} + "version", true);
     EXPECT_TRUE (r);
     EXPECT_THAT (output, ::testing::ContainsRegex ("\r\n\r\n\\{ *\"version\" *:"));
+    EXPECT_THAT (output, ::testing::Not (::testing::HasSubstr ("Connection: close\r\n")));
+}
+
+TEST (ServeDynamicContent, ConnectionClose) {
+    std::string output;
+    auto sender = [&output] (int io, pstore::gsl::span<std::uint8_t const> const & s) {
+        std::transform (std::begin (s), std::end (s), std::back_inserter (output),
+                        [] (std::uint8_t v) { return static_cast<char> (v); });
+        return pstore::error_or<int>{io};
+    };
+
+    pstore::error_or<int> const r = pstore::http::serve_dynamic_content (
+        sender, 0, std::string{pstore::http::dynamic_path} + "version", false);
+    EXPECT_TRUE (r);
+    EXPECT_THAT (output, ::testing::HasSubstr ("\r\nConnection: close\r\n"));
 }
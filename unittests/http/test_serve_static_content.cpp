@@ -24,6 +24,7 @@
 #include <algorithm>
 #include <array>
 #include <cstring>
+#include <map>
 #include <string>
 
 #include "pstore/http/request.hpp"
@@ -38,11 +39,20 @@ namespace {
     char const index_html[] = "<!DOCTYPE html><html></html>";
     static constexpr std::size_t index_size = pstore::array_elements (index_html) - 1U;
 
+    char const app_js[] = "console.log('hello');";
+    static constexpr std::size_t app_js_size = pstore::array_elements (app_js) - 1U;
+    // This isn't really gzip-compressed data but the server doesn't care.
+    std::uint8_t const app_js_gz[] = {31, 139, 8, 0};
+    constexpr auto app_js_etag = "\"0123456789abcdef\"";
+
     extern pstore::romfs::directory const root_dir;
     constexpr std::time_t index_mtime = 1556010627;
-    std::array<pstore::romfs::dirent, 3> const root_dir_membs = {{
+    std::array<pstore::romfs::dirent, 4> const root_dir_membs = {{
         {".", &root_dir},
         {"..", &root_dir},
+        {"app.js", reinterpret_cast<std::uint8_t const *> (app_js),
+         pstore::romfs::stat{app_js_size, index_mtime, pstore::romfs::mode_t::file}, app_js_etag,
+         app_js_gz, sizeof (app_js_gz)},
         {"index.html", reinterpret_cast<std::uint8_t const *> (index_html),
          pstore::romfs::stat{index_size, index_mtime, pstore::romfs::mode_t::file}},
     }};
@@ -60,13 +70,19 @@ namespace {
 
     protected:
         pstore::romfs::romfs const & fs () const noexcept { return fs_; }
-        pstore::error_or<std::string> serve_path (std::string const & path) const;
+        pstore::error_or<std::string>
+        serve_path (std::string const & path,
+                    pstore::http::header_info const & request_headers = {},
+                    bool keep_alive = true) const;
 
     private:
         pstore::romfs::romfs fs_;
     };
 
-    pstore::error_or<std::string> ServeStaticContent::serve_path (std::string const & path) const {
+    pstore::error_or<std::string>
+    ServeStaticContent::serve_path (std::string const & path,
+                                    pstore::http::header_info const & request_headers,
+                                    bool const keep_alive) const {
         std::string actual;
 
         using eoint = pstore::error_or<int>;
@@ -76,9 +92,11 @@ namespace {
             return eoint (io + 1);
         };
 
-        return pstore::http::serve_static_content (sender, 0, path, fs ()) >>= [&actual] (int) {
-            return pstore::error_or<std::string>{pstore::in_place, actual};
-        };
+        return pstore::http::serve_static_content (sender, 0, path, fs (), request_headers,
+                                                   keep_alive) >>=
+               [&actual] (int) {
+                   return pstore::error_or<std::string>{pstore::in_place, actual};
+               };
     }
 
 
@@ -107,6 +125,34 @@ namespace {
         std::string const & src_;
     };
 
+    struct response {
+        std::string status;
+        std::map<std::string, std::string> headers;
+        std::string body;
+    };
+
+    /// Splits an HTTP response into its status code, headers, and body.
+    response parse_response (std::string const & src) {
+        response result;
+        reader r{src};
+        auto const record_headers = [&r, &result] (reader::state_type io,
+                                                   pstore::http::request_info const & status) {
+            // read_request() sees the response's status code as the request URI.
+            result.status = status.uri ();
+            auto record_header = [&result] (int io2, std::string const & key,
+                                            std::string const & value) {
+                result.headers[key] = value;
+                return io2 + 1;
+            };
+            return pstore::http::read_headers (r, io, record_header, 0);
+        };
+        pstore::error_or_n<std::string::size_type, int> const eo =
+            pstore::http::read_request (r, std::string::size_type{0}) >>= record_headers;
+        PSTORE_ASSERT (static_cast<bool> (eo));
+        result.body = src.substr (std::get<0> (eo));
+        return result;
+    }
+
 } // end anonymous namespace
 
 
@@ -138,13 +184,91 @@ TEST_F (ServeStaticContent, Simple) {
     EXPECT_THAT (headers,
                  ::testing::UnorderedElementsAre (
                      string_pair{"content-length", "28"}, string_pair{"content-type", "text/html"},
-                     string_pair{"date", ""}, string_pair{"connection", "close"},
+                     string_pair{"date", ""},
                      string_pair{"last-modified", "Tue, 23 Apr 2019 09:10:27 GMT"},
                      string_pair{"server", "pstore-http"}));
     EXPECT_EQ ((std::string{*actual, std::get<0> (eo)}), index_html);
 }
 
+TEST_F (ServeStaticContent, ConnectionClose) {
+    pstore::error_or<std::string> const actual = serve_path ("/index.html", {}, false);
+    ASSERT_TRUE (static_cast<bool> (actual));
+    response const r = parse_response (*actual);
+    EXPECT_EQ (r.status, "200");
+    EXPECT_EQ (r.headers.at ("connection"), "close");
+    EXPECT_EQ (r.body, index_html);
+}
+
 TEST_F (ServeStaticContent, MissingFile) {
     pstore::error_or<std::string> const actual = serve_path ("/foo.html");
     EXPECT_EQ (actual.get_error (), make_error_code (pstore::romfs::error_code::enoent));
 }
+
+TEST_F (ServeStaticContent, ETag) {
+    pstore::error_or<std::string> const actual = serve_path ("/app.js");
+    ASSERT_TRUE (static_cast<bool> (actual));
+    response const r = parse_response (*actual);
+    EXPECT_EQ (r.status, "200");
+    EXPECT_EQ (r.headers.at ("etag"), app_js_etag);
+    EXPECT_EQ (r.headers.at ("vary"), "Accept-Encoding");
+    EXPECT_EQ (r.headers.count ("content-encoding"), 0U);
+    EXPECT_EQ (r.body, app_js);
+}
+
+TEST_F (ServeStaticContent, IfNoneMatch) {
+    pstore::http::header_info request_headers;
+    request_headers.if_none_match = std::string{"\"other\", W/"} + app_js_etag;
+    pstore::error_or<std::string> const actual = serve_path ("/app.js", request_headers);
+    ASSERT_TRUE (static_cast<bool> (actual));
+    response const r = parse_response (*actual);
+    EXPECT_EQ (r.status, "304");
+    EXPECT_EQ (r.headers.at ("etag"), app_js_etag);
+    EXPECT_EQ (r.headers.count ("content-length"), 0U);
+    EXPECT_EQ (r.body, "");
+}
+
+TEST_F (ServeStaticContent, IfNoneMatchDifferent) {
+    pstore::http::header_info request_headers;
+    request_headers.if_none_match = std::string{"\"other\""};
+    // If-None-Match takes precedence over If-Modified-Since.
+    request_headers.if_modified_since = index_mtime;
+    pstore::error_or<std::string> const actual = serve_path ("/app.js", request_headers);
+    ASSERT_TRUE (static_cast<bool> (actual));
+    EXPECT_EQ (parse_response (*actual).status, "200");
+}
+
+TEST_F (ServeStaticContent, IfModifiedSince) {
+    pstore::http::header_info request_headers;
+    request_headers.if_modified_since = index_mtime;
+    {
+        pstore::error_or<std::string> const actual = serve_path ("/index.html", request_headers);
+        ASSERT_TRUE (static_cast<bool> (actual));
+        EXPECT_EQ (parse_response (*actual).status, "304");
+    }
+    request_headers.if_modified_since = index_mtime - 1;
+    {
+        pstore::error_or<std::string> const actual = serve_path ("/index.html", request_headers);
+        ASSERT_TRUE (static_cast<bool> (actual));
+        EXPECT_EQ (parse_response (*actual).status, "200");
+    }
+}
+
+TEST_F (ServeStaticContent, Gzip) {
+    pstore::http::header_info request_headers;
+    request_headers.accept_gzip = true;
+    pstore::error_or<std::string> const actual = serve_path ("/app.js", request_headers);
+    ASSERT_TRUE (static_cast<bool> (actual));
+    response const r = parse_response (*actual);
+    EXPECT_EQ (r.status, "200");
+    EXPECT_EQ (r.headers.at ("content-encoding"), "gzip");
+    EXPECT_EQ (r.headers.at ("content-length"), std::to_string (sizeof (app_js_gz)));
+    EXPECT_EQ (r.headers.at ("etag"), "\"0123456789abcdef-gzip\"");
+    EXPECT_EQ (r.body, (std::string{reinterpret_cast<char const *> (app_js_gz),
+                                    sizeof (app_js_gz)}));
+
+    // The uncompressed representation's entity tag doesn't match the compressed one.
+    request_headers.if_none_match = std::string{app_js_etag};
+    pstore::error_or<std::string> const actual2 = serve_path ("/app.js", request_headers);
+    ASSERT_TRUE (static_cast<bool> (actual2));
+    EXPECT_EQ (parse_response (*actual2).status, "200");
+}
@@ -67,3 +67,45 @@ TEST (MemoryMapper, MemoryMapThenCheckFileContents) {
     std::iota (expected.begin (), expected.end (), std::uint8_t{0});
     EXPECT_THAT (expected, ContainerEq (contents));
 }
+
+#ifdef __linux__
+TEST (MemoryMapper, ReservationMakesAdjacentMappings) {
+    pstore::file::file_handle file;
+    file.open (pstore::file::file_handle::temporary ());
+
+    std::size_t const size = pstore::system_page_size ().get ();
+    file.seek (size * 2U - 1U);
+    file.write (0);
+
+    auto reservation = std::make_shared<pstore::address_reservation> (size * 4U);
+    ASSERT_TRUE (reservation->valid ());
+    {
+        pstore::memory_mapper mm0{file, true, 0U, size, reservation};
+        pstore::memory_mapper mm1{file, true, size, size, reservation};
+
+        auto * const p0 = static_cast<std::uint8_t *> (mm0.data ().get ());
+        auto * const p1 = static_cast<std::uint8_t *> (mm1.data ().get ());
+        EXPECT_EQ (p0, reservation->base ());
+        EXPECT_EQ (p1, p0 + size) << "The second page should immediately follow the first";
+
+        // The two mappings look like a single block of memory.
+        std::iota (p0, p0 + size * 2U, std::uint8_t{0});
+
+        // The first page is in use so can't be acquired again.
+        EXPECT_EQ (reservation->acquire (0U, size), nullptr);
+        // A range beyond the end of the reservation can't be acquired at all.
+        EXPECT_EQ (reservation->acquire (size * 4U, size), nullptr);
+    }
+    // With the mappings gone, their addresses are available once more.
+    void * const p = reservation->acquire (0U, size * 2U);
+    EXPECT_EQ (p, reservation->base ());
+    reservation->release (0U, size * 2U);
+
+    file.seek (0);
+    std::vector<std::uint8_t> contents (size * 2U);
+    file.read_span (pstore::gsl::make_span (contents));
+    std::vector<std::uint8_t> expected (size * 2U);
+    std::iota (expected.begin (), expected.end (), std::uint8_t{0});
+    EXPECT_EQ (expected, contents);
+}
+#endif // __linux__
@@ -119,6 +119,19 @@ TEST_F (RomFs, OpenAndReadFile) {
     EXPECT_EQ (d.seek (0, SEEK_CUR), 0);
 }
 
+TEST_F (RomFs, Lookup) {
+    pstore::error_or<dirent const *> const eo = fs ().lookup ("/dir/foo");
+    ASSERT_TRUE (static_cast<bool> (eo));
+    dirent const * const de = *eo;
+    EXPECT_STREQ (de->name (), "foo");
+    EXPECT_EQ (de->contents (), file1);
+    EXPECT_FALSE (de->is_directory ());
+    EXPECT_EQ (de->etag (), nullptr);
+    EXPECT_EQ (de->gzip_contents (), nullptr);
+
+    this->check_for_error (fs ().lookup ("/dir/missing"), pstore::romfs::error_code::enoent);
+}
+
 TEST_F (RomFs, OpenDir) {
     this->check_for_error (fs ().opendir ("hello"), pstore::romfs::error_code::enotdir);
     EXPECT_TRUE (static_cast<bool> (fs ().opendir ("/")));
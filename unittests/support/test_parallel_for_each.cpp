@@ -18,6 +18,7 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <mutex>
 #include <vector>
 
@@ -109,6 +110,27 @@ TEST_F (ParallelForEach, ConcurrencyPlusOne) {
     EXPECT_THAT (out, ::testing::ContainerEq (expected));
 }
 
+TEST_F (ParallelForEach, ManyElements) {
+    auto num = concurrency () * 100U + 7U;
+    auto const src = make_input (num);
+    auto const expected = make_expected (num);
+    auto const out = run_for_each (src);
+    EXPECT_THAT (out, ::testing::ContainerEq (expected));
+}
+
+TEST_F (ParallelForEach, Nested) {
+    // A parallel_for_each() issued from within a worker must not deadlock waiting for workers
+    // which are themselves busy.
+    auto const num = concurrency () * 2U;
+    auto const src = make_input (num);
+    std::atomic<unsigned> count{0U};
+    pstore::parallel_for_each (std::begin (src), std::end (src), [&src, &count] (int) {
+        pstore::parallel_for_each (std::begin (src), std::end (src),
+                                   [&count] (int) { ++count; });
+    });
+    EXPECT_EQ (count.load (), num * num);
+}
+
 TEST (ParallelForEachException, WorkerExceptionPropogates) {
     // Check that an exception throw in a worker thread fully propogates back to the caller.
 #ifdef PSTORE_EXCEPTIONS
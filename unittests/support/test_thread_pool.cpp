@@ -0,0 +1,85 @@
+//===- unittests/support/test_thread_pool.cpp -----------------------------===//
+//*  _   _                        _                     _  *
+//* | |_| |__  _ __ ___  __ _  __| |  _ __   ___   ___ | | *
+//* | __| '_ \| '__/ _ \/ _` |/ _` | | '_ \ / _ \ / _ \| | *
+//* | |_| | | | | |  __/ (_| | (_| | | |_) | (_) | (_) | | *
+//*  \__|_| |_|_|  \___|\__,_|\__,_| | .__/ \___/ \___/|_| *
+//*                                  |_|                   *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+#include "pstore/support/thread_pool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+
+#include <gmock/gmock.h>
+
+TEST (ThreadPool, RunsAllTasks) {
+    std::atomic<unsigned> count{0U};
+    {
+        pstore::thread_pool pool{4U};
+        EXPECT_EQ (pool.size (), 4U);
+        for (auto ctr = 0U; ctr < 1000U; ++ctr) {
+            pool.submit ([&count] () { ++count; });
+        }
+        // The destructor runs any tasks which are still queued.
+    }
+    EXPECT_EQ (count.load (), 1000U);
+}
+
+TEST (ThreadPool, TasksSubmittedByWorkers) {
+    // A task submitted by a worker goes onto that worker's own queue. Check that those tasks are
+    // run even though the other workers must steal them.
+    std::atomic<unsigned> count{0U};
+    {
+        pstore::thread_pool pool{3U};
+        pool.submit ([&pool, &count] () {
+            for (auto ctr = 0U; ctr < 100U; ++ctr) {
+                pool.submit ([&count] () { ++count; });
+            }
+        });
+    }
+    EXPECT_EQ (count.load (), 100U);
+}
+
+TEST (ThreadPool, BlockedWorkerIsNotStarved) {
+    // Block one worker. The tasks that were distributed to its queue must be stolen and run by
+    // the other worker.
+    std::mutex mut;
+    std::condition_variable cv;
+    bool release = false;
+    std::atomic<unsigned> count{0U};
+    {
+        pstore::thread_pool pool{2U};
+        pool.submit ([&] () {
+            std::unique_lock<std::mutex> lock{mut};
+            cv.wait (lock, [&release] () { return release; });
+        });
+        for (auto ctr = 0U; ctr < 10U; ++ctr) {
+            pool.submit ([&count] () { ++count; });
+        }
+        while (count.load () < 10U) {
+            std::this_thread::yield ();
+        }
+        {
+            std::lock_guard<std::mutex> const lock{mut};
+            release = true;
+        }
+        cv.notify_one ();
+    }
+    EXPECT_EQ (count.load (), 10U);
+}
+
+TEST (ThreadPool, Global) {
+    pstore::thread_pool & pool = pstore::thread_pool::global ();
+    EXPECT_EQ (&pool, &pstore::thread_pool::global ());
+    EXPECT_GE (pool.size (), 1U);
+}
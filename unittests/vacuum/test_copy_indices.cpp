@@ -0,0 +1,408 @@
+//===- unittests/vacuum/test_copy_indices.cpp -----------------------------===//
+//*                            _           _ _                *
+//*   ___ ___  _ __  _   _    (_)_ __   __| (_) ___ ___  ___  *
+//*  / __/ _ \| '_ \| | | |   | | '_ \ / _` | |/ __/ _ \/ __| *
+//* | (_| (_) | |_) | |_| |   | | | | | (_| | | (_|  __/\__ \ *
+//*  \___\___/| .__/ \__, |   |_|_| |_|\__,_|_|\___\___||___/ *
+//*           |_|    |___/                                    *
+//===----------------------------------------------------------------------===//
+//
+// Part of the pstore project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://github.com/SNSystems/pstore/blob/master/LICENSE.txt for license
+// information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+#include "pstore/vacuum/copy_indices.hpp"
+
+// Standard library includes
+#include <array>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// 3rd party includes
+#include <gmock/gmock.h>
+
+// pstore includes
+#include "pstore/core/hamt_map.hpp"
+#include "pstore/core/hamt_set.hpp"
+#include "pstore/core/index_types.hpp"
+#include "pstore/core/transaction.hpp"
+#include "pstore/mcrepo/compilation.hpp"
+#include "pstore/mcrepo/fragment.hpp"
+#include "pstore/support/pointee_adaptor.hpp"
+#include "pstore/vacuum/status.hpp"
+
+// Local includes
+#include "empty_store.hpp"
+
+namespace {
+
+    using lock_guard = std::unique_lock<mock_mutex>;
+    using transaction_type = pstore::transaction<lock_guard>;
+    using string_address = pstore::typed_address<pstore::indirect_string>;
+
+    class CopyIndices : public testing::Test {
+    public:
+        CopyIndices ()
+                : source_{source_store_.file ()}
+                , destination_{destination_store_.file ()} {
+            source_.set_vacuum_mode (pstore::database::vacuum_mode::disabled);
+            destination_.set_vacuum_mode (pstore::database::vacuum_mode::disabled);
+        }
+
+    protected:
+        static constexpr pstore::index::digest header_digest{0x1111, 0x2222};
+        static constexpr pstore::index::digest fragment0{0x3333, 0x4444};
+        static constexpr pstore::index::digest fragment1{0x5555, 0x6666};
+        static constexpr pstore::index::digest compilation0{0x7777, 0x8888};
+        static constexpr pstore::index::digest compilation1{0x9999, 0xAAAA};
+
+        void build_source ();
+        bool copy (vacuum::status const & st);
+
+        template <typename Database>
+        static std::string load_string (Database const & db, string_address const addr) {
+            return pstore::indirect_string::read (db, addr).to_string ();
+        }
+
+        mock_mutex mutex_;
+        InMemoryStore source_store_;
+        pstore::database source_;
+        InMemoryStore destination_store_;
+        pstore::database destination_;
+    };
+
+    constexpr pstore::index::digest CopyIndices::header_digest;
+    constexpr pstore::index::digest CopyIndices::fragment0;
+    constexpr pstore::index::digest CopyIndices::fragment1;
+    constexpr pstore::index::digest CopyIndices::compilation0;
+    constexpr pstore::index::digest CopyIndices::compilation1;
+
+    // build_source
+    // ~~~~~~~~~~~~
+    void CopyIndices::build_source () {
+        using namespace pstore::repo;
+        auto transaction = begin (source_, lock_guard{mutex_});
+
+        // Strings.
+        std::array<pstore::raw_sstring_view, 4> const names{
+            {pstore::make_sstring_view ("triple"), pstore::make_sstring_view ("sym0"),
+             pstore::make_sstring_view ("sym1"), pstore::make_sstring_view ("external")}};
+        std::array<string_address, 4> addrs;
+        pstore::indirect_string_adder adder;
+        auto const name_index = pstore::index::get_index<pstore::trailer::indices::name> (source_);
+        for (auto ctr = 0U; ctr < names.size (); ++ctr) {
+            addrs[ctr] = string_address::make (
+                adder.add (transaction, name_index, &names[ctr]).first.get_address ());
+        }
+        pstore::raw_sstring_view const path = pstore::make_sstring_view ("/path/to/file.c");
+        adder.add (transaction, pstore::index::get_index<pstore::trailer::indices::path> (source_),
+                   &path);
+        adder.flush (transaction);
+        string_address const triple = addrs[0];
+        string_address const sym0 = addrs[1];
+        string_address const sym1 = addrs[2];
+        string_address const external = addrs[3];
+
+        // A write-index entry.
+        {
+            std::string const value = "write value";
+            std::shared_ptr<char> ptr;
+            auto where = pstore::typed_address<char>::null ();
+            std::tie (ptr, where) = transaction.alloc_rw<char> (value.length ());
+            std::memcpy (ptr.get (), value.data (), value.length ());
+            pstore::index::get_index<pstore::trailer::indices::write> (source_)->insert (
+                transaction, std::make_pair (std::string{"key"}, make_extent (where,
+                                                                              value.length ())));
+        }
+
+        // A debug line header.
+        pstore::extent<std::uint8_t> header;
+        {
+            std::array<std::uint8_t, 4> const bytes{{1, 2, 3, 4}};
+            std::shared_ptr<std::uint8_t> ptr;
+            auto where = pstore::typed_address<std::uint8_t>::null ();
+            std::tie (ptr, where) = transaction.alloc_rw<std::uint8_t> (bytes.size ());
+            std::copy (std::begin (bytes), std::end (bytes), ptr.get ());
+            header = make_extent (where, bytes.size ());
+            pstore::index::get_index<pstore::trailer::indices::debug_line_header> (source_)
+                ->insert (transaction, std::make_pair (header_digest, header));
+        }
+
+        auto const fragment_index =
+            pstore::index::get_index<pstore::trailer::indices::fragment> (source_);
+        auto const compilation_index =
+            pstore::index::get_index<pstore::trailer::indices::compilation> (source_);
+
+        // fragment0 is a plain text fragment defined by compilation0.
+        section_content text{section_kind::text, 4U};
+        text.data.assign ({0x90, 0x90, 0x90, 0x90});
+        text.xfixups.emplace_back (external, relocation_type{1}, reference_strength::strong,
+                                   std::uint64_t{0}, std::int64_t{0});
+        std::shared_ptr<section_creation_dispatcher> const text_dispatcher =
+            std::make_shared<generic_section_creation_dispatcher> (section_kind::text, &text);
+        {
+            std::array<section_creation_dispatcher *, 1> d{{text_dispatcher.get ()}};
+            auto const fext =
+                fragment::alloc (transaction, pstore::make_pointee_adaptor (std::begin (d)),
+                                 pstore::make_pointee_adaptor (std::end (d)));
+            fragment_index->insert (transaction, std::make_pair (fragment0, fext));
+
+            std::array<definition, 1> const defs{{{fragment0, fext, sym0, linkage::external}}};
+            compilation_index->insert (
+                transaction,
+                std::make_pair (compilation0, compilation::alloc (transaction, triple,
+                                                                  std::begin (defs),
+                                                                  std::end (defs))));
+        }
+
+        // fragment1 has text, debug line, and linked-definitions sections.
+        {
+            auto const c0 = compilation_index->find (source_, compilation0)->second;
+            std::array<linked_definitions::value_type, 1> const links{
+                {{compilation0, 0U, compilation::index_address (c0.addr, 0U)}}};
+
+            section_content dl{section_kind::debug_line, 1U};
+            dl.data.assign ({0xAA, 0xBB});
+            dl.xfixups.emplace_back (external, relocation_type{2}, reference_strength::weak,
+                                     std::uint64_t{1}, std::int64_t{0});
+            debug_line_section_creation_dispatcher dl_dispatcher{header_digest, header, &dl};
+            linked_definitions_creation_dispatcher ld_dispatcher{links.data (),
+                                                                 links.data () + links.size ()};
+            std::array<section_creation_dispatcher *, 3> d{
+                {text_dispatcher.get (), &dl_dispatcher, &ld_dispatcher}};
+            auto const fext =
+                fragment::alloc (transaction, pstore::make_pointee_adaptor (std::begin (d)),
+                                 pstore::make_pointee_adaptor (std::end (d)));
+            fragment_index->insert (transaction, std::make_pair (fragment1, fext));
+
+            std::array<definition, 1> const defs{{{fragment1, fext, sym1, linkage::external}}};
+            compilation_index->insert (
+                transaction,
+                std::make_pair (compilation1, compilation::alloc (transaction, triple,
+                                                                  std::begin (defs),
+                                                                  std::end (defs))));
+        }
+        transaction.commit ();
+    }
+
+    // copy
+    // ~~~~
+    bool CopyIndices::copy (vacuum::status const & st) {
+        auto transaction = begin (destination_, lock_guard{mutex_});
+        if (!vacuum::copy_indices (source_, transaction, st)) {
+            transaction.rollback ();
+            return false;
+        }
+        transaction.commit ();
+        return true;
+    }
+
+} // end anonymous namespace
+
+TEST_F (CopyIndices, EmptyStore) {
+    vacuum::status st;
+    ASSERT_TRUE (this->copy (st));
+    EXPECT_EQ (destination_.get_current_revision (), 0U)
+        << "Copying an empty store should not create a new revision";
+}
+
+TEST_F (CopyIndices, AllIndices) {
+    using namespace pstore::repo;
+    this->build_source ();
+
+    vacuum::status st;
+    ASSERT_TRUE (this->copy (st));
+
+    auto const & db = destination_;
+    auto const names = pstore::index::get_index<pstore::trailer::indices::name> (db);
+    EXPECT_EQ (names->size (), 4U);
+    auto const paths = pstore::index::get_index<pstore::trailer::indices::path> (db);
+    ASSERT_EQ (paths->size (), 1U);
+    EXPECT_EQ (paths->begin (db)->to_string (), "/path/to/file.c");
+
+    {
+        auto const write = pstore::index::get_index<pstore::trailer::indices::write> (db);
+        auto const pos = write->find (db, std::string{"key"});
+        ASSERT_NE (pos, write->end (db));
+        std::shared_ptr<char const> const value = db.getro (pos->second);
+        EXPECT_EQ (std::string (value.get (), pos->second.size), "write value");
+    }
+
+    auto const headers = pstore::index::get_index<pstore::trailer::indices::debug_line_header> (db);
+    auto const header_pos = headers->find (db, header_digest);
+    ASSERT_NE (header_pos, headers->end (db));
+    {
+        std::shared_ptr<std::uint8_t const> const h = db.getro (header_pos->second);
+        EXPECT_THAT (std::vector<std::uint8_t> (h.get (), h.get () + header_pos->second.size),
+                     testing::ElementsAre (1, 2, 3, 4));
+    }
+
+    auto const fragments = pstore::index::get_index<pstore::trailer::indices::fragment> (db);
+    auto const compilations =
+        pstore::index::get_index<pstore::trailer::indices::compilation> (db);
+    ASSERT_EQ (fragments->size (), 2U);
+    ASSERT_EQ (compilations->size (), 2U);
+
+    auto const c0_pos = compilations->find (db, compilation0);
+    ASSERT_NE (c0_pos, compilations->end (db));
+    auto const f1_pos = fragments->find (db, fragment1);
+    ASSERT_NE (f1_pos, fragments->end (db));
+
+    // Check fragment1's sections now refer to the destination's records.
+    std::shared_ptr<fragment const> const f1 = fragment::load (db, f1_pos->second);
+    ASSERT_TRUE (f1->has_section (section_kind::text));
+    ASSERT_EQ (f1->at<section_kind::text> ().xfixups ().size (), 1U);
+    EXPECT_EQ (load_string (db, f1->at<section_kind::text> ().xfixups ().begin ()->name),
+               "external");
+
+    ASSERT_TRUE (f1->has_section (section_kind::debug_line));
+    auto const & dl = f1->at<section_kind::debug_line> ();
+    EXPECT_EQ (dl.header_extent (), header_pos->second);
+    ASSERT_EQ (dl.xfixups ().size (), 1U);
+    EXPECT_EQ (load_string (db, dl.xfixups ().begin ()->name), "external");
+
+    ASSERT_TRUE (f1->has_section (section_kind::linked_definitions));
+    auto const & ld = f1->at<section_kind::linked_definitions> ();
+    ASSERT_EQ (ld.size (), 1U);
+    EXPECT_EQ (ld.begin ()->pointer, compilation::index_address (c0_pos->second.addr, 0U));
+    EXPECT_EQ (definition::load (db, ld.begin ()->pointer)->digest, fragment0);
+
+    // Check compilation1's fields.
+    auto const c1_pos = compilations->find (db, compilation1);
+    ASSERT_NE (c1_pos, compilations->end (db));
+    std::shared_ptr<compilation const> const c1 = compilation::load (db, c1_pos->second);
+    EXPECT_EQ (load_string (db, c1->triple ()), "triple");
+    ASSERT_EQ (c1->size (), 1U);
+    EXPECT_EQ ((*c1)[0].digest, fragment1);
+    EXPECT_EQ ((*c1)[0].fext, f1_pos->second);
+    EXPECT_EQ (load_string (db, (*c1)[0].name), "sym1");
+}
+
+TEST_F (CopyIndices, Aborted) {
+    this->build_source ();
+
+    vacuum::status st;
+    st.modified = true;
+    EXPECT_FALSE (this->copy (st));
+    EXPECT_EQ (destination_.get_current_revision (), 0U);
+}
+
+TEST_F (CopyIndices, IncrementalCopy) {
+    using namespace pstore::repo;
+    this->build_source ();
+
+    vacuum::index_copier copier{source_};
+    {
+        auto transaction = begin (destination_, lock_guard{mutex_});
+        ASSERT_TRUE (copier.copy (transaction));
+        transaction.commit ();
+    }
+
+    // Add a second revision to the source: a new name, a replacement write-index value, and a
+    // fragment and compilation which refer to records from the first revision.
+    constexpr pstore::index::digest fragment2{0xBBBB, 0xCCCC};
+    constexpr pstore::index::digest compilation2{0xDDDD, 0xEEEE};
+    {
+        auto transaction = begin (source_, lock_guard{mutex_});
+        auto const name_index = pstore::index::get_index<pstore::trailer::indices::name> (source_);
+        pstore::raw_sstring_view const sym2_str = pstore::make_sstring_view ("sym2");
+        pstore::indirect_string_adder adder;
+        auto const sym2 = string_address::make (
+            adder.add (transaction, name_index, &sym2_str).first.get_address ());
+        adder.flush (transaction);
+
+        pstore::raw_sstring_view const external_str = pstore::make_sstring_view ("external");
+        auto const external = string_address::make (
+            name_index->find (source_, pstore::indirect_string{source_, &external_str})
+                .get_address ());
+        pstore::raw_sstring_view const triple_str = pstore::make_sstring_view ("triple");
+        auto const triple = string_address::make (
+            name_index->find (source_, pstore::indirect_string{source_, &triple_str})
+                .get_address ());
+
+        {
+            std::string const value = "new value";
+            std::shared_ptr<char> ptr;
+            auto where = pstore::typed_address<char>::null ();
+            std::tie (ptr, where) = transaction.alloc_rw<char> (value.length ());
+            std::memcpy (ptr.get (), value.data (), value.length ());
+            pstore::index::get_index<pstore::trailer::indices::write> (source_)->insert_or_assign (
+                transaction, std::string{"key"}, make_extent (where, value.length ()));
+        }
+
+        auto const compilation_index =
+            pstore::index::get_index<pstore::trailer::indices::compilation> (source_);
+        auto const c1 = compilation_index->find (source_, compilation1)->second;
+        std::array<linked_definitions::value_type, 1> const links{
+            {{compilation1, 0U, compilation::index_address (c1.addr, 0U)}}};
+
+        section_content text{section_kind::text, 4U};
+        text.data.assign ({0xC3});
+        text.xfixups.emplace_back (external, relocation_type{3}, reference_strength::strong,
+                                   std::uint64_t{0}, std::int64_t{0});
+        generic_section_creation_dispatcher text_dispatcher{section_kind::text, &text};
+        linked_definitions_creation_dispatcher ld_dispatcher{links.data (),
+                                                             links.data () + links.size ()};
+        std::array<section_creation_dispatcher *, 2> d{{&text_dispatcher, &ld_dispatcher}};
+        auto const fext =
+            fragment::alloc (transaction, pstore::make_pointee_adaptor (std::begin (d)),
+                             pstore::make_pointee_adaptor (std::end (d)));
+        pstore::index::get_index<pstore::trailer::indices::fragment> (source_)->insert (
+            transaction, std::make_pair (fragment2, fext));
+
+        std::array<definition, 1> const defs{{{fragment2, fext, sym2, linkage::external}}};
+        compilation_index->insert (
+            transaction,
+            std::make_pair (compilation2, compilation::alloc (transaction, triple,
+                                                              std::begin (defs),
+                                                              std::end (defs))));
+        transaction.commit ();
+    }
+    ASSERT_EQ (source_.get_current_revision (), 2U);
+
+    {
+        auto transaction = begin (destination_, lock_guard{mutex_});
+        copier.copy_since (transaction, 1U);
+        transaction.commit ();
+    }
+
+    auto const & db = destination_;
+    EXPECT_EQ (pstore::index::get_index<pstore::trailer::indices::name> (db)->size (), 5U);
+    {
+        auto const write = pstore::index::get_index<pstore::trailer::indices::write> (db);
+        ASSERT_EQ (write->size (), 1U);
+        auto const pos = write->find (db, std::string{"key"});
+        ASSERT_NE (pos, write->end (db));
+        std::shared_ptr<char const> const value = db.getro (pos->second);
+        EXPECT_EQ (std::string (value.get (), pos->second.size), "new value");
+    }
+
+    auto const fragments = pstore::index::get_index<pstore::trailer::indices::fragment> (db);
+    auto const compilations =
+        pstore::index::get_index<pstore::trailer::indices::compilation> (db);
+    ASSERT_EQ (fragments->size (), 3U);
+    ASSERT_EQ (compilations->size (), 3U);
+
+    auto const f2_pos = fragments->find (db, fragment2);
+    ASSERT_NE (f2_pos, fragments->end (db));
+    std::shared_ptr<fragment const> const f2 = fragment::load (db, f2_pos->second);
+    ASSERT_EQ (f2->at<section_kind::text> ().xfixups ().size (), 1U);
+    EXPECT_EQ (load_string (db, f2->at<section_kind::text> ().xfixups ().begin ()->name),
+               "external");
+    auto const & ld = f2->at<section_kind::linked_definitions> ();
+    ASSERT_EQ (ld.size (), 1U);
+    auto const c1_pos = compilations->find (db, compilation1);
+    ASSERT_NE (c1_pos, compilations->end (db));
+    EXPECT_EQ (ld.begin ()->pointer, compilation::index_address (c1_pos->second.addr, 0U));
+
+    auto const c2_pos = compilations->find (db, compilation2);
+    ASSERT_NE (c2_pos, compilations->end (db));
+    std::shared_ptr<compilation const> const c2 = compilation::load (db, c2_pos->second);
+    EXPECT_EQ (load_string (db, c2->triple ()), "triple");
+    ASSERT_EQ (c2->size (), 1U);
+    EXPECT_EQ ((*c2)[0].fext, f2_pos->second);
+    EXPECT_EQ (load_string (db, (*c2)[0].name), "sym2");
+}